@@ -0,0 +1,63 @@
+#include "bench.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+static void *bench_allocate(struct b6_allocator *self, unsigned long int size)
+{
+	return malloc(size);
+}
+
+static void *bench_reallocate(struct b6_allocator *self, void *ptr,
+			      unsigned long int size)
+{
+	return realloc(ptr, size);
+}
+
+static void bench_deallocate(struct b6_allocator *self, void *ptr)
+{
+	free(ptr);
+}
+
+static void *bench_allocate_aligned(struct b6_allocator *self,
+				    unsigned long int size,
+				    unsigned long int alignment)
+{
+	void *ptr;
+	if (alignment < sizeof(void*))
+		alignment = sizeof(void*);
+	return posix_memalign(&ptr, alignment, size) ? NULL : ptr;
+}
+
+static const struct b6_allocator_ops bench_allocator_ops = {
+	.allocate = bench_allocate,
+	.reallocate = bench_reallocate,
+	.deallocate = bench_deallocate,
+	.allocate_aligned = bench_allocate_aligned,
+};
+
+struct b6_allocator bench_allocator = { .ops = &bench_allocator_ops, };
+
+double bench_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+unsigned long int bench_random(unsigned long int *seed)
+{
+	/* xorshift64 */
+	unsigned long int x = *seed;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	return *seed = x;
+}
+
+void b6_assert_handler(const char *func, const char *file, int line, int type,
+		       const char *condition)
+{
+	fprintf(stderr, "%s (%s:%d): %s failed\n", func, file, line, condition);
+	abort();
+}
@@ -0,0 +1,20 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include "b6/allocator.h"
+
+#include <stdio.h>
+
+extern struct b6_allocator bench_allocator;
+
+extern double bench_time(void);
+
+extern unsigned long int bench_random(unsigned long int *seed);
+
+#define bench_report(name, ops, seconds) \
+	printf("%-40s %12.0f ops/s\n", name, (ops) / (seconds))
+
+#define bench_report_throughput(name, bytes, seconds) \
+	printf("%-40s %12.1f MB/s\n", name, (bytes) / (seconds) / 1e6)
+
+#endif /* BENCH_H_ */
@@ -0,0 +1,101 @@
+#include "b6/concurrent.h"
+#include "b6/pool.h"
+#include "bench.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+
+/*
+ * A producer allocates messages that a consumer releases, through a pool
+ * protected by a mutex or through a concurrent allocator wrapping the pool.
+ */
+
+#define RING 1024
+
+static unsigned long int messages = 10000000;
+static struct b6_pool pool;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct b6_concurrent_allocator shared;
+static int use_mutex;
+
+static void *slots[RING];
+static unsigned long int head, tail;
+
+static void *allocate(struct b6_allocator *allocator)
+{
+	void *ptr;
+	if (!use_mutex)
+		return b6_allocate(allocator, 48);
+	pthread_mutex_lock(&mutex);
+	ptr = b6_pool_get(&pool);
+	pthread_mutex_unlock(&mutex);
+	return ptr;
+}
+
+static void deallocate(struct b6_allocator *allocator, void *ptr)
+{
+	if (!use_mutex) {
+		b6_deallocate(allocator, ptr);
+		return;
+	}
+	pthread_mutex_lock(&mutex);
+	b6_pool_put(&pool, ptr);
+	pthread_mutex_unlock(&mutex);
+}
+
+static void *producer(void *arg)
+{
+	struct b6_allocator *allocator = b6_concurrent_attach(&shared);
+	unsigned long int i;
+	for (i = 0; i < messages; i += 1) {
+		void *ptr = allocate(allocator);
+		while (tail - __atomic_load_n(&head, __ATOMIC_ACQUIRE) == RING)
+			sched_yield();
+		slots[tail % RING] = ptr;
+		__atomic_store_n(&tail, tail + 1, __ATOMIC_RELEASE);
+	}
+	b6_concurrent_detach(allocator);
+	return NULL;
+}
+
+static void *consumer(void *arg)
+{
+	struct b6_allocator *allocator = b6_concurrent_attach(&shared);
+	unsigned long int i;
+	for (i = 0; i < messages; i += 1) {
+		while (__atomic_load_n(&tail, __ATOMIC_ACQUIRE) == head)
+			sched_yield();
+		deallocate(allocator, slots[head % RING]);
+		__atomic_store_n(&head, head + 1, __ATOMIC_RELEASE);
+	}
+	b6_concurrent_detach(allocator);
+	return NULL;
+}
+
+static double run(void)
+{
+	pthread_t threads[2];
+	double t = bench_time();
+	head = tail = 0;
+	pthread_create(&threads[0], NULL, producer, NULL);
+	pthread_create(&threads[1], NULL, consumer, NULL);
+	pthread_join(threads[0], NULL);
+	pthread_join(threads[1], NULL);
+	return bench_time() - t;
+}
+
+int main(int argc, const char *argv[])
+{
+	b6_pool_initialize_aligned(&pool, &bench_allocator,
+				   B6_CONCURRENT_SIZE(48), 0);
+	b6_concurrent_allocator_initialize(&shared, &pool.parent,
+					   &bench_allocator);
+	use_mutex = 1;
+	bench_report("mutex", messages, run());
+	use_mutex = 0;
+	bench_report("concurrent", messages, run());
+	b6_concurrent_allocator_finalize(&shared);
+	b6_pool_finalize(&pool);
+	return 0;
+}
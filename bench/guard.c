@@ -0,0 +1,63 @@
+#include "b6/guard.h"
+#include "b6/pool.h"
+#include "bench.h"
+
+#include <stdlib.h>
+
+#define LIVE 10000
+
+/* Replace random live allocations of random sizes up to max bytes. */
+static double churn(struct b6_allocator *allocator, unsigned long int max,
+		    unsigned long int ops)
+{
+	unsigned long int seed = 0x9e3779b97f4a7c15UL, i;
+	static void *ptrs[LIVE];
+	double t;
+	for (i = 0; i < LIVE; i += 1)
+		ptrs[i] = b6_allocate(allocator, 1 + i % max);
+	t = bench_time();
+	for (i = 0; i < ops; i += 1) {
+		unsigned long int r = bench_random(&seed);
+		unsigned long int j = r % LIVE;
+		b6_deallocate(allocator, ptrs[j]);
+		ptrs[j] = b6_allocate(allocator, 1 + (r >> 32) % max);
+		*(char *)ptrs[j] = 0;
+	}
+	t = bench_time() - t;
+	for (i = 0; i < LIVE; i += 1)
+		b6_deallocate(allocator, ptrs[i]);
+	return t;
+}
+
+/* Same with pool objects of 64 bytes. */
+static double pool_churn(struct b6_allocator *allocator, unsigned long int ops)
+{
+	struct b6_pool pool;
+	double t;
+	b6_pool_initialize_aligned(&pool, allocator, 64, 0);
+	t = churn(&pool.parent, 64, ops);
+	b6_pool_finalize(&pool);
+	return t;
+}
+
+int main(int argc, const char *argv[])
+{
+	unsigned long int ops = 10000000;
+	struct b6_guard guard;
+
+	bench_report("malloc", 2. * ops, churn(&bench_allocator, 256, ops));
+	b6_guard_initialize(&guard, &bench_allocator, 0);
+	bench_report("guard", 2. * ops, churn(&guard.parent, 256, ops));
+	b6_guard_finalize(&guard);
+	b6_guard_initialize(&guard, &bench_allocator, 1 << 20);
+	bench_report("guard 1MiB quarantine", 2. * ops,
+		     churn(&guard.parent, 256, ops));
+	b6_guard_finalize(&guard);
+
+	bench_report("pool", 2. * ops, pool_churn(&bench_allocator, ops));
+	b6_guard_initialize(&guard, &bench_allocator, 0);
+	bench_report("guarded pool", 2. * ops, pool_churn(&guard.parent, ops));
+	b6_guard_finalize(&guard);
+
+	return 0;
+}
@@ -0,0 +1,890 @@
+#include "b6/json.h"
+#include "bench.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct string_istream {
+	struct b6_json_istream up;
+	const char *ptr;
+	unsigned long int len;
+};
+
+static long int string_istream_read(struct b6_json_istream *up, void *buf,
+				    unsigned long int len)
+{
+	struct string_istream *self =
+		b6_cast_of(up, struct string_istream, up);
+	if (len > self->len)
+		len = self->len;
+	memcpy(buf, self->ptr, len);
+	self->ptr += len;
+	self->len -= len;
+	return len;
+}
+
+static const struct b6_json_istream_ops string_istream_ops = {
+	.read = string_istream_read,
+};
+
+/* Builds an object holding an array of n records mixing strings, numbers,
+ * literals and nesting, with some indentation. */
+static char *generate(unsigned long int n, unsigned long int *len)
+{
+	unsigned long int seed = 0x9e3779b97f4a7c15UL, i;
+	char *buf = malloc(n * 256 + 64), *ptr = buf;
+	if (!buf)
+		return NULL;
+	ptr += sprintf(ptr, "{\n  \"records\": [\n");
+	for (i = 0; i < n; i += 1) {
+		unsigned long int r = bench_random(&seed);
+		ptr += sprintf(ptr, "    {\"id\": %lu, \"name\": \"record "
+			       "number %lu\", \"score\": %lu.%02lu, "
+			       "\"tags\": [\"alpha\", \"beta\", \"gamma\"], "
+			       "\"valid\": %s, \"parent\": null}%s\n",
+			       i, r % 100000, r % 1000, r / 1000 % 100,
+			       r & 1 ? "true" : "false", i + 1 < n ? "," : "");
+	}
+	ptr += sprintf(ptr, "  ]\n}\n");
+	*len = ptr - buf;
+	return buf;
+}
+
+/* Builds an object holding an indented array of n long strings, some of
+ * them with non-ascii characters or escapes. */
+static char *generate_strings(unsigned long int n, unsigned long int *len)
+{
+	static const char text[] = "Lorem ipsum dolor sit amet, consectetur "
+		"adipiscing elit, sed do eiusmod tempor incididunt ut labore "
+		"et dolore magna aliqua. Ut enim ad minim veniam, quis nostrud "
+		"exercitation ullamco laboris nisi ut aliquip ex ea commodo.";
+	unsigned long int seed = 0x9e3779b97f4a7c15UL, i;
+	char *buf = malloc(n * (sizeof(text) + 32) + 64), *ptr = buf;
+	if (!buf)
+		return NULL;
+	ptr += sprintf(ptr, "{\n  \"strings\": [\n");
+	for (i = 0; i < n; i += 1) {
+		unsigned long int r = bench_random(&seed);
+		int k = 32 + r % (sizeof(text) - 33);
+		ptr += sprintf(ptr, "    \"%.*s%s\"%s\n", k, text,
+			       r & 0x100 ? " caf\xc3\xa9" :
+			       r & 0x200 ? "\\n" : "", i + 1 < n ? "," : "");
+	}
+	ptr += sprintf(ptr, "  ]\n}\n");
+	*len = ptr - buf;
+	return buf;
+}
+
+/* Builds an object holding an array of n numbers: integers, decimals with a
+ * few digits and doubles printed with all their digits. */
+static char *generate_numbers(unsigned long int n, unsigned long int *len)
+{
+	static const double scale[] = { 1e-20, 1e-5, 1, 1e3, 1e8, 1e20 };
+	unsigned long int seed = 0x9e3779b97f4a7c15UL, i;
+	char *buf = malloc(n * 32 + 64), *ptr = buf;
+	if (!buf)
+		return NULL;
+	ptr += sprintf(ptr, "{\"numbers\":[");
+	for (i = 0; i < n; i += 1) {
+		unsigned long int r = bench_random(&seed);
+		const char *sep = i + 1 < n ? "," : "";
+		switch (i % 3) {
+		case 0:
+			ptr += sprintf(ptr, "%ld%s", (long int)r >> 40, sep);
+			break;
+		case 1:
+			ptr += sprintf(ptr, "%lu.%02lu%s", r % 10000,
+				       r / 10000 % 100, sep);
+			break;
+		default:
+			ptr += sprintf(ptr, "%.17g%s",
+				       (double)(r >> 11) / (1UL << 53) *
+				       scale[r % b6_card_of(scale)], sep);
+		}
+	}
+	ptr += sprintf(ptr, "]}");
+	*len = ptr - buf;
+	return buf;
+}
+
+static double parse(struct b6_json *json, const char *doc,
+		    unsigned long int len, char *buf, unsigned long int size,
+		    unsigned long int runs)
+{
+	double t = bench_time();
+	unsigned long int i;
+	for (i = 0; i < runs; i += 1) {
+		struct string_istream is;
+		struct b6_json_object *object = b6_json_new_object(json);
+		if (!object)
+			return -1;
+		b6_json_setup_istream(&is.up, &string_istream_ops);
+		if (buf)
+			b6_json_setup_buffered_istream(&is.up, is.up.ops, buf,
+						       size);
+		is.ptr = doc;
+		is.len = len;
+		if (b6_json_parse_object(object, &is.up, NULL))
+			return -1;
+		b6_json_unref_value(&object->up);
+	}
+	return bench_time() - t;
+}
+
+static double parse_memory(struct b6_json *json, const char *doc,
+			   unsigned long int len, unsigned long int runs)
+{
+	double t = bench_time();
+	unsigned long int i;
+	for (i = 0; i < runs; i += 1) {
+		struct b6_json_istream is;
+		struct b6_json_object *object = b6_json_new_object(json);
+		if (!object)
+			return -1;
+		b6_json_setup_memory_istream(&is, doc, len);
+		if (b6_json_parse_object(object, &is, NULL))
+			return -1;
+		b6_json_unref_value(&object->up);
+	}
+	return bench_time() - t;
+}
+
+static double parse_file(struct b6_json *json, const char *doc,
+			 unsigned long int len, unsigned long int runs)
+{
+	char path[] = "/tmp/b6-bench-json-XXXXXX";
+	double t = -1;
+	unsigned long int i;
+	FILE *file;
+	int fd;
+	if ((fd = mkstemp(path)) < 0)
+		return -1;
+	if (!(file = fdopen(fd, "w"))) {
+		close(fd);
+		goto out;
+	}
+	if (fwrite(doc, 1, len, file) != len) {
+		fclose(file);
+		goto out;
+	}
+	fclose(file);
+	t = bench_time();
+	for (i = 0; i < runs; i += 1) {
+		struct b6_json_file_istream is;
+		struct b6_json_object *object = b6_json_new_object(json);
+		if (!object || b6_json_open_file_istream(&is, path)) {
+			t = -1;
+			goto out;
+		}
+		if (b6_json_parse_object(object, &is.up, NULL))
+			t = -1;
+		b6_json_unref_value(&object->up);
+		b6_json_close_file_istream(&is);
+		if (t < 0)
+			goto out;
+	}
+	t = bench_time() - t;
+out:
+	unlink(path);
+	return t;
+}
+
+/* Writes n records on as many lines to a temporary file, streaming them so
+ * that the file can be larger than memory. */
+static int generate_ndjson(char *path, unsigned long int n,
+			   unsigned long int *len)
+{
+	unsigned long int seed = 0x9e3779b97f4a7c15UL, i;
+	FILE *file;
+	int fd;
+	if ((fd = mkstemp(path)) < 0)
+		return -1;
+	if (!(file = fdopen(fd, "w"))) {
+		close(fd);
+		unlink(path);
+		return -1;
+	}
+	for (i = 0; i < n; i += 1) {
+		unsigned long int r = bench_random(&seed);
+		fprintf(file, "{\"id\": %lu, \"name\": \"record number %lu\", "
+			"\"score\": %lu.%02lu, \"tags\": [\"alpha\", \"beta\", "
+			"\"gamma\"], \"valid\": %s, \"parent\": null}\n",
+			i, r % 100000, r % 1000, r / 1000 % 100,
+			r & 1 ? "true" : "false");
+	}
+	*len = ftell(file);
+	if (fclose(file)) {
+		unlink(path);
+		return -1;
+	}
+	return 0;
+}
+
+/* Parsing stops with an I/O error when the end of the input is reached. */
+static int at_end(struct b6_json_istream *is, enum b6_json_error error)
+{
+	return error == B6_JSON_IO_ERROR && !b6_json_istream_avail(is);
+}
+
+/* Sums the ids and scores of all the records of a file. */
+static double parse_ndjson_dom(struct b6_json *json, const char *path,
+			       double *sum)
+{
+	struct b6_json_file_istream is;
+	double t = bench_time();
+	*sum = 0;
+	if (b6_json_open_file_istream(&is, path))
+		return -1;
+	for (;;) {
+		struct b6_json_object *object = b6_json_new_object(json);
+		struct b6_json_number *number;
+		enum b6_json_error error;
+		if (!object) {
+			t = -1;
+			break;
+		}
+		error = b6_json_parse_object(object, &is.up, NULL);
+		if (!error) {
+			if ((number = b6_json_get_object_as(object,
+							    B6_UTF8("id"),
+							    number)))
+				*sum += b6_json_get_number(number);
+			if ((number = b6_json_get_object_as(object,
+							    B6_UTF8("score"),
+							    number)))
+				*sum += b6_json_get_number(number);
+		}
+		b6_json_unref_value(&object->up);
+		if (error) {
+			if (!at_end(&is.up, error))
+				t = -1;
+			break;
+		}
+	}
+	b6_json_close_file_istream(&is);
+	return t < 0 ? t : bench_time() - t;
+}
+
+struct sum_handler {
+	struct b6_json_handler up;
+	unsigned int depth;
+	int selected;
+	double sum;
+};
+
+static enum b6_json_error sum_enter(struct b6_json_handler *up)
+{
+	b6_cast_of(up, struct sum_handler, up)->depth += 1;
+	return B6_JSON_OK;
+}
+
+static enum b6_json_error sum_leave(struct b6_json_handler *up)
+{
+	b6_cast_of(up, struct sum_handler, up)->depth -= 1;
+	return B6_JSON_OK;
+}
+
+static enum b6_json_error sum_key(struct b6_json_handler *up,
+				  const struct b6_utf8 *key)
+{
+	struct sum_handler *self = b6_cast_of(up, struct sum_handler, up);
+	self->selected = self->depth == 1 &&
+		((key->nbytes == 2 && !memcmp(key->ptr, "id", 2)) ||
+		 (key->nbytes == 5 && !memcmp(key->ptr, "score", 5)));
+	return B6_JSON_OK;
+}
+
+static enum b6_json_error sum_number(struct b6_json_handler *up, double d)
+{
+	struct sum_handler *self = b6_cast_of(up, struct sum_handler, up);
+	if (self->selected)
+		self->sum += d;
+	return B6_JSON_OK;
+}
+
+static const struct b6_json_handler_ops sum_handler_ops = {
+	.enter_object = sum_enter,
+	.leave_object = sum_leave,
+	.key = sum_key,
+	.enter_array = sum_enter,
+	.leave_array = sum_leave,
+	.number = sum_number,
+};
+
+static double parse_ndjson_events(const char *path, double *sum)
+{
+	struct sum_handler handler = { .up = { .ops = &sum_handler_ops, }, };
+	struct b6_json_event_parser parser;
+	struct b6_json_file_istream is;
+	double t = bench_time();
+	*sum = 0;
+	if (b6_json_open_file_istream(&is, path))
+		return -1;
+	b6_json_event_parser_initialize(&parser, &bench_allocator);
+	for (;;) {
+		enum b6_json_error error =
+			b6_json_parse_events(&parser, &is.up, &handler.up,
+					     NULL);
+		if (error) {
+			if (!at_end(&is.up, error))
+				t = -1;
+			break;
+		}
+	}
+	b6_json_event_parser_finalize(&parser);
+	b6_json_close_file_istream(&is);
+	*sum = handler.sum;
+	return t < 0 ? t : bench_time() - t;
+}
+
+struct record {
+	long long int id;
+	struct b6_utf8_string name;
+	double score;
+	int valid;
+};
+
+static const struct b6_json_field record_fields[] = {
+	{ "id", b6_offset_of(struct record, id), B6_JSON_FIELD_INTEGER,
+	  B6_JSON_FIELD_REQUIRED },
+	{ "name", b6_offset_of(struct record, name), B6_JSON_FIELD_STRING },
+	{ "score", b6_offset_of(struct record, score), B6_JSON_FIELD_NUMBER },
+	{ "valid", b6_offset_of(struct record, valid), B6_JSON_FIELD_BOOLEAN },
+};
+
+/* Decodes the records of a file into a struct, skipping their tags. */
+static double parse_ndjson_struct(const char *path, double *sum)
+{
+	struct b6_json_struct_parser parser;
+	struct b6_json_file_istream is;
+	struct b6_json_schema schema;
+	struct record record;
+	double t = bench_time();
+	*sum = 0;
+	if (b6_json_open_file_istream(&is, path))
+		return -1;
+	b6_json_struct_parser_initialize(&parser, &bench_allocator);
+	b6_json_schema_initialize(&schema, &bench_allocator);
+	b6_initialize_utf8_string(&record.name, &bench_allocator);
+	if (b6_json_compile_schema(&schema, record_fields,
+				   b6_card_of(record_fields)))
+		t = -1;
+	while (t >= 0) {
+		enum b6_json_error error =
+			b6_json_parse_struct(&parser, &is.up, &schema, &record,
+					     NULL);
+		if (error) {
+			if (!at_end(&is.up, error))
+				t = -1;
+			break;
+		}
+		*sum += record.id;
+		*sum += record.score;
+	}
+	b6_finalize_utf8_string(&record.name);
+	b6_json_schema_finalize(&schema);
+	b6_json_struct_parser_finalize(&parser);
+	b6_json_close_file_istream(&is);
+	return t < 0 ? t : bench_time() - t;
+}
+
+/* Sums the values a pointer selects in all the records of a file. */
+static double parse_ndjson_selected(const char *path, const char *text,
+				    double *sum)
+{
+	struct sum_handler handler = {
+		.up = { .ops = &sum_handler_ops, },
+		.selected = 1,
+	};
+	struct b6_json_event_parser parser;
+	struct b6_json_pointer pointer;
+	struct b6_json_file_istream is;
+	struct b6_utf8 utf8;
+	double t;
+	b6_json_pointer_initialize(&pointer, &bench_allocator);
+	b6_setup_utf8(&utf8, text, strlen(text));
+	if (b6_json_compile_pointer(&pointer, &utf8) ||
+	    b6_json_open_file_istream(&is, path)) {
+		b6_json_pointer_finalize(&pointer);
+		return -1;
+	}
+	b6_json_event_parser_initialize(&parser, &bench_allocator);
+	t = bench_time();
+	for (;;) {
+		enum b6_json_error error =
+			b6_json_parse_selected_events(&parser, &is.up,
+						      &pointer, &handler.up,
+						      NULL);
+		if (error) {
+			if (!at_end(&is.up, error))
+				t = -1;
+			break;
+		}
+	}
+	b6_json_event_parser_finalize(&parser);
+	b6_json_close_file_istream(&is);
+	b6_json_pointer_finalize(&pointer);
+	*sum += handler.sum;
+	return t < 0 ? t : bench_time() - t;
+}
+
+/* Pushes the file by chunks of size bytes as if it came from a socket. */
+static double parse_ndjson_push(const char *path, unsigned long int size,
+				double *sum)
+{
+	struct sum_handler handler = { .up = { .ops = &sum_handler_ops, }, };
+	struct b6_json_push_parser parser;
+	static char buf[65536];
+	double t = bench_time();
+	int fd = open(path, O_RDONLY);
+	long int len;
+	*sum = 0;
+	if (fd < 0)
+		return -1;
+	b6_json_push_parser_initialize(&parser, &handler.up, &bench_allocator);
+	while ((len = read(fd, buf, size)) > 0)
+		if (b6_json_push_parser_feed(&parser, buf, len))
+			break;
+	if (len || b6_json_push_parser_finish(&parser))
+		t = -1;
+	b6_json_push_parser_finalize(&parser);
+	close(fd);
+	*sum = handler.sum;
+	return t < 0 ? t : bench_time() - t;
+}
+
+/* Builds an object of n keys then looks each of them up runs times. */
+struct record_sum {
+	struct b6_json_record_handler up;
+	double sum;
+};
+
+static enum b6_json_error sum_record(struct b6_json_record_handler *up,
+				     struct b6_json_object *object,
+				     unsigned long int offset)
+{
+	struct record_sum *self = b6_cast_of(up, struct record_sum, up);
+	struct b6_json_number *number;
+	if ((number = b6_json_get_object_as(object, B6_UTF8("id"), number)))
+		self->sum += b6_json_get_number(number);
+	if ((number = b6_json_get_object_as(object, B6_UTF8("score"), number)))
+		self->sum += b6_json_get_number(number);
+	return B6_JSON_OK;
+}
+
+static const struct b6_json_record_handler_ops sum_record_ops = {
+	.record = sum_record,
+};
+
+/* Records are delivered in order so that the sum needs no lock and adds up
+ * like the other readers. */
+static double parse_ndjson_threads(const char *path, unsigned int nthreads,
+				   double *sum)
+{
+	struct record_sum handler = { .up = { .ops = &sum_record_ops, }, };
+	struct b6_json_file_istream is;
+	double t = bench_time();
+	*sum = 0;
+	if (b6_json_open_file_istream(&is, path))
+		return -1;
+	if (b6_json_parse_ndjson(is.up.ptr, b6_json_istream_avail(&is.up),
+				 &handler.up, &bench_allocator, nthreads,
+				 B6_JSON_NDJSON_ORDERED))
+		t = -1;
+	b6_json_close_file_istream(&is);
+	*sum = handler.sum;
+	return t < 0 ? t : bench_time() - t;
+}
+
+/* Builds n records of 200 fields, most of them nested values. */
+static char *generate_wide(unsigned long int n, unsigned long int *len)
+{
+	char *buf = malloc(n * 200 * 64 + 1), *ptr = buf;
+	unsigned long int i, j;
+	if (!buf)
+		return NULL;
+	for (i = 0; i < n; i += 1) {
+		ptr += sprintf(ptr, "{\"id\": %lu, \"route\": \"svc-%lu\"", i,
+			       i % 7);
+		for (j = 0; j < 198; j += 1)
+			ptr += sprintf(ptr, ", \"f%lu\": {\"x\": %lu, "
+				       "\"y\": [1, 2, 3], \"s\": \"text\"}",
+				       j, i + j);
+		ptr += sprintf(ptr, "}\n");
+	}
+	*len = ptr - buf;
+	return buf;
+}
+
+/* Reads 3 fields of each record. */
+static double route_records(struct b6_json *json, const char *doc,
+			    unsigned long int len, double *sum)
+{
+	struct b6_json_istream is;
+	double t = bench_time();
+	b6_json_setup_memory_istream(&is, doc, len);
+	*sum = 0;
+	for (;;) {
+		struct b6_json_object *object = b6_json_new_object(json), *f;
+		struct b6_json_number *number;
+		struct b6_json_string *route;
+		enum b6_json_error error;
+		if (!object)
+			return -1;
+		if (!(error = b6_json_parse_object(object, &is, NULL))) {
+			if ((number = b6_json_get_object_as(object,
+							    B6_UTF8("id"),
+							    number)))
+				*sum += b6_json_get_number(number);
+			if ((route = b6_json_get_object_as(object,
+							   B6_UTF8("route"),
+							   string)))
+				*sum += b6_json_get_string(route)->nbytes;
+			if ((f = b6_json_get_object_as(object,
+						       B6_UTF8("f7"),
+						       object)) &&
+			    (number = b6_json_get_object_as(f, B6_UTF8("x"),
+							    number)))
+				*sum += b6_json_get_number(number);
+		}
+		b6_json_unref_value(&object->up);
+		if (error)
+			return at_end(&is, error) ? bench_time() - t : -1;
+	}
+}
+
+static double lookup_keys(struct b6_json *json, unsigned long int n,
+			  unsigned long int runs)
+{
+	struct b6_json_object *object = b6_json_new_object(json);
+	char (*keys)[24] = malloc(n * sizeof(*keys));
+	double t = -1;
+	unsigned long int i;
+	if (!object || !keys)
+		goto out;
+	t = bench_time();
+	for (i = 0; i < n; i += 1) {
+		struct b6_json_number *number = b6_json_new_number(json, i);
+		struct b6_utf8 utf8;
+		sprintf(keys[i], "some_field_%lu", i);
+		b6_utf8_from_ascii(&utf8, keys[i]);
+		if (!number || b6_json_set_object(object, &utf8, &number->up)) {
+			t = -1;
+			goto out;
+		}
+	}
+	while (runs--)
+		for (i = 0; i < n; i += 1) {
+			struct b6_utf8 utf8;
+			b6_utf8_from_ascii(&utf8, keys[i]);
+			if (!b6_json_get_object(object, &utf8)) {
+				t = -1;
+				goto out;
+			}
+		}
+	t = bench_time() - t;
+out:
+	if (object)
+		b6_json_unref_value(&object->up);
+	free(keys);
+	return t;
+}
+
+struct null_ostream {
+	struct b6_json_ostream up;
+	unsigned long int len;
+	unsigned long int writes;
+};
+
+static long int null_ostream_write(struct b6_json_ostream *up,
+				   const void *buf, unsigned long int len)
+{
+	struct null_ostream *self = b6_cast_of(up, struct null_ostream, up);
+	self->len += len;
+	self->writes += 1;
+	return len;
+}
+
+static int null_ostream_flush(struct b6_json_ostream *up)
+{
+	return 0;
+}
+
+static const struct b6_json_ostream_ops null_ostream_ops = {
+	.write = null_ostream_write,
+	.flush = null_ostream_flush,
+};
+
+/* Serializes n random doubles spanning the whole range of exponents. */
+static double serialize_doubles(struct b6_json *json, unsigned long int n,
+				unsigned long int *len)
+{
+	unsigned long int seed = 0x9e3779b97f4a7c15UL, i;
+	struct b6_json_default_serializer serializer;
+	struct null_ostream os;
+	struct b6_json_number *number = b6_json_new_number(json, 0);
+	double t;
+	if (!number)
+		return -1;
+	b6_json_setup_ostream(&os.up, &null_ostream_ops);
+	b6_json_setup_default_serializer(&serializer);
+	os.len = os.writes = 0;
+	t = bench_time();
+	for (i = 0; i < n; i += 1) {
+		unsigned long int r = bench_random(&seed);
+		double d;
+		/* Skip infinities and NaNs. */
+		r &= ~(1UL << 62);
+		__builtin_memcpy(&d, &r, sizeof(d));
+		b6_json_set_number(number, d);
+		if (b6_json_serialize_value(&number->up, &os.up,
+					    &serializer.up))
+			return -1;
+	}
+	t = bench_time() - t;
+	b6_json_unref_value(&number->up);
+	*len = os.len;
+	return t;
+}
+
+/* Serializes a document through a window of size bytes (the default one when
+ * buf is NULL) or into an array when size is 0. */
+static double serialize_document(struct b6_json *json, const char *doc,
+				 unsigned long int len, char *buf,
+				 unsigned long int size, unsigned long int runs,
+				 unsigned long int *writes)
+{
+	struct b6_json_default_serializer serializer;
+	struct b6_json_object *object = b6_json_new_object(json);
+	struct b6_json_array_ostream aos;
+	struct null_ostream os;
+	struct b6_json_istream is;
+	double t = -1;
+	b6_json_setup_default_serializer(&serializer);
+	b6_json_setup_memory_istream(&is, doc, len);
+	if (!object || b6_json_parse_object(object, &is, NULL))
+		goto out;
+	t = bench_time();
+	while (runs--) {
+		struct b6_json_ostream *up = &os.up;
+		if (buf && !size) {
+			b6_json_array_ostream_initialize(&aos,
+							 &bench_allocator);
+			up = &aos.up;
+		} else if (buf)
+			b6_json_setup_buffered_ostream(up, &null_ostream_ops,
+						       buf, size);
+		else
+			b6_json_setup_ostream(up, &null_ostream_ops);
+		os.len = os.writes = 0;
+		if (b6_json_serialize_object(object, up, &serializer.up))
+			t = -1;
+		if (up == &aos.up)
+			b6_json_array_ostream_finalize(&aos);
+		if (t < 0)
+			goto out;
+	}
+	t = bench_time() - t;
+	*writes = os.writes;
+out:
+	if (object)
+		b6_json_unref_value(&object->up);
+	return t;
+}
+
+/* Serializes a document into an array and parses it back, as text or as
+ * CBOR, and returns the size of the encoding in len. */
+static double round_trip(struct b6_json *json, const char *doc,
+			 unsigned long int *len, int cbor,
+			 unsigned long int runs)
+{
+	struct b6_json_default_serializer serializer;
+	struct b6_json_object *object = b6_json_new_object(json);
+	struct b6_json_array_ostream os;
+	struct b6_json_istream is;
+	double t = -1;
+	b6_json_setup_default_serializer(&serializer);
+	b6_json_setup_memory_istream(&is, doc, *len);
+	if (!object || b6_json_parse_object(object, &is, NULL))
+		goto out;
+	t = bench_time();
+	while (runs--) {
+		struct b6_json_value *value = NULL;
+		enum b6_json_error error;
+		b6_json_array_ostream_initialize(&os, &bench_allocator);
+		error = cbor ? b6_json_serialize_cbor(&object->up, &os.up) :
+			b6_json_serialize_object(object, &os.up,
+						 &serializer.up);
+		*len = b6_json_array_ostream_len(&os);
+		b6_json_setup_memory_istream(&is,
+					     b6_json_array_ostream_data(&os),
+					     *len);
+		if (error)
+			;
+		else if (cbor)
+			error = b6_json_parse_cbor(json, &is, &value);
+		else if (!(value = &b6_json_new_object(json)->up))
+			error = B6_JSON_ALLOC_ERROR;
+		else
+			error = b6_json_parse_object(
+				b6_json_value_as(value, object), &is, NULL);
+		if (value)
+			b6_json_unref_value(value);
+		b6_json_array_ostream_finalize(&os);
+		if (error) {
+			t = -1;
+			goto out;
+		}
+	}
+	t = bench_time() - t;
+out:
+	if (object)
+		b6_json_unref_value(&object->up);
+	return t;
+}
+
+int main(int argc, const char *argv[])
+{
+	unsigned long int n = argc > 1 ? strtoul(argv[1], NULL, 0) : 10000;
+	unsigned long int runs = 20, len, i;
+	static const struct {
+		enum b6_json_isa isa;
+		const char *name;
+	} isas[] = {
+		{ B6_JSON_ISA_SCALAR, "scalar" },
+		{ B6_JSON_ISA_SSE2, "sse2" },
+		{ B6_JSON_ISA_AVX2, "avx2" },
+	};
+	static char buf[65536];
+	char path[] = "/tmp/b6-bench-json-XXXXXX";
+	struct b6_json_default_impl impl;
+	struct b6_json json;
+	char *doc = generate(n, &len), *doc2;
+	double t;
+	if (!doc)
+		return 1;
+	b6_json_default_impl_initialize(&impl, &bench_allocator);
+	b6_json_initialize(&json, &impl.up, &bench_allocator);
+	t = parse(&json, doc, len, buf, 1, runs);
+	bench_report_throughput("parse 1-byte reads", 1. * runs * len, t);
+	t = parse(&json, doc, len, NULL, 0, runs);
+	bench_report_throughput("parse default buffer", 1. * runs * len, t);
+	t = parse(&json, doc, len, buf, sizeof(buf), runs);
+	bench_report_throughput("parse 64KiB buffer", 1. * runs * len, t);
+	t = parse_memory(&json, doc, len, runs);
+	bench_report_throughput("parse memory", 1. * runs * len, t);
+	t = parse_file(&json, doc, len, runs);
+	bench_report_throughput("parse mapped file", 1. * runs * len, t);
+	if (!generate_ndjson(path, n * 10, &i)) {
+		double dom, events;
+		t = parse_ndjson_dom(&json, path, &dom);
+		bench_report_throughput("ndjson dom", 1. * i, t);
+		t = parse_ndjson_events(path, &events);
+		bench_report_throughput("ndjson events", 1. * i, t);
+		if (dom != events)
+			fprintf(stderr, "ndjson sums differ\n");
+		t = parse_ndjson_struct(path, &events);
+		bench_report_throughput("ndjson struct", 1. * i, t);
+		if (dom != events)
+			fprintf(stderr, "ndjson sums differ\n");
+		events = 0;
+		t = parse_ndjson_selected(path, "/id", &events);
+		bench_report_throughput("ndjson selected /id", 1. * i, t);
+		t = parse_ndjson_selected(path, "/score", &events);
+		bench_report_throughput("ndjson selected /score", 1. * i, t);
+		/* Ids and scores are not added in the same order. */
+		if (dom - events > dom * 1e-12 || events - dom > dom * 1e-12)
+			fprintf(stderr, "ndjson sums differ\n");
+		t = parse_ndjson_push(path, 1500, &events);
+		bench_report_throughput("ndjson push 1500-byte chunks", 1. * i,
+					t);
+		t = parse_ndjson_push(path, sizeof(buf), &events);
+		bench_report_throughput("ndjson push 64KiB chunks", 1. * i, t);
+		if (dom != events)
+			fprintf(stderr, "ndjson sums differ\n");
+		t = parse_ndjson_threads(path, 1, &events);
+		bench_report_throughput("ndjson 1 thread", 1. * i, t);
+		t = parse_ndjson_threads(path, 4, &events);
+		bench_report_throughput("ndjson 4 threads", 1. * i, t);
+		t = parse_ndjson_threads(path, 0, &events);
+		bench_report_throughput("ndjson 1 thread per processor", 1. * i,
+					t);
+		if (dom != events)
+			fprintf(stderr, "ndjson sums differ\n");
+		unlink(path);
+	}
+	if ((doc2 = generate_wide(n / 10, &i))) {
+		double eager, lazy;
+		t = route_records(&json, doc2, i, &eager);
+		bench_report_throughput("route records", 1. * i, t);
+		json.flags = B6_JSON_LAZY;
+		t = route_records(&json, doc2, i, &lazy);
+		bench_report_throughput("route records lazily", 1. * i, t);
+		json.flags = 0;
+		if (eager != lazy)
+			fprintf(stderr, "routes differ\n");
+		free(doc2);
+	}
+	t = lookup_keys(&json, 8, n);
+	bench_report("lookup 8 keys", 8. * (n + 1), t);
+	t = lookup_keys(&json, n, runs);
+	bench_report("lookup many keys", 1. * n * (runs + 1), t);
+	t = serialize_document(&json, doc, len, buf, 1, runs, &i);
+	bench_report_throughput("serialize 1-byte writes", 1. * runs * len, t);
+	t = serialize_document(&json, doc, len, NULL, 0, runs, &i);
+	bench_report_throughput("serialize default buffer", 1. * runs * len,
+				t);
+	printf("%-40s %12lu writes\n", "", i);
+	t = serialize_document(&json, doc, len, buf, sizeof(buf), runs, &i);
+	bench_report_throughput("serialize 64KiB buffer", 1. * runs * len, t);
+	printf("%-40s %12lu writes\n", "", i);
+	t = serialize_document(&json, doc, len, buf, 0, runs, &i);
+	bench_report_throughput("serialize array", 1. * runs * len, t);
+	i = len;
+	t = round_trip(&json, doc, &i, 0, runs);
+	bench_report_throughput("round trip text", 1. * runs * len, t);
+	printf("%-40s %12lu bytes\n", "", i);
+	i = len;
+	t = round_trip(&json, doc, &i, 1, runs);
+	bench_report_throughput("round trip cbor", 1. * runs * len, t);
+	printf("%-40s %12lu bytes\n", "", i);
+	free(doc);
+	if (!(doc = generate_strings(n, &len)))
+		return 1;
+	for (i = 0; i < b6_card_of(isas); i += 1) {
+		char name[64];
+		if (b6_json_select_isa(isas[i].isa))
+			continue;
+		t = parse(&json, doc, len, buf, sizeof(buf), runs);
+		snprintf(name, sizeof(name), "strings %-6s 64KiB buffer",
+			 isas[i].name);
+		bench_report_throughput(name, 1. * runs * len, t);
+		t = parse_memory(&json, doc, len, runs);
+		snprintf(name, sizeof(name), "strings %-6s memory",
+			 isas[i].name);
+		bench_report_throughput(name, 1. * runs * len, t);
+	}
+	free(doc);
+	if (!(doc = generate_numbers(n * 10, &len)))
+		return 1;
+	t = parse_memory(&json, doc, len, runs);
+	bench_report_throughput("numbers memory", 1. * runs * len, t);
+	t = serialize_doubles(&json, n * 100, &len);
+	bench_report("serialize doubles", 100. * n, t);
+	free(doc);
+	if (!(doc = generate(n, &len)))
+		return 1;
+	b6_json_default_impl_intern_keys(&impl);
+	t = parse(&json, doc, len, buf, sizeof(buf), runs);
+	bench_report_throughput("parse 64KiB buffer interned keys",
+				1. * runs * len, t);
+	t = parse_memory(&json, doc, len, runs);
+	bench_report_throughput("parse memory interned keys", 1. * runs * len,
+				t);
+	b6_json_finalize(&json);
+	b6_json_default_impl_finalize(&impl);
+	free(doc);
+	return 0;
+}
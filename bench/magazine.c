@@ -0,0 +1,93 @@
+#include "b6/magazine.h"
+#include "bench.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#define LIVE 1000
+
+static unsigned long int ops = 10000000;
+static struct b6_pool pool;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct b6_magazine_depot depot;
+
+static void *mutex_thread(void *arg)
+{
+	unsigned long int seed = (unsigned long int)arg, i;
+	void *ptrs[LIVE];
+	for (i = 0; i < LIVE; i += 1) {
+		pthread_mutex_lock(&mutex);
+		ptrs[i] = b6_pool_get(&pool);
+		pthread_mutex_unlock(&mutex);
+	}
+	for (i = 0; i < ops; i += 1) {
+		unsigned long int j = bench_random(&seed) % LIVE;
+		pthread_mutex_lock(&mutex);
+		b6_pool_put(&pool, ptrs[j]);
+		pthread_mutex_unlock(&mutex);
+		pthread_mutex_lock(&mutex);
+		ptrs[j] = b6_pool_get(&pool);
+		pthread_mutex_unlock(&mutex);
+	}
+	pthread_mutex_lock(&mutex);
+	for (i = 0; i < LIVE; i += 1)
+		b6_pool_put(&pool, ptrs[i]);
+	pthread_mutex_unlock(&mutex);
+	return NULL;
+}
+
+static void *magazine_thread(void *arg)
+{
+	unsigned long int seed = (unsigned long int)arg, i;
+	struct b6_magazine_cache cache;
+	void *ptrs[LIVE];
+	if (b6_magazine_cache_initialize(&cache, &depot))
+		abort();
+	for (i = 0; i < LIVE; i += 1)
+		ptrs[i] = b6_magazine_get(&cache);
+	for (i = 0; i < ops; i += 1) {
+		unsigned long int j = bench_random(&seed) % LIVE;
+		b6_magazine_put(&cache, ptrs[j]);
+		ptrs[j] = b6_magazine_get(&cache);
+	}
+	for (i = 0; i < LIVE; i += 1)
+		b6_magazine_put(&cache, ptrs[i]);
+	b6_magazine_cache_finalize(&cache);
+	return NULL;
+}
+
+static double run(void *(*func)(void*), unsigned long int n)
+{
+	pthread_t threads[n];
+	unsigned long int i;
+	double t = bench_time();
+	for (i = 0; i < n; i += 1)
+		pthread_create(&threads[i], NULL, func, (void*)(i * 2 + 1));
+	for (i = 0; i < n; i += 1)
+		pthread_join(threads[i], NULL);
+	return bench_time() - t;
+}
+
+int main(int argc, const char *argv[])
+{
+	unsigned long int max = argc > 1 ? strtoul(argv[1], NULL, 0) : 16;
+	unsigned long int n;
+	for (n = 1; n <= max; n *= 2) {
+		char name[64];
+		double t;
+		b6_pool_initialize_aligned(&pool, &bench_allocator, 32, 0);
+		t = run(mutex_thread, n);
+		b6_pool_finalize(&pool);
+		snprintf(name, sizeof(name), "mutex    threads=%lu", n);
+		bench_report(name, 2. * ops * n, t);
+		b6_pool_initialize_aligned(&pool, &bench_allocator, 32, 0);
+		b6_magazine_depot_initialize(&depot, &pool, &bench_allocator,
+					     64);
+		t = run(magazine_thread, n);
+		b6_magazine_depot_finalize(&depot);
+		b6_pool_finalize(&pool);
+		snprintf(name, sizeof(name), "magazine threads=%lu", n);
+		bench_report(name, 2. * ops * n, t);
+	}
+	return 0;
+}
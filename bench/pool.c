@@ -0,0 +1,62 @@
+#include "b6/pool.h"
+#include "bench.h"
+
+#include <stdlib.h>
+
+/*
+ * Keep n objects alive and repeatedly release a random one and allocate a new
+ * one in its place, so that every b6_pool_get recycles an object and has to
+ * find its chunk.
+ */
+static double churn(struct b6_pool *pool, void **ptrs, unsigned long int n,
+		    unsigned long int ops)
+{
+	unsigned long int seed = 0x9e3779b97f4a7c15UL, i;
+	double t;
+	for (i = 0; i < n; i += 1)
+		if (!(ptrs[i] = b6_pool_get(pool)))
+			return -1;
+	t = bench_time();
+	for (i = 0; i < ops; i += 1) {
+		unsigned long int j = bench_random(&seed) % n;
+		b6_pool_put(pool, ptrs[j]);
+		ptrs[j] = b6_pool_get(pool);
+	}
+	t = bench_time() - t;
+	for (i = 0; i < n; i += 1)
+		b6_pool_put(pool, ptrs[i]);
+	return t;
+}
+
+int main(int argc, const char *argv[])
+{
+	unsigned long int max = argc > 1 ? strtoul(argv[1], NULL, 0) : 10000000;
+	unsigned long int ops = 10000000;
+	unsigned long int n;
+	void **ptrs = malloc(max * sizeof(void*));
+	if (!ptrs)
+		return 1;
+	for (n = 1000; n <= max; n *= 10) {
+		struct b6_pool pool;
+		char name[64];
+		double t;
+		b6_pool_initialize(&pool, &bench_allocator, 32, 0);
+		t = churn(&pool, ptrs, n, ops);
+		b6_pool_finalize(&pool);
+		snprintf(name, sizeof(name), "tree    live=%lu", n);
+		bench_report(name, 2. * ops, t);
+		b6_pool_initialize_aligned(&pool, &bench_allocator, 32, 0);
+		t = churn(&pool, ptrs, n, ops);
+		b6_pool_finalize(&pool);
+		snprintf(name, sizeof(name), "aligned live=%lu", n);
+		bench_report(name, 2. * ops, t);
+		b6_pool_initialize_aligned(&pool, &bench_allocator, 32, 0);
+		b6_pool_set_threshold(&pool, 65536);
+		t = churn(&pool, ptrs, n, ops);
+		b6_pool_finalize(&pool);
+		snprintf(name, sizeof(name), "trimmed live=%lu", n);
+		bench_report(name, 2. * ops, t);
+	}
+	free(ptrs);
+	return 0;
+}
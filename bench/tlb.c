@@ -0,0 +1,123 @@
+#include "b6/mmap.h"
+#include "b6/pool.h"
+#include "bench.h"
+
+#include <linux/perf_event.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+ * Link the objects of a large pool in a random cycle and chase pointers
+ * through it, so that almost every step touches another page.
+ */
+
+struct object {
+	struct object *next;
+	char pad[56];
+};
+
+static int open_counter(void)
+{
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HW_CACHE;
+	attr.config = PERF_COUNT_HW_CACHE_DTLB |
+		PERF_COUNT_HW_CACHE_OP_READ << 8 |
+		PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void run(const char *name, struct b6_pool *pool, struct object **objs,
+		unsigned long int n, unsigned long int steps)
+{
+	unsigned long int seed = 0x9e3779b97f4a7c15UL, i;
+	long long int misses = -1;
+	struct object *obj;
+	char label[64];
+	double t;
+	int fd;
+
+	for (i = 0; i < n; i += 1)
+		if (!(objs[i] = b6_pool_get(pool))) {
+			fprintf(stderr, "%s: out of memory\n", name);
+			return;
+		}
+	/* shuffle then link */
+	for (i = n - 1; i > 0; i -= 1) {
+		unsigned long int j = bench_random(&seed) % (i + 1);
+		obj = objs[i];
+		objs[i] = objs[j];
+		objs[j] = obj;
+	}
+	for (i = 0; i < n; i += 1)
+		objs[i]->next = objs[(i + 1) % n];
+
+	fd = open_counter();
+	if (fd >= 0) {
+		ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+	t = bench_time();
+	for (obj = objs[0], i = 0; i < steps; i += 1)
+		obj = obj->next;
+	t = bench_time() - t;
+	if (fd >= 0) {
+		ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(fd, &misses, sizeof(misses)) != sizeof(misses))
+			misses = -1;
+		close(fd);
+	}
+	/* keep the chase from being optimized away */
+	if (!obj)
+		abort();
+
+	snprintf(label, sizeof(label), "%s steps", name);
+	bench_report(label, steps, t);
+	if (misses >= 0)
+		printf("%-40s %12.3f dTLB misses/step\n", name,
+		       (double)misses / steps);
+	else
+		printf("%-40s %12s dTLB misses/step\n", name, "n/a");
+}
+
+int main(int argc, const char *argv[])
+{
+	unsigned long int mb = argc > 1 ? strtoul(argv[1], NULL, 0) : 512;
+	unsigned long int n = (mb << 20) / sizeof(struct object);
+	unsigned long int steps = 20000000;
+	struct b6_mmap_allocator mmap;
+	struct b6_pool pool;
+	struct object **objs = malloc(n * sizeof(*objs));
+
+	if (!objs)
+		return 1;
+
+	b6_pool_initialize(&pool, &bench_allocator, sizeof(struct object), 0);
+	run("malloc 4KiB chunks", &pool, objs, n, steps);
+	b6_pool_finalize(&pool);
+
+	b6_mmap_allocator_initialize(&mmap, 0);
+	b6_pool_initialize_aligned(&pool, &mmap.parent, sizeof(struct object),
+				   B6_MMAP_HUGE_PAGE_SIZE);
+	run("mmap 2MiB chunks", &pool, objs, n, steps);
+	b6_pool_finalize(&pool);
+	b6_mmap_allocator_finalize(&mmap);
+
+	b6_mmap_allocator_initialize(&mmap,
+				     B6_MMAP_HUGETLB | B6_MMAP_HUGEPAGE);
+	b6_pool_initialize_aligned(&pool, &mmap.parent, sizeof(struct object),
+				   B6_MMAP_HUGE_PAGE_SIZE);
+	run("huge pages 2MiB chunks", &pool, objs, n, steps);
+	b6_pool_finalize(&pool);
+	b6_mmap_allocator_finalize(&mmap);
+
+	free(objs);
+	return 0;
+}
@@ -17,6 +17,12 @@ struct b6_allocator_ops {
 	void *(*allocate)(struct b6_allocator*, unsigned long int);
 	void *(*reallocate)(struct b6_allocator*, void*, unsigned long int);
 	void (*deallocate)(struct b6_allocator*, void*);
+	void *(*allocate_aligned)(struct b6_allocator*, unsigned long int,
+				  unsigned long int);
+	unsigned long int (*allocate_n)(struct b6_allocator*,
+					unsigned long int, void**,
+					unsigned long int);
+	void (*deallocate_n)(struct b6_allocator*, void**, unsigned long int);
 };
 
 extern struct b6_allocator b6_oom_allocator;
@@ -40,6 +46,17 @@ static inline void *b6_reallocate(struct b6_allocator *self, void *ptr,
 	return NULL;
 }
 
+static inline void *b6_allocate_aligned(struct b6_allocator *self,
+					unsigned long int size,
+					unsigned long int alignment)
+{
+	b6_precond(self->ops);
+	b6_precond(b6_is_apot(alignment));
+	if (self->ops->allocate_aligned)
+		return self->ops->allocate_aligned(self, size, alignment);
+	return NULL;
+}
+
 static inline void b6_deallocate(struct b6_allocator *self, void *ptr)
 {
 	b6_precond(self->ops);
@@ -48,6 +65,32 @@ static inline void b6_deallocate(struct b6_allocator *self, void *ptr)
 		self->ops->deallocate(self, ptr);
 }
 
+static inline unsigned long int b6_allocate_n(struct b6_allocator *self,
+					      unsigned long int size,
+					      void **ptrs,
+					      unsigned long int n)
+{
+	unsigned long int i;
+	b6_precond(self->ops);
+	if (self->ops->allocate_n)
+		return self->ops->allocate_n(self, size, ptrs, n);
+	for (i = 0; i < n; i += 1)
+		if (!(ptrs[i] = b6_allocate(self, size)))
+			break;
+	return i;
+}
+
+static inline void b6_deallocate_n(struct b6_allocator *self, void **ptrs,
+				   unsigned long int n)
+{
+	b6_precond(self->ops);
+	if (self->ops->deallocate_n)
+		self->ops->deallocate_n(self, ptrs, n);
+	else
+		while (n--)
+			b6_deallocate(self, *ptrs++);
+}
+
 struct b6_fixed_allocator {
 	struct b6_allocator allocator;
 	void *buf;
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2015, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+/**
+ * @file arena.h
+ * @brief Region allocator releasing memory all at once.
+ */
+
+#ifndef B6_ARENA_H_
+#define B6_ARENA_H_
+
+#include "b6/allocator.h"
+
+/**
+ * @brief An arena allocates memory by bumping a pointer within blocks obtained
+ * from another allocator.
+ *
+ * Releasing memory is a no-op, except for the latest allocation. Instead,
+ * everything allocated after a mark is released at once, in a time
+ * proportional to the number of blocks involved.
+ *
+ * For instance, a whole JSON document can be dropped without walking its
+ * values:
+ *
+ * @code
+ * struct b6_arena arena;
+ * struct b6_arena_mark mark;
+ * struct b6_json_default_impl impl;
+ * struct b6_json json;
+ *
+ * b6_arena_initialize(&arena, &some_allocator, 0);
+ * b6_arena_mark(&arena, &mark);
+ * b6_json_default_impl_initialize(&impl, &arena.parent);
+ * b6_json_initialize(&json, &impl.up, &arena.parent);
+ * ... parse and use the document ...
+ * b6_arena_release_to_mark(&arena, &mark);
+ * @endcode
+ */
+struct b6_arena {
+	struct b6_allocator parent; /**< an arena is a kind of allocator */
+	struct b6_allocator *allocator; /**< underlying allocator */
+	struct b6_arena_block *block; /**< block allocations are bumped in */
+	char *ptr; /**< first free byte in the current block */
+	char *end; /**< end of the current block */
+	char *last; /**< latest allocation or NULL */
+	unsigned long int block_size; /**< minimum size of a block */
+};
+
+/**
+ * @brief Header of the blocks of an arena.
+ */
+struct b6_arena_block {
+	struct b6_arena_block *prev; /**< block allocated before this one */
+	char *end; /**< end of the block */
+};
+
+/**
+ * @brief Position within an arena to release memory to.
+ */
+struct b6_arena_mark {
+	struct b6_arena_block *block; /**< current block when marked */
+	char *ptr; /**< first free byte in the block when marked */
+};
+
+/**
+ * @brief Initialize an arena.
+ * @param self specifies the arena to initialize.
+ * @param allocator specifies the allocator to get blocks from.
+ * @param block_size specifies the minimum size of blocks in bytes, or 0 to let
+ * the arena choose.
+ */
+extern void b6_arena_initialize(struct b6_arena *self,
+				struct b6_allocator *allocator,
+				unsigned long int block_size);
+
+/**
+ * @brief Finalize an arena, releasing all its memory.
+ * @param self specifies the arena to finalize.
+ */
+extern void b6_arena_finalize(struct b6_arena *self);
+
+/**
+ * @brief Remember the current position within an arena.
+ * @param self specifies the arena.
+ * @param mark specifies where to store the position.
+ */
+static inline void b6_arena_mark(const struct b6_arena *self,
+				 struct b6_arena_mark *mark)
+{
+	mark->block = self->block;
+	mark->ptr = self->ptr;
+}
+
+/**
+ * @brief Release everything allocated since a mark was set.
+ *
+ * Marks set after this one become invalid.
+ *
+ * @param self specifies the arena.
+ * @param mark specifies a position previously returned by b6_arena_mark.
+ */
+extern void b6_arena_release_to_mark(struct b6_arena *self,
+				     const struct b6_arena_mark *mark);
+
+#endif /* B6_ARENA_H_ */
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2015, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+/**
+ * @file atomic.h
+ * @brief Minimal synchronization primitives for multi-threaded code.
+ */
+
+#ifndef B6_ATOMIC_H_
+#define B6_ATOMIC_H_
+
+#include "b6/utils.h"
+
+/**
+ * @brief Tell the processor the current thread is busy waiting.
+ */
+static inline void b6_cpu_relax(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#endif
+}
+
+/**
+ * @brief A lock that busy waits until it can be acquired.
+ *
+ * Spin locks are meant to protect short critical sections which are rarely
+ * contended.
+ */
+struct b6_spinlock {
+	int lock; /**< whether the lock is held */
+};
+
+#define B6_SPINLOCK_INIT { 0 }
+
+/**
+ * @brief Initialize a spin lock in the released state.
+ * @param self specifies the spin lock.
+ */
+static inline void b6_spinlock_initialize(struct b6_spinlock *self)
+{
+	self->lock = 0;
+}
+
+/**
+ * @brief Acquire a spin lock.
+ * @param self specifies the spin lock.
+ */
+static inline void b6_spinlock_acquire(struct b6_spinlock *self)
+{
+	while (__atomic_exchange_n(&self->lock, 1, __ATOMIC_ACQUIRE))
+		while (__atomic_load_n(&self->lock, __ATOMIC_RELAXED))
+			b6_cpu_relax();
+}
+
+/**
+ * @brief Release a spin lock.
+ * @pre The spin lock is held by the caller.
+ * @param self specifies the spin lock.
+ */
+static inline void b6_spinlock_release(struct b6_spinlock *self)
+{
+	__atomic_store_n(&self->lock, 0, __ATOMIC_RELEASE);
+}
+
+#endif /* B6_ATOMIC_H_ */
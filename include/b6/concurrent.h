@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2015, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+/**
+ * @file concurrent.h
+ * @brief Thread-safe adapter of allocators.
+ *
+ * A concurrent allocator wraps an allocator so that several threads can share
+ * it. Each thread allocates and releases memory through its own cache, that
+ * keeps released blocks in bins of sizes. The wrapped allocator is only
+ * called, under a spin lock, when a bin runs empty or overflows.
+ *
+ * Blocks have a header recording the cache which allocated them. A thread
+ * releasing a block of another thread pushes it onto the remote list of that
+ * cache without locking, and the owner takes back all its remote blocks at
+ * once when a bin runs empty. Thus a producer thread can allocate objects
+ * that a consumer thread releases:
+ *
+ * @code
+ * struct b6_pool pool;
+ * struct b6_concurrent_allocator shared;
+ *
+ * b6_pool_initialize_aligned(&pool, &some_allocator,
+ *                            B6_CONCURRENT_SIZE(sizeof(struct message)), 0);
+ * b6_concurrent_allocator_initialize(&shared, &pool.parent, &some_allocator);
+ *
+ * void *producer(void *arg)
+ * {
+ *   struct b6_allocator *allocator = b6_concurrent_attach(&shared);
+ *   struct message *msg = b6_allocate(allocator, sizeof(*msg));
+ *   ... send msg ...
+ *   b6_concurrent_detach(allocator);
+ * }
+ *
+ * void *consumer(void *arg)
+ * {
+ *   struct b6_allocator *allocator = b6_concurrent_attach(&shared);
+ *   ... receive msg ...
+ *   b6_deallocate(allocator, msg);
+ *   b6_concurrent_detach(allocator);
+ * }
+ * @endcode
+ */
+
+#ifndef B6_CONCURRENT_H_
+#define B6_CONCURRENT_H_
+
+#include "b6/allocator.h"
+#include "b6/atomic.h"
+#include "b6/list.h"
+
+/**
+ * @brief Size of the header of blocks.
+ */
+#define B6_CONCURRENT_HEADER 16
+
+/**
+ * @brief Number of bins of a cache.
+ *
+ * Bins hold blocks of 16, 32, ... 16 * B6_CONCURRENT_BINS bytes. Larger
+ * blocks are allocated and released by the wrapped allocator directly.
+ */
+#define B6_CONCURRENT_BINS 32
+
+/**
+ * @brief Size the wrapped allocator is asked for when allocating size bytes.
+ *
+ * Pools that are wrapped must have objects of this size.
+ */
+#define B6_CONCURRENT_SIZE(size) \
+	((((size) + 15) & ~15UL) + B6_CONCURRENT_HEADER)
+
+/**
+ * @brief The shared part of a concurrent allocator.
+ */
+struct b6_concurrent_allocator {
+	struct b6_spinlock lock; /**< protects the fields below */
+	struct b6_allocator *allocator; /**< wrapped allocator */
+	struct b6_allocator *cache_allocator; /**< where caches come from */
+	struct b6_list caches; /**< caches in use */
+	struct b6_list orphans; /**< caches detached from their thread */
+};
+
+/**
+ * @brief Free blocks of the same size.
+ */
+struct b6_concurrent_bin {
+	void *head; /**< stack of blocks */
+	unsigned int count; /**< number of blocks */
+};
+
+/**
+ * @brief The per-thread part of a concurrent allocator.
+ */
+struct b6_concurrent_cache {
+	struct b6_allocator parent; /**< a cache is a kind of allocator */
+	struct b6_dref dref; /**< in the list of caches or orphans */
+	struct b6_concurrent_allocator *shared; /**< shared part */
+	void *remote; /**< blocks released by other threads */
+	struct b6_concurrent_bin bins[B6_CONCURRENT_BINS]; /**< free blocks */
+};
+
+/**
+ * @brief Initialize a concurrent allocator.
+ * @param self specifies the concurrent allocator.
+ * @param allocator specifies the allocator to wrap. It must not be used
+ * directly as long as the concurrent allocator is.
+ * @param cache_allocator specifies the allocator for caches. It is only
+ * called while the concurrent allocator is locked.
+ */
+extern void b6_concurrent_allocator_initialize(
+	struct b6_concurrent_allocator *self, struct b6_allocator *allocator,
+	struct b6_allocator *cache_allocator);
+
+/**
+ * @brief Finalize a concurrent allocator.
+ *
+ * Blocks cached are returned to the wrapped allocator and caches are released.
+ *
+ * @pre Every cache has been detached.
+ * @param self specifies the concurrent allocator.
+ */
+extern void b6_concurrent_allocator_finalize(
+	struct b6_concurrent_allocator *self);
+
+/**
+ * @brief Get a cache for the calling thread.
+ *
+ * Caches detached by other threads are reused first.
+ *
+ * @param self specifies the concurrent allocator.
+ * @return the allocator the thread has to use or NULL if out of memory.
+ */
+extern struct b6_allocator *b6_concurrent_attach(
+	struct b6_concurrent_allocator *self);
+
+/**
+ * @brief Give up the cache of the calling thread.
+ *
+ * Blocks it allocated can still be released by other threads afterwards.
+ *
+ * @param allocator specifies the allocator returned by b6_concurrent_attach.
+ */
+extern void b6_concurrent_detach(struct b6_allocator *allocator);
+
+#endif /* B6_CONCURRENT_H_ */
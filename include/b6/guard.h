@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2015, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+/**
+ * @file guard.h
+ * @brief Allocator wrapper checking memory misuses.
+ */
+
+#ifndef B6_GUARD_H_
+#define B6_GUARD_H_
+
+#include "b6/allocator.h"
+#include "b6/list.h"
+
+/**
+ * @brief An allocator wrapping another one to catch memory misuses.
+ *
+ * Each allocation is surrounded by redzones and recorded with the address of
+ * the code that allocated it in a table, so that live allocations can be
+ * listed to find leaks. Released memory is poisoned and put in quarantine for
+ * a while before being given back to the underlying allocator.
+ *
+ * Errors are reported through b6_check, thus whatever the value of NDEBUG:
+ * - releasing memory twice or memory that was not allocated by the guard,
+ * - writing before or after an allocation,
+ * - writing to memory in quarantine, which is detected when it leaves it.
+ *
+ * Pools which chunks are allocated by a guard also check their objects: they
+ * mark and poison released objects and verify them when they are allocated
+ * again, and detect objects released twice. Objects smaller than 16 bytes
+ * have no room for this and are not checked.
+ *
+ * Costs are a few memory accesses per allocation and per byte released, plus
+ * memory held in quarantine, so that a guard can stay enabled in canaries:
+ *
+ * @code
+ * struct b6_guard guard;
+ * struct b6_json_default_impl impl;
+ *
+ * b6_guard_initialize(&guard, &some_allocator, 0);
+ * b6_json_default_impl_initialize(&impl, &guard.parent);
+ * ...
+ * @endcode
+ */
+struct b6_guard {
+	struct b6_allocator parent; /**< a guard is a kind of allocator */
+	struct b6_allocator *allocator; /**< underlying allocator */
+	struct b6_guard_block **slots; /**< live allocations or free slots */
+	unsigned long int nslots; /**< number of slots in use or free */
+	unsigned long int maxslots; /**< capacity of the table of slots */
+	unsigned long int free; /**< first free slot plus one or 0 if none */
+	struct b6_list quarantine; /**< released allocations, oldest first */
+	unsigned long int quarantined; /**< bytes in quarantine */
+	unsigned long int capacity; /**< maximum bytes in quarantine */
+};
+
+/**
+ * @brief Header of the allocations of a guard.
+ */
+struct b6_guard_block {
+	struct b6_dref dref; /**< in the quarantine list */
+	const void *site; /**< address of the allocating code */
+	unsigned long int size; /**< size in bytes asked */
+	unsigned long int slot; /**< index in the table of live allocations */
+	unsigned int offset; /**< offset of memory in the actual block */
+	unsigned int magic; /**< state of the block */
+};
+
+/**
+ * @brief Size of the redzone between the header and memory.
+ */
+#define B6_GUARD_REDZONE 16
+
+/**
+ * @brief Value of the bytes of released memory.
+ */
+#define B6_GUARD_POISON 0xdd
+
+extern const struct b6_allocator_ops b6_guard_ops;
+
+/**
+ * @brief Test whether memory is poisoned.
+ * @param ptr specifies the memory.
+ * @param len specifies its size in bytes.
+ * @return true if every byte is B6_GUARD_POISON.
+ */
+extern int b6_guard_poisoned(const void *ptr, unsigned long int len);
+
+/**
+ * @brief Initialize a guard.
+ * @param self specifies the guard.
+ * @param allocator specifies the allocator to wrap.
+ * @param capacity specifies how many bytes to hold in quarantine at most, or
+ * 0 to release memory at once.
+ */
+extern void b6_guard_initialize(struct b6_guard *self,
+				struct b6_allocator *allocator,
+				unsigned long int capacity);
+
+/**
+ * @brief Finalize a guard.
+ *
+ * Memory in quarantine is checked and released, as well as allocations still
+ * alive.
+ *
+ * @param self specifies the guard.
+ * @return how many allocations were still alive, that is leaked.
+ */
+extern unsigned long int b6_guard_finalize(struct b6_guard *self);
+
+/**
+ * @brief Test whether an allocator is a guard.
+ * @param allocator specifies the allocator.
+ * @return true if allocator is a guard.
+ */
+static inline int b6_is_guard(const struct b6_allocator *allocator)
+{
+	return allocator->ops == &b6_guard_ops;
+}
+
+/**
+ * @brief Get the first live allocation of a guard.
+ *
+ * Live allocations are walked in no particular order.
+ *
+ * @param self specifies the guard.
+ * @return the header of the allocation or NULL if there is none.
+ */
+extern struct b6_guard_block *b6_guard_first(const struct b6_guard *self);
+
+/**
+ * @brief Get the live allocation after another one.
+ * @param self specifies the guard.
+ * @param block specifies the current allocation.
+ * @return the header of the next allocation or NULL if there is none.
+ */
+extern struct b6_guard_block *b6_guard_next(const struct b6_guard *self,
+					    const struct b6_guard_block *block);
+
+/**
+ * @brief Get the memory of an allocation.
+ * @param block specifies the header of the allocation.
+ * @return the pointer returned to the caller who allocated it.
+ */
+static inline void *b6_guard_block_ptr(const struct b6_guard_block *block)
+{
+	return (char *)(block + 1) + B6_GUARD_REDZONE;
+}
+
+#endif /* B6_GUARD_H_ */
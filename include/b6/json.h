@@ -17,40 +17,195 @@ enum b6_json_error {
 
 extern const char *b6_json_strerror(enum b6_json_error);
 
+/* Instruction sets the parser can scan its input with. The best one the
+ * processor supports is used unless another one is selected. */
+enum b6_json_isa {
+	B6_JSON_ISA_SCALAR,
+	B6_JSON_ISA_SSE2,
+	B6_JSON_ISA_AVX2,
+};
+
+/* Returns -1 when the processor does not support the instruction set. */
+extern int b6_json_select_isa(enum b6_json_isa);
+
+#define B6_JSON_ISTREAM_SIZE 256
+
+/* Bytes are consumed from the [ptr, end) window of buf, which the read
+ * operation refills by chunks of up to size bytes. */
 struct b6_json_istream {
 	const struct b6_json_istream_ops *ops;
-	char c;
-	short int has_c;
+	const char *ptr;
+	const char *end;
+	char *buf;
+	unsigned long int size;
+	char tmp[B6_JSON_ISTREAM_SIZE];
 };
 
 struct b6_json_istream_ops {
 	long int (*read)(struct b6_json_istream*, void*, unsigned long int);
 };
 
+static inline void b6_json_setup_buffered_istream(
+	struct b6_json_istream *self, const struct b6_json_istream_ops *ops,
+	char *buf, unsigned long int size)
+{
+	self->ops = ops;
+	self->ptr = self->end = self->buf = buf;
+	self->size = size;
+}
+
 static inline void b6_json_setup_istream(struct b6_json_istream *self,
 					 const struct b6_json_istream_ops *ops)
 {
-	self->ops = ops;
-	self->has_c = 0;
+	b6_json_setup_buffered_istream(self, ops, self->tmp, sizeof(self->tmp));
 }
 
-struct b6_json_ostream {
-	const struct b6_json_ostream_ops *ops;
+extern const struct b6_json_istream_ops b6_json_memory_istream_ops;
+
+/* Reads from a contiguous document without copying it: the window spans the
+ * whole document and is never refilled. Strings without escapes are parsed
+ * as references to the document, which has to outlive them. */
+static inline void b6_json_setup_memory_istream(struct b6_json_istream *self,
+						const void *buf,
+						unsigned long int len)
+{
+	b6_json_setup_buffered_istream(self, &b6_json_memory_istream_ops,
+				       (char*)buf, 0);
+	self->end += len;
+}
+
+static inline int b6_json_istream_is_addressable(
+	const struct b6_json_istream *self)
+{
+	return !self->size;
+}
+
+/* A memory istream over a read-only private mapping of a file. */
+struct b6_json_file_istream {
+	struct b6_json_istream up;
+	void *addr;
+	unsigned long int len;
 };
 
-static inline void b6_json_setup_ostream(struct b6_json_ostream *self,
-					 const struct b6_json_ostream_ops *ops)
+extern enum b6_json_error b6_json_open_file_istream(
+	struct b6_json_file_istream*, const char *path);
+
+extern void b6_json_close_file_istream(struct b6_json_file_istream*);
+
+/* Moves the pending bytes at the beginning of the buffer and reads until at
+ * least n bytes are available, the stream ends or the buffer is full. Returns
+ * the number of bytes available or a negative value on error. */
+extern long int b6_json_istream_refill(struct b6_json_istream*,
+				       unsigned long int n);
+
+static inline unsigned long int b6_json_istream_avail(
+	const struct b6_json_istream *self)
 {
-	self->ops = ops;
+	return self->end - self->ptr;
+}
+
+/* Returns a pointer to the next n bytes without consuming them, or NULL when
+ * fewer than n bytes are left. n cannot exceed the size of the buffer. */
+static inline const char *b6_json_istream_peek(struct b6_json_istream *self,
+					       unsigned long int n)
+{
+	if (b6_unlikely(b6_json_istream_avail(self) < n) &&
+	    b6_json_istream_refill(self, n) < (long int)n)
+		return NULL;
+	return self->ptr;
+}
+
+static inline void b6_json_istream_advance(struct b6_json_istream *self,
+					   unsigned long int n)
+{
+	b6_precond(n <= b6_json_istream_avail(self));
+	self->ptr += n;
 }
 
+#define B6_JSON_OSTREAM_SIZE 256
+
+/* Bytes are gathered in the [buf, end) window of the stream: ptr points past
+ * the last pending byte. The write operation is called with the pending bytes
+ * when the window is full or flushed, and directly with the writes that do
+ * not fit in an empty window. */
+struct b6_json_ostream {
+	const struct b6_json_ostream_ops *ops;
+	char *ptr;
+	char *end;
+	char *buf;
+	unsigned long int size;
+	unsigned int depth;
+	char tmp[B6_JSON_OSTREAM_SIZE];
+};
 
 struct b6_json_ostream_ops {
 	long int (*write)(struct b6_json_ostream*, const void*,
 			  unsigned long int);
 	int (*flush)(struct b6_json_ostream*);
+	/* Optional: hands the pending bytes over and makes room for at least
+	 * n bytes in the window, which the stream manages by itself. */
+	int (*drain)(struct b6_json_ostream*, unsigned long int n);
+};
+
+static inline void b6_json_setup_buffered_ostream(
+	struct b6_json_ostream *self, const struct b6_json_ostream_ops *ops,
+	char *buf, unsigned long int size)
+{
+	self->ops = ops;
+	self->ptr = self->buf = buf;
+	self->end = buf + size;
+	self->size = size;
+	self->depth = 0;
+}
+
+static inline void b6_json_setup_ostream(struct b6_json_ostream *self,
+					 const struct b6_json_ostream_ops *ops)
+{
+	b6_json_setup_buffered_ostream(self, ops, self->tmp, sizeof(self->tmp));
+}
+
+/* Called when len bytes do not fit in the window. */
+extern long int b6_json_ostream_write_slow(struct b6_json_ostream*,
+					   const void*, unsigned long int len);
+
+static inline long int b6_json_ostream_write(struct b6_json_ostream *self,
+					     const void *buf,
+					     unsigned long int len)
+{
+	if (b6_unlikely(len > (unsigned long int)(self->end - self->ptr)))
+		return b6_json_ostream_write_slow(self, buf, len);
+	__builtin_memcpy(self->ptr, buf, len);
+	self->ptr += len;
+	return len;
+}
+
+/* Writes the pending bytes out and flushes the stream. */
+extern int b6_json_ostream_flush(struct b6_json_ostream*);
+
+/* An ostream gathering its output in an array of bytes, which is up to date
+ * once the stream is flushed. */
+struct b6_json_array_ostream {
+	struct b6_json_ostream up;
+	struct b6_array array;
 };
 
+extern void b6_json_array_ostream_initialize(struct b6_json_array_ostream*,
+					     struct b6_allocator*);
+
+extern void b6_json_array_ostream_finalize(struct b6_json_array_ostream*);
+
+static inline const char *b6_json_array_ostream_data(
+	const struct b6_json_array_ostream *self)
+{
+	return (const char*)self->array.buffer;
+}
+
+static inline unsigned long int b6_json_array_ostream_len(
+	const struct b6_json_array_ostream *self)
+{
+	return self->array.length;
+}
+
 struct b6_json_value {
 	const struct b6_json_value_ops *ops;
 	unsigned int refcount;
@@ -78,8 +233,12 @@ struct b6_json_false {
 
 struct b6_json_number {
 	struct b6_json_value up;
-	double number;
+	union {
+		double number;
+		long long int integer;
+	};
 	struct b6_json *json;
+	int is_integer;
 };
 
 struct b6_json_string {
@@ -110,12 +269,21 @@ struct b6_json_iterator {
 	struct b6_json_pair *pair;
 };
 
+/* Parse integers that fit in 64 bits as such instead of as doubles. */
+#define B6_JSON_PRESERVE_INTEGERS 1
+
+/* Parse nested objects and arrays from memory istreams only when they are
+ * first accessed, if the implementation supports it: until then, their bytes
+ * are merely bracket-matched and have to outlive the document. */
+#define B6_JSON_LAZY 2
+
 struct b6_json {
 	struct b6_pool pool;
 	struct b6_json_impl *impl;
 	struct b6_json_null json_null;
 	struct b6_json_true json_true;
 	struct b6_json_false json_false;
+	unsigned int flags;
 };
 
 struct b6_json_impl {
@@ -127,6 +295,25 @@ struct b6_json_impl_ops {
 	struct b6_json_string_impl *(*string_impl)(struct b6_json_impl*,
 						   const struct b6_utf8*);
 	struct b6_json_object_impl *(*object_impl)(struct b6_json_impl*);
+	/* Optional: references the bytes of the string instead of copying
+	 * them until it is modified. */
+	struct b6_json_string_impl *(*string_view_impl)(struct b6_json_impl*,
+							const struct b6_utf8*);
+	/* Optional: returns a new reference to a string of the document
+	 * shared by all the keys with the same bytes. */
+	struct b6_json_string *(*intern_key)(struct b6_json_impl*,
+					     struct b6_json*,
+					     const struct b6_utf8*);
+	/* Optional: references the bytes of an object or an array of the
+	 * document to parse them once accessed. */
+	struct b6_json_object_impl *(*lazy_object_impl)(struct b6_json_impl*,
+							struct b6_json*,
+							const void*,
+							unsigned long int);
+	struct b6_json_array_impl *(*lazy_array_impl)(struct b6_json_impl*,
+						      struct b6_json*,
+						      const void*,
+						      unsigned long int);
 };
 
 struct b6_json_parser_info {
@@ -203,9 +390,12 @@ static inline enum b6_json_error b6_json_serialize_value(
 	const struct b6_json_value *self, struct b6_json_ostream *os,
 	struct b6_json_serializer *serializer)
 {
-	enum b6_json_error error = self->ops->serialize(self, os, serializer);
-	if (!error)
-		os->ops->flush(os);
+	enum b6_json_error error;
+	os->depth += 1;
+	error = self->ops->serialize(self, os, serializer);
+	/* Nested values are flushed along with the outermost one. */
+	if (!--os->depth && !error && b6_json_ostream_flush(os))
+		error = B6_JSON_IO_ERROR;
 	return error;
 }
 
@@ -242,6 +432,7 @@ static inline void b6_json_initialize(struct b6_json *self,
 	b6_json_setup_value(&self->json_true.up, &b6_json_true_ops);
 	b6_json_setup_value(&self->json_false.up, &b6_json_false_ops);
 	self->impl = impl;
+	self->flags = 0;
 	b6_pool_initialize(&self->pool, allocator,
 			   sizeof(union b6_json_element), 0);
 }
@@ -284,10 +475,41 @@ static inline void b6_json_set_number(struct b6_json_number *self,
 				      double number)
 {
 	self->number = number;
+	self->is_integer = 0;
 }
 
 static inline double b6_json_get_number(const struct b6_json_number *self)
 {
+	return self->is_integer ? (double)self->integer : self->number;
+}
+
+static inline void b6_json_set_integer(struct b6_json_number *self,
+				       long long int integer)
+{
+	self->integer = integer;
+	self->is_integer = 1;
+}
+
+/* Tells whether the number holds an exact 64-bit integer, which only
+ * happens when set as such or parsed with B6_JSON_PRESERVE_INTEGERS. Other
+ * numbers are truncated toward zero as integers, clamped to the range of
+ * long long int, and NaN is 0. */
+static inline int b6_json_number_is_integer(const struct b6_json_number *self)
+{
+	return self->is_integer;
+}
+
+static inline long long int b6_json_get_integer(
+	const struct b6_json_number *self)
+{
+	if (self->is_integer)
+		return self->integer;
+	if (self->number != self->number)
+		return 0;
+	if (self->number >= 9223372036854775808.)
+		return ~0ULL >> 1;
+	if (self->number < -9223372036854775808.)
+		return -(long long int)(~0ULL >> 1) - 1;
 	return self->number;
 }
 
@@ -298,7 +520,7 @@ static inline struct b6_json_number *b6_json_new_number(struct b6_json *json,
 	if (!(self = b6_pool_get(&json->pool)))
 		return NULL;
 	b6_json_setup_value(&self->up, &b6_json_number_ops);
-	self->number = d;
+	b6_json_set_number(self, d);
 	self->json = json;
 	return self;
 }
@@ -330,6 +552,36 @@ static inline struct b6_json_string *b6_json_new_string(
 	return self;
 }
 
+/* Same as b6_json_new_string but the string may keep a reference to slice,
+ * which then has to outlive it. */
+static inline struct b6_json_string *b6_json_new_string_view(
+	struct b6_json *json, const struct b6_utf8 *slice)
+{
+	struct b6_json_string *self;
+	if (!json->impl->ops->string_view_impl)
+		return b6_json_new_string(json, slice);
+	if (!(self = b6_pool_get(&json->pool)))
+		return NULL;
+	if (!(self->impl = json->impl->ops->string_view_impl(json->impl,
+							     slice))) {
+		b6_pool_put(&json->pool, self);
+		return NULL;
+	}
+	b6_json_setup_value(&self->up, &b6_json_string_ops);
+	self->json = json;
+	return self;
+}
+
+/* Same as b6_json_new_string for the key of a pair, which may be shared with
+ * other keys and must not be modified then. */
+static inline struct b6_json_string *b6_json_new_key(
+	struct b6_json *json, const struct b6_utf8 *slice)
+{
+	if (!json->impl->ops->intern_key)
+		return b6_json_new_string(json, slice);
+	return json->impl->ops->intern_key(json->impl, json, slice);
+}
+
 static inline const struct b6_utf8 *b6_json_get_string(
 	const struct b6_json_string *self)
 {
@@ -363,6 +615,8 @@ struct b6_json_array_impl_ops {
 				     unsigned int);
 	void (*set)(struct b6_json_array_impl*, unsigned int,
 		    struct b6_json_value*);
+	/* Optional: parses the bytes of a lazy array. */
+	enum b6_json_error (*load)(struct b6_json_array_impl*);
 };
 
 static inline unsigned int b6_json_array_len(const struct b6_json_array *self)
@@ -434,6 +688,8 @@ struct b6_json_object_impl_ops {
 				   const struct b6_utf8*);
 	struct b6_json_pair *(*walk)(struct b6_json_object_impl*,
 				     struct b6_json_pair*, int);
+	/* Optional: parses the bytes of a lazy object. */
+	enum b6_json_error (*load)(struct b6_json_object_impl*);
 };
 
 static inline void b6_json_setup_iterator(struct b6_json_iterator *self,
@@ -507,7 +763,7 @@ static inline enum b6_json_error b6_json_set_object(
 		pair->value = value;
 		return B6_JSON_OK;
 	}
-	if (!(temp.key = b6_json_new_string(self->json, key)))
+	if (!(temp.key = b6_json_new_key(self->json, key)))
 		return B6_JSON_ALLOC_ERROR;
 	temp.value = value;
 	error = self->impl->ops->add(self->impl, self->json->impl, &temp);
@@ -527,6 +783,258 @@ extern enum b6_json_error b6_json_parse_object(struct b6_json_object*,
 					       struct b6_json_istream*,
 					       struct b6_json_parser_info*);
 
+/* Parses an object or an array deferred by B6_JSON_LAZY, which any access
+ * does anyway. A malformed one looks empty then: only this tells the error,
+ * until it is parsed successfully. The values it holds stay deferred. */
+static inline enum b6_json_error b6_json_load_value(struct b6_json_value *self)
+{
+	struct b6_json_object *object;
+	struct b6_json_array *array;
+	if ((object = b6_json_value_as_or_null(self, object)))
+		return object->impl->ops->load ?
+			object->impl->ops->load(object->impl) : B6_JSON_OK;
+	if ((array = b6_json_value_as_or_null(self, array)))
+		return array->impl->ops->load ?
+			array->impl->ops->load(array->impl) : B6_JSON_OK;
+	return B6_JSON_OK;
+}
+
+/* Receives the events of a value as it is parsed instead of a document.
+ * Operations are optional and returning an error aborts the parsing with it.
+ * Strings and keys are only valid during the call. */
+struct b6_json_handler {
+	const struct b6_json_handler_ops *ops;
+};
+
+struct b6_json_handler_ops {
+	enum b6_json_error (*enter_object)(struct b6_json_handler*);
+	enum b6_json_error (*leave_object)(struct b6_json_handler*);
+	enum b6_json_error (*key)(struct b6_json_handler*,
+				  const struct b6_utf8*);
+	enum b6_json_error (*enter_array)(struct b6_json_handler*);
+	enum b6_json_error (*leave_array)(struct b6_json_handler*);
+	enum b6_json_error (*string)(struct b6_json_handler*,
+				     const struct b6_utf8*);
+	enum b6_json_error (*number)(struct b6_json_handler*, double);
+	/* When set, integers that fit in 64 bits are reported here instead of
+	 * as numbers. */
+	enum b6_json_error (*integer)(struct b6_json_handler*, long long int);
+	enum b6_json_error (*boolean)(struct b6_json_handler*, int);
+	enum b6_json_error (*null)(struct b6_json_handler*);
+};
+
+/* Strings are referenced in the window of the istream when they fit in it
+ * without escapes, and decoded in buf otherwise: memory is bounded by the
+ * longest of them whatever the size of the input. */
+struct b6_json_event_parser {
+	struct b6_array buf;
+};
+
+static inline void b6_json_event_parser_initialize(
+	struct b6_json_event_parser *self, struct b6_allocator *allocator)
+{
+	b6_array_initialize(&self->buf, allocator, 1);
+}
+
+static inline void b6_json_event_parser_finalize(
+	struct b6_json_event_parser *self)
+{
+	b6_array_finalize(&self->buf);
+}
+
+/* Parses the next value of the istream, which can be of any type. */
+extern enum b6_json_error b6_json_parse_events(struct b6_json_event_parser*,
+					       struct b6_json_istream*,
+					       struct b6_json_handler*,
+					       struct b6_json_parser_info*);
+
+/* Reports the events of a sequence of values to a handler as their bytes are
+ * pushed, so that the input never has to be complete. Nesting is kept in an
+ * explicit stack instead of the call stack, and only the bytes of a token
+ * split between two chunks are copied. */
+struct b6_json_push_parser {
+	struct b6_json_event_parser up;
+	struct b6_json_handler *handler;
+	struct b6_array stack;
+	struct b6_array token;
+	enum b6_json_error error;
+	unsigned int state;
+	int escaped;
+};
+
+extern void b6_json_push_parser_initialize(struct b6_json_push_parser*,
+					   struct b6_json_handler*,
+					   struct b6_allocator*);
+
+extern void b6_json_push_parser_finalize(struct b6_json_push_parser*);
+
+/* Parses as much of the chunk as possible, keeping an incomplete token until
+ * the next one. Once an error is returned, it is returned again until the
+ * parser is finished. */
+extern enum b6_json_error b6_json_push_parser_feed(struct b6_json_push_parser*,
+						   const void *buf,
+						   unsigned long int len);
+
+/* Ends the input, which is an I/O error if a value is incomplete, and makes
+ * the parser ready for a new sequence of values. */
+extern enum b6_json_error b6_json_push_parser_finish(
+	struct b6_json_push_parser*);
+
+/* A location in a document compiled once into the keys to follow from its
+ * root, to be looked up in many documents. Keys are checked and copied when
+ * compiled, along with the array index they stand for if any. */
+struct b6_json_pointer {
+	struct b6_array steps;
+	struct b6_array buf;
+};
+
+struct b6_json_pointer_step {
+	struct b6_utf8 key;
+	unsigned long int index; /* ~0UL when the key is not an index */
+};
+
+static inline void b6_json_pointer_initialize(struct b6_json_pointer *self,
+					      struct b6_allocator *allocator)
+{
+	b6_array_initialize(&self->steps, allocator,
+			    sizeof(struct b6_json_pointer_step));
+	b6_array_initialize(&self->buf, allocator, 1);
+}
+
+static inline void b6_json_pointer_finalize(struct b6_json_pointer *self)
+{
+	b6_array_finalize(&self->buf);
+	b6_array_finalize(&self->steps);
+}
+
+static inline unsigned long int b6_json_pointer_len(
+	const struct b6_json_pointer *self)
+{
+	return b6_array_length(&self->steps);
+}
+
+static inline const struct b6_json_pointer_step *b6_json_pointer_step(
+	const struct b6_json_pointer *self, unsigned long int i)
+{
+	return b6_array_get(&self->steps, i);
+}
+
+/* Compiles a JSON Pointer as of RFC 6901, such as "/a/0/b~1c". The empty
+ * pointer selects the root. Returns B6_JSON_PARSE_ERROR when malformed. */
+extern enum b6_json_error b6_json_compile_pointer(struct b6_json_pointer*,
+						  const struct b6_utf8*);
+
+/* Compiles a path such as "$.a[0].b", where the leading "$" and the dot
+ * before the first key are optional. Keys cannot hold dots nor brackets. */
+extern enum b6_json_error b6_json_compile_path(struct b6_json_pointer*,
+					       const struct b6_utf8*);
+
+/* Returns the value the pointer selects from root, or NULL if none. */
+extern struct b6_json_value *b6_json_select(const struct b6_json_pointer*,
+					    struct b6_json_value *root);
+
+/* Parses the next value of the istream like b6_json_parse_events, but only
+ * reports the events of the value the pointer selects, if any. The other
+ * values are skipped: their strings are not decoded nor their numbers
+ * converted. */
+extern enum b6_json_error b6_json_parse_selected_events(
+	struct b6_json_event_parser*, struct b6_json_istream*,
+	const struct b6_json_pointer*, struct b6_json_handler*,
+	struct b6_json_parser_info*);
+
+/* Types of the members of C structs that JSON objects are decoded into. */
+enum b6_json_field_type {
+	B6_JSON_FIELD_BOOLEAN, /* int */
+	B6_JSON_FIELD_INTEGER, /* long long int */
+	B6_JSON_FIELD_NUMBER, /* double */
+	B6_JSON_FIELD_STRING, /* struct b6_utf8_string */
+	B6_JSON_FIELD_STRUCT, /* struct described by another schema */
+};
+
+#define B6_JSON_FIELD_REQUIRED 1
+
+/* Describes the member at offset of a struct, named name in JSON. */
+struct b6_json_field {
+	const char *name;
+	unsigned long int offset;
+	enum b6_json_field_type type;
+	unsigned int flags;
+	const struct b6_json_schema *schema; /* for B6_JSON_FIELD_STRUCT */
+};
+
+struct b6_json_schema_slot {
+	unsigned int len;
+	unsigned int field; /* ~0U when empty */
+};
+
+/* Fields are dispatched through a perfect hash of their names, which is
+ * searched once when compiling the schema. */
+struct b6_json_schema {
+	const struct b6_json_field *fields;
+	unsigned int nfields;
+	unsigned int seed;
+	unsigned int mask;
+	struct b6_array slots;
+};
+
+static inline void b6_json_schema_initialize(struct b6_json_schema *self,
+					     struct b6_allocator *allocator)
+{
+	self->fields = NULL;
+	self->nfields = 0;
+	self->seed = self->mask = 0;
+	b6_array_initialize(&self->slots, allocator,
+			    sizeof(struct b6_json_schema_slot));
+}
+
+static inline void b6_json_schema_finalize(struct b6_json_schema *self)
+{
+	b6_array_finalize(&self->slots);
+}
+
+/* Compiles a table of nfields fields, which has to outlive the schema, as
+ * well as the compiled schemas its struct fields refer to. Returns
+ * B6_JSON_ERROR when two fields have the same name. */
+extern enum b6_json_error b6_json_compile_schema(struct b6_json_schema*,
+						 const struct b6_json_field*,
+						 unsigned int nfields);
+
+/* Tells which fields of the objects being decoded were found. */
+struct b6_json_struct_parser {
+	struct b6_json_event_parser up;
+	struct b6_array seen;
+};
+
+static inline void b6_json_struct_parser_initialize(
+	struct b6_json_struct_parser *self, struct b6_allocator *allocator)
+{
+	b6_json_event_parser_initialize(&self->up, allocator);
+	b6_array_initialize(&self->seen, allocator, 1);
+}
+
+static inline void b6_json_struct_parser_finalize(
+	struct b6_json_struct_parser *self)
+{
+	b6_array_finalize(&self->seen);
+	b6_json_event_parser_finalize(&self->up);
+}
+
+/* Decodes the next object of the istream into the struct at ptr without
+ * creating any value. Unknown keys are skipped, null values and missing keys
+ * leave their members as they are, and string members, which the caller
+ * initializes, are overwritten. Values of the wrong type and missing required
+ * fields are parse errors, after which the struct may be partly decoded. */
+extern enum b6_json_error b6_json_parse_struct(struct b6_json_struct_parser*,
+					       struct b6_json_istream*,
+					       const struct b6_json_schema*,
+					       void *ptr,
+					       struct b6_json_parser_info*);
+
+/* Writes all the fields of the struct at ptr as an object, in the order of
+ * the table of the schema. */
+extern enum b6_json_error b6_json_serialize_struct(
+	const struct b6_json_schema*, const void *ptr, struct b6_json_ostream*);
+
 static inline struct b6_json_object *b6_json_new_object(struct b6_json *json)
 {
 	struct b6_json_object *self;
@@ -549,11 +1057,64 @@ struct b6_json_default_impl {
 	struct b6_pool object_pool;
 	struct b6_pool pool;
 	struct b6_allocator *allocator;
+	/* Open addressing index of the interned keys. */
+	void **keys;
+	unsigned int keys_mask;
+	unsigned int nkeys;
 };
 
 extern int b6_json_default_impl_initialize(struct b6_json_default_impl *self,
 					   struct b6_allocator *allocator);
 
+/* Makes the keys parsed or set afterwards share one string per document for
+ * the same bytes, until all of them are released. */
+extern void b6_json_default_impl_intern_keys(struct b6_json_default_impl*);
+
 extern void b6_json_default_impl_finalize(struct b6_json_default_impl *self);
 
+/* Receives the records of a newline-delimited document. */
+struct b6_json_record_handler {
+	const struct b6_json_record_handler_ops *ops;
+};
+
+struct b6_json_record_handler_ops {
+	/* Called with each object of the input and its offset in bytes. The
+	 * object is released once the call returns, and returning an error
+	 * stops the parsing. */
+	enum b6_json_error (*record)(struct b6_json_record_handler*,
+				     struct b6_json_object*,
+				     unsigned long int offset);
+};
+
+/* Records are delivered in input order, one at a time. Otherwise, they are
+ * delivered as soon as parsed, concurrently from several threads. */
+#define B6_JSON_NDJSON_ORDERED 0x100
+
+/* Each thread interns the keys of its records. */
+#define B6_JSON_NDJSON_INTERN_KEYS 0x200
+
+/* Parses a newline-delimited document of objects, such as a mapped file, with
+ * nthreads threads (one per processor if 0) including the calling one. The
+ * input is split in chunks at line boundaries, which threads parse into
+ * documents of their own allocated by allocator: it has to be thread-safe.
+ * Other flags are the ones of the documents. Blank lines are skipped. */
+extern enum b6_json_error b6_json_parse_ndjson(
+	const void *buf, unsigned long int len,
+	struct b6_json_record_handler *handler, struct b6_allocator *allocator,
+	unsigned int nthreads, unsigned int flags);
+
+/* Writes a value in CBOR (RFC 8949), a binary encoding of the same values:
+ * integral numbers are written as integers and the others as floats, while
+ * strings, arrays and objects are prefixed with their length. */
+extern enum b6_json_error b6_json_serialize_cbor(const struct b6_json_value*,
+						 struct b6_json_ostream*);
+
+/* Reads a CBOR data item into a new value of the document. Integers are
+ * parsed as doubles unless B6_JSON_PRESERVE_INTEGERS is set, text strings
+ * are referenced in memory istreams and tags are ignored. Byte strings,
+ * indefinite lengths and keys other than text strings are parse errors. */
+extern enum b6_json_error b6_json_parse_cbor(struct b6_json*,
+					     struct b6_json_istream*,
+					     struct b6_json_value**);
+
 #endif /* B6_JSON_H */
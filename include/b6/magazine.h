@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2015, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+/**
+ * @file magazine.h
+ * @brief Per-thread caches of objects on top of a pool.
+ *
+ * A depot wraps a pool so that several threads can share it. Each thread
+ * allocates and releases objects through its own cache which holds two
+ * magazines, that is bounded stacks of objects. The depot is only locked when
+ * a thread has to exchange an empty magazine for a full one or conversely, that
+ * is at most once every capacity operations.
+ *
+ * @code
+ * struct b6_magazine_depot depot;
+ *
+ * void *thread(void *arg)
+ * {
+ *   struct b6_magazine_cache cache;
+ *   void *ptr;
+ *   if (b6_magazine_cache_initialize(&cache, &depot))
+ *     return NULL;
+ *   ptr = b6_allocate(&cache.parent, size);
+ *   ...
+ *   b6_deallocate(&cache.parent, ptr);
+ *   b6_magazine_cache_finalize(&cache);
+ *   return NULL;
+ * }
+ * @endcode
+ */
+
+#ifndef B6_MAGAZINE_H_
+#define B6_MAGAZINE_H_
+
+#include "b6/allocator.h"
+#include "b6/atomic.h"
+#include "b6/deque.h"
+#include "b6/pool.h"
+
+/**
+ * @brief A bounded stack of objects.
+ */
+struct b6_magazine {
+	struct b6_sref sref; /**< magazines are queued in the depot */
+	unsigned int count; /**< number of objects in the magazine */
+	void *rounds[]; /**< objects */
+};
+
+/**
+ * @brief The shared part of the magazine layer.
+ */
+struct b6_magazine_depot {
+	struct b6_spinlock lock; /**< protects the fields below and the pool */
+	struct b6_pool *pool; /**< where objects come from */
+	struct b6_allocator *allocator; /**< where magazines come from */
+	unsigned int capacity; /**< maximum number of objects per magazine */
+	struct b6_deque full; /**< queue of full magazines */
+	struct b6_deque empty; /**< queue of empty magazines */
+};
+
+/**
+ * @brief The per-thread part of the magazine layer.
+ *
+ * A cache is an allocator of its own which must only be used by one thread at
+ * a time.
+ */
+struct b6_magazine_cache {
+	struct b6_allocator parent; /**< a cache is a kind of allocator */
+	struct b6_magazine_depot *depot; /**< shared depot */
+	struct b6_magazine *loaded; /**< magazine objects are taken from */
+	struct b6_magazine *previous; /**< spare magazine */
+};
+
+/**
+ * @brief Initialize a depot.
+ * @param self specifies the depot to initialize.
+ * @param pool specifies the pool to get objects from. It must not be used
+ * directly as long as the depot is.
+ * @param allocator specifies the allocator for magazines. It is only called
+ * while the depot is locked.
+ * @param capacity specifies how many objects a magazine can hold.
+ * @return 0 on success or -1 if parameters are invalid.
+ */
+extern int b6_magazine_depot_initialize(struct b6_magazine_depot *self,
+					struct b6_pool *pool,
+					struct b6_allocator *allocator,
+					unsigned int capacity);
+
+/**
+ * @brief Finalize a depot.
+ *
+ * Objects in full magazines are returned to the pool and magazines are
+ * released.
+ *
+ * @pre Every cache of the depot has been finalized.
+ * @param self specifies the depot to finalize.
+ */
+extern void b6_magazine_depot_finalize(struct b6_magazine_depot *self);
+
+/**
+ * @brief Initialize the cache of a thread.
+ * @param self specifies the cache to initialize.
+ * @param depot specifies the depot to attach the cache to.
+ * @return 0 on success or -1 if out of memory.
+ */
+extern int b6_magazine_cache_initialize(struct b6_magazine_cache *self,
+					struct b6_magazine_depot *depot);
+
+/**
+ * @brief Finalize the cache of a thread.
+ *
+ * Magazines of the cache are handed over to the depot.
+ *
+ * @param self specifies the cache to finalize.
+ */
+extern void b6_magazine_cache_finalize(struct b6_magazine_cache *self);
+
+/**
+ * @internal
+ */
+extern void *b6_magazine_reload(struct b6_magazine_cache *self);
+
+/**
+ * @internal
+ */
+extern void b6_magazine_unload(struct b6_magazine_cache *self, void *ptr);
+
+/**
+ * @brief Allocate an object.
+ * @param self specifies the cache of the calling thread.
+ * @return a pointer to the object or NULL if allocation failed.
+ */
+static inline void *b6_magazine_get(struct b6_magazine_cache *self)
+{
+	struct b6_magazine *loaded = self->loaded;
+	if (b6_likely(loaded->count))
+		return loaded->rounds[--loaded->count];
+	return b6_magazine_reload(self);
+}
+
+/**
+ * @brief Release an object.
+ * @param self specifies the cache of the calling thread.
+ * @param ptr specifies the object to release. It may have been allocated
+ * by any cache of the same depot.
+ */
+static inline void b6_magazine_put(struct b6_magazine_cache *self, void *ptr)
+{
+	struct b6_magazine *loaded = self->loaded;
+	if (b6_likely(loaded->count < self->depot->capacity))
+		loaded->rounds[loaded->count++] = ptr;
+	else
+		b6_magazine_unload(self, ptr);
+}
+
+#endif /* B6_MAGAZINE_H_ */
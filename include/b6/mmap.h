@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2015, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+/**
+ * @file mmap.h
+ * @brief Allocator of memory mappings, possibly backed by huge pages.
+ */
+
+#ifndef B6_MMAP_H_
+#define B6_MMAP_H_
+
+#include "b6/allocator.h"
+#include "b6/pool.h"
+#include "b6/tree.h"
+
+/**
+ * @brief Size in bytes of huge pages.
+ */
+#define B6_MMAP_HUGE_PAGE_SIZE (2UL << 20)
+
+/**
+ * @brief Try to map huge pages from the reserved pool with MAP_HUGETLB first.
+ *
+ * Memory is mapped with regular pages when none is available.
+ */
+#define B6_MMAP_HUGETLB 1
+
+/**
+ * @brief Advise the kernel to back mappings with transparent huge pages.
+ *
+ * Mappings of B6_MMAP_HUGE_PAGE_SIZE bytes or more are aligned on huge pages
+ * then.
+ */
+#define B6_MMAP_HUGEPAGE 2
+
+/**
+ * @brief An allocator mapping anonymous memory for each allocation.
+ *
+ * It is meant for large blocks, like the chunks of a pool. For instance, a
+ * pool of many objects suffers less TLB misses with 2MiB chunks backed by huge
+ * pages:
+ *
+ * @code
+ * struct b6_mmap_allocator mmap;
+ * struct b6_pool pool;
+ *
+ * b6_mmap_allocator_initialize(&mmap, B6_MMAP_HUGETLB | B6_MMAP_HUGEPAGE);
+ * b6_pool_initialize_aligned(&pool, &mmap.parent, 64, B6_MMAP_HUGE_PAGE_SIZE);
+ * @endcode
+ *
+ * The size of mappings is recorded in a tree of descriptors, themselves
+ * allocated within mapped pages, so that memory returned is neither preceded
+ * by a header nor misaligned.
+ *
+ * Reallocation keeps the alignment a mapping was allocated with: when it
+ * cannot grow in place, its pages are moved to a new aligned address.
+ */
+struct b6_mmap_allocator {
+	struct b6_allocator parent; /**< a kind of allocator */
+	struct b6_allocator pages; /**< allocator of pages for descriptors */
+	struct b6_pool pool; /**< pool of descriptors */
+	struct b6_tree tree; /**< descriptors sorted by address */
+	unsigned long int page_size; /**< size of regular pages */
+	int flags; /**< B6_MMAP_HUGETLB and/or B6_MMAP_HUGEPAGE */
+};
+
+/**
+ * @brief Initialize an mmap allocator.
+ * @param self specifies the allocator to initialize.
+ * @param flags specifies B6_MMAP_HUGETLB and/or B6_MMAP_HUGEPAGE or 0.
+ * @return 0 on success or -1 on error.
+ */
+extern int b6_mmap_allocator_initialize(struct b6_mmap_allocator *self,
+					int flags);
+
+/**
+ * @brief Finalize an mmap allocator, unmapping every mapping left.
+ * @param self specifies the allocator to finalize.
+ */
+extern void b6_mmap_allocator_finalize(struct b6_mmap_allocator *self);
+
+#endif /* B6_MMAP_H_ */
@@ -17,6 +17,22 @@
 #include "deque.h"
 #include "allocator.h"
 
+/**
+ * Counters of pool events.
+ *
+ * They are only updated when the library is built with B6_POOL_STATS defined,
+ * so that pools do not pay for them otherwise. They stay zero then.
+ */
+struct b6_pool_counters {
+	unsigned long int objects; /**< Allocated objects. */
+	unsigned long int chunks; /**< Allocated chunks. */
+	unsigned long int peak_objects; /**< High-water mark of objects. */
+	unsigned long int peak_chunks; /**< High-water mark of chunks. */
+	unsigned long int recycled; /**< Allocations from the free queue. */
+	unsigned long int carved; /**< Allocations from the current chunk. */
+	unsigned long int grown; /**< Allocations requiring a new chunk. */
+};
+
 /**
  * A memory allocator using cached chunks where it actually allocates objects
  * of constant size.
@@ -26,29 +42,43 @@ struct b6_pool {
 
 	unsigned chunk_size; /**< Size in bytes of a chunk. */
 	unsigned size; /**< Size in bytes of an object. */
+	unsigned long int mask; /**< Chunk address mask or 0 if not aligned. */
 
 	struct b6_chunk *curr; /**< Chunk within objects are allocated. */
 	struct b6_chunk *free; /**< Cached free chunk for fast allocation. */
 
 	struct b6_deque queue; /**< Queue of free objects. */
 	struct b6_list list; /**< List of chunks. */
-	struct b6_tree tree; /**< Tree of chunks. */
+	struct b6_tree tree; /**< Tree of chunks when not aligned. */
 
 	struct b6_allocator *allocator; /**< Underlying allocator. */
+
+	unsigned int guarded; /**< Whether objects are checked. */
+	unsigned long int threshold; /**< Bytes of free chunks to keep. */
+	unsigned long int trigger; /**< Bytes of emptied chunks to trim at. */
+	unsigned long int nempty; /**< Chunks emptied since last trim. */
+
+	struct b6_pool_counters counters; /**< Statistics, if enabled. */
 };
 
 /** The chunk of the pool which objects are allocated in. */
 struct b6_chunk {
-	struct b6_tref tref; /**< Chunks are organized in a tree. */
+	struct b6_tref tref; /**< Chunks are organized in a tree if needed. */
 	struct b6_dref dref; /**< Chunks are organized in a list. */
 	unsigned int free; /**< Free bytes remaining in the chunk. */
 	unsigned int used; /**< Allocated objects in the chunk. */
 	unsigned int index; /**< Offset of the 1st free object in the chunk. */
 	unsigned int flag; /**< Whether this chunk is to be deleted. */
+	struct b6_pool *pool; /**< Pool the chunk belongs to. */
 };
 
 /**
  * Initialize a pool allocator.
+ *
+ * When allocator is a guard (see b6/guard.h), the pool checks its objects too:
+ * released objects are poisoned and checked when allocated again, and
+ * releasing an object twice is detected.
+ *
  * @param pool specifies the pool to initialize.
  * @param size specifies the size of object this allocator will produce.
  * @param chunk_size specifies the size of memory chunk to allocate.
@@ -58,6 +88,26 @@ struct b6_chunk {
 int b6_pool_initialize(struct b6_pool *pool, struct b6_allocator *allocator,
 		       unsigned size, unsigned chunk_size);
 
+/**
+ * Initialize a pool allocator which chunks are aligned on their size.
+ *
+ * The chunk an object belongs to is found by masking the address of the
+ * object, instead of searching a tree of chunks as b6_pool_initialize does.
+ * This makes b6_pool_put and recycling objects in b6_pool_get run in constant
+ * time.
+ *
+ * @param pool specifies the pool to initialize.
+ * @param size specifies the size of object this allocator will produce.
+ * @param chunk_size specifies the size of memory chunk to allocate, which must
+ *        be a power of two, or 0 to let the pool choose.
+ * @param allocator specifies the allocator used for dynamically allocating
+ *        chunks. It has to support b6_allocate_aligned.
+ * @return 0 on success or -1 if parameters are invalid.
+ */
+int b6_pool_initialize_aligned(struct b6_pool *pool,
+			       struct b6_allocator *allocator,
+			       unsigned size, unsigned chunk_size);
+
 /**
  * Finalize a pool allocator.
  * @param pool specifies the pool to finalize.
@@ -82,4 +132,87 @@ void *b6_pool_get(struct b6_pool *pool);
  */
 void b6_pool_put(struct b6_pool *pool, void *ptr);
 
+/**
+ * Allocate several objects at once.
+ *
+ * Objects are taken from the queue of released objects first, then carved out
+ * of chunks by runs.
+ *
+ * @param pool specifies the pool within objects have to be allocated.
+ * @param ptrs specifies where to store pointers to the objects.
+ * @param n specifies how many objects to allocate.
+ * @return how many objects were allocated, less than n if out of memory.
+ */
+unsigned long int b6_pool_get_n(struct b6_pool *pool, void **ptrs,
+				unsigned long int n);
+
+/**
+ * Release several objects at once.
+ *
+ * Objects are queued all together for later allocation.
+ *
+ * @param pool specifies the pool within objects were allocated.
+ * @param ptrs specifies the objects to release.
+ * @param n specifies how many objects to release.
+ */
+void b6_pool_put_n(struct b6_pool *pool, void **ptrs, unsigned long int n);
+
+/**
+ * Release chunks which objects are all free.
+ *
+ * Chunks without allocated objects are kept up to keep_bytes, and their
+ * objects are reused by later allocations. The others are returned to the
+ * underlying allocator at once instead of waiting for b6_pool_get to dequeue
+ * their objects. This runs in linear time with the number of chunks and of
+ * free objects.
+ *
+ * @param pool specifies the pool to trim.
+ * @param keep_bytes specifies how many bytes of free chunks to keep.
+ * @return how many bytes were returned to the underlying allocator.
+ */
+unsigned long int b6_pool_trim(struct b6_pool *pool,
+			       unsigned long int keep_bytes);
+
+/**
+ * Set up a pool to trim itself.
+ *
+ * Once chunks totalling more than twice threshold bytes have been emptied by
+ * b6_pool_put or b6_pool_put_n since the last trim, and as many objects as
+ * the last trim went through have been released in them, the pool calls
+ * b6_pool_trim keeping threshold bytes. The cost of trimming is thus
+ * amortized over the releases that emptied chunks, and putting objects back
+ * is not slowed down otherwise. Chunks without objects total less than
+ * threshold bytes plus the bytes to trim at, in trigger.
+ *
+ * @param pool specifies the pool.
+ * @param threshold specifies the threshold in bytes or 0 to disable trimming,
+ *        which is the default.
+ */
+void b6_pool_set_threshold(struct b6_pool *pool, unsigned long int threshold);
+
+/**
+ * Statistics about a pool.
+ */
+struct b6_pool_stats {
+	unsigned long int objects; /**< Allocated objects. */
+	unsigned long int chunks; /**< Allocated chunks. */
+	unsigned long int reserved; /**< Bytes of chunks, cached one included. */
+	unsigned long int used; /**< Bytes of allocated objects. */
+	unsigned long int queued; /**< Length of the free queue. */
+	unsigned long int flagged; /**< Chunks pending deletion. */
+	struct b6_pool_counters counters; /**< Counters if enabled. */
+};
+
+/**
+ * Get statistics about a pool.
+ *
+ * Figures are computed by walking chunks and the queue of free objects, so
+ * this runs in linear time. Counters are only available when the library is
+ * built with B6_POOL_STATS defined.
+ *
+ * @param pool specifies the pool to inspect.
+ * @param stats specifies where to store statistics.
+ */
+void b6_pool_stats(const struct b6_pool *pool, struct b6_pool_stats *stats);
+
 #endif /* POOL_H_ */
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2015, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+/**
+ * @file slab.h
+ * @brief General purpose allocator built from pools of size classes.
+ */
+
+#ifndef B6_SLAB_H_
+#define B6_SLAB_H_
+
+#include "b6/allocator.h"
+#include "b6/pool.h"
+#include "b6/tree.h"
+
+/**
+ * @brief Number of size classes served by pools.
+ *
+ * Sizes classes go from 16 to 4096 bytes, two per power of two: 16, 24, 32,
+ * 48, 64, 96, ... 3072, 4096.
+ */
+#define B6_SLAB_CLASSES 17
+
+/**
+ * @brief Largest size in bytes served by pools.
+ */
+#define B6_SLAB_MAX_SIZE 4096
+
+/**
+ * @brief An allocator of objects of any size.
+ *
+ * Objects up to B6_SLAB_MAX_SIZE bytes are rounded up to the nearest size
+ * class and allocated from the aligned pool of that class. Larger objects are
+ * allocated directly from the underlying allocator.
+ *
+ * Every chunk of the pools is aligned on the same chunk size, so that the
+ * size class of an object is found from its address. Large objects are not
+ * aligned but recorded in a tree, which is looked up first when releasing.
+ */
+struct b6_slab {
+	struct b6_allocator parent; /**< a slab is a kind of allocator */
+	struct b6_allocator *allocator; /**< underlying allocator */
+	unsigned long int mask; /**< chunk address mask */
+	unsigned chunk_size; /**< size in bytes of chunks */
+	struct b6_tree tree; /**< large objects sorted by address */
+	struct b6_pool pools[B6_SLAB_CLASSES]; /**< pools of size classes */
+};
+
+/**
+ * @brief Initialize a slab allocator.
+ * @param self specifies the slab allocator to initialize.
+ * @param allocator specifies the underlying allocator. It has to support
+ * b6_allocate_aligned.
+ * @param chunk_size specifies the size of the chunks of the pools, which must
+ * be a power of two large enough for B6_SLAB_MAX_SIZE objects, or 0 to let the
+ * slab allocator choose.
+ * @return 0 on success or -1 if parameters are invalid.
+ */
+extern int b6_slab_initialize(struct b6_slab *self,
+			      struct b6_allocator *allocator,
+			      unsigned chunk_size);
+
+/**
+ * @brief Finalize a slab allocator, releasing every object.
+ * @param self specifies the slab allocator to finalize.
+ */
+extern void b6_slab_finalize(struct b6_slab *self);
+
+/**
+ * @brief Get the size class of a size.
+ * @param size specifies the size in bytes.
+ * @return the index of the size class.
+ * @return B6_SLAB_CLASSES if size is larger than B6_SLAB_MAX_SIZE.
+ */
+static inline unsigned int b6_slab_class(unsigned long int size)
+{
+	unsigned int bits;
+	if (size <= 16)
+		return 0;
+	if (size > B6_SLAB_MAX_SIZE)
+		return B6_SLAB_CLASSES;
+	size -= 1;
+	bits = sizeof(size) * 8 - 1 - __builtin_clzl(size);
+	return 2 * (bits - 4) + 1 + ((size >> (bits - 1)) & 1);
+}
+
+#endif /* B6_SLAB_H_ */
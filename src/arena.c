@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2015, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+#include "b6/arena.h"
+
+#define ARENA_ALIGNMENT (2 * sizeof(void*))
+
+static char *align_ptr(char *ptr, unsigned long int alignment)
+{
+	return (char*)(((unsigned long int)ptr + alignment - 1) &
+		       ~(alignment - 1));
+}
+
+static void release_block(struct b6_arena *self)
+{
+	struct b6_arena_block *block = self->block;
+	self->block = block->prev;
+	b6_deallocate(self->allocator, block);
+}
+
+static int grow_arena(struct b6_arena *self, unsigned long int size,
+		      unsigned long int alignment)
+{
+	struct b6_arena_block *block;
+	unsigned long int block_size = sizeof(*block) + alignment - 1 + size;
+	if (block_size < size)
+		return -1;
+	if (block_size < self->block_size)
+		block_size = self->block_size;
+	if (!(block = b6_allocate(self->allocator, block_size)))
+		return -1;
+	block->prev = self->block;
+	block->end = (char*)block + block_size;
+	self->block = block;
+	self->ptr = (char*)(block + 1);
+	self->end = block->end;
+	return 0;
+}
+
+static void *bump(struct b6_arena *self, unsigned long int size,
+		  unsigned long int alignment)
+{
+	char *ptr = align_ptr(self->ptr, alignment);
+	if (!self->block || ptr > self->end || size > self->end - ptr) {
+		if (grow_arena(self, size, alignment))
+			return NULL;
+		ptr = align_ptr(self->ptr, alignment);
+	}
+	self->ptr = ptr + size;
+	self->last = ptr;
+	return ptr;
+}
+
+static void *b6_arena_allocate(struct b6_allocator *up, unsigned long int size)
+{
+	struct b6_arena *self = b6_cast_of(up, struct b6_arena, parent);
+	return bump(self, size, ARENA_ALIGNMENT);
+}
+
+static void *b6_arena_allocate_aligned(struct b6_allocator *up,
+				       unsigned long int size,
+				       unsigned long int alignment)
+{
+	struct b6_arena *self = b6_cast_of(up, struct b6_arena, parent);
+	if (alignment < ARENA_ALIGNMENT)
+		alignment = ARENA_ALIGNMENT;
+	return bump(self, size, alignment);
+}
+
+static void *b6_arena_reallocate(struct b6_allocator *up, void *ptr,
+				 unsigned long int size)
+{
+	struct b6_arena *self = b6_cast_of(up, struct b6_arena, parent);
+	struct b6_arena_block *block;
+	unsigned long int len;
+	char *dst;
+	/* The latest allocation is resized in place when it fits. */
+	if (ptr == self->last && size <= self->end - self->last) {
+		self->ptr = self->last + size;
+		return ptr;
+	}
+	/* Otherwise, copy what can be of the former allocation as its size is
+	   unknown: the block it belongs to bounds it. */
+	for (block = self->block; block; block = block->prev)
+		if ((char*)ptr > (char*)block && (char*)ptr < block->end)
+			break;
+	b6_assert(block);
+	len = block->end - (char*)ptr;
+	if (block == self->block)
+		len = self->ptr - (char*)ptr;
+	if (len > size)
+		len = size;
+	if (!(dst = bump(self, size, ARENA_ALIGNMENT)))
+		return NULL;
+	__builtin_memcpy(dst, ptr, len);
+	return dst;
+}
+
+static void b6_arena_deallocate(struct b6_allocator *up, void *ptr)
+{
+	struct b6_arena *self = b6_cast_of(up, struct b6_arena, parent);
+	/* Only the latest allocation can be given back. */
+	if (ptr == self->last) {
+		self->ptr = self->last;
+		self->last = NULL;
+	}
+}
+
+void b6_arena_initialize(struct b6_arena *self, struct b6_allocator *allocator,
+			 unsigned long int block_size)
+{
+	static const struct b6_allocator_ops ops = {
+		.allocate = b6_arena_allocate,
+		.reallocate = b6_arena_reallocate,
+		.deallocate = b6_arena_deallocate,
+		.allocate_aligned = b6_arena_allocate_aligned,
+	};
+	self->parent.ops = &ops;
+	self->allocator = allocator;
+	self->block = NULL;
+	self->ptr = self->end = self->last = NULL;
+	self->block_size = block_size ? block_size : 65536 - sizeof(void*);
+}
+
+void b6_arena_finalize(struct b6_arena *self)
+{
+	while (self->block)
+		release_block(self);
+	self->ptr = self->end = self->last = NULL;
+}
+
+void b6_arena_release_to_mark(struct b6_arena *self,
+			      const struct b6_arena_mark *mark)
+{
+	while (self->block != mark->block)
+		release_block(self);
+	self->last = NULL;
+	if (self->block) {
+		self->ptr = mark->ptr;
+		self->end = self->block->end;
+	} else
+		self->ptr = self->end = NULL;
+}
@@ -0,0 +1,496 @@
+/*
+ * Copyright (c) 2015, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+#include "b6/json.h"
+
+/* The initial byte of a data item holds its major type in its 3 upper bits
+ * and an argument or the size of the argument that follows in the others. */
+#define CBOR_UNSIGNED (0 << 5)
+#define CBOR_NEGATIVE (1 << 5)
+#define CBOR_BYTES (2 << 5)
+#define CBOR_TEXT (3 << 5)
+#define CBOR_ARRAY (4 << 5)
+#define CBOR_MAP (5 << 5)
+#define CBOR_TAG (6 << 5)
+#define CBOR_SIMPLE (7 << 5)
+
+#define CBOR_FALSE (CBOR_SIMPLE | 20)
+#define CBOR_TRUE (CBOR_SIMPLE | 21)
+#define CBOR_NULL (CBOR_SIMPLE | 22)
+#define CBOR_UNDEFINED (CBOR_SIMPLE | 23)
+#define CBOR_HALF (CBOR_SIMPLE | 25)
+#define CBOR_FLOAT (CBOR_SIMPLE | 26)
+#define CBOR_DOUBLE (CBOR_SIMPLE | 27)
+
+static enum b6_json_error write_bytes(struct b6_json_ostream *os,
+				      const void *buf, unsigned long int len)
+{
+	return b6_json_ostream_write(os, buf, len) == (long int)len ?
+		B6_JSON_OK : B6_JSON_IO_ERROR;
+}
+
+/* Writes the shortest form of an initial byte and its argument. */
+static enum b6_json_error write_head(struct b6_json_ostream *os,
+				     unsigned char major,
+				     unsigned long long int arg)
+{
+	unsigned char buf[9];
+	unsigned int len, i;
+	if (arg < 24) {
+		buf[0] = major | arg;
+		len = 1;
+	} else if (arg <= 0xff) {
+		buf[0] = major | 24;
+		len = 2;
+	} else if (arg <= 0xffff) {
+		buf[0] = major | 25;
+		len = 3;
+	} else if (arg <= 0xffffffff) {
+		buf[0] = major | 26;
+		len = 5;
+	} else {
+		buf[0] = major | 27;
+		len = 9;
+	}
+	for (i = len; i-- > 1; arg >>= 8)
+		buf[i] = arg;
+	return write_bytes(os, buf, len);
+}
+
+static enum b6_json_error serialize_integer(struct b6_json_ostream *os,
+					    long long int i)
+{
+	return i < 0 ? write_head(os, CBOR_NEGATIVE, -1 - i) :
+		write_head(os, CBOR_UNSIGNED, i);
+}
+
+static enum b6_json_error serialize_number(struct b6_json_ostream *os,
+					   const struct b6_json_number *self)
+{
+	unsigned char buf[9];
+	unsigned long long int bits;
+	unsigned int len, i;
+	double d;
+	float f;
+	if (b6_json_number_is_integer(self))
+		return serialize_integer(os, b6_json_get_integer(self));
+	/* Integral numbers are written as integers, like in text. */
+	d = b6_json_get_number(self);
+	if (d >= -9223372036854775808. && d < 9223372036854775808. &&
+	    d == (long long int)d && !(d == 0 && __builtin_signbit(d)))
+		return serialize_integer(os, d);
+	f = d;
+	if (f == d || d != d) {
+		unsigned int f_bits;
+		__builtin_memcpy(&f_bits, &f, sizeof(f_bits));
+		bits = f_bits;
+		buf[0] = CBOR_FLOAT;
+		len = 5;
+	} else {
+		__builtin_memcpy(&bits, &d, sizeof(bits));
+		buf[0] = CBOR_DOUBLE;
+		len = 9;
+	}
+	for (i = len; i-- > 1; bits >>= 8)
+		buf[i] = bits;
+	return write_bytes(os, buf, len);
+}
+
+static enum b6_json_error serialize_text(struct b6_json_ostream *os,
+					 const struct b6_utf8 *utf8)
+{
+	enum b6_json_error retval = write_head(os, CBOR_TEXT, utf8->nbytes);
+	return retval ? retval : write_bytes(os, utf8->ptr, utf8->nbytes);
+}
+
+static enum b6_json_error serialize_value(const struct b6_json_value *value,
+					  struct b6_json_ostream *os)
+{
+	static const unsigned char simple[] = {
+		CBOR_NULL, CBOR_TRUE, CBOR_FALSE,
+	};
+	enum b6_json_error retval;
+	/* Deferred objects and arrays that do not parse would look empty. */
+	if ((retval = b6_json_load_value((struct b6_json_value*)value)))
+		return retval;
+	if (b6_json_value_is_of(value, null))
+		return write_bytes(os, &simple[0], 1);
+	if (b6_json_value_is_of(value, true))
+		return write_bytes(os, &simple[1], 1);
+	if (b6_json_value_is_of(value, false))
+		return write_bytes(os, &simple[2], 1);
+	if (b6_json_value_is_of(value, number))
+		return serialize_number(os, b6_json_value_as(value, number));
+	if (b6_json_value_is_of(value, string))
+		return serialize_text(os, b6_json_get_string(
+				b6_json_value_as(value, string)));
+	if (b6_json_value_is_of(value, array)) {
+		const struct b6_json_array *array =
+			b6_json_value_as(value, array);
+		unsigned int i, n = b6_json_array_len(array);
+		if ((retval = write_head(os, CBOR_ARRAY, n)))
+			return retval;
+		for (i = 0; i < n; i += 1)
+			if ((retval = serialize_value(
+				     b6_json_get_array(array, i), os)))
+				return retval;
+		return B6_JSON_OK;
+	}
+	if (b6_json_value_is_of(value, object)) {
+		const struct b6_json_object *object =
+			b6_json_value_as(value, object);
+		const struct b6_json_pair *pair;
+		struct b6_json_iterator iter;
+		unsigned long long int n = 0;
+		/* Objects do not tell how many pairs they hold. */
+		for (b6_json_setup_iterator(&iter, object);
+		     b6_json_get_iterator(&iter);
+		     b6_json_advance_iterator(&iter))
+			n += 1;
+		if ((retval = write_head(os, CBOR_MAP, n)))
+			return retval;
+		for (b6_json_setup_iterator(&iter, object);
+		     (pair = b6_json_get_iterator(&iter));
+		     b6_json_advance_iterator(&iter))
+			if ((retval = serialize_text(
+				     os, b6_json_get_string(pair->key))) ||
+			    (retval = serialize_value(pair->value, os)))
+				return retval;
+		return B6_JSON_OK;
+	}
+	return B6_JSON_ERROR;
+}
+
+enum b6_json_error b6_json_serialize_cbor(const struct b6_json_value *self,
+					  struct b6_json_ostream *os)
+{
+	enum b6_json_error retval = serialize_value(self, os);
+	if (!retval && b6_json_ostream_flush(os))
+		retval = B6_JSON_IO_ERROR;
+	return retval;
+}
+
+static enum b6_json_error read_bytes(struct b6_json_istream *is, void *buf,
+				     unsigned long int len)
+{
+	char *ptr = buf;
+	while (len) {
+		unsigned long int n = b6_json_istream_avail(is);
+		if (!n) {
+			if (b6_json_istream_refill(is, len) < 1)
+				return B6_JSON_IO_ERROR;
+			continue;
+		}
+		if (n > len)
+			n = len;
+		__builtin_memcpy(ptr, is->ptr, n);
+		b6_json_istream_advance(is, n);
+		ptr += n;
+		len -= n;
+	}
+	return B6_JSON_OK;
+}
+
+/* Reads the initial byte of the next data item and its argument, skipping
+ * the tags in front of it. Indefinite lengths are not supported. */
+static enum b6_json_error read_head(struct b6_json_istream *is,
+				    unsigned char *byte,
+				    unsigned long long int *arg)
+{
+	enum b6_json_error retval;
+	unsigned char buf[8];
+	unsigned int len, i;
+	do {
+		if ((retval = read_bytes(is, byte, 1)))
+			return retval;
+		if ((*byte & 31) < 24) {
+			*arg = *byte & 31;
+			continue;
+		}
+		if ((*byte & 31) > 27)
+			return B6_JSON_PARSE_ERROR;
+		len = 1 << ((*byte & 31) - 24);
+		if ((retval = read_bytes(is, buf, len)))
+			return retval;
+		for (*arg = 0, i = 0; i < len; i += 1)
+			*arg = *arg << 8 | buf[i];
+	} while ((*byte & 0xe0) == CBOR_TAG);
+	return B6_JSON_OK;
+}
+
+static int setup_text(struct b6_utf8 *utf8, const char *ptr,
+		      unsigned long int len)
+{
+	const char *end = ptr + len;
+	utf8->ptr = ptr;
+	utf8->nbytes = len;
+	utf8->nchars = 0;
+	while (ptr != end) {
+		unsigned int n = b6_utf8_dec_len(ptr);
+		unsigned int unicode;
+		if (n > 1 && (n > end - ptr ||
+			      b6_utf8_dec(n, &unicode, ptr) != n))
+			return -1;
+		if (n < 1)
+			return -1;
+		ptr += n;
+		utf8->nchars += 1;
+	}
+	return 0;
+}
+
+/* Text strings are referenced in the window of memory istreams, and copied
+ * at once when they fit in the window of the others. */
+static enum b6_json_error parse_text(struct b6_json *json,
+				     struct b6_json_istream *is,
+				     unsigned long long int len,
+				     struct b6_json_string **string)
+{
+	struct b6_utf8 utf8;
+	if (len > ~0U)
+		return B6_JSON_PARSE_ERROR;
+	if (b6_json_istream_avail(is) < len &&
+	    !b6_json_istream_is_addressable(is) &&
+	    b6_json_istream_refill(is, len) < 0)
+		return B6_JSON_IO_ERROR;
+	if (b6_json_istream_avail(is) >= len) {
+		if (setup_text(&utf8, is->ptr, len))
+			return B6_JSON_PARSE_ERROR;
+		*string = b6_json_istream_is_addressable(is) ?
+			b6_json_new_string_view(json, &utf8) :
+			b6_json_new_string(json, &utf8);
+		if (!*string)
+			return B6_JSON_ALLOC_ERROR;
+		b6_json_istream_advance(is, len);
+		return B6_JSON_OK;
+	}
+	if (b6_json_istream_is_addressable(is))
+		return B6_JSON_IO_ERROR;
+	if (!(*string = b6_json_new_string(json, NULL)))
+		return B6_JSON_ALLOC_ERROR;
+	while (len) {
+		unsigned long int n = b6_json_istream_avail(is), i;
+		enum b6_json_error retval;
+		if (!n && b6_json_istream_refill(is, 1) < 1) {
+			b6_json_unref_value(&(*string)->up);
+			return B6_JSON_IO_ERROR;
+		}
+		if (n > len)
+			n = len;
+		/* Pieces may split characters: their bytes add up anyway. */
+		utf8.ptr = is->ptr;
+		utf8.nbytes = n;
+		for (utf8.nchars = 0, i = 0; i < n; i += 1)
+			utf8.nchars += (is->ptr[i] & 0xc0) != 0x80;
+		if ((retval = (*string)->impl->ops->append(
+			     (*string)->impl, json->impl, &utf8))) {
+			b6_json_unref_value(&(*string)->up);
+			return retval;
+		}
+		b6_json_istream_advance(is, n);
+		len -= n;
+	}
+	utf8 = *b6_json_get_string(*string);
+	if (setup_text(&utf8, utf8.ptr, utf8.nbytes)) {
+		b6_json_unref_value(&(*string)->up);
+		return B6_JSON_PARSE_ERROR;
+	}
+	return B6_JSON_OK;
+}
+
+static struct b6_json_number *new_integer(struct b6_json *json,
+					  unsigned long long int n, int neg)
+{
+	struct b6_json_number *self =
+		b6_json_new_number(json, neg ? -1. - n : (double)n);
+	if (self && (json->flags & B6_JSON_PRESERVE_INTEGERS) &&
+	    n <= 0x7fffffffffffffffULL)
+		b6_json_set_integer(self, neg ? -1 - (long long int)n :
+				    (long long int)n);
+	return self;
+}
+
+static double half_to_double(unsigned int half)
+{
+	unsigned long long int exp = half >> 10 & 0x1f, bits;
+	unsigned long long int mant = half & 0x3ff;
+	double d;
+	if (!exp)
+		d = mant / 16777216.;
+	else {
+		bits = (exp == 0x1f ? 0x7ffULL : exp - 15 + 1023) << 52 |
+			mant << 42;
+		__builtin_memcpy(&d, &bits, sizeof(d));
+	}
+	return half & 0x8000 ? -d : d;
+}
+
+static enum b6_json_error parse_simple(struct b6_json *json, unsigned char byte,
+				       unsigned long long int arg,
+				       struct b6_json_value **value)
+{
+	struct b6_json_number *number;
+	struct b6_json_false *f_value;
+	struct b6_json_true *t_value;
+	struct b6_json_null *n_value;
+	unsigned int f_bits = arg;
+	double d;
+	float f;
+	switch (byte) {
+	case CBOR_FALSE:
+		if (!(f_value = b6_json_new_false(json)))
+			return B6_JSON_ALLOC_ERROR;
+		*value = &f_value->up;
+		return B6_JSON_OK;
+	case CBOR_TRUE:
+		if (!(t_value = b6_json_new_true(json)))
+			return B6_JSON_ALLOC_ERROR;
+		*value = &t_value->up;
+		return B6_JSON_OK;
+	case CBOR_NULL:
+	case CBOR_UNDEFINED:
+		if (!(n_value = b6_json_new_null(json)))
+			return B6_JSON_ALLOC_ERROR;
+		*value = &n_value->up;
+		return B6_JSON_OK;
+	case CBOR_HALF:
+		d = half_to_double(arg);
+		break;
+	case CBOR_FLOAT:
+		__builtin_memcpy(&f, &f_bits, sizeof(f));
+		d = f;
+		break;
+	case CBOR_DOUBLE:
+		__builtin_memcpy(&d, &arg, sizeof(d));
+		break;
+	default:
+		return B6_JSON_PARSE_ERROR;
+	}
+	if (!(number = b6_json_new_number(json, d)))
+		return B6_JSON_ALLOC_ERROR;
+	*value = &number->up;
+	return B6_JSON_OK;
+}
+
+static enum b6_json_error parse_value(struct b6_json*, struct b6_json_istream*,
+				      struct b6_json_value**);
+
+static enum b6_json_error parse_array(struct b6_json_array *self,
+				      struct b6_json_istream *is,
+				      unsigned long long int n)
+{
+	unsigned long long int i;
+	for (i = 0; i < n; i += 1) {
+		struct b6_json_value *value;
+		enum b6_json_error retval;
+		if ((retval = parse_value(self->json, is, &value)))
+			return retval;
+		if ((retval = b6_json_add_array(self, i, value))) {
+			b6_json_unref_value(value);
+			return retval;
+		}
+	}
+	return B6_JSON_OK;
+}
+
+static enum b6_json_error parse_map(struct b6_json_object *self,
+				    struct b6_json_istream *is,
+				    unsigned long long int n)
+{
+	struct b6_json *json = self->json;
+	unsigned long long int i, arg;
+	for (i = 0; i < n; i += 1) {
+		struct b6_json_pair pair;
+		enum b6_json_error retval;
+		unsigned char byte;
+		if ((retval = read_head(is, &byte, &arg)))
+			return retval;
+		if ((byte & 0xe0) != CBOR_TEXT)
+			return B6_JSON_PARSE_ERROR;
+		if ((retval = parse_text(json, is, arg, &pair.key)))
+			return retval;
+		if (json->impl->ops->intern_key) {
+			struct b6_json_string *key = pair.key;
+			pair.key = json->impl->ops->intern_key(
+				json->impl, json, b6_json_get_string(key));
+			b6_json_unref_value(&key->up);
+			if (!pair.key)
+				return B6_JSON_ALLOC_ERROR;
+		}
+		if ((retval = parse_value(json, is, &pair.value))) {
+			b6_json_unref_value(&pair.key->up);
+			return retval;
+		}
+		if ((retval = self->impl->ops->add(self->impl, json->impl,
+						   &pair))) {
+			b6_json_unref_value(&pair.key->up);
+			b6_json_unref_value(pair.value);
+			return retval;
+		}
+	}
+	return B6_JSON_OK;
+}
+
+static enum b6_json_error parse_value(struct b6_json *json,
+				      struct b6_json_istream *is,
+				      struct b6_json_value **value)
+{
+	enum b6_json_error retval;
+	unsigned long long int arg;
+	unsigned char byte;
+	if ((retval = read_head(is, &byte, &arg)))
+		return retval;
+	switch (byte & 0xe0) {
+	case CBOR_UNSIGNED:
+	case CBOR_NEGATIVE: {
+		struct b6_json_number *number =
+			new_integer(json, arg, byte & CBOR_NEGATIVE);
+		if (!number)
+			return B6_JSON_ALLOC_ERROR;
+		*value = &number->up;
+		return B6_JSON_OK;
+	}
+	case CBOR_TEXT: {
+		struct b6_json_string *string;
+		if ((retval = parse_text(json, is, arg, &string)))
+			return retval;
+		*value = &string->up;
+		return B6_JSON_OK;
+	}
+	case CBOR_ARRAY: {
+		struct b6_json_array *array = b6_json_new_array(json);
+		if (!array)
+			return B6_JSON_ALLOC_ERROR;
+		if ((retval = parse_array(array, is, arg))) {
+			b6_json_unref_value(&array->up);
+			return retval;
+		}
+		*value = &array->up;
+		return B6_JSON_OK;
+	}
+	case CBOR_MAP: {
+		struct b6_json_object *object = b6_json_new_object(json);
+		if (!object)
+			return B6_JSON_ALLOC_ERROR;
+		if ((retval = parse_map(object, is, arg))) {
+			b6_json_unref_value(&object->up);
+			return retval;
+		}
+		*value = &object->up;
+		return B6_JSON_OK;
+	}
+	case CBOR_SIMPLE:
+		return parse_simple(json, byte, arg, value);
+	default:
+		return B6_JSON_PARSE_ERROR;
+	}
+}
+
+enum b6_json_error b6_json_parse_cbor(struct b6_json *json,
+				      struct b6_json_istream *is,
+				      struct b6_json_value **value)
+{
+	return parse_value(json, is, value);
+}
@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2015, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+#include "b6/concurrent.h"
+
+/* Maximum number of blocks in a bin before half of them are released. */
+#define BIN_CAPACITY 64
+
+/* Number of blocks allocated at once when a bin runs empty. */
+#define BATCH 16
+
+struct header {
+	struct b6_concurrent_cache *owner; /* NULL for large blocks */
+	unsigned long int size;
+};
+
+#define MAX_SIZE (16UL * B6_CONCURRENT_BINS)
+
+static unsigned int bin_of(unsigned long int size)
+{
+	return size ? (size - 1) / 16 : 0;
+}
+
+static struct header *header_of(void *ptr)
+{
+	return (struct header *)ptr - 1;
+}
+
+static void push(struct b6_concurrent_bin *bin, void *ptr)
+{
+	*(void **)ptr = bin->head;
+	bin->head = ptr;
+	bin->count += 1;
+}
+
+static void *pop(struct b6_concurrent_bin *bin)
+{
+	void *ptr = bin->head;
+	bin->head = *(void **)ptr;
+	bin->count -= 1;
+	return ptr;
+}
+
+/* Give n blocks of a bin back to the wrapped allocator. */
+static void flush(struct b6_concurrent_cache *self,
+		  struct b6_concurrent_bin *bin, unsigned int n)
+{
+	struct b6_concurrent_allocator *shared = self->shared;
+	void *ptrs[BIN_CAPACITY];
+	unsigned int i;
+
+	while (n) {
+		for (i = 0; i < n && i < b6_card_of(ptrs); i += 1)
+			ptrs[i] = header_of(pop(bin));
+		n -= i;
+		b6_spinlock_acquire(&shared->lock);
+		b6_deallocate_n(shared->allocator, ptrs, i);
+		b6_spinlock_release(&shared->lock);
+	}
+}
+
+/* Sort blocks released by other threads into bins. */
+static int drain(struct b6_concurrent_cache *self)
+{
+	void *ptr = __atomic_exchange_n(&self->remote, NULL, __ATOMIC_ACQUIRE);
+	int drained = !!ptr;
+
+	while (ptr) {
+		void *next = *(void **)ptr;
+		struct b6_concurrent_bin *bin =
+			&self->bins[bin_of(header_of(ptr)->size)];
+		push(bin, ptr);
+		if (bin->count > BIN_CAPACITY)
+			flush(self, bin, BIN_CAPACITY / 2);
+		ptr = next;
+	}
+
+	return drained;
+}
+
+static int refill(struct b6_concurrent_cache *self, unsigned int index)
+{
+	struct b6_concurrent_allocator *shared = self->shared;
+	unsigned long int size = 16 * (index + 1), n, i;
+	void *ptrs[BATCH];
+
+	b6_spinlock_acquire(&shared->lock);
+	n = b6_allocate_n(shared->allocator, size + B6_CONCURRENT_HEADER,
+			  ptrs, BATCH);
+	b6_spinlock_release(&shared->lock);
+
+	for (i = 0; i < n; i += 1) {
+		struct header *header = ptrs[i];
+		header->owner = self;
+		header->size = size;
+		push(&self->bins[index], header + 1);
+	}
+
+	return n;
+}
+
+static void *allocate_large(struct b6_concurrent_cache *self,
+			    unsigned long int size)
+{
+	struct b6_concurrent_allocator *shared = self->shared;
+	struct header *header;
+
+	if (size + B6_CONCURRENT_HEADER < size)
+		return NULL;
+
+	b6_spinlock_acquire(&shared->lock);
+	header = b6_allocate(shared->allocator, size + B6_CONCURRENT_HEADER);
+	b6_spinlock_release(&shared->lock);
+
+	if (!header)
+		return NULL;
+	header->owner = NULL;
+	header->size = size;
+	return header + 1;
+}
+
+static void *b6_concurrent_allocate(struct b6_allocator *up,
+				    unsigned long int size)
+{
+	struct b6_concurrent_cache *self =
+		b6_cast_of(up, struct b6_concurrent_cache, parent);
+	struct b6_concurrent_bin *bin;
+	unsigned int index;
+
+	if (size > MAX_SIZE)
+		return allocate_large(self, size);
+
+	index = bin_of(size);
+	bin = &self->bins[index];
+	if (b6_unlikely(!bin->head) && !(drain(self) && bin->head) &&
+	    !refill(self, index))
+		return NULL;
+
+	return pop(bin);
+}
+
+static void b6_concurrent_deallocate(struct b6_allocator *up, void *ptr)
+{
+	struct b6_concurrent_cache *self =
+		b6_cast_of(up, struct b6_concurrent_cache, parent);
+	struct header *header = header_of(ptr);
+	struct b6_concurrent_cache *owner = header->owner;
+	struct b6_concurrent_bin *bin;
+	void *head;
+
+	if (b6_unlikely(!owner)) {
+		b6_spinlock_acquire(&self->shared->lock);
+		b6_deallocate(self->shared->allocator, header);
+		b6_spinlock_release(&self->shared->lock);
+		return;
+	}
+
+	if (owner != self) {
+		/* Push onto the remote list of the owner. */
+		head = __atomic_load_n(&owner->remote, __ATOMIC_RELAXED);
+		do
+			*(void **)ptr = head;
+		while (!__atomic_compare_exchange_n(&owner->remote, &head, ptr,
+						    1, __ATOMIC_RELEASE,
+						    __ATOMIC_RELAXED));
+		return;
+	}
+
+	bin = &self->bins[bin_of(header->size)];
+	push(bin, ptr);
+	if (b6_unlikely(bin->count > BIN_CAPACITY))
+		flush(self, bin, BIN_CAPACITY / 2);
+}
+
+static void *b6_concurrent_reallocate(struct b6_allocator *up, void *ptr,
+				      unsigned long int size)
+{
+	struct header *header = header_of(ptr);
+	unsigned long int len = header->size;
+	void *dst;
+
+	if (header->owner && size <= MAX_SIZE && bin_of(size) == bin_of(len))
+		return ptr;
+
+	if (!(dst = b6_concurrent_allocate(up, size)))
+		return NULL;
+	__builtin_memcpy(dst, ptr, len < size ? len : size);
+	b6_concurrent_deallocate(up, ptr);
+	return dst;
+}
+
+void b6_concurrent_allocator_initialize(struct b6_concurrent_allocator *self,
+					struct b6_allocator *allocator,
+					struct b6_allocator *cache_allocator)
+{
+	b6_spinlock_initialize(&self->lock);
+	self->allocator = allocator;
+	self->cache_allocator = cache_allocator;
+	b6_list_initialize(&self->caches);
+	b6_list_initialize(&self->orphans);
+}
+
+static void flush_all(struct b6_concurrent_cache *self)
+{
+	unsigned int i;
+	drain(self);
+	for (i = 0; i < B6_CONCURRENT_BINS; i += 1)
+		flush(self, &self->bins[i], self->bins[i].count);
+}
+
+static void release_caches(struct b6_concurrent_allocator *self,
+			   struct b6_list *list)
+{
+	while (!b6_list_empty(list)) {
+		struct b6_concurrent_cache *cache =
+			b6_cast_of(b6_list_first(list),
+				   struct b6_concurrent_cache, dref);
+		b6_list_del(&cache->dref);
+		flush_all(cache);
+		b6_deallocate(self->cache_allocator, cache);
+	}
+}
+
+void b6_concurrent_allocator_finalize(struct b6_concurrent_allocator *self)
+{
+	release_caches(self, &self->caches);
+	release_caches(self, &self->orphans);
+}
+
+struct b6_allocator *b6_concurrent_attach(struct b6_concurrent_allocator *self)
+{
+	static const struct b6_allocator_ops ops = {
+		.allocate = b6_concurrent_allocate,
+		.reallocate = b6_concurrent_reallocate,
+		.deallocate = b6_concurrent_deallocate,
+	};
+	struct b6_concurrent_cache *cache;
+	unsigned int i;
+
+	b6_spinlock_acquire(&self->lock);
+	if (!b6_list_empty(&self->orphans)) {
+		cache = b6_cast_of(b6_list_first(&self->orphans),
+				   struct b6_concurrent_cache, dref);
+		b6_list_del(&cache->dref);
+	} else if ((cache = b6_allocate(self->cache_allocator,
+					sizeof(*cache)))) {
+		cache->parent.ops = &ops;
+		cache->shared = self;
+		cache->remote = NULL;
+		for (i = 0; i < B6_CONCURRENT_BINS; i += 1) {
+			cache->bins[i].head = NULL;
+			cache->bins[i].count = 0;
+		}
+	}
+	if (cache)
+		b6_list_add_last(&self->caches, &cache->dref);
+	b6_spinlock_release(&self->lock);
+
+	return cache ? &cache->parent : NULL;
+}
+
+void b6_concurrent_detach(struct b6_allocator *allocator)
+{
+	struct b6_concurrent_cache *cache =
+		b6_cast_of(allocator, struct b6_concurrent_cache, parent);
+	struct b6_concurrent_allocator *shared = cache->shared;
+
+	flush_all(cache);
+	b6_spinlock_acquire(&shared->lock);
+	b6_list_del(&cache->dref);
+	b6_list_add_last(&shared->orphans, &cache->dref);
+	b6_spinlock_release(&shared->lock);
+}
@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2015, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+#include "b6/guard.h"
+
+#define LIVE_MAGIC 0x4c697665U
+#define FREE_MAGIC 0x46726565U
+#define REDZONE_BYTE 0xfd
+
+#define HEADER_SIZE (sizeof(struct b6_guard_block) + B6_GUARD_REDZONE)
+
+/* Bytes after memory: at least a redzone, up to a multiple of 16 bytes. */
+static unsigned long int tail_size(unsigned long int size)
+{
+	return B6_GUARD_REDZONE + (-size & 15);
+}
+
+static int filled(const void *ptr, int c, unsigned long int len)
+{
+	const unsigned char *p = ptr, *end = p + len;
+	const unsigned long int word = ~0UL / 255 * c;
+	unsigned long int acc = 0;
+	while (p < end && ((unsigned long int)p & (sizeof(word) - 1)))
+		if (*p++ != c)
+			return 0;
+	/* Compare words and check once for speed. */
+	for (; p + sizeof(word) <= end; p += sizeof(word))
+		acc |= *(const unsigned long int *)p ^ word;
+	while (p < end)
+		acc |= *p++ ^ c;
+	return !acc;
+}
+
+static void fill(void *ptr, int c, unsigned long int len)
+{
+	__builtin_memset(ptr, c, len);
+}
+
+int b6_guard_poisoned(const void *ptr, unsigned long int len)
+{
+	return filled(ptr, B6_GUARD_POISON, len);
+}
+
+/* Free slots are chained by their index shifted with the lowest bit set. */
+static struct b6_guard_block *free_slot(unsigned long int next)
+{
+	return (struct b6_guard_block *)(next << 1 | 1);
+}
+
+static int is_free_slot(const struct b6_guard_block *block)
+{
+	return (unsigned long int)block & 1;
+}
+
+static int grow_slots(struct b6_guard *self)
+{
+	unsigned long int max = self->maxslots ? 2 * self->maxslots : 256;
+	struct b6_guard_block **slots;
+	if (max > ~0UL / sizeof(*slots))
+		return -1;
+	if (!(slots = b6_allocate(self->allocator, max * sizeof(*slots))))
+		return -1;
+	if (self->slots) {
+		__builtin_memcpy(slots, self->slots,
+				 self->nslots * sizeof(*slots));
+		b6_deallocate(self->allocator, self->slots);
+	}
+	self->slots = slots;
+	self->maxslots = max;
+	return 0;
+}
+
+static int add_slot(struct b6_guard *self, struct b6_guard_block *block)
+{
+	if (self->free) {
+		block->slot = self->free - 1;
+		self->free = (unsigned long int)self->slots[block->slot] >> 1;
+	} else {
+		if (self->nslots == self->maxslots && grow_slots(self))
+			return -1;
+		block->slot = self->nslots++;
+	}
+	self->slots[block->slot] = block;
+	return 0;
+}
+
+static void del_slot(struct b6_guard *self, struct b6_guard_block *block)
+{
+	self->slots[block->slot] = free_slot(self->free);
+	self->free = block->slot + 1;
+}
+
+static void *setup_block(struct b6_guard *self, char *base,
+			 unsigned long int offset, unsigned long int size,
+			 const void *site)
+{
+	char *ptr = base + offset;
+	struct b6_guard_block *block =
+		(struct b6_guard_block *)(ptr - HEADER_SIZE);
+	block->site = site;
+	block->size = size;
+	block->offset = offset;
+	block->magic = LIVE_MAGIC;
+	fill(ptr - B6_GUARD_REDZONE, REDZONE_BYTE, B6_GUARD_REDZONE);
+	fill(ptr + size, REDZONE_BYTE, tail_size(size));
+	if (add_slot(self, block)) {
+		b6_deallocate(self->allocator, base);
+		return NULL;
+	}
+	return ptr;
+}
+
+static struct b6_guard_block *check_block(void *ptr)
+{
+	struct b6_guard_block *block =
+		(struct b6_guard_block *)((char *)ptr - HEADER_SIZE);
+	b6_check(block->magic != FREE_MAGIC);
+	b6_check(block->magic == LIVE_MAGIC);
+	b6_check(filled((char *)ptr - B6_GUARD_REDZONE, REDZONE_BYTE,
+			B6_GUARD_REDZONE));
+	b6_check(filled((char *)ptr + block->size, REDZONE_BYTE,
+			tail_size(block->size)));
+	return block;
+}
+
+static void release_block(struct b6_guard *self, struct b6_guard_block *block)
+{
+	b6_deallocate(self->allocator,
+		      (char *)b6_guard_block_ptr(block) - block->offset);
+}
+
+static void evict(struct b6_guard *self)
+{
+	struct b6_guard_block *block = b6_cast_of(
+		b6_list_first(&self->quarantine), struct b6_guard_block, dref);
+	int intact;
+	b6_list_del(&block->dref);
+	self->quarantined -= block->size;
+	/* Poison has to be intact, otherwise memory was used after release. */
+	intact = filled(b6_guard_block_ptr(block), B6_GUARD_POISON,
+			block->size);
+	release_block(self, block);
+	b6_check(intact);
+}
+
+static void *allocate(struct b6_guard *self, unsigned long int size,
+		      unsigned long int alignment, const void *site)
+{
+	unsigned long int offset = HEADER_SIZE, len;
+	char *base;
+
+	if (alignment > ~0U)
+		return NULL;
+
+	if (alignment <= 16) {
+		len = offset + size + tail_size(size);
+		if (len < size)
+			return NULL;
+		base = b6_allocate(self->allocator, len);
+	} else {
+		if (offset < alignment)
+			offset = alignment;
+		len = offset + size + tail_size(size);
+		if (len < size)
+			return NULL;
+		base = b6_allocate_aligned(self->allocator, len, alignment);
+	}
+
+	return base ? setup_block(self, base, offset, size, site) : NULL;
+}
+
+static void deallocate(struct b6_guard *self, void *ptr)
+{
+	struct b6_guard_block *block = check_block(ptr);
+
+	del_slot(self, block);
+	block->magic = FREE_MAGIC;
+	if (!self->capacity || block->size > self->capacity) {
+		release_block(self, block);
+		return;
+	}
+
+	fill(ptr, B6_GUARD_POISON, block->size);
+	b6_list_add_last(&self->quarantine, &block->dref);
+	self->quarantined += block->size;
+	while (self->quarantined > self->capacity)
+		evict(self);
+}
+
+static void *b6_guard_allocate(struct b6_allocator *up, unsigned long int size)
+{
+	struct b6_guard *self = b6_cast_of(up, struct b6_guard, parent);
+	return allocate(self, size, 1, __builtin_return_address(0));
+}
+
+static void *b6_guard_allocate_aligned(struct b6_allocator *up,
+				       unsigned long int size,
+				       unsigned long int alignment)
+{
+	struct b6_guard *self = b6_cast_of(up, struct b6_guard, parent);
+	return allocate(self, size, alignment, __builtin_return_address(0));
+}
+
+static void *b6_guard_reallocate(struct b6_allocator *up, void *ptr,
+				 unsigned long int size)
+{
+	struct b6_guard *self = b6_cast_of(up, struct b6_guard, parent);
+	struct b6_guard_block *block = check_block(ptr);
+	void *dst;
+
+	/* Always move, so that stale pointers hit the quarantine. */
+	if (!(dst = allocate(self, size, 1, __builtin_return_address(0))))
+		return NULL;
+	__builtin_memcpy(dst, ptr, block->size < size ? block->size : size);
+	deallocate(self, ptr);
+	return dst;
+}
+
+static void b6_guard_deallocate(struct b6_allocator *up, void *ptr)
+{
+	struct b6_guard *self = b6_cast_of(up, struct b6_guard, parent);
+	deallocate(self, ptr);
+}
+
+const struct b6_allocator_ops b6_guard_ops = {
+	.allocate = b6_guard_allocate,
+	.reallocate = b6_guard_reallocate,
+	.deallocate = b6_guard_deallocate,
+	.allocate_aligned = b6_guard_allocate_aligned,
+};
+
+void b6_guard_initialize(struct b6_guard *self, struct b6_allocator *allocator,
+			 unsigned long int capacity)
+{
+	self->parent.ops = &b6_guard_ops;
+	self->allocator = allocator;
+	self->capacity = capacity;
+	self->quarantined = 0;
+	self->slots = NULL;
+	self->nslots = 0;
+	self->maxslots = 0;
+	self->free = 0;
+	b6_list_initialize(&self->quarantine);
+}
+
+static struct b6_guard_block *find_block(const struct b6_guard *self,
+					 unsigned long int slot)
+{
+	for (; slot < self->nslots; slot += 1)
+		if (!is_free_slot(self->slots[slot]))
+			return self->slots[slot];
+	return NULL;
+}
+
+struct b6_guard_block *b6_guard_first(const struct b6_guard *self)
+{
+	return find_block(self, 0);
+}
+
+struct b6_guard_block *b6_guard_next(const struct b6_guard *self,
+				     const struct b6_guard_block *block)
+{
+	return find_block(self, block->slot + 1);
+}
+
+unsigned long int b6_guard_finalize(struct b6_guard *self)
+{
+	unsigned long int leaks = 0, slot;
+
+	while (!b6_list_empty(&self->quarantine))
+		evict(self);
+
+	for (slot = 0; slot < self->nslots; slot += 1)
+		if (!is_free_slot(self->slots[slot])) {
+			release_block(self, self->slots[slot]);
+			leaks += 1;
+		}
+
+	b6_deallocate(self->allocator, self->slots);
+
+	return leaks;
+}
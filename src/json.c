@@ -1,8 +1,8 @@
 #include "b6/json.h"
 
 #include "b6/array.h"
+#include "b6/list.h"
 #include "b6/pool.h"
-#include "b6/registry.h"
 #include "b6/utf8.h"
 
 static const char null_token[] = "null";
@@ -41,79 +41,385 @@ static int b6_json_is_whitespace(char c)
 	}
 }
 
-static long int b6_json_istream_read(struct b6_json_istream *self,
-				     char *buf, unsigned long int len)
+static int is_plain(char c)
 {
-	char * const ptr = buf;
-	if (!len)
-		goto done;
-	if (self->has_c) {
-		self->has_c = 0;
-		*buf++ = self->c;
-		len -= 1;
+	return (unsigned char)(c - ' ') < 0x80 - ' ' && c != quote &&
+		c != backslash;
+}
+
+/* Scanners look for the first byte of [ptr, end) that needs attention:
+ * plain() stops at quotes, backslashes, control characters and non-ascii
+ * bytes, blank() at anything but whitespace. */
+struct scanner {
+	const char *(*plain)(const char *ptr, const char *end);
+	const char *(*blank)(const char *ptr, const char *end);
+};
+
+static const char *scalar_plain(const char *ptr, const char *end)
+{
+	while (ptr != end && is_plain(*ptr))
+		ptr += 1;
+	return ptr;
+}
+
+static const char *scalar_blank(const char *ptr, const char *end)
+{
+	while (ptr != end && b6_json_is_whitespace(*ptr))
+		ptr += 1;
+	return ptr;
+}
+
+static const struct scanner scalar_scanner = {
+	.plain = scalar_plain,
+	.blank = scalar_blank,
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/* Vectors of signed chars, so that a single comparison against a space
+ * catches both control characters and non-ascii bytes. */
+typedef char v16qi __attribute__((vector_size(16)));
+typedef char v32qi __attribute__((vector_size(32)));
+typedef signed char v16qs __attribute__((vector_size(16)));
+typedef signed char v32qs __attribute__((vector_size(32)));
+
+#define splat16(c) ((v16qs){ c, c, c, c, c, c, c, c, c, c, c, c, c, c, c, c })
+#define splat32(c) ((v32qs){ \
+	c, c, c, c, c, c, c, c, c, c, c, c, c, c, c, c, \
+	c, c, c, c, c, c, c, c, c, c, c, c, c, c, c, c })
+
+__attribute__((target("sse2")))
+static const char *sse2_plain(const char *ptr, const char *end)
+{
+	for (; end - ptr >= 16; ptr += 16) {
+		v16qs v;
+		int mask;
+		__builtin_memcpy(&v, ptr, sizeof(v));
+		mask = __builtin_ia32_pmovmskb128((v16qi)(
+			(v < splat16(' ')) | (v == splat16('"')) |
+			(v == splat16('\\'))));
+		if (mask)
+			return ptr + __builtin_ctz(mask);
+	}
+	return scalar_plain(ptr, end);
+}
+
+__attribute__((target("sse2")))
+static const char *sse2_blank(const char *ptr, const char *end)
+{
+	/* Most tokens are preceded by a single space at most. */
+	if (ptr == end || !b6_json_is_whitespace(*ptr))
+		return ptr;
+	for (; end - ptr >= 16; ptr += 16) {
+		v16qs v;
+		int mask;
+		__builtin_memcpy(&v, ptr, sizeof(v));
+		mask = __builtin_ia32_pmovmskb128((v16qi)(
+			(v == splat16(' ')) | (v == splat16('\n')) |
+			(v == splat16('\t')) | (v == splat16('\r')) |
+			(v == splat16('\f')))) ^ 0xffff;
+		if (mask)
+			return ptr + __builtin_ctz(mask);
+	}
+	return scalar_blank(ptr, end);
+}
+
+static const struct scanner sse2_scanner = {
+	.plain = sse2_plain,
+	.blank = sse2_blank,
+};
+
+__attribute__((target("avx2")))
+static const char *avx2_plain(const char *ptr, const char *end)
+{
+	for (; end - ptr >= 32; ptr += 32) {
+		v32qs v;
+		unsigned int mask;
+		__builtin_memcpy(&v, ptr, sizeof(v));
+		mask = __builtin_ia32_pmovmskb256((v32qi)(
+			(v < splat32(' ')) | (v == splat32('"')) |
+			(v == splat32('\\'))));
+		if (mask)
+			return ptr + __builtin_ctz(mask);
 	}
-	if (len) {
-		long int retval = self->ops->read(self, buf, len);
+	return sse2_plain(ptr, end);
+}
+
+__attribute__((target("avx2")))
+static const char *avx2_blank(const char *ptr, const char *end)
+{
+	if (ptr == end || !b6_json_is_whitespace(*ptr))
+		return ptr;
+	for (; end - ptr >= 32; ptr += 32) {
+		v32qs v;
+		unsigned int mask;
+		__builtin_memcpy(&v, ptr, sizeof(v));
+		mask = ~__builtin_ia32_pmovmskb256((v32qi)(
+			(v == splat32(' ')) | (v == splat32('\n')) |
+			(v == splat32('\t')) | (v == splat32('\r')) |
+			(v == splat32('\f'))));
+		if (mask)
+			return ptr + __builtin_ctz(mask);
+	}
+	return sse2_blank(ptr, end);
+}
+
+static const struct scanner avx2_scanner = {
+	.plain = avx2_plain,
+	.blank = avx2_blank,
+};
+
+#endif
+
+static const struct scanner *get_scanner(enum b6_json_isa isa)
+{
+	switch (isa) {
+	case B6_JSON_ISA_SCALAR:
+		return &scalar_scanner;
+#if defined(__x86_64__) || defined(__i386__)
+	case B6_JSON_ISA_SSE2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("sse2") ? &sse2_scanner : NULL;
+	case B6_JSON_ISA_AVX2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") ? &avx2_scanner : NULL;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+static const struct scanner *scanner;
+
+int b6_json_select_isa(enum b6_json_isa isa)
+{
+	const struct scanner *s = get_scanner(isa);
+	if (!s)
+		return -1;
+	__atomic_store_n(&scanner, s, __ATOMIC_RELAXED);
+	return 0;
+}
+
+/* Selects the best scanner on first use. Racing threads store the same
+ * value. */
+static const struct scanner *get_best_scanner(void)
+{
+	const struct scanner *s = __atomic_load_n(&scanner, __ATOMIC_RELAXED);
+	if (b6_likely(s))
+		return s;
+	if (!(s = get_scanner(B6_JSON_ISA_AVX2)) &&
+	    !(s = get_scanner(B6_JSON_ISA_SSE2)))
+		s = &scalar_scanner;
+	__atomic_store_n(&scanner, s, __ATOMIC_RELAXED);
+	return s;
+}
+
+long int b6_json_istream_refill(struct b6_json_istream *self,
+				unsigned long int n)
+{
+	unsigned long int len = self->end - self->ptr;
+	if (len >= n || !self->size)
+		return len;
+	if (self->ptr != self->buf) {
+		__builtin_memmove(self->buf, self->ptr, len);
+		self->ptr = self->buf;
+		self->end = self->buf + len;
+	}
+	while (len < n && len < self->size) {
+		long int retval = self->ops->read(self, self->buf + len,
+						  self->size - len);
 		if (retval < 0)
 			return retval;
-		buf += retval;
+		if (!retval)
+			break;
+		len += retval;
+		self->end += retval;
 	}
-done:
-	return buf - ptr;
+	return len;
 }
 
-static int b6_json_istream_get(struct b6_json_istream *self, char *c,
-			       struct b6_json_parser_info *info)
+static long int memory_istream_read(struct b6_json_istream *self, void *buf,
+				    unsigned long int len)
 {
-	if (self->has_c) {
-		*c = self->c;
-		self->has_c = 0;
-	} else if (self->ops->read(self, c, sizeof(*c)) != sizeof(*c))
-		return 0;
-	if (info) {
-		info->col += 1;
-		if (*c == '\n') {
-			info->row += 1;
-			info->col = 0;
+	return 0;
+}
+
+const struct b6_json_istream_ops b6_json_memory_istream_ops = {
+	.read = memory_istream_read,
+};
+
+static long int b6_json_istream_read(struct b6_json_istream *self,
+				     char *buf, unsigned long int len)
+{
+	char * const ptr = buf;
+	while (len) {
+		unsigned long int n = b6_json_istream_avail(self);
+		if (!n) {
+			long int retval = b6_json_istream_refill(self, 1);
+			if (retval < 0)
+				return retval;
+			if (!retval)
+				break;
+			n = retval;
 		}
+		if (n > len)
+			n = len;
+		__builtin_memcpy(buf, self->ptr, n);
+		self->ptr += n;
+		buf += n;
+		len -= n;
+	}
+	return buf - ptr;
+}
+
+static void b6_json_parser_info_update(struct b6_json_parser_info *info,
+				       char c)
+{
+	info->col += 1;
+	if (c == '\n') {
+		info->row += 1;
+		info->col = 0;
+	}
+}
+
+/* Same as updating info with each character of a run, only faster. */
+static void b6_json_parser_info_skip(struct b6_json_parser_info *info,
+				     const char *ptr, const char *end)
+{
+	const char *eol;
+	while ((eol = __builtin_memchr(ptr, '\n', end - ptr))) {
+		info->row += 1;
+		info->col = 0;
+		ptr = eol + 1;
 	}
+	info->col += end - ptr;
+}
+
+static inline int b6_json_istream_get(struct b6_json_istream *self, char *c,
+				      struct b6_json_parser_info *info)
+{
+	if (b6_unlikely(self->ptr == self->end) &&
+	    b6_json_istream_refill(self, 1) < 1)
+		return 0;
+	*c = *self->ptr++;
+	if (info)
+		b6_json_parser_info_update(info, *c);
 	return 1;
 }
 
-static enum b6_json_error b6_json_istream_unget(
-	struct b6_json_istream *self, char c, struct b6_json_parser_info *info)
+/* Only the byte returned by the last call to b6_json_istream_get can be put
+ * back: it is still in the window as refills happen before reading. */
+static void b6_json_istream_unget(struct b6_json_istream *self, char c,
+				  struct b6_json_parser_info *info)
 {
-	if (self->has_c)
-		return B6_JSON_ERROR;
-	self->has_c = 1;
-	self->c = c;
+	b6_precond(self->ptr != self->buf && self->ptr[-1] == c);
+	self->ptr -= 1;
 	if (info) {
 		if (c == '\n')
 			info->row -= 1;
 		else
 			info->col -= 1;
 	}
-	return B6_JSON_OK;
 }
 
-static long int b6_json_ostream_write(struct b6_json_ostream *self,
-				      const void *buf, unsigned long int len)
+static int b6_json_ostream_write_all(struct b6_json_ostream *self,
+				     const char *buf, unsigned long int len)
+{
+	while (len) {
+		long int n = self->ops->write(self, buf, len);
+		if (n <= 0)
+			return -1;
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int b6_json_ostream_drain(struct b6_json_ostream *self,
+				 unsigned long int n)
+{
+	if (self->ops->drain)
+		return self->ops->drain(self, n);
+	if (b6_json_ostream_write_all(self, self->buf, self->ptr - self->buf))
+		return -1;
+	self->ptr = self->buf;
+	return 0;
+}
+
+long int b6_json_ostream_write_slow(struct b6_json_ostream *self,
+				    const void *buf, unsigned long int len)
+{
+	if (b6_json_ostream_drain(self, len))
+		return -1;
+	if (len > (unsigned long int)(self->end - self->ptr))
+		return b6_json_ostream_write_all(self, buf, len) ? -1 : len;
+	__builtin_memcpy(self->ptr, buf, len);
+	self->ptr += len;
+	return len;
+}
+
+int b6_json_ostream_flush(struct b6_json_ostream *self)
+{
+	if (b6_json_ostream_drain(self, 0))
+		return -1;
+	return self->ops->flush ? self->ops->flush(self) : 0;
+}
+
+/* The window is the spare capacity of the array: draining only accounts for
+ * the bytes written in it. */
+static int array_ostream_drain(struct b6_json_ostream *up, unsigned long int n)
+{
+	struct b6_json_array_ostream *self =
+		b6_cast_of(up, struct b6_json_array_ostream, up);
+	struct b6_array *array = &self->array;
+	/* Commit the bytes of the window first so that a failure below does
+	 * not have them counted again by the next drain. */
+	array->length += up->ptr - up->buf;
+	up->buf = up->ptr;
+	if (n > array->capacity - array->length) {
+		if (n < B6_JSON_OSTREAM_SIZE)
+			n = B6_JSON_OSTREAM_SIZE;
+		if (b6_array_expand(array, n) ||
+		    n > array->capacity - array->length)
+			return -1;
+	}
+	up->ptr = up->buf = (char*)array->buffer + array->length;
+	up->end = (char*)array->buffer + array->capacity;
+	return 0;
+}
+
+static const struct b6_json_ostream_ops array_ostream_ops = {
+	.drain = array_ostream_drain,
+};
+
+void b6_json_array_ostream_initialize(struct b6_json_array_ostream *self,
+				      struct b6_allocator *allocator)
 {
-	return self->ops->write(self, buf, len);
+	b6_array_initialize(&self->array, allocator, 1);
+	b6_json_setup_buffered_ostream(&self->up, &array_ostream_ops, NULL, 0);
 }
 
-static int b6_json_ostream_flush(struct b6_json_ostream *self)
+void b6_json_array_ostream_finalize(struct b6_json_array_ostream *self)
 {
-	return self->ops->flush(self);
+	b6_array_finalize(&self->array);
 }
 
 static enum b6_json_error b6_json_istream_token(
 	struct b6_json_istream *self, char *c, struct b6_json_parser_info *info)
 {
-	while (b6_json_istream_get(self, c, info))
-		if (!b6_json_is_whitespace(*c))
-			return B6_JSON_OK;
-	return B6_JSON_IO_ERROR;
+	for (;;) {
+		const char *ptr = get_best_scanner()->blank(self->ptr,
+							    self->end);
+		if (info)
+			b6_json_parser_info_skip(info, self->ptr, ptr);
+		self->ptr = ptr;
+		if (ptr != self->end)
+			break;
+		if (b6_json_istream_refill(self, 1) < 1)
+			return B6_JSON_IO_ERROR;
+	}
+	return b6_json_istream_get(self, c, info) ? B6_JSON_OK :
+		B6_JSON_IO_ERROR;
 }
 
 static enum b6_json_error serialize_null(const struct b6_json_value *up,
@@ -158,91 +464,385 @@ const struct b6_json_value_ops b6_json_false_ops = {
 	.serialize = serialize_false,
 };
 
-static enum b6_json_error serialize_uint(unsigned long long int u,
-					 struct b6_json_ostream *os)
+/* Writes the decimal digits of u and returns their number. */
+static int format_uint(unsigned long long int u, char *buf)
 {
-	char tmp[32];
+	char tmp[20];
 	char *const end = tmp + sizeof(tmp);
 	char *ptr = end;
-	long int len;
 	do {
-		unsigned int d = u % 10;
+		*--ptr = u % 10 + '0';
 		u /= 10;
-		*--ptr = d + '0';
 	} while (u > 0);
-	len = end - ptr;
-	return b6_json_ostream_write(os, ptr, len) != len ? B6_JSON_IO_ERROR :
+	__builtin_memcpy(buf, ptr, end - ptr);
+	return end - ptr;
+}
+
+static enum b6_json_error serialize_uint(unsigned long long int u,
+					 struct b6_json_ostream *os)
+{
+	char buf[20];
+	long int len = format_uint(u, buf);
+	return b6_json_ostream_write(os, buf, len) != len ? B6_JSON_IO_ERROR :
 		B6_JSON_OK;
 }
 
-static enum b6_json_error serialize_number(const struct b6_json_value *up,
-					   struct b6_json_ostream *os,
-					   struct b6_json_serializer *helper)
+static void mul128(unsigned long long int a, unsigned long long int b,
+		   unsigned long long int *hi, unsigned long long int *lo)
 {
-	const struct b6_json_number *self = b6_json_value_as(up, number);
-	double epsilon = 1e-12;
-	double d;
-	unsigned long long int u;
+#ifdef __SIZEOF_INT128__
+	unsigned __int128 p = (unsigned __int128)a * b;
+	*hi = p >> 64;
+	*lo = p;
+#else
+	unsigned long long int a0 = a & 0xffffffff, a1 = a >> 32;
+	unsigned long long int b0 = b & 0xffffffff, b1 = b >> 32;
+	unsigned long long int p00 = a0 * b0, p01 = a0 * b1;
+	unsigned long long int p10 = a1 * b0, p11 = a1 * b1;
+	unsigned long long int mid = (p00 >> 32) + (p01 & 0xffffffff) +
+		(p10 & 0xffffffff);
+	*lo = (mid << 32) | (p00 & 0xffffffff);
+	*hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+#endif
+}
+
+/*
+ * Shortest double formatting with Grisu2 (Florian Loitsch, "Printing
+ * Floating-Point Numbers Quickly and Accurately with Integers"). The digits
+ * generated always parse back to the same double, and are the shortest such
+ * ones but for a tiny fraction of inputs where one more digit is emitted.
+ */
+
+struct diy_fp {
+	unsigned long long int f;
 	int e;
-	enum b6_json_error retval;
-	d = self->number;
-	if (d < 0) {
-		d = -d;
-		if (b6_json_ostream_write(os, &minus, 1) != 1)
-			return B6_JSON_IO_ERROR;
+};
+
+static struct diy_fp diy_fp_mul(struct diy_fp lhs, struct diy_fp rhs)
+{
+	struct diy_fp r;
+	unsigned long long int lo;
+	mul128(lhs.f, rhs.f, &r.f, &lo);
+	r.f += lo >> 63;
+	r.e = lhs.e + rhs.e + 64;
+	return r;
+}
+
+static struct diy_fp diy_fp_normalize(struct diy_fp x)
+{
+	int s = __builtin_clzll(x.f);
+	x.f <<= s;
+	x.e -= s;
+	return x;
+}
+
+/* Normalized 64-bit approximations of 10^k for k = -348, -340, ..., 340. */
+static const struct diy_fp cached_pow10[] = {
+	{ 0xfa8fd5a0081c0288ULL, -1220 },
+	{ 0xbaaee17fa23ebf76ULL, -1193 },
+	{ 0x8b16fb203055ac76ULL, -1166 },
+	{ 0xcf42894a5dce35eaULL, -1140 },
+	{ 0x9a6bb0aa55653b2dULL, -1113 },
+	{ 0xe61acf033d1a45dfULL, -1087 },
+	{ 0xab70fe17c79ac6caULL, -1060 },
+	{ 0xff77b1fcbebcdc4fULL, -1034 },
+	{ 0xbe5691ef416bd60cULL, -1007 },
+	{ 0x8dd01fad907ffc3cULL, -980 },
+	{ 0xd3515c2831559a83ULL, -954 },
+	{ 0x9d71ac8fada6c9b5ULL, -927 },
+	{ 0xea9c227723ee8bcbULL, -901 },
+	{ 0xaecc49914078536dULL, -874 },
+	{ 0x823c12795db6ce57ULL, -847 },
+	{ 0xc21094364dfb5637ULL, -821 },
+	{ 0x9096ea6f3848984fULL, -794 },
+	{ 0xd77485cb25823ac7ULL, -768 },
+	{ 0xa086cfcd97bf97f4ULL, -741 },
+	{ 0xef340a98172aace5ULL, -715 },
+	{ 0xb23867fb2a35b28eULL, -688 },
+	{ 0x84c8d4dfd2c63f3bULL, -661 },
+	{ 0xc5dd44271ad3cdbaULL, -635 },
+	{ 0x936b9fcebb25c996ULL, -608 },
+	{ 0xdbac6c247d62a584ULL, -582 },
+	{ 0xa3ab66580d5fdaf6ULL, -555 },
+	{ 0xf3e2f893dec3f126ULL, -529 },
+	{ 0xb5b5ada8aaff80b8ULL, -502 },
+	{ 0x87625f056c7c4a8bULL, -475 },
+	{ 0xc9bcff6034c13053ULL, -449 },
+	{ 0x964e858c91ba2655ULL, -422 },
+	{ 0xdff9772470297ebdULL, -396 },
+	{ 0xa6dfbd9fb8e5b88fULL, -369 },
+	{ 0xf8a95fcf88747d94ULL, -343 },
+	{ 0xb94470938fa89bcfULL, -316 },
+	{ 0x8a08f0f8bf0f156bULL, -289 },
+	{ 0xcdb02555653131b6ULL, -263 },
+	{ 0x993fe2c6d07b7facULL, -236 },
+	{ 0xe45c10c42a2b3b06ULL, -210 },
+	{ 0xaa242499697392d3ULL, -183 },
+	{ 0xfd87b5f28300ca0eULL, -157 },
+	{ 0xbce5086492111aebULL, -130 },
+	{ 0x8cbccc096f5088ccULL, -103 },
+	{ 0xd1b71758e219652cULL, -77 },
+	{ 0x9c40000000000000ULL, -50 },
+	{ 0xe8d4a51000000000ULL, -24 },
+	{ 0xad78ebc5ac620000ULL, 3 },
+	{ 0x813f3978f8940984ULL, 30 },
+	{ 0xc097ce7bc90715b3ULL, 56 },
+	{ 0x8f7e32ce7bea5c70ULL, 83 },
+	{ 0xd5d238a4abe98068ULL, 109 },
+	{ 0x9f4f2726179a2245ULL, 136 },
+	{ 0xed63a231d4c4fb27ULL, 162 },
+	{ 0xb0de65388cc8ada8ULL, 189 },
+	{ 0x83c7088e1aab65dbULL, 216 },
+	{ 0xc45d1df942711d9aULL, 242 },
+	{ 0x924d692ca61be758ULL, 269 },
+	{ 0xda01ee641a708deaULL, 295 },
+	{ 0xa26da3999aef774aULL, 322 },
+	{ 0xf209787bb47d6b85ULL, 348 },
+	{ 0xb454e4a179dd1877ULL, 375 },
+	{ 0x865b86925b9bc5c2ULL, 402 },
+	{ 0xc83553c5c8965d3dULL, 428 },
+	{ 0x952ab45cfa97a0b3ULL, 455 },
+	{ 0xde469fbd99a05fe3ULL, 481 },
+	{ 0xa59bc234db398c25ULL, 508 },
+	{ 0xf6c69a72a3989f5cULL, 534 },
+	{ 0xb7dcbf5354e9beceULL, 561 },
+	{ 0x88fcf317f22241e2ULL, 588 },
+	{ 0xcc20ce9bd35c78a5ULL, 614 },
+	{ 0x98165af37b2153dfULL, 641 },
+	{ 0xe2a0b5dc971f303aULL, 667 },
+	{ 0xa8d9d1535ce3b396ULL, 694 },
+	{ 0xfb9b7cd9a4a7443cULL, 720 },
+	{ 0xbb764c4ca7a44410ULL, 747 },
+	{ 0x8bab8eefb6409c1aULL, 774 },
+	{ 0xd01fef10a657842cULL, 800 },
+	{ 0x9b10a4e5e9913129ULL, 827 },
+	{ 0xe7109bfba19c0c9dULL, 853 },
+	{ 0xac2820d9623bf429ULL, 880 },
+	{ 0x80444b5e7aa7cf85ULL, 907 },
+	{ 0xbf21e44003acdd2dULL, 933 },
+	{ 0x8e679c2f5e44ff8fULL, 960 },
+	{ 0xd433179d9c8cb841ULL, 986 },
+	{ 0x9e19db92b4e31ba9ULL, 1013 },
+	{ 0xeb96bf6ebadf77d9ULL, 1039 },
+	{ 0xaf87023b9bf0ee6bULL, 1066 },
+};
+
+static struct diy_fp get_cached_pow10(int e, int *k)
+{
+	/* Smallest k such that 10^k brings e in [-60, -32]. */
+	double dk = (-61 - e) * 0.30102999566398114 + 347;
+	int i = (int)dk;
+	if (dk - i > 0)
+		i += 1;
+	i = (i >> 3) + 1;
+	*k = 348 - (i << 3);
+	return cached_pow10[i];
+}
+
+static const unsigned long long int pow10_64[] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+	10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+	100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+	100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+	100000000000000000ULL, 1000000000000000000ULL,
+	10000000000000000000ULL,
+};
+
+static void grisu_round(char *buf, int len, unsigned long long int delta,
+			unsigned long long int rest,
+			unsigned long long int ten_kappa,
+			unsigned long long int wp_w)
+{
+	while (rest < wp_w && delta - rest >= ten_kappa &&
+	       (rest + ten_kappa < wp_w ||
+		wp_w - rest > rest + ten_kappa - wp_w)) {
+		buf[len - 1] -= 1;
+		rest += ten_kappa;
 	}
-	if (d == (double)(u = (unsigned long long int)d))
-		return serialize_uint(u, os);
-	e = 0;
-	if (d < 1)
-		do {
-			d *= 10;
-			e -= 1;
-		} while (d < 1);
-	else
-		while (d > 10) {
-			d /= 10;
-			e += 1;
+}
+
+static int count_digits(unsigned int n)
+{
+	int i = 1;
+	while (i < 10 && n >= pow10_64[i])
+		i += 1;
+	return i;
+}
+
+static int grisu_digits(struct diy_fp w, struct diy_fp mp,
+			unsigned long long int delta, char *buf, int *k)
+{
+	const int shift = -mp.e;
+	const unsigned long long int one = 1ULL << shift;
+	const unsigned long long int wp_w = mp.f - w.f;
+	unsigned int p1 = mp.f >> shift;
+	unsigned long long int p2 = mp.f & (one - 1);
+	int kappa = count_digits(p1);
+	int len = 0;
+	while (kappa > 0) {
+		unsigned long long int rest;
+		unsigned int d = p1 / pow10_64[kappa - 1];
+		p1 %= pow10_64[kappa - 1];
+		if (d || len)
+			buf[len++] = '0' + d;
+		kappa -= 1;
+		rest = ((unsigned long long int)p1 << shift) + p2;
+		if (rest <= delta) {
+			*k += kappa;
+			grisu_round(buf, len, delta, rest,
+				    pow10_64[kappa] << shift, wp_w);
+			return len;
 		}
-	u = (unsigned long long int)d;
-	d -= (double)u;
-	if (d >= 1 - epsilon) {
-		u += 1;
-		d = 0;
 	}
-	if ((retval = serialize_uint(u, os)))
-		return retval;
-	if (d > 0) {
-		if (b6_json_ostream_write(os, &point, 1) != 1)
-			return B6_JSON_IO_ERROR;
-		d = ((unsigned long long int)(d / epsilon)) * epsilon;
-		for (;;) {
-			char c;
-			d *= 10;
-			epsilon *= 10;
-			u = (unsigned long long int)d;
-			d -= (double)u;
-			if (d >= 1 - epsilon) {
-				u += 1;
-				if ((retval = serialize_uint(u, os)))
-					return retval;
-				break;
-			}
-			c = u + '0';
-			if (b6_json_ostream_write(os, &c, 1) != 1)
-				return B6_JSON_IO_ERROR;
+	for (;;) {
+		unsigned int d;
+		p2 *= 10;
+		delta *= 10;
+		d = p2 >> shift;
+		if (d || len)
+			buf[len++] = '0' + d;
+		p2 &= one - 1;
+		kappa -= 1;
+		if (p2 < delta) {
+			*k += kappa;
+			grisu_round(buf, len, delta, p2, one,
+				    -kappa < b6_card_of(pow10_64) ?
+				    wp_w * pow10_64[-kappa] : 0);
+			return len;
 		}
 	}
-	if (!e)
-		return B6_JSON_OK;
-	if (b6_json_ostream_write(os, &power, 1) != 1)
-		return B6_JSON_IO_ERROR;
-	if (e < 0) {
-		e = -e;
+}
+
+/* Writes the digits of a positive finite double d such that d is the
+ * nearest double to digits * 10^k. Returns the number of digits. */
+static int grisu2(double d, char *buf, int *k)
+{
+	unsigned long long int bits;
+	struct diy_fp v, w, plus, minus, c;
+	int cached_k;
+	__builtin_memcpy(&bits, &d, sizeof(bits));
+	v.f = bits & ((1ULL << 52) - 1);
+	if (bits >> 52) {
+		v.f += 1ULL << 52;
+		v.e = (int)(bits >> 52) - 1075;
+	} else
+		v.e = -1074;
+	/* Boundaries halfway to the neighbouring doubles, the lower one being
+	 * closer when v is a power of two. */
+	plus.f = (v.f << 1) + 1;
+	plus.e = v.e - 1;
+	plus = diy_fp_normalize(plus);
+	if (v.f == 1ULL << 52) {
+		minus.f = (v.f << 2) - 1;
+		minus.e = v.e - 2;
+	} else {
+		minus.f = (v.f << 1) - 1;
+		minus.e = v.e - 1;
+	}
+	minus.f <<= minus.e - plus.e;
+	minus.e = plus.e;
+	c = get_cached_pow10(plus.e, &cached_k);
+	w = diy_fp_mul(diy_fp_normalize(v), c);
+	plus = diy_fp_mul(plus, c);
+	minus = diy_fp_mul(minus, c);
+	minus.f += 1;
+	plus.f -= 1;
+	*k = cached_k;
+	return grisu_digits(w, plus, plus.f - minus.f, buf, k);
+}
+
+/* Lays out digits * 10^k the way JavaScript does: positional notation for
+ * decimal exponents in [-6, 21), scientific notation otherwise. */
+static int format_double(char *buf, int len, int k)
+{
+	int kk = len + k, i;
+	if (k >= 0 && kk <= 21) {
+		/* 1234e2 -> 123400 */
+		for (i = len; i < kk; i += 1)
+			buf[i] = '0';
+		return kk;
+	}
+	if (kk > 0 && kk <= 21) {
+		/* 1234e-2 -> 12.34 */
+		__builtin_memmove(buf + kk + 1, buf + kk, len - kk);
+		buf[kk] = '.';
+		return len + 1;
+	}
+	if (kk > -6 && kk <= 0) {
+		/* 1234e-6 -> 0.001234 */
+		int offset = 2 - kk;
+		__builtin_memmove(buf + offset, buf, len);
+		buf[0] = '0';
+		buf[1] = '.';
+		for (i = 2; i < offset; i += 1)
+			buf[i] = '0';
+		return len + offset;
+	}
+	/* 1234e30 -> 1.234e33 */
+	if (len > 1) {
+		__builtin_memmove(buf + 2, buf + 1, len - 1);
+		buf[1] = '.';
+		len += 1;
+	}
+	buf[len++] = 'e';
+	kk -= 1;
+	if (kk < 0) {
+		buf[len++] = '-';
+		kk = -kk;
+	}
+	if (kk >= 100)
+		buf[len++] = '0' + kk / 100;
+	if (kk >= 10)
+		buf[len++] = '0' + kk / 10 % 10;
+	buf[len++] = '0' + kk % 10;
+	return len;
+}
+
+static enum b6_json_error serialize_integer(long long int i,
+					    struct b6_json_ostream *os)
+{
+	unsigned long long int u = i;
+	if (i < 0) {
+		u = -u;
 		if (b6_json_ostream_write(os, &minus, 1) != 1)
 			return B6_JSON_IO_ERROR;
 	}
-	return serialize_uint(e, os);
+	return serialize_uint(u, os);
+}
+
+static enum b6_json_error serialize_double(double d,
+					   struct b6_json_ostream *os)
+{
+	/* Sign, 17 digits, decimal point, 5 leading zeros, exponent. */
+	char buf[32], *ptr = buf;
+	unsigned long long int bits;
+	int len, k;
+	__builtin_memcpy(&bits, &d, sizeof(bits));
+	/* JSON has no representation for infinities and NaNs. */
+	if ((bits >> 52 & 0x7ff) == 0x7ff)
+		return serialize_null(NULL, os, NULL);
+	if (bits >> 63) {
+		*ptr++ = minus;
+		d = -d;
+	}
+	if (d < 1e15 && d == (double)(unsigned long long int)d)
+		len = format_uint((unsigned long long int)d, ptr);
+	else {
+		len = grisu2(d, ptr, &k);
+		len = format_double(ptr, len, k);
+	}
+	len += ptr - buf;
+	return b6_json_ostream_write(os, buf, len) != len ? B6_JSON_IO_ERROR :
+		B6_JSON_OK;
+}
+
+static enum b6_json_error serialize_number(const struct b6_json_value *up,
+					   struct b6_json_ostream *os,
+					   struct b6_json_serializer *helper)
+{
+	const struct b6_json_number *self = b6_json_value_as(up, number);
+	return self->is_integer ? serialize_integer(self->integer, os) :
+		serialize_double(self->number, os);
 }
 
 static void number_dtor(struct b6_json_value *up)
@@ -261,8 +861,12 @@ static enum b6_json_error serialize_array(const struct b6_json_value *up,
 					  struct b6_json_serializer *helper)
 {
 	struct b6_json_array *self = b6_cast_of(up, struct b6_json_array, up);
-	unsigned int index = 0, len = b6_json_array_len(self);
+	unsigned int index = 0, len;
 	enum b6_json_error retval;
+	/* A deferred array that does not parse would otherwise look empty. */
+	if ((retval = b6_json_load_value(&self->up)))
+		return retval;
+	len = b6_json_array_len(self);
 	if ((retval = helper->ops->enter_array(helper, os, self)))
 		return retval;
 	if (len) for (;;) {
@@ -300,6 +904,8 @@ static enum b6_json_error serialize_object(const struct b6_json_value *up,
 	struct b6_json_iterator iter;
 	const struct b6_json_pair *curr, *next;
 	enum b6_json_error retval;
+	if ((retval = b6_json_load_value(&self->up)))
+		return retval;
 	if ((retval = helper->ops->enter_object(helper, os, self)))
 		return retval;
 	b6_json_setup_iterator(&iter, self);
@@ -404,6 +1010,15 @@ static void array_default_impl_del(struct b6_json_array_impl *up,
 	b6_array_reduce(&self->array, 1);
 }
 
+static void array_default_impl_clear(struct b6_json_array_default_impl *self)
+{
+	struct b6_json_value **values = b6_array_get(&self->array, 0);
+	unsigned int i = b6_array_length(&self->array);
+	while (i--)
+		b6_json_unref_value(*values++);
+	b6_array_finalize(&self->array);
+}
+
 static void array_default_impl_dtor(struct b6_json_array_impl *up,
 				    struct b6_json_impl *impl)
 {
@@ -411,33 +1026,36 @@ static void array_default_impl_dtor(struct b6_json_array_impl *up,
 		b6_cast_of(up, struct b6_json_array_default_impl, up);
 	struct b6_json_default_impl *default_impl =
 		b6_cast_of(impl, struct b6_json_default_impl, up);
-	struct b6_json_value **values = b6_array_get(&self->array, 0);
-	unsigned int i = b6_array_length(&self->array);
-	while (i--)
-		b6_json_unref_value(*values++);
-	b6_array_finalize(&self->array);
+	array_default_impl_clear(self);
 	b6_pool_put(&default_impl->array_pool, self);
 }
 
+static const struct b6_json_array_impl_ops array_default_impl_ops = {
+	.dtor = array_default_impl_dtor,
+	.len = array_default_impl_len,
+	.add = array_default_impl_add,
+	.del = array_default_impl_del,
+	.get = array_default_impl_get,
+	.set = array_default_impl_set,
+};
+
+static void array_default_impl_setup(struct b6_json_array_default_impl *self,
+				     struct b6_json_default_impl *impl)
+{
+	self->up.ops = &array_default_impl_ops;
+	b6_array_initialize(&self->array, impl->allocator,
+			    sizeof(struct b6_json_value*));
+}
+
 static struct b6_json_array_impl *array_default_impl_new(
 	struct b6_json_impl *up)
 {
 	struct b6_json_default_impl *self =
 		b6_cast_of(up, struct b6_json_default_impl, up);
-	static const struct b6_json_array_impl_ops ops = {
-		.dtor = array_default_impl_dtor,
-		.len = array_default_impl_len,
-		.add = array_default_impl_add,
-		.del = array_default_impl_del,
-		.get = array_default_impl_get,
-		.set = array_default_impl_set,
-	};
 	struct b6_json_array_default_impl *impl;
 	if (!(impl = b6_pool_get(&self->array_pool)))
 		return NULL;
-	impl->up.ops = &ops;
-	b6_array_initialize(&impl->array, self->allocator,
-			    sizeof(struct b6_json_value*));
+	array_default_impl_setup(impl, self);
 	return &impl->up;
 }
 
@@ -477,20 +1095,21 @@ static enum b6_json_error string_default_impl_append(
 	return B6_JSON_OK;
 }
 
+static const struct b6_json_string_impl_ops string_default_impl_ops = {
+	.dtor = string_default_impl_dtor,
+	.get = string_default_impl_get,
+	.append = string_default_impl_append,
+};
+
 static struct b6_json_string_impl *string_default_impl_new(
 	struct b6_json_impl *up, const struct b6_utf8 *utf8)
 {
 	struct b6_json_default_impl *self =
 		b6_cast_of(up, struct b6_json_default_impl, up);
-	static const struct b6_json_string_impl_ops ops = {
-		.dtor = string_default_impl_dtor,
-		.get = string_default_impl_get,
-		.append = string_default_impl_append,
-	};
 	struct b6_json_string_default_impl *impl;
 	if (!(impl = b6_pool_get(&self->string_pool)))
 		return NULL;
-	impl->up.ops = &ops;
+	impl->up.ops = &string_default_impl_ops;
 	b6_initialize_utf8_string(&impl->utf8_string, self->allocator);
 	if (utf8 && b6_extend_utf8_string(&impl->utf8_string, utf8)) {
 		b6_pool_put(&self->string_pool, impl);
@@ -499,94 +1118,385 @@ static struct b6_json_string_impl *string_default_impl_new(
 	return &impl->up;
 }
 
-static void string_dtor(struct b6_json_value *up)
+/* String views borrow the bytes they are created with and become regular
+ * strings owning a copy of them when appended to. */
+static void string_view_impl_dtor(struct b6_json_string_impl *up,
+				  struct b6_json_impl *impl)
 {
-	struct b6_json_string *self = b6_cast_of(up, struct b6_json_string, up);
-	self->impl->ops->dtor(self->impl, self->json->impl);
-	b6_pool_put(&self->json->pool, self);
+	struct b6_json_default_impl *default_impl =
+		b6_cast_of(impl, struct b6_json_default_impl, up);
+	b6_pool_put(&default_impl->string_pool, up);
 }
 
-static enum b6_json_error serialize_string(const struct b6_json_value *up,
-					   struct b6_json_ostream *os,
-					   struct b6_json_serializer *helper)
+static enum b6_json_error string_view_impl_append(
+	struct b6_json_string_impl *up,
+	struct b6_json_impl *impl,
+	const struct b6_utf8 *utf8)
 {
-	struct b6_json_string *self = b6_cast_of(up, struct b6_json_string, up);
-	struct b6_json_string_default_impl *impl = b6_cast_of(
-		self->impl, struct b6_json_string_default_impl, up);
-	struct b6_utf8_iterator iter;
-	b6_setup_utf8_iterator(&iter, &impl->utf8_string.utf8);
-	if (b6_json_ostream_write(os, &quote, 1) != 1)
-		return B6_JSON_IO_ERROR;
-	while (b6_utf8_iterator_has_next(&iter)) {
-		unsigned int unicode = b6_utf8_iterator_get_next(&iter);
-		if (unicode >= 128) {
-			unsigned char utf8[4];
-			int len = b6_utf8_enc_len(unicode);
-			b6_assert(len > 0);
-			b6_utf8_enc(len, unicode, utf8);
-			if (b6_json_ostream_write(os, utf8, len) != len)
-				return B6_JSON_IO_ERROR;
-		} else {
-			char escape[2] = { '\\', '\0' };
-			escape[1] = unicode;
-			switch (escape[1]) {
-			case '\"':
-			case '\\':
-				if (b6_json_ostream_write(os, escape, 2) != 2)
-					return B6_JSON_IO_ERROR;
-				break;
-			case '\b':
-				escape[1] = 'b';
-				if (b6_json_ostream_write(os, escape, 2) != 2)
-					return B6_JSON_IO_ERROR;
-				break;
-			case '\f':
-				escape[1] = 'f';
-				if (b6_json_ostream_write(os, escape, 2) != 2)
-					return B6_JSON_IO_ERROR;
-				break;
-			case '\n':
-				escape[1] = 'n';
-				if (b6_json_ostream_write(os, escape, 2) != 2)
-					return B6_JSON_IO_ERROR;
-				break;
-			case '\r':
-				escape[1] = 'r';
-				if (b6_json_ostream_write(os, escape, 2) != 2)
-					return B6_JSON_IO_ERROR;
-				break;
-			case '\t':
-				escape[1] = 't';
-				if (b6_json_ostream_write(os, escape, 2) != 2)
-					return B6_JSON_IO_ERROR;
-				break;
-			default:
-				if (b6_json_ostream_write(os, escape + 1,
-							  1) != 1)
-					return B6_JSON_IO_ERROR;
-			}
-		}
-	}
+	struct b6_json_string_default_impl *self = b6_cast_of(
+		up, struct b6_json_string_default_impl, up);
+	struct b6_json_default_impl *default_impl =
+		b6_cast_of(impl, struct b6_json_default_impl, up);
+	struct b6_utf8_string copy;
+	b6_initialize_utf8_string(&copy, default_impl->allocator);
+	if (b6_extend_utf8_string(&copy, &self->utf8_string.utf8) ||
+	    b6_extend_utf8_string(&copy, utf8)) {
+		b6_finalize_utf8_string(&copy);
+		return B6_JSON_ALLOC_ERROR;
+	}
+	self->utf8_string = copy;
+	self->up.ops = &string_default_impl_ops;
+	return B6_JSON_OK;
+}
+
+static struct b6_json_string_impl *string_view_impl_new(
+	struct b6_json_impl *up, const struct b6_utf8 *utf8)
+{
+	struct b6_json_default_impl *self =
+		b6_cast_of(up, struct b6_json_default_impl, up);
+	static const struct b6_json_string_impl_ops ops = {
+		.dtor = string_view_impl_dtor,
+		.get = string_default_impl_get,
+		.append = string_view_impl_append,
+	};
+	struct b6_json_string_default_impl *impl;
+	if (!(impl = b6_pool_get(&self->string_pool)))
+		return NULL;
+	impl->up.ops = &ops;
+	b6_initialize_utf8_string(&impl->utf8_string, self->allocator);
+	if (utf8)
+		b6_clone_utf8(&impl->utf8_string.utf8, utf8);
+	return &impl->up;
+}
+
+static void string_dtor(struct b6_json_value *up)
+{
+	struct b6_json_string *self = b6_cast_of(up, struct b6_json_string, up);
+	self->impl->ops->dtor(self->impl, self->json->impl);
+	b6_pool_put(&self->json->pool, self);
+}
+
+/* Copies the runs of bytes that need no escaping as they are. */
+static enum b6_json_error serialize_utf8(const struct b6_utf8 *utf8,
+					 struct b6_json_ostream *os)
+{
+	static const char hex[] = "0123456789abcdef";
+	const struct scanner *scanner = get_best_scanner();
+	const char *ptr = utf8->ptr, *end = ptr + utf8->nbytes;
+	if (b6_json_ostream_write(os, &quote, 1) != 1)
+		return B6_JSON_IO_ERROR;
+	while (ptr != end) {
+		const char *run = ptr;
+		char escape[6] = { '\\', 'u', '0', '0' };
+		long int len = 2;
+		for (;;) {
+			ptr = scanner->plain(ptr, end);
+			if (ptr == end || (unsigned char)*ptr < 0x80)
+				break;
+			ptr += 1;
+		}
+		if (ptr != run && b6_json_ostream_write(os, run, ptr - run) !=
+		    ptr - run)
+			return B6_JSON_IO_ERROR;
+		if (ptr == end)
+			break;
+		switch (*ptr) {
+		case '"':
+		case '\\':
+			escape[1] = *ptr;
+			break;
+		case '\b':
+			escape[1] = 'b';
+			break;
+		case '\f':
+			escape[1] = 'f';
+			break;
+		case '\n':
+			escape[1] = 'n';
+			break;
+		case '\r':
+			escape[1] = 'r';
+			break;
+		case '\t':
+			escape[1] = 't';
+			break;
+		default:
+			escape[4] = hex[*ptr >> 4];
+			escape[5] = hex[*ptr & 15];
+			len = 6;
+		}
+		if (b6_json_ostream_write(os, escape, len) != len)
+			return B6_JSON_IO_ERROR;
+		ptr += 1;
+	}
 	if (b6_json_ostream_write(os, &quote, 1) != 1)
 		return B6_JSON_IO_ERROR;
 	return B6_JSON_OK;
 }
 
+static enum b6_json_error serialize_string(const struct b6_json_value *up,
+					   struct b6_json_ostream *os,
+					   struct b6_json_serializer *helper)
+{
+	const struct b6_json_string *self =
+		b6_cast_of(up, struct b6_json_string, up);
+	return serialize_utf8(b6_json_get_string(self), os);
+}
+
 const struct b6_json_value_ops b6_json_string_ops = {
 	.dtor = string_dtor,
 	.serialize = serialize_string,
 };
 
+/* Open addressing indexes: mask + 1 slots, a power of two, hold nodes or
+ * NULL and collisions are resolved by linear probing. */
+static void index_insert(void **slots, unsigned int mask, void *node,
+			 unsigned int hash)
+{
+	unsigned int i = hash & mask;
+	while (slots[i])
+		i = (i + 1) & mask;
+	slots[i] = node;
+}
+
+/* Empties the slot of a node, moving back the nodes after it that would not
+ * be found anymore otherwise. */
+static void index_remove(void **slots, unsigned int mask, const void *node,
+			 unsigned int hash, unsigned int (*get_hash)(const void*))
+{
+	unsigned int i = hash & mask, j;
+	void *next;
+	while (slots[i] != node)
+		i = (i + 1) & mask;
+	for (j = i; (j = (j + 1) & mask, next = slots[j]);) {
+		unsigned int k = get_hash(next) & mask;
+		/* Skip nodes whose home slot lies in (i, j]. */
+		if (i <= j ? i < k && k <= j : i < k || k <= j)
+			continue;
+		slots[i] = next;
+		i = j;
+	}
+	slots[i] = NULL;
+}
+
+/* Moves the nodes of an index to a new one of size slots, or returns NULL
+ * leaving them in place. */
+static void **index_resize(void **slots, unsigned int mask, unsigned int size,
+			   struct b6_allocator *allocator,
+			   unsigned int (*get_hash)(const void*))
+{
+	void **resized = b6_allocate(allocator, size * sizeof(*slots));
+	unsigned int i;
+	if (!resized)
+		return NULL;
+	__builtin_memset(resized, 0, size * sizeof(*slots));
+	if (!slots)
+		return resized;
+	for (i = 0; i <= mask; i += 1)
+		if (slots[i])
+			index_insert(resized, size - 1, slots[i],
+				     get_hash(slots[i]));
+	b6_deallocate(allocator, slots);
+	return resized;
+}
+
+static unsigned int hash_key(const struct b6_utf8 *key)
+{
+	const unsigned char *ptr = (const unsigned char*)key->ptr;
+	unsigned long int n = key->nbytes;
+	unsigned long long int h = n * 0x9e3779b97f4a7c15ULL;
+	for (; n >= 8; n -= 8, ptr += 8) {
+		unsigned long long int w;
+		__builtin_memcpy(&w, ptr, 8);
+		h = (h ^ w) * 0xff51afd7ed558ccdULL;
+	}
+	while (n--)
+		h = (h ^ *ptr++) * 0x100000001b3ULL;
+	h ^= h >> 29;
+	return h ^ h >> 32;
+}
+
+/* Interned keys are shared by pointer, which spares comparing them. */
+static int key_equals(const struct b6_utf8 *lhs, const struct b6_utf8 *rhs)
+{
+	return lhs == rhs || (lhs->nbytes == rhs->nbytes &&
+			      !__builtin_memcmp(lhs->ptr, rhs->ptr,
+						lhs->nbytes));
+}
+
+/* Interned keys are read-only strings of a document listed in the keys
+ * index of the default implementation until they are released. */
+struct b6_json_interned_impl {
+	struct b6_json_string_impl up;
+	struct b6_utf8_string utf8_string;
+	struct b6_json_string *string;
+	unsigned int hash;
+};
+
+static unsigned int interned_impl_hash(const void *node)
+{
+	return ((const struct b6_json_interned_impl*)node)->hash;
+}
+
+static void interned_impl_dtor(struct b6_json_string_impl *up,
+			       struct b6_json_impl *impl)
+{
+	struct b6_json_interned_impl *self =
+		b6_cast_of(up, struct b6_json_interned_impl, up);
+	struct b6_json_default_impl *default_impl =
+		b6_cast_of(impl, struct b6_json_default_impl, up);
+	index_remove(default_impl->keys, default_impl->keys_mask, self,
+		     self->hash, interned_impl_hash);
+	default_impl->nkeys -= 1;
+	b6_finalize_utf8_string(&self->utf8_string);
+	b6_pool_put(&default_impl->string_pool, self);
+}
+
+static enum b6_json_error interned_impl_append(struct b6_json_string_impl *up,
+					       struct b6_json_impl *impl,
+					       const struct b6_utf8 *utf8)
+{
+	return B6_JSON_ERROR;
+}
+
+static const struct b6_json_string_impl_ops interned_impl_ops = {
+	.dtor = interned_impl_dtor,
+	.get = string_default_impl_get,
+	.append = interned_impl_append,
+};
+
+static struct b6_json_string *default_impl_intern_key(
+	struct b6_json_impl *up, struct b6_json *json,
+	const struct b6_utf8 *utf8)
+{
+	struct b6_json_default_impl *self =
+		b6_cast_of(up, struct b6_json_default_impl, up);
+	unsigned int hash = hash_key(utf8), i;
+	struct b6_json_interned_impl *impl;
+	struct b6_json_string *string;
+	if (self->keys)
+		for (i = hash & self->keys_mask; (impl = self->keys[i]);
+		     i = (i + 1) & self->keys_mask)
+			if (impl->hash == hash && impl->string->json == json &&
+			    key_equals(&impl->utf8_string.utf8, utf8)) {
+				b6_json_ref_value(&impl->string->up);
+				return impl->string;
+			}
+	/* Keep the index at most half full. */
+	if (!self->keys || self->nkeys >= (self->keys_mask + 1) / 2) {
+		unsigned int size = self->keys ? 2 * (self->keys_mask + 1) : 64;
+		void **keys = index_resize(self->keys, self->keys_mask, size,
+					   self->allocator,
+					   interned_impl_hash);
+		if (!keys)
+			return NULL;
+		self->keys = keys;
+		self->keys_mask = size - 1;
+	}
+	if (!(string = b6_pool_get(&json->pool)))
+		return NULL;
+	if (!(impl = b6_pool_get(&self->string_pool))) {
+		b6_pool_put(&json->pool, string);
+		return NULL;
+	}
+	b6_initialize_utf8_string(&impl->utf8_string, self->allocator);
+	if (b6_extend_utf8_string(&impl->utf8_string, utf8)) {
+		b6_pool_put(&self->string_pool, impl);
+		b6_pool_put(&json->pool, string);
+		return NULL;
+	}
+	impl->up.ops = &interned_impl_ops;
+	impl->string = string;
+	impl->hash = hash;
+	index_insert(self->keys, self->keys_mask, impl, hash);
+	self->nkeys += 1;
+	b6_json_setup_value(&string->up, &b6_json_string_ops);
+	string->impl = &impl->up;
+	string->json = json;
+	return string;
+}
+
+static unsigned int key_hash(const struct b6_json_string *key)
+{
+	if (key->impl->ops == &interned_impl_ops)
+		return b6_cast_of(key->impl, struct b6_json_interned_impl,
+				  up)->hash;
+	return hash_key(b6_json_get_string(key));
+}
+
+/* Pairs are listed in insertion order. Small objects are searched linearly,
+ * larger ones through an index of their pairs built when they grow past
+ * OBJECT_INDEX_THRESHOLD. */
+#define OBJECT_INDEX_THRESHOLD 8
+
 struct b6_json_object_default_impl {
 	struct b6_json_object_impl up;
-	struct b6_registry registry;
+	struct b6_list list;
+	void **index;
+	unsigned int mask;
+	unsigned int len;
 };
 
 struct b6_json_pair_default {
-	struct b6_entry entry;
+	struct b6_dref dref;
+	unsigned int hash;
 	struct b6_json_pair pair;
 };
 
+static unsigned int pair_default_hash(const void *node)
+{
+	return ((const struct b6_json_pair_default*)node)->hash;
+}
+
+static struct b6_json_pair_default *object_default_impl_find(
+	const struct b6_json_object_default_impl *self,
+	const struct b6_utf8 *key, unsigned int hash)
+{
+	struct b6_json_pair_default *pair;
+	struct b6_dref *dref;
+	unsigned int i;
+	if (self->index) {
+		for (i = hash & self->mask; (pair = self->index[i]);
+		     i = (i + 1) & self->mask)
+			if (pair->hash == hash &&
+			    key_equals(b6_json_get_string(pair->pair.key), key))
+				return pair;
+		return NULL;
+	}
+	for (dref = b6_list_first(&self->list);
+	     dref != b6_list_tail(&self->list);
+	     dref = b6_list_walk(dref, B6_NEXT)) {
+		pair = b6_cast_of(dref, struct b6_json_pair_default, dref);
+		if (pair->hash == hash &&
+		    key_equals(b6_json_get_string(pair->pair.key), key))
+			return pair;
+	}
+	return NULL;
+}
+
+/* Grows the index or builds it from the list of pairs. */
+static int object_default_impl_reindex(
+	struct b6_json_object_default_impl *self,
+	struct b6_json_default_impl *impl, unsigned int size)
+{
+	void **index = index_resize(self->index, self->mask, size,
+				    impl->allocator, pair_default_hash);
+	struct b6_dref *dref;
+	if (!index)
+		return -1;
+	if (!self->index)
+		for (dref = b6_list_first(&self->list);
+		     dref != b6_list_tail(&self->list);
+		     dref = b6_list_walk(dref, B6_NEXT)) {
+			struct b6_json_pair_default *pair = b6_cast_of(
+				dref, struct b6_json_pair_default, dref);
+			index_insert(index, size - 1, pair, pair->hash);
+		}
+	self->index = index;
+	self->mask = size - 1;
+	return 0;
+}
+
 static enum b6_json_error object_default_impl_add(
 	struct b6_json_object_impl *up,
 	struct b6_json_impl *impl,
@@ -596,17 +1506,27 @@ static enum b6_json_error object_default_impl_add(
 		b6_cast_of(up, struct b6_json_object_default_impl, up);
 	struct b6_json_default_impl *default_impl =
 		b6_cast_of(impl, struct b6_json_default_impl, up);
-	struct b6_json_pair_default *default_pair =
-		b6_pool_get(&default_impl->pair_pool);
 	const struct b6_utf8 *utf8 = b6_json_get_string(pair->key);
-	if (!default_pair)
-		return B6_JSON_ALLOC_ERROR;
-	if (b6_register(&self->registry, &default_pair->entry, utf8)) {
-		b6_pool_put(&default_impl->pair_pool, default_pair);
+	unsigned int hash = key_hash(pair->key);
+	struct b6_json_pair_default *default_pair;
+	if (object_default_impl_find(self, utf8, hash))
 		return B6_JSON_ERROR;
-	}
+	/* Keep the index at most half full. */
+	if ((self->index ? self->len >= (self->mask + 1) / 2 :
+	     self->len >= OBJECT_INDEX_THRESHOLD) &&
+	    object_default_impl_reindex(self, default_impl, self->index ?
+					2 * (self->mask + 1) :
+					4 * OBJECT_INDEX_THRESHOLD))
+		return B6_JSON_ALLOC_ERROR;
+	if (!(default_pair = b6_pool_get(&default_impl->pair_pool)))
+		return B6_JSON_ALLOC_ERROR;
+	default_pair->hash = hash;
 	default_pair->pair.key = pair->key;
 	default_pair->pair.value = pair->value;
+	b6_list_add_last(&self->list, &default_pair->dref);
+	if (self->index)
+		index_insert(self->index, self->mask, default_pair, hash);
+	self->len += 1;
 	return B6_JSON_OK;
 }
 
@@ -621,7 +1541,11 @@ static enum b6_json_error object_default_impl_del(
 		b6_cast_of(impl, struct b6_json_default_impl, up);
 	struct b6_json_pair_default *default_pair =
 		b6_cast_of(pair, struct b6_json_pair_default, pair);
-	b6_unregister(&self->registry, &default_pair->entry);
+	if (self->index)
+		index_remove(self->index, self->mask, default_pair,
+			     default_pair->hash, pair_default_hash);
+	b6_list_del(&default_pair->dref);
+	self->len -= 1;
 	b6_json_unref_value(&default_pair->pair.key->up);
 	b6_json_unref_value(default_pair->pair.value);
 	b6_pool_put(&default_impl->pair_pool, default_pair);
@@ -633,10 +1557,10 @@ static struct b6_json_pair *object_default_impl_first(
 {
 	struct b6_json_object_default_impl *self =
 		b6_cast_of(up, struct b6_json_object_default_impl, up);
-	struct b6_entry *entry = b6_get_first_entry(&self->registry);
-	if (!entry)
+	struct b6_dref *dref = b6_list_first(&self->list);
+	if (dref == b6_list_tail(&self->list))
 		return NULL;
-	return &b6_cast_of(entry, struct b6_json_pair_default, entry)->pair;
+	return &b6_cast_of(dref, struct b6_json_pair_default, dref)->pair;
 }
 
 static struct b6_json_pair *object_default_impl_walk(
@@ -646,12 +1570,14 @@ static struct b6_json_pair *object_default_impl_walk(
 {
 	struct b6_json_object_default_impl *self =
 		b6_cast_of(up, struct b6_json_object_default_impl, up);
-	struct b6_entry *entry =
-		&b6_cast_of(pair, struct b6_json_pair_default, pair)->entry;
-	entry = b6_walk_registry(&self->registry, entry, dir);
-	if (!entry)
+	struct b6_dref *dref =
+		&b6_cast_of(pair, struct b6_json_pair_default, pair)->dref;
+	dref = dir == B6_NEXT ? b6_list_walk(dref, B6_NEXT) :
+		b6_list_walk(dref, B6_PREV);
+	/* The head and the tail of the list are the same reference. */
+	if (dref == b6_list_tail(&self->list))
 		return NULL;
-	return &b6_cast_of(entry, struct b6_json_pair_default, entry)->pair;
+	return &b6_cast_of(dref, struct b6_json_pair_default, dref)->pair;
 }
 
 static struct b6_json_pair *object_default_impl_at(
@@ -660,10 +1586,32 @@ static struct b6_json_pair *object_default_impl_at(
 {
 	struct b6_json_object_default_impl *self =
 		b6_cast_of(up, struct b6_json_object_default_impl, up);
-	struct b6_entry *entry = b6_lookup_registry(&self->registry, key);
-	if (!entry)
-		return NULL;
-	return &b6_cast_of(entry, struct b6_json_pair_default, entry)->pair;
+	struct b6_json_pair_default *pair =
+		object_default_impl_find(self, key, hash_key(key));
+	return pair ? &pair->pair : NULL;
+}
+
+static void object_default_impl_clear(struct b6_json_object_default_impl *self,
+				      struct b6_json_default_impl *default_impl)
+{
+	void *pairs[32];
+	unsigned long int n = 0;
+	/* Release pairs by batches once they are out of the list. */
+	while (!b6_list_empty(&self->list)) {
+		struct b6_json_pair_default *default_pair = b6_cast_of(
+			b6_list_del_first(&self->list),
+			struct b6_json_pair_default, dref);
+		b6_json_unref_value(&default_pair->pair.key->up);
+		b6_json_unref_value(default_pair->pair.value);
+		pairs[n++] = default_pair;
+		if (n == b6_card_of(pairs)) {
+			b6_pool_put_n(&default_impl->pair_pool, pairs, n);
+			n = 0;
+		}
+	}
+	b6_pool_put_n(&default_impl->pair_pool, pairs, n);
+	if (self->index)
+		b6_deallocate(default_impl->allocator, self->index);
 }
 
 static void object_default_impl_dtor(struct b6_json_object_impl *up,
@@ -673,66 +1621,297 @@ static void object_default_impl_dtor(struct b6_json_object_impl *up,
 		b6_cast_of(up, struct b6_json_object_default_impl, up);
 	struct b6_json_default_impl *default_impl =
 		b6_cast_of(impl, struct b6_json_default_impl, up);
-	struct b6_json_pair *pair = object_default_impl_first(up);
-	while (pair) {
-		struct b6_json_pair *next =
-			object_default_impl_walk(up, pair, B6_NEXT);
-		object_default_impl_del(up, impl, pair);
-		pair = next;
-	}
+	object_default_impl_clear(self, default_impl);
 	b6_pool_put(&default_impl->object_pool, self);
 }
 
+static const struct b6_json_object_impl_ops object_default_impl_ops = {
+	.dtor = object_default_impl_dtor,
+	.add = object_default_impl_add,
+	.del = object_default_impl_del,
+	.at = object_default_impl_at,
+	.first = object_default_impl_first,
+	.walk = object_default_impl_walk,
+};
+
+static void object_default_impl_setup(struct b6_json_object_default_impl *self)
+{
+	self->up.ops = &object_default_impl_ops;
+	b6_list_initialize(&self->list);
+	self->index = NULL;
+	self->mask = 0;
+	self->len = 0;
+}
+
 static struct b6_json_object_impl *object_default_impl_new(
 	struct b6_json_impl *up)
 {
 	struct b6_json_default_impl *self =
 		b6_cast_of(up, struct b6_json_default_impl, up);
-	static const struct b6_json_object_impl_ops ops = {
-		.dtor = object_default_impl_dtor,
-		.add = object_default_impl_add,
-		.del = object_default_impl_del,
-		.at = object_default_impl_at,
-		.first = object_default_impl_first,
-		.walk = object_default_impl_walk,
-	};
 	struct b6_json_object_default_impl *impl;
 	if (!(impl = b6_pool_get(&self->object_pool)))
 		return NULL;
-	impl->up.ops = &ops;
-	b6_setup_registry(&impl->registry);
+	object_default_impl_setup(impl);
+	return &impl->up;
+}
+
+static enum b6_json_error parse_object(struct b6_json_object*,
+				       struct b6_json_istream*,
+				       struct b6_json_parser_info*);
+
+static enum b6_json_error parse_array(struct b6_json_array*,
+				      struct b6_json_istream*,
+				      struct b6_json_parser_info*);
+
+/* Lazy objects and arrays only reference their bytes in the document until
+ * they are accessed, when they are parsed in place into default ones. They
+ * stay lazy if their bytes are malformed. */
+struct b6_json_object_lazy_impl {
+	struct b6_json_object_impl up;
+	struct b6_json *json;
+	const char *ptr;
+	unsigned long int len;
+};
+
+struct b6_json_array_lazy_impl {
+	struct b6_json_array_impl up;
+	struct b6_json *json;
+	const char *ptr;
+	unsigned long int len;
+};
+
+static enum b6_json_error object_lazy_impl_load(struct b6_json_object_impl *up)
+{
+	struct b6_json_object_lazy_impl *self =
+		b6_cast_of(up, struct b6_json_object_lazy_impl, up);
+	struct b6_json_object_default_impl *impl =
+		b6_cast_of(up, struct b6_json_object_default_impl, up);
+	const struct b6_json_object_lazy_impl lazy = *self;
+	struct b6_json_object object = { .impl = up, .json = lazy.json, };
+	struct b6_json_istream is;
+	enum b6_json_error retval;
+	/* Skip the opening brace. */
+	b6_json_setup_memory_istream(&is, lazy.ptr + 1, lazy.len - 1);
+	object_default_impl_setup(impl);
+	if (!(retval = parse_object(&object, &is, NULL)))
+		return B6_JSON_OK;
+	object_default_impl_clear(impl, b6_cast_of(lazy.json->impl,
+						   struct b6_json_default_impl,
+						   up));
+	*self = lazy;
+	return retval;
+}
+
+static void object_lazy_impl_dtor(struct b6_json_object_impl *up,
+				  struct b6_json_impl *impl)
+{
+	struct b6_json_default_impl *default_impl =
+		b6_cast_of(impl, struct b6_json_default_impl, up);
+	b6_pool_put(&default_impl->object_pool, up);
+}
+
+static enum b6_json_error object_lazy_impl_add(struct b6_json_object_impl *up,
+					       struct b6_json_impl *impl,
+					       const struct b6_json_pair *pair)
+{
+	enum b6_json_error retval = object_lazy_impl_load(up);
+	return retval ? retval : up->ops->add(up, impl, pair);
+}
+
+static struct b6_json_pair *object_lazy_impl_first(
+	struct b6_json_object_impl *up)
+{
+	return object_lazy_impl_load(up) ? NULL : up->ops->first(up);
+}
+
+static struct b6_json_pair *object_lazy_impl_at(struct b6_json_object_impl *up,
+						const struct b6_utf8 *key)
+{
+	return object_lazy_impl_load(up) ? NULL : up->ops->at(up, key);
+}
+
+/* Pairs cannot be deleted nor walked from before they are loaded. */
+static const struct b6_json_object_impl_ops object_lazy_impl_ops = {
+	.dtor = object_lazy_impl_dtor,
+	.add = object_lazy_impl_add,
+	.at = object_lazy_impl_at,
+	.first = object_lazy_impl_first,
+	.load = object_lazy_impl_load,
+};
+
+static struct b6_json_object_impl *object_lazy_impl_new(
+	struct b6_json_impl *up, struct b6_json *json, const void *buf,
+	unsigned long int len)
+{
+	struct b6_json_default_impl *self =
+		b6_cast_of(up, struct b6_json_default_impl, up);
+	struct b6_json_object_lazy_impl *impl;
+	if (!(impl = b6_pool_get(&self->object_pool)))
+		return NULL;
+	impl->up.ops = &object_lazy_impl_ops;
+	impl->json = json;
+	impl->ptr = buf;
+	impl->len = len;
+	return &impl->up;
+}
+
+static enum b6_json_error array_lazy_impl_load(struct b6_json_array_impl *up)
+{
+	struct b6_json_array_lazy_impl *self =
+		b6_cast_of(up, struct b6_json_array_lazy_impl, up);
+	struct b6_json_array_default_impl *impl =
+		b6_cast_of(up, struct b6_json_array_default_impl, up);
+	const struct b6_json_array_lazy_impl lazy = *self;
+	struct b6_json_array array = { .impl = up, .json = lazy.json, };
+	struct b6_json_istream is;
+	enum b6_json_error retval;
+	/* Skip the opening bracket. */
+	b6_json_setup_memory_istream(&is, lazy.ptr + 1, lazy.len - 1);
+	array_default_impl_setup(impl, b6_cast_of(lazy.json->impl,
+						  struct b6_json_default_impl,
+						  up));
+	if (!(retval = parse_array(&array, &is, NULL)))
+		return B6_JSON_OK;
+	array_default_impl_clear(impl);
+	*self = lazy;
+	return retval;
+}
+
+static void array_lazy_impl_dtor(struct b6_json_array_impl *up,
+				 struct b6_json_impl *impl)
+{
+	struct b6_json_default_impl *default_impl =
+		b6_cast_of(impl, struct b6_json_default_impl, up);
+	b6_pool_put(&default_impl->array_pool, up);
+}
+
+/* Loading does not change the value of the array, only how it is held. */
+static unsigned int array_lazy_impl_len(const struct b6_json_array_impl *up)
+{
+	struct b6_json_array_impl *self = (struct b6_json_array_impl*)up;
+	return array_lazy_impl_load(self) ? 0 : self->ops->len(self);
+}
+
+static enum b6_json_error array_lazy_impl_add(struct b6_json_array_impl *up,
+					      unsigned int index,
+					      struct b6_json_value *value)
+{
+	enum b6_json_error retval = array_lazy_impl_load(up);
+	return retval ? retval : up->ops->add(up, index, value);
+}
+
+/* Items are checked against the length first, which loads them. */
+static struct b6_json_value *array_lazy_impl_get(
+	const struct b6_json_array_impl *up, unsigned int index)
+{
+	return array_lazy_impl_len(up) ? up->ops->get(up, index) : NULL;
+}
+
+static void array_lazy_impl_set(struct b6_json_array_impl *up,
+				unsigned int index, struct b6_json_value *value)
+{
+	if (array_lazy_impl_len(up))
+		up->ops->set(up, index, value);
+}
+
+static void array_lazy_impl_del(struct b6_json_array_impl *up,
+				unsigned int index)
+{
+	if (array_lazy_impl_len(up))
+		up->ops->del(up, index);
+}
+
+static const struct b6_json_array_impl_ops array_lazy_impl_ops = {
+	.dtor = array_lazy_impl_dtor,
+	.len = array_lazy_impl_len,
+	.add = array_lazy_impl_add,
+	.del = array_lazy_impl_del,
+	.get = array_lazy_impl_get,
+	.set = array_lazy_impl_set,
+	.load = array_lazy_impl_load,
+};
+
+static struct b6_json_array_impl *array_lazy_impl_new(
+	struct b6_json_impl *up, struct b6_json *json, const void *buf,
+	unsigned long int len)
+{
+	struct b6_json_default_impl *self =
+		b6_cast_of(up, struct b6_json_default_impl, up);
+	struct b6_json_array_lazy_impl *impl;
+	if (!(impl = b6_pool_get(&self->array_pool)))
+		return NULL;
+	impl->up.ops = &array_lazy_impl_ops;
+	impl->json = json;
+	impl->ptr = buf;
+	impl->len = len;
 	return &impl->up;
 }
 
 #define JSON_IMPL_SIZE (4096 - sizeof(void*))
 
+static const struct b6_json_impl_ops default_impl_ops = {
+	.array_impl = array_default_impl_new,
+	.string_impl = string_default_impl_new,
+	.object_impl = object_default_impl_new,
+	.string_view_impl = string_view_impl_new,
+	.lazy_object_impl = object_lazy_impl_new,
+	.lazy_array_impl = array_lazy_impl_new,
+};
+
+static const struct b6_json_impl_ops interning_default_impl_ops = {
+	.array_impl = array_default_impl_new,
+	.string_impl = string_default_impl_new,
+	.object_impl = object_default_impl_new,
+	.string_view_impl = string_view_impl_new,
+	.intern_key = default_impl_intern_key,
+	.lazy_object_impl = object_lazy_impl_new,
+	.lazy_array_impl = array_lazy_impl_new,
+};
+
 int b6_json_default_impl_initialize(struct b6_json_default_impl *self,
 				    struct b6_allocator *allocator)
 {
-	static const struct b6_json_impl_ops b6_json_impl_ops = {
-		.array_impl = array_default_impl_new,
-		.string_impl = string_default_impl_new,
-		.object_impl = object_default_impl_new,
+	union b6_json_string_element {
+		struct b6_json_string_default_impl s;
+		struct b6_json_interned_impl i;
+	};
+	union b6_json_array_element {
+		struct b6_json_array_default_impl a;
+		struct b6_json_array_lazy_impl l;
+	};
+	union b6_json_object_element {
+		struct b6_json_object_default_impl o;
+		struct b6_json_object_lazy_impl l;
 	};
 	static const unsigned int s = JSON_IMPL_SIZE;
 	static const unsigned int p =
 		(JSON_IMPL_SIZE - sizeof(struct b6_chunk)) / 4;
-	self->up.ops = &b6_json_impl_ops;
+	self->up.ops = &default_impl_ops;
 	self->allocator = allocator;
+	self->keys = NULL;
+	self->keys_mask = 0;
+	self->nkeys = 0;
 	b6_pool_initialize(&self->pool, allocator, p, s);
 	b6_pool_initialize(&self->pair_pool, &self->pool.parent,
 			   sizeof(struct b6_json_pair_default), p);
 	b6_pool_initialize(&self->array_pool, &self->pool.parent,
-			   sizeof(struct b6_json_array_default_impl), p);
+			   sizeof(union b6_json_array_element), p);
 	b6_pool_initialize(&self->string_pool, &self->pool.parent,
-			   sizeof(struct b6_json_string_default_impl), p);
+			   sizeof(union b6_json_string_element), p);
 	b6_pool_initialize(&self->object_pool, &self->pool.parent,
-			   sizeof(struct b6_json_object_default_impl), p);
+			   sizeof(union b6_json_object_element), p);
 	return 0;
 }
 
+void b6_json_default_impl_intern_keys(struct b6_json_default_impl *self)
+{
+	self->up.ops = &interning_default_impl_ops;
+}
+
 void b6_json_default_impl_finalize(struct b6_json_default_impl *self)
 {
+	if (self->keys)
+		b6_deallocate(self->allocator, self->keys);
 	b6_pool_finalize(&self->pair_pool);
 	b6_pool_finalize(&self->array_pool);
 	b6_pool_finalize(&self->string_pool);
@@ -740,33 +1919,113 @@ void b6_json_default_impl_finalize(struct b6_json_default_impl *self)
 	b6_pool_finalize(&self->pool);
 }
 
-static enum b6_json_error parse_string(struct b6_json_string *self,
-				       struct b6_json_istream *is,
-				       struct b6_json_parser_info *info)
+/* Skips characters that can be copied as is from the input: plain ascii
+ * characters and complete, valid UTF-8 sequences. */
+static const char *scan_string(const char *ptr, const char *end,
+			       unsigned int *nchars)
 {
-	enum b6_json_error retval = B6_JSON_OK;
-	char hex[4];
-	char c;
-	int i;
+	const struct scanner *scanner = get_best_scanner();
+	unsigned int n = 0;
 	for (;;) {
-		struct b6_utf8 utf8;
+		const char *next = scanner->plain(ptr, end);
+		unsigned int len;
 		unsigned int unicode;
-		int utf8_len;
-		char utf8_buf[4];
-		if (!b6_json_istream_get(is, &c, info)) {
-			retval = B6_JSON_IO_ERROR;
+		n += next - ptr;
+		ptr = next;
+		if (ptr == end || !(*ptr & 0x80))
 			break;
-		}
-		if (c == quote)
+		len = b6_utf8_dec_len(ptr);
+		if (len < 1 || len > end - ptr ||
+		    b6_utf8_dec(len, &unicode, ptr) != len)
 			break;
-		if (c != backslash) {
-			int ret;
-			utf8_len = b6_utf8_dec_len(&c);
-			if (utf8_len < 1) {
-				retval = B6_JSON_PARSE_ERROR;
-				break;
-			}
-			ret = b6_json_istream_read(is, &utf8_buf[1],
+		ptr += len;
+		n += 1;
+	}
+	*nchars = n;
+	return ptr;
+}
+
+/* Returns the length in bytes of a string without escapes that can be
+ * referenced in place, or -1 if the window holds no such string. */
+static long int scan_string_view(const char *ptr, const char *end,
+				 unsigned int *nchars)
+{
+	const char *next = scan_string(ptr, end, nchars);
+	return next != end && *next == quote ? next - ptr : -1;
+}
+
+static enum b6_json_error parse_string_view(struct b6_json_string *self,
+					    struct b6_json_istream *is,
+					    struct b6_json_parser_info *info)
+{
+	struct b6_json_string_impl *impl;
+	struct b6_utf8 utf8;
+	unsigned int nchars;
+	long int len = scan_string_view(is->ptr, is->end, &nchars);
+	if (len < 0)
+		return B6_JSON_ERROR;
+	utf8.ptr = is->ptr;
+	utf8.nbytes = len;
+	utf8.nchars = nchars;
+	impl = self->json->impl->ops->string_view_impl(self->json->impl,
+						       &utf8);
+	if (!impl)
+		return B6_JSON_ALLOC_ERROR;
+	self->impl->ops->dtor(self->impl, self->json->impl);
+	self->impl = impl;
+	is->ptr += len + 1;
+	if (info)
+		info->col += nchars + 1;
+	return B6_JSON_OK;
+}
+
+/* Receives the decoded characters of a string by runs. */
+struct string_sink {
+	enum b6_json_error (*append)(struct string_sink*,
+				     const struct b6_utf8*);
+};
+
+/* Decodes a string up to its closing quote, the opening one being already
+ * consumed. */
+static enum b6_json_error decode_string(struct string_sink *sink,
+					struct b6_json_istream *is,
+					struct b6_json_parser_info *info)
+{
+	enum b6_json_error retval = B6_JSON_OK;
+	char hex[4];
+	char c;
+	int i;
+	for (;;) {
+		struct b6_utf8 utf8;
+		unsigned int unicode;
+		int utf8_len;
+		char utf8_buf[4];
+		/* Append runs of characters straight from the input
+		 * buffer. */
+		const char *ptr = scan_string(is->ptr, is->end, &utf8.nchars);
+		if (ptr != is->ptr) {
+			utf8.ptr = is->ptr;
+			utf8.nbytes = ptr - is->ptr;
+			if (info)
+				info->col += utf8.nchars;
+			is->ptr = ptr;
+			if ((retval = sink->append(sink, &utf8)))
+				break;
+		}
+		if (!b6_json_istream_get(is, &c, info)) {
+			retval = B6_JSON_IO_ERROR;
+			break;
+		}
+		if (c == quote)
+			break;
+		if (c != backslash) {
+			int ret;
+			utf8_len = b6_utf8_dec_len(&c);
+			if (utf8_len < 1) {
+				retval = B6_JSON_PARSE_ERROR;
+				break;
+			}
+			ret = b6_json_istream_read(is, &utf8_buf[1],
 						   utf8_len - 1);
 			if (ret != utf8_len - 1) {
 				retval = B6_JSON_IO_ERROR;
@@ -779,9 +2038,7 @@ static enum b6_json_error parse_string(struct b6_json_string *self,
 				break;
 			}
 			b6_setup_utf8(&utf8, utf8_buf, utf8_len);
-			if ((retval = self->impl->ops->append(self->impl,
-							      self->json->impl,
-							      &utf8)))
+			if ((retval = sink->append(sink, &utf8)))
 				break;
 			continue;
 		}
@@ -790,48 +2047,38 @@ static enum b6_json_error parse_string(struct b6_json_string *self,
 			break;
 		}
 		if (c == quote || c == backslash || c == slash) {
-			retval = self->impl->ops->append(
-				self->impl, self->json->impl, &b6_utf8_char[c]);
+			retval = sink->append(sink, &b6_utf8_char[c]);
 			if (retval)
 				break;
 			continue;
 		}
 		if (c == 'b') {
-			retval = self->impl->ops->append(
-				self->impl, self->json->impl,
-				&b6_utf8_char[backspace]);
+			retval = sink->append(sink, &b6_utf8_char[backspace]);
 			if (retval)
 				break;
 			continue;
 		}
 		if (c == 'f') {
-			retval = self->impl->ops->append(
-				self->impl, self->json->impl,
-				&b6_utf8_char[formfeed]);
+			retval = sink->append(sink, &b6_utf8_char[formfeed]);
 			if (retval)
 				break;
 			continue;
 		}
 		if (c == 'n') {
-			retval = self->impl->ops->append(
-				self->impl, self->json->impl,
-				&b6_utf8_char[newline]);
+			retval = sink->append(sink, &b6_utf8_char[newline]);
 			if (retval)
 				break;
 			continue;
 		}
 		if (c == 'r') {
-			retval = self->impl->ops->append(
-				self->impl, self->json->impl,
-				&b6_utf8_char[carriage_return]);
+			retval = sink->append(sink,
+					      &b6_utf8_char[carriage_return]);
 			if (retval)
 				break;
 			continue;
 		}
 		if (c == 't') {
-			retval = self->impl->ops->append(self->impl,
-							 self->json->impl,
-							 &b6_utf8_char[tab]);
+			retval = sink->append(sink, &b6_utf8_char[tab]);
 			if (retval)
 				break;
 			continue;
@@ -869,14 +2116,82 @@ static enum b6_json_error parse_string(struct b6_json_string *self,
 		if (b6_utf8_enc(utf8_len, unicode, utf8_buf) != utf8_len)
 			continue;
 		b6_setup_utf8(&utf8, utf8_buf, utf8_len);
-		retval = self->impl->ops->append(self->impl, self->json->impl,
-						 &utf8);
+		retval = sink->append(sink, &utf8);
 		if (retval)
 			break;
 	}
 	return retval;
 }
 
+struct string_impl_sink {
+	struct string_sink up;
+	struct b6_json_string *string;
+};
+
+static enum b6_json_error string_impl_sink_append(struct string_sink *up,
+						  const struct b6_utf8 *utf8)
+{
+	struct b6_json_string *string =
+		b6_cast_of(up, struct string_impl_sink, up)->string;
+	return string->impl->ops->append(string->impl, string->json->impl,
+					 utf8);
+}
+
+static enum b6_json_error parse_string(struct b6_json_string *self,
+				       struct b6_json_istream *is,
+				       struct b6_json_parser_info *info)
+{
+	struct string_impl_sink sink = {
+		.up = { .append = string_impl_sink_append, },
+		.string = self,
+	};
+	enum b6_json_error retval;
+	if (b6_json_istream_is_addressable(is) &&
+	    self->json->impl->ops->string_view_impl &&
+	    (retval = parse_string_view(self, is, info)) != B6_JSON_ERROR)
+		return retval;
+	return decode_string(&sink.up, is, info);
+}
+
+/* Keys to intern are looked up in the window of the istream when possible,
+ * so that known ones cost no copy. */
+static enum b6_json_error parse_key(struct b6_json *json,
+				    struct b6_json_istream *is,
+				    struct b6_json_string **key,
+				    struct b6_json_parser_info *info)
+{
+	struct b6_json_string *temp;
+	enum b6_json_error retval;
+	struct b6_utf8 utf8;
+	long int len;
+	if (!json->impl->ops->intern_key) {
+		if (!(*key = b6_json_new_string(json, NULL)))
+			return B6_JSON_ALLOC_ERROR;
+		if ((retval = parse_string(*key, is, info)))
+			b6_json_unref_value(&(*key)->up);
+		return retval;
+	}
+	if ((len = scan_string_view(is->ptr, is->end, &utf8.nchars)) >= 0) {
+		utf8.ptr = is->ptr;
+		utf8.nbytes = len;
+		if (!(*key = json->impl->ops->intern_key(json->impl, json,
+							 &utf8)))
+			return B6_JSON_ALLOC_ERROR;
+		is->ptr += len + 1;
+		if (info)
+			info->col += utf8.nchars + 1;
+		return B6_JSON_OK;
+	}
+	if (!(temp = b6_json_new_string(json, NULL)))
+		return B6_JSON_ALLOC_ERROR;
+	if (!(retval = parse_string(temp, is, info)) &&
+	    !(*key = json->impl->ops->intern_key(json->impl, json,
+						 b6_json_get_string(temp))))
+		retval = B6_JSON_ALLOC_ERROR;
+	b6_json_unref_value(&temp->up);
+	return retval;
+}
+
 static enum b6_json_error parse_value(struct b6_json*, struct b6_json_istream*,
 				      struct b6_json_value**,
 				      struct b6_json_parser_info*);
@@ -894,14 +2209,15 @@ static enum b6_json_error parse_object(struct b6_json_object *self,
 		struct b6_json_pair pair;
 		if (c != quote)
 			return B6_JSON_PARSE_ERROR;
-		if (!(pair.key = b6_json_new_string(self->json, NULL)))
-			return B6_JSON_PARSE_ERROR;
-		if ((retval = parse_string(pair.key, is, info)) != B6_JSON_OK)
+		if ((retval = parse_key(self->json, is, &pair.key, info)))
 			return retval;
-		if ((retval = b6_json_istream_token(is, &c, info)))
+		if (!(retval = b6_json_istream_token(is, &c, info)) &&
+		    c != colon)
+			retval = B6_JSON_PARSE_ERROR;
+		if (retval) {
+			b6_json_unref_value(&pair.key->up);
 			return retval;
-		if (c != colon)
-			return B6_JSON_PARSE_ERROR;
+		}
 		if ((retval = parse_value(self->json, is, &pair.value, info))) {
 			b6_json_unref_value(&pair.key->up);
 			return retval;
@@ -964,76 +2280,1030 @@ static enum b6_json_error parse_array(struct b6_json_array *self,
 
 static int is_digit(char c) { return c >= '0' && c <= '9'; }
 
-static enum b6_json_error parse_number(struct b6_json_number *self, char c,
-				       struct b6_json_istream *is,
-				       struct b6_json_parser_info *info)
+/*
+ * Decimal to binary conversion of numbers.
+ *
+ * Numbers are scanned into the 19 first significant digits of their mantissa
+ * and a power of ten. When both are exact doubles, a single floating point
+ * operation rounds them correctly (Clinger's fast path). Otherwise, the
+ * Eisel-Lemire algorithm multiplies the mantissa by a 128-bit approximation
+ * of the power of five, which is known to be enough to round correctly. When
+ * the mantissa had to be truncated and the result depends on the dropped
+ * digits, the number is converted digit by digit as a big decimal.
+ */
+
+#define SMALLEST_POWER_OF_TEN -342
+#define LARGEST_POWER_OF_TEN 308
+
+#define MANTISSA_BITS 52
+#define EXPONENT_BIAS 1023
+#define INFINITE_POWER 0x7ff
+
+/* 128-bit normalized approximations of 5^q from 5^-342 to 5^308. */
+static const unsigned long long int pow5_128[][2] = {
+	{ 0xeef453d6923bd65aULL, 0x113faa2906a13b3fULL },
+	{ 0x9558b4661b6565f8ULL, 0x4ac7ca59a424c507ULL },
+	{ 0xbaaee17fa23ebf76ULL, 0x5d79bcf00d2df649ULL },
+	{ 0xe95a99df8ace6f53ULL, 0xf4d82c2c107973dcULL },
+	{ 0x91d8a02bb6c10594ULL, 0x79071b9b8a4be869ULL },
+	{ 0xb64ec836a47146f9ULL, 0x9748e2826cdee284ULL },
+	{ 0xe3e27a444d8d98b7ULL, 0xfd1b1b2308169b25ULL },
+	{ 0x8e6d8c6ab0787f72ULL, 0xfe30f0f5e50e20f7ULL },
+	{ 0xb208ef855c969f4fULL, 0xbdbd2d335e51a935ULL },
+	{ 0xde8b2b66b3bc4723ULL, 0xad2c788035e61382ULL },
+	{ 0x8b16fb203055ac76ULL, 0x4c3bcb5021afcc31ULL },
+	{ 0xaddcb9e83c6b1793ULL, 0xdf4abe242a1bbf3dULL },
+	{ 0xd953e8624b85dd78ULL, 0xd71d6dad34a2af0dULL },
+	{ 0x87d4713d6f33aa6bULL, 0x8672648c40e5ad68ULL },
+	{ 0xa9c98d8ccb009506ULL, 0x680efdaf511f18c2ULL },
+	{ 0xd43bf0effdc0ba48ULL, 0x0212bd1b2566def2ULL },
+	{ 0x84a57695fe98746dULL, 0x014bb630f7604b57ULL },
+	{ 0xa5ced43b7e3e9188ULL, 0x419ea3bd35385e2dULL },
+	{ 0xcf42894a5dce35eaULL, 0x52064cac828675b9ULL },
+	{ 0x818995ce7aa0e1b2ULL, 0x7343efebd1940993ULL },
+	{ 0xa1ebfb4219491a1fULL, 0x1014ebe6c5f90bf8ULL },
+	{ 0xca66fa129f9b60a6ULL, 0xd41a26e077774ef6ULL },
+	{ 0xfd00b897478238d0ULL, 0x8920b098955522b4ULL },
+	{ 0x9e20735e8cb16382ULL, 0x55b46e5f5d5535b0ULL },
+	{ 0xc5a890362fddbc62ULL, 0xeb2189f734aa831dULL },
+	{ 0xf712b443bbd52b7bULL, 0xa5e9ec7501d523e4ULL },
+	{ 0x9a6bb0aa55653b2dULL, 0x47b233c92125366eULL },
+	{ 0xc1069cd4eabe89f8ULL, 0x999ec0bb696e840aULL },
+	{ 0xf148440a256e2c76ULL, 0xc00670ea43ca250dULL },
+	{ 0x96cd2a865764dbcaULL, 0x380406926a5e5728ULL },
+	{ 0xbc807527ed3e12bcULL, 0xc605083704f5ecf2ULL },
+	{ 0xeba09271e88d976bULL, 0xf7864a44c633682eULL },
+	{ 0x93445b8731587ea3ULL, 0x7ab3ee6afbe0211dULL },
+	{ 0xb8157268fdae9e4cULL, 0x5960ea05bad82964ULL },
+	{ 0xe61acf033d1a45dfULL, 0x6fb92487298e33bdULL },
+	{ 0x8fd0c16206306babULL, 0xa5d3b6d479f8e056ULL },
+	{ 0xb3c4f1ba87bc8696ULL, 0x8f48a4899877186cULL },
+	{ 0xe0b62e2929aba83cULL, 0x331acdabfe94de87ULL },
+	{ 0x8c71dcd9ba0b4925ULL, 0x9ff0c08b7f1d0b14ULL },
+	{ 0xaf8e5410288e1b6fULL, 0x07ecf0ae5ee44dd9ULL },
+	{ 0xdb71e91432b1a24aULL, 0xc9e82cd9f69d6150ULL },
+	{ 0x892731ac9faf056eULL, 0xbe311c083a225cd2ULL },
+	{ 0xab70fe17c79ac6caULL, 0x6dbd630a48aaf406ULL },
+	{ 0xd64d3d9db981787dULL, 0x092cbbccdad5b108ULL },
+	{ 0x85f0468293f0eb4eULL, 0x25bbf56008c58ea5ULL },
+	{ 0xa76c582338ed2621ULL, 0xaf2af2b80af6f24eULL },
+	{ 0xd1476e2c07286faaULL, 0x1af5af660db4aee1ULL },
+	{ 0x82cca4db847945caULL, 0x50d98d9fc890ed4dULL },
+	{ 0xa37fce126597973cULL, 0xe50ff107bab528a0ULL },
+	{ 0xcc5fc196fefd7d0cULL, 0x1e53ed49a96272c8ULL },
+	{ 0xff77b1fcbebcdc4fULL, 0x25e8e89c13bb0f7aULL },
+	{ 0x9faacf3df73609b1ULL, 0x77b191618c54e9acULL },
+	{ 0xc795830d75038c1dULL, 0xd59df5b9ef6a2417ULL },
+	{ 0xf97ae3d0d2446f25ULL, 0x4b0573286b44ad1dULL },
+	{ 0x9becce62836ac577ULL, 0x4ee367f9430aec32ULL },
+	{ 0xc2e801fb244576d5ULL, 0x229c41f793cda73fULL },
+	{ 0xf3a20279ed56d48aULL, 0x6b43527578c1110fULL },
+	{ 0x9845418c345644d6ULL, 0x830a13896b78aaa9ULL },
+	{ 0xbe5691ef416bd60cULL, 0x23cc986bc656d553ULL },
+	{ 0xedec366b11c6cb8fULL, 0x2cbfbe86b7ec8aa8ULL },
+	{ 0x94b3a202eb1c3f39ULL, 0x7bf7d71432f3d6a9ULL },
+	{ 0xb9e08a83a5e34f07ULL, 0xdaf5ccd93fb0cc53ULL },
+	{ 0xe858ad248f5c22c9ULL, 0xd1b3400f8f9cff68ULL },
+	{ 0x91376c36d99995beULL, 0x23100809b9c21fa1ULL },
+	{ 0xb58547448ffffb2dULL, 0xabd40a0c2832a78aULL },
+	{ 0xe2e69915b3fff9f9ULL, 0x16c90c8f323f516cULL },
+	{ 0x8dd01fad907ffc3bULL, 0xae3da7d97f6792e3ULL },
+	{ 0xb1442798f49ffb4aULL, 0x99cd11cfdf41779cULL },
+	{ 0xdd95317f31c7fa1dULL, 0x40405643d711d583ULL },
+	{ 0x8a7d3eef7f1cfc52ULL, 0x482835ea666b2572ULL },
+	{ 0xad1c8eab5ee43b66ULL, 0xda3243650005eecfULL },
+	{ 0xd863b256369d4a40ULL, 0x90bed43e40076a82ULL },
+	{ 0x873e4f75e2224e68ULL, 0x5a7744a6e804a291ULL },
+	{ 0xa90de3535aaae202ULL, 0x711515d0a205cb36ULL },
+	{ 0xd3515c2831559a83ULL, 0x0d5a5b44ca873e03ULL },
+	{ 0x8412d9991ed58091ULL, 0xe858790afe9486c2ULL },
+	{ 0xa5178fff668ae0b6ULL, 0x626e974dbe39a872ULL },
+	{ 0xce5d73ff402d98e3ULL, 0xfb0a3d212dc8128fULL },
+	{ 0x80fa687f881c7f8eULL, 0x7ce66634bc9d0b99ULL },
+	{ 0xa139029f6a239f72ULL, 0x1c1fffc1ebc44e80ULL },
+	{ 0xc987434744ac874eULL, 0xa327ffb266b56220ULL },
+	{ 0xfbe9141915d7a922ULL, 0x4bf1ff9f0062baa8ULL },
+	{ 0x9d71ac8fada6c9b5ULL, 0x6f773fc3603db4a9ULL },
+	{ 0xc4ce17b399107c22ULL, 0xcb550fb4384d21d3ULL },
+	{ 0xf6019da07f549b2bULL, 0x7e2a53a146606a48ULL },
+	{ 0x99c102844f94e0fbULL, 0x2eda7444cbfc426dULL },
+	{ 0xc0314325637a1939ULL, 0xfa911155fefb5308ULL },
+	{ 0xf03d93eebc589f88ULL, 0x793555ab7eba27caULL },
+	{ 0x96267c7535b763b5ULL, 0x4bc1558b2f3458deULL },
+	{ 0xbbb01b9283253ca2ULL, 0x9eb1aaedfb016f16ULL },
+	{ 0xea9c227723ee8bcbULL, 0x465e15a979c1cadcULL },
+	{ 0x92a1958a7675175fULL, 0x0bfacd89ec191ec9ULL },
+	{ 0xb749faed14125d36ULL, 0xcef980ec671f667bULL },
+	{ 0xe51c79a85916f484ULL, 0x82b7e12780e7401aULL },
+	{ 0x8f31cc0937ae58d2ULL, 0xd1b2ecb8b0908810ULL },
+	{ 0xb2fe3f0b8599ef07ULL, 0x861fa7e6dcb4aa15ULL },
+	{ 0xdfbdcece67006ac9ULL, 0x67a791e093e1d49aULL },
+	{ 0x8bd6a141006042bdULL, 0xe0c8bb2c5c6d24e0ULL },
+	{ 0xaecc49914078536dULL, 0x58fae9f773886e18ULL },
+	{ 0xda7f5bf590966848ULL, 0xaf39a475506a899eULL },
+	{ 0x888f99797a5e012dULL, 0x6d8406c952429603ULL },
+	{ 0xaab37fd7d8f58178ULL, 0xc8e5087ba6d33b83ULL },
+	{ 0xd5605fcdcf32e1d6ULL, 0xfb1e4a9a90880a64ULL },
+	{ 0x855c3be0a17fcd26ULL, 0x5cf2eea09a55067fULL },
+	{ 0xa6b34ad8c9dfc06fULL, 0xf42faa48c0ea481eULL },
+	{ 0xd0601d8efc57b08bULL, 0xf13b94daf124da26ULL },
+	{ 0x823c12795db6ce57ULL, 0x76c53d08d6b70858ULL },
+	{ 0xa2cb1717b52481edULL, 0x54768c4b0c64ca6eULL },
+	{ 0xcb7ddcdda26da268ULL, 0xa9942f5dcf7dfd09ULL },
+	{ 0xfe5d54150b090b02ULL, 0xd3f93b35435d7c4cULL },
+	{ 0x9efa548d26e5a6e1ULL, 0xc47bc5014a1a6dafULL },
+	{ 0xc6b8e9b0709f109aULL, 0x359ab6419ca1091bULL },
+	{ 0xf867241c8cc6d4c0ULL, 0xc30163d203c94b62ULL },
+	{ 0x9b407691d7fc44f8ULL, 0x79e0de63425dcf1dULL },
+	{ 0xc21094364dfb5636ULL, 0x985915fc12f542e4ULL },
+	{ 0xf294b943e17a2bc4ULL, 0x3e6f5b7b17b2939dULL },
+	{ 0x979cf3ca6cec5b5aULL, 0xa705992ceecf9c42ULL },
+	{ 0xbd8430bd08277231ULL, 0x50c6ff782a838353ULL },
+	{ 0xece53cec4a314ebdULL, 0xa4f8bf5635246428ULL },
+	{ 0x940f4613ae5ed136ULL, 0x871b7795e136be99ULL },
+	{ 0xb913179899f68584ULL, 0x28e2557b59846e3fULL },
+	{ 0xe757dd7ec07426e5ULL, 0x331aeada2fe589cfULL },
+	{ 0x9096ea6f3848984fULL, 0x3ff0d2c85def7621ULL },
+	{ 0xb4bca50b065abe63ULL, 0x0fed077a756b53a9ULL },
+	{ 0xe1ebce4dc7f16dfbULL, 0xd3e8495912c62894ULL },
+	{ 0x8d3360f09cf6e4bdULL, 0x64712dd7abbbd95cULL },
+	{ 0xb080392cc4349decULL, 0xbd8d794d96aacfb3ULL },
+	{ 0xdca04777f541c567ULL, 0xecf0d7a0fc5583a0ULL },
+	{ 0x89e42caaf9491b60ULL, 0xf41686c49db57244ULL },
+	{ 0xac5d37d5b79b6239ULL, 0x311c2875c522ced5ULL },
+	{ 0xd77485cb25823ac7ULL, 0x7d633293366b828bULL },
+	{ 0x86a8d39ef77164bcULL, 0xae5dff9c02033197ULL },
+	{ 0xa8530886b54dbdebULL, 0xd9f57f830283fdfcULL },
+	{ 0xd267caa862a12d66ULL, 0xd072df63c324fd7bULL },
+	{ 0x8380dea93da4bc60ULL, 0x4247cb9e59f71e6dULL },
+	{ 0xa46116538d0deb78ULL, 0x52d9be85f074e608ULL },
+	{ 0xcd795be870516656ULL, 0x67902e276c921f8bULL },
+	{ 0x806bd9714632dff6ULL, 0x00ba1cd8a3db53b6ULL },
+	{ 0xa086cfcd97bf97f3ULL, 0x80e8a40eccd228a4ULL },
+	{ 0xc8a883c0fdaf7df0ULL, 0x6122cd128006b2cdULL },
+	{ 0xfad2a4b13d1b5d6cULL, 0x796b805720085f81ULL },
+	{ 0x9cc3a6eec6311a63ULL, 0xcbe3303674053bb0ULL },
+	{ 0xc3f490aa77bd60fcULL, 0xbedbfc4411068a9cULL },
+	{ 0xf4f1b4d515acb93bULL, 0xee92fb5515482d44ULL },
+	{ 0x991711052d8bf3c5ULL, 0x751bdd152d4d1c4aULL },
+	{ 0xbf5cd54678eef0b6ULL, 0xd262d45a78a0635dULL },
+	{ 0xef340a98172aace4ULL, 0x86fb897116c87c34ULL },
+	{ 0x9580869f0e7aac0eULL, 0xd45d35e6ae3d4da0ULL },
+	{ 0xbae0a846d2195712ULL, 0x8974836059cca109ULL },
+	{ 0xe998d258869facd7ULL, 0x2bd1a438703fc94bULL },
+	{ 0x91ff83775423cc06ULL, 0x7b6306a34627ddcfULL },
+	{ 0xb67f6455292cbf08ULL, 0x1a3bc84c17b1d542ULL },
+	{ 0xe41f3d6a7377eecaULL, 0x20caba5f1d9e4a93ULL },
+	{ 0x8e938662882af53eULL, 0x547eb47b7282ee9cULL },
+	{ 0xb23867fb2a35b28dULL, 0xe99e619a4f23aa43ULL },
+	{ 0xdec681f9f4c31f31ULL, 0x6405fa00e2ec94d4ULL },
+	{ 0x8b3c113c38f9f37eULL, 0xde83bc408dd3dd04ULL },
+	{ 0xae0b158b4738705eULL, 0x9624ab50b148d445ULL },
+	{ 0xd98ddaee19068c76ULL, 0x3badd624dd9b0957ULL },
+	{ 0x87f8a8d4cfa417c9ULL, 0xe54ca5d70a80e5d6ULL },
+	{ 0xa9f6d30a038d1dbcULL, 0x5e9fcf4ccd211f4cULL },
+	{ 0xd47487cc8470652bULL, 0x7647c3200069671fULL },
+	{ 0x84c8d4dfd2c63f3bULL, 0x29ecd9f40041e073ULL },
+	{ 0xa5fb0a17c777cf09ULL, 0xf468107100525890ULL },
+	{ 0xcf79cc9db955c2ccULL, 0x7182148d4066eeb4ULL },
+	{ 0x81ac1fe293d599bfULL, 0xc6f14cd848405530ULL },
+	{ 0xa21727db38cb002fULL, 0xb8ada00e5a506a7cULL },
+	{ 0xca9cf1d206fdc03bULL, 0xa6d90811f0e4851cULL },
+	{ 0xfd442e4688bd304aULL, 0x908f4a166d1da663ULL },
+	{ 0x9e4a9cec15763e2eULL, 0x9a598e4e043287feULL },
+	{ 0xc5dd44271ad3cdbaULL, 0x40eff1e1853f29fdULL },
+	{ 0xf7549530e188c128ULL, 0xd12bee59e68ef47cULL },
+	{ 0x9a94dd3e8cf578b9ULL, 0x82bb74f8301958ceULL },
+	{ 0xc13a148e3032d6e7ULL, 0xe36a52363c1faf01ULL },
+	{ 0xf18899b1bc3f8ca1ULL, 0xdc44e6c3cb279ac1ULL },
+	{ 0x96f5600f15a7b7e5ULL, 0x29ab103a5ef8c0b9ULL },
+	{ 0xbcb2b812db11a5deULL, 0x7415d448f6b6f0e7ULL },
+	{ 0xebdf661791d60f56ULL, 0x111b495b3464ad21ULL },
+	{ 0x936b9fcebb25c995ULL, 0xcab10dd900beec34ULL },
+	{ 0xb84687c269ef3bfbULL, 0x3d5d514f40eea742ULL },
+	{ 0xe65829b3046b0afaULL, 0x0cb4a5a3112a5112ULL },
+	{ 0x8ff71a0fe2c2e6dcULL, 0x47f0e785eaba72abULL },
+	{ 0xb3f4e093db73a093ULL, 0x59ed216765690f56ULL },
+	{ 0xe0f218b8d25088b8ULL, 0x306869c13ec3532cULL },
+	{ 0x8c974f7383725573ULL, 0x1e414218c73a13fbULL },
+	{ 0xafbd2350644eeacfULL, 0xe5d1929ef90898faULL },
+	{ 0xdbac6c247d62a583ULL, 0xdf45f746b74abf39ULL },
+	{ 0x894bc396ce5da772ULL, 0x6b8bba8c328eb783ULL },
+	{ 0xab9eb47c81f5114fULL, 0x066ea92f3f326564ULL },
+	{ 0xd686619ba27255a2ULL, 0xc80a537b0efefebdULL },
+	{ 0x8613fd0145877585ULL, 0xbd06742ce95f5f36ULL },
+	{ 0xa798fc4196e952e7ULL, 0x2c48113823b73704ULL },
+	{ 0xd17f3b51fca3a7a0ULL, 0xf75a15862ca504c5ULL },
+	{ 0x82ef85133de648c4ULL, 0x9a984d73dbe722fbULL },
+	{ 0xa3ab66580d5fdaf5ULL, 0xc13e60d0d2e0ebbaULL },
+	{ 0xcc963fee10b7d1b3ULL, 0x318df905079926a8ULL },
+	{ 0xffbbcfe994e5c61fULL, 0xfdf17746497f7052ULL },
+	{ 0x9fd561f1fd0f9bd3ULL, 0xfeb6ea8bedefa633ULL },
+	{ 0xc7caba6e7c5382c8ULL, 0xfe64a52ee96b8fc0ULL },
+	{ 0xf9bd690a1b68637bULL, 0x3dfdce7aa3c673b0ULL },
+	{ 0x9c1661a651213e2dULL, 0x06bea10ca65c084eULL },
+	{ 0xc31bfa0fe5698db8ULL, 0x486e494fcff30a62ULL },
+	{ 0xf3e2f893dec3f126ULL, 0x5a89dba3c3efccfaULL },
+	{ 0x986ddb5c6b3a76b7ULL, 0xf89629465a75e01cULL },
+	{ 0xbe89523386091465ULL, 0xf6bbb397f1135823ULL },
+	{ 0xee2ba6c0678b597fULL, 0x746aa07ded582e2cULL },
+	{ 0x94db483840b717efULL, 0xa8c2a44eb4571cdcULL },
+	{ 0xba121a4650e4ddebULL, 0x92f34d62616ce413ULL },
+	{ 0xe896a0d7e51e1566ULL, 0x77b020baf9c81d17ULL },
+	{ 0x915e2486ef32cd60ULL, 0x0ace1474dc1d122eULL },
+	{ 0xb5b5ada8aaff80b8ULL, 0x0d819992132456baULL },
+	{ 0xe3231912d5bf60e6ULL, 0x10e1fff697ed6c69ULL },
+	{ 0x8df5efabc5979c8fULL, 0xca8d3ffa1ef463c1ULL },
+	{ 0xb1736b96b6fd83b3ULL, 0xbd308ff8a6b17cb2ULL },
+	{ 0xddd0467c64bce4a0ULL, 0xac7cb3f6d05ddbdeULL },
+	{ 0x8aa22c0dbef60ee4ULL, 0x6bcdf07a423aa96bULL },
+	{ 0xad4ab7112eb3929dULL, 0x86c16c98d2c953c6ULL },
+	{ 0xd89d64d57a607744ULL, 0xe871c7bf077ba8b7ULL },
+	{ 0x87625f056c7c4a8bULL, 0x11471cd764ad4972ULL },
+	{ 0xa93af6c6c79b5d2dULL, 0xd598e40d3dd89bcfULL },
+	{ 0xd389b47879823479ULL, 0x4aff1d108d4ec2c3ULL },
+	{ 0x843610cb4bf160cbULL, 0xcedf722a585139baULL },
+	{ 0xa54394fe1eedb8feULL, 0xc2974eb4ee658828ULL },
+	{ 0xce947a3da6a9273eULL, 0x733d226229feea32ULL },
+	{ 0x811ccc668829b887ULL, 0x0806357d5a3f525fULL },
+	{ 0xa163ff802a3426a8ULL, 0xca07c2dcb0cf26f7ULL },
+	{ 0xc9bcff6034c13052ULL, 0xfc89b393dd02f0b5ULL },
+	{ 0xfc2c3f3841f17c67ULL, 0xbbac2078d443ace2ULL },
+	{ 0x9d9ba7832936edc0ULL, 0xd54b944b84aa4c0dULL },
+	{ 0xc5029163f384a931ULL, 0x0a9e795e65d4df11ULL },
+	{ 0xf64335bcf065d37dULL, 0x4d4617b5ff4a16d5ULL },
+	{ 0x99ea0196163fa42eULL, 0x504bced1bf8e4e45ULL },
+	{ 0xc06481fb9bcf8d39ULL, 0xe45ec2862f71e1d6ULL },
+	{ 0xf07da27a82c37088ULL, 0x5d767327bb4e5a4cULL },
+	{ 0x964e858c91ba2655ULL, 0x3a6a07f8d510f86fULL },
+	{ 0xbbe226efb628afeaULL, 0x890489f70a55368bULL },
+	{ 0xeadab0aba3b2dbe5ULL, 0x2b45ac74ccea842eULL },
+	{ 0x92c8ae6b464fc96fULL, 0x3b0b8bc90012929dULL },
+	{ 0xb77ada0617e3bbcbULL, 0x09ce6ebb40173744ULL },
+	{ 0xe55990879ddcaabdULL, 0xcc420a6a101d0515ULL },
+	{ 0x8f57fa54c2a9eab6ULL, 0x9fa946824a12232dULL },
+	{ 0xb32df8e9f3546564ULL, 0x47939822dc96abf9ULL },
+	{ 0xdff9772470297ebdULL, 0x59787e2b93bc56f7ULL },
+	{ 0x8bfbea76c619ef36ULL, 0x57eb4edb3c55b65aULL },
+	{ 0xaefae51477a06b03ULL, 0xede622920b6b23f1ULL },
+	{ 0xdab99e59958885c4ULL, 0xe95fab368e45ecedULL },
+	{ 0x88b402f7fd75539bULL, 0x11dbcb0218ebb414ULL },
+	{ 0xaae103b5fcd2a881ULL, 0xd652bdc29f26a119ULL },
+	{ 0xd59944a37c0752a2ULL, 0x4be76d3346f0495fULL },
+	{ 0x857fcae62d8493a5ULL, 0x6f70a4400c562ddbULL },
+	{ 0xa6dfbd9fb8e5b88eULL, 0xcb4ccd500f6bb952ULL },
+	{ 0xd097ad07a71f26b2ULL, 0x7e2000a41346a7a7ULL },
+	{ 0x825ecc24c873782fULL, 0x8ed400668c0c28c8ULL },
+	{ 0xa2f67f2dfa90563bULL, 0x728900802f0f32faULL },
+	{ 0xcbb41ef979346bcaULL, 0x4f2b40a03ad2ffb9ULL },
+	{ 0xfea126b7d78186bcULL, 0xe2f610c84987bfa8ULL },
+	{ 0x9f24b832e6b0f436ULL, 0x0dd9ca7d2df4d7c9ULL },
+	{ 0xc6ede63fa05d3143ULL, 0x91503d1c79720dbbULL },
+	{ 0xf8a95fcf88747d94ULL, 0x75a44c6397ce912aULL },
+	{ 0x9b69dbe1b548ce7cULL, 0xc986afbe3ee11abaULL },
+	{ 0xc24452da229b021bULL, 0xfbe85badce996168ULL },
+	{ 0xf2d56790ab41c2a2ULL, 0xfae27299423fb9c3ULL },
+	{ 0x97c560ba6b0919a5ULL, 0xdccd879fc967d41aULL },
+	{ 0xbdb6b8e905cb600fULL, 0x5400e987bbc1c920ULL },
+	{ 0xed246723473e3813ULL, 0x290123e9aab23b68ULL },
+	{ 0x9436c0760c86e30bULL, 0xf9a0b6720aaf6521ULL },
+	{ 0xb94470938fa89bceULL, 0xf808e40e8d5b3e69ULL },
+	{ 0xe7958cb87392c2c2ULL, 0xb60b1d1230b20e04ULL },
+	{ 0x90bd77f3483bb9b9ULL, 0xb1c6f22b5e6f48c2ULL },
+	{ 0xb4ecd5f01a4aa828ULL, 0x1e38aeb6360b1af3ULL },
+	{ 0xe2280b6c20dd5232ULL, 0x25c6da63c38de1b0ULL },
+	{ 0x8d590723948a535fULL, 0x579c487e5a38ad0eULL },
+	{ 0xb0af48ec79ace837ULL, 0x2d835a9df0c6d851ULL },
+	{ 0xdcdb1b2798182244ULL, 0xf8e431456cf88e65ULL },
+	{ 0x8a08f0f8bf0f156bULL, 0x1b8e9ecb641b58ffULL },
+	{ 0xac8b2d36eed2dac5ULL, 0xe272467e3d222f3fULL },
+	{ 0xd7adf884aa879177ULL, 0x5b0ed81dcc6abb0fULL },
+	{ 0x86ccbb52ea94baeaULL, 0x98e947129fc2b4e9ULL },
+	{ 0xa87fea27a539e9a5ULL, 0x3f2398d747b36224ULL },
+	{ 0xd29fe4b18e88640eULL, 0x8eec7f0d19a03aadULL },
+	{ 0x83a3eeeef9153e89ULL, 0x1953cf68300424acULL },
+	{ 0xa48ceaaab75a8e2bULL, 0x5fa8c3423c052dd7ULL },
+	{ 0xcdb02555653131b6ULL, 0x3792f412cb06794dULL },
+	{ 0x808e17555f3ebf11ULL, 0xe2bbd88bbee40bd0ULL },
+	{ 0xa0b19d2ab70e6ed6ULL, 0x5b6aceaeae9d0ec4ULL },
+	{ 0xc8de047564d20a8bULL, 0xf245825a5a445275ULL },
+	{ 0xfb158592be068d2eULL, 0xeed6e2f0f0d56712ULL },
+	{ 0x9ced737bb6c4183dULL, 0x55464dd69685606bULL },
+	{ 0xc428d05aa4751e4cULL, 0xaa97e14c3c26b886ULL },
+	{ 0xf53304714d9265dfULL, 0xd53dd99f4b3066a8ULL },
+	{ 0x993fe2c6d07b7fabULL, 0xe546a8038efe4029ULL },
+	{ 0xbf8fdb78849a5f96ULL, 0xde98520472bdd033ULL },
+	{ 0xef73d256a5c0f77cULL, 0x963e66858f6d4440ULL },
+	{ 0x95a8637627989aadULL, 0xdde7001379a44aa8ULL },
+	{ 0xbb127c53b17ec159ULL, 0x5560c018580d5d52ULL },
+	{ 0xe9d71b689dde71afULL, 0xaab8f01e6e10b4a6ULL },
+	{ 0x9226712162ab070dULL, 0xcab3961304ca70e8ULL },
+	{ 0xb6b00d69bb55c8d1ULL, 0x3d607b97c5fd0d22ULL },
+	{ 0xe45c10c42a2b3b05ULL, 0x8cb89a7db77c506aULL },
+	{ 0x8eb98a7a9a5b04e3ULL, 0x77f3608e92adb242ULL },
+	{ 0xb267ed1940f1c61cULL, 0x55f038b237591ed3ULL },
+	{ 0xdf01e85f912e37a3ULL, 0x6b6c46dec52f6688ULL },
+	{ 0x8b61313bbabce2c6ULL, 0x2323ac4b3b3da015ULL },
+	{ 0xae397d8aa96c1b77ULL, 0xabec975e0a0d081aULL },
+	{ 0xd9c7dced53c72255ULL, 0x96e7bd358c904a21ULL },
+	{ 0x881cea14545c7575ULL, 0x7e50d64177da2e54ULL },
+	{ 0xaa242499697392d2ULL, 0xdde50bd1d5d0b9e9ULL },
+	{ 0xd4ad2dbfc3d07787ULL, 0x955e4ec64b44e864ULL },
+	{ 0x84ec3c97da624ab4ULL, 0xbd5af13bef0b113eULL },
+	{ 0xa6274bbdd0fadd61ULL, 0xecb1ad8aeacdd58eULL },
+	{ 0xcfb11ead453994baULL, 0x67de18eda5814af2ULL },
+	{ 0x81ceb32c4b43fcf4ULL, 0x80eacf948770ced7ULL },
+	{ 0xa2425ff75e14fc31ULL, 0xa1258379a94d028dULL },
+	{ 0xcad2f7f5359a3b3eULL, 0x096ee45813a04330ULL },
+	{ 0xfd87b5f28300ca0dULL, 0x8bca9d6e188853fcULL },
+	{ 0x9e74d1b791e07e48ULL, 0x775ea264cf55347eULL },
+	{ 0xc612062576589ddaULL, 0x95364afe032a819eULL },
+	{ 0xf79687aed3eec551ULL, 0x3a83ddbd83f52205ULL },
+	{ 0x9abe14cd44753b52ULL, 0xc4926a9672793543ULL },
+	{ 0xc16d9a0095928a27ULL, 0x75b7053c0f178294ULL },
+	{ 0xf1c90080baf72cb1ULL, 0x5324c68b12dd6339ULL },
+	{ 0x971da05074da7beeULL, 0xd3f6fc16ebca5e04ULL },
+	{ 0xbce5086492111aeaULL, 0x88f4bb1ca6bcf585ULL },
+	{ 0xec1e4a7db69561a5ULL, 0x2b31e9e3d06c32e6ULL },
+	{ 0x9392ee8e921d5d07ULL, 0x3aff322e62439fd0ULL },
+	{ 0xb877aa3236a4b449ULL, 0x09befeb9fad487c3ULL },
+	{ 0xe69594bec44de15bULL, 0x4c2ebe687989a9b4ULL },
+	{ 0x901d7cf73ab0acd9ULL, 0x0f9d37014bf60a11ULL },
+	{ 0xb424dc35095cd80fULL, 0x538484c19ef38c95ULL },
+	{ 0xe12e13424bb40e13ULL, 0x2865a5f206b06fbaULL },
+	{ 0x8cbccc096f5088cbULL, 0xf93f87b7442e45d4ULL },
+	{ 0xafebff0bcb24aafeULL, 0xf78f69a51539d749ULL },
+	{ 0xdbe6fecebdedd5beULL, 0xb573440e5a884d1cULL },
+	{ 0x89705f4136b4a597ULL, 0x31680a88f8953031ULL },
+	{ 0xabcc77118461cefcULL, 0xfdc20d2b36ba7c3eULL },
+	{ 0xd6bf94d5e57a42bcULL, 0x3d32907604691b4dULL },
+	{ 0x8637bd05af6c69b5ULL, 0xa63f9a49c2c1b110ULL },
+	{ 0xa7c5ac471b478423ULL, 0x0fcf80dc33721d54ULL },
+	{ 0xd1b71758e219652bULL, 0xd3c36113404ea4a9ULL },
+	{ 0x83126e978d4fdf3bULL, 0x645a1cac083126eaULL },
+	{ 0xa3d70a3d70a3d70aULL, 0x3d70a3d70a3d70a4ULL },
+	{ 0xccccccccccccccccULL, 0xcccccccccccccccdULL },
+	{ 0x8000000000000000ULL, 0x0000000000000000ULL },
+	{ 0xa000000000000000ULL, 0x0000000000000000ULL },
+	{ 0xc800000000000000ULL, 0x0000000000000000ULL },
+	{ 0xfa00000000000000ULL, 0x0000000000000000ULL },
+	{ 0x9c40000000000000ULL, 0x0000000000000000ULL },
+	{ 0xc350000000000000ULL, 0x0000000000000000ULL },
+	{ 0xf424000000000000ULL, 0x0000000000000000ULL },
+	{ 0x9896800000000000ULL, 0x0000000000000000ULL },
+	{ 0xbebc200000000000ULL, 0x0000000000000000ULL },
+	{ 0xee6b280000000000ULL, 0x0000000000000000ULL },
+	{ 0x9502f90000000000ULL, 0x0000000000000000ULL },
+	{ 0xba43b74000000000ULL, 0x0000000000000000ULL },
+	{ 0xe8d4a51000000000ULL, 0x0000000000000000ULL },
+	{ 0x9184e72a00000000ULL, 0x0000000000000000ULL },
+	{ 0xb5e620f480000000ULL, 0x0000000000000000ULL },
+	{ 0xe35fa931a0000000ULL, 0x0000000000000000ULL },
+	{ 0x8e1bc9bf04000000ULL, 0x0000000000000000ULL },
+	{ 0xb1a2bc2ec5000000ULL, 0x0000000000000000ULL },
+	{ 0xde0b6b3a76400000ULL, 0x0000000000000000ULL },
+	{ 0x8ac7230489e80000ULL, 0x0000000000000000ULL },
+	{ 0xad78ebc5ac620000ULL, 0x0000000000000000ULL },
+	{ 0xd8d726b7177a8000ULL, 0x0000000000000000ULL },
+	{ 0x878678326eac9000ULL, 0x0000000000000000ULL },
+	{ 0xa968163f0a57b400ULL, 0x0000000000000000ULL },
+	{ 0xd3c21bcecceda100ULL, 0x0000000000000000ULL },
+	{ 0x84595161401484a0ULL, 0x0000000000000000ULL },
+	{ 0xa56fa5b99019a5c8ULL, 0x0000000000000000ULL },
+	{ 0xcecb8f27f4200f3aULL, 0x0000000000000000ULL },
+	{ 0x813f3978f8940984ULL, 0x4000000000000000ULL },
+	{ 0xa18f07d736b90be5ULL, 0x5000000000000000ULL },
+	{ 0xc9f2c9cd04674edeULL, 0xa400000000000000ULL },
+	{ 0xfc6f7c4045812296ULL, 0x4d00000000000000ULL },
+	{ 0x9dc5ada82b70b59dULL, 0xf020000000000000ULL },
+	{ 0xc5371912364ce305ULL, 0x6c28000000000000ULL },
+	{ 0xf684df56c3e01bc6ULL, 0xc732000000000000ULL },
+	{ 0x9a130b963a6c115cULL, 0x3c7f400000000000ULL },
+	{ 0xc097ce7bc90715b3ULL, 0x4b9f100000000000ULL },
+	{ 0xf0bdc21abb48db20ULL, 0x1e86d40000000000ULL },
+	{ 0x96769950b50d88f4ULL, 0x1314448000000000ULL },
+	{ 0xbc143fa4e250eb31ULL, 0x17d955a000000000ULL },
+	{ 0xeb194f8e1ae525fdULL, 0x5dcfab0800000000ULL },
+	{ 0x92efd1b8d0cf37beULL, 0x5aa1cae500000000ULL },
+	{ 0xb7abc627050305adULL, 0xf14a3d9e40000000ULL },
+	{ 0xe596b7b0c643c719ULL, 0x6d9ccd05d0000000ULL },
+	{ 0x8f7e32ce7bea5c6fULL, 0xe4820023a2000000ULL },
+	{ 0xb35dbf821ae4f38bULL, 0xdda2802c8a800000ULL },
+	{ 0xe0352f62a19e306eULL, 0xd50b2037ad200000ULL },
+	{ 0x8c213d9da502de45ULL, 0x4526f422cc340000ULL },
+	{ 0xaf298d050e4395d6ULL, 0x9670b12b7f410000ULL },
+	{ 0xdaf3f04651d47b4cULL, 0x3c0cdd765f114000ULL },
+	{ 0x88d8762bf324cd0fULL, 0xa5880a69fb6ac800ULL },
+	{ 0xab0e93b6efee0053ULL, 0x8eea0d047a457a00ULL },
+	{ 0xd5d238a4abe98068ULL, 0x72a4904598d6d880ULL },
+	{ 0x85a36366eb71f041ULL, 0x47a6da2b7f864750ULL },
+	{ 0xa70c3c40a64e6c51ULL, 0x999090b65f67d924ULL },
+	{ 0xd0cf4b50cfe20765ULL, 0xfff4b4e3f741cf6dULL },
+	{ 0x82818f1281ed449fULL, 0xbff8f10e7a8921a4ULL },
+	{ 0xa321f2d7226895c7ULL, 0xaff72d52192b6a0dULL },
+	{ 0xcbea6f8ceb02bb39ULL, 0x9bf4f8a69f764490ULL },
+	{ 0xfee50b7025c36a08ULL, 0x02f236d04753d5b4ULL },
+	{ 0x9f4f2726179a2245ULL, 0x01d762422c946590ULL },
+	{ 0xc722f0ef9d80aad6ULL, 0x424d3ad2b7b97ef5ULL },
+	{ 0xf8ebad2b84e0d58bULL, 0xd2e0898765a7deb2ULL },
+	{ 0x9b934c3b330c8577ULL, 0x63cc55f49f88eb2fULL },
+	{ 0xc2781f49ffcfa6d5ULL, 0x3cbf6b71c76b25fbULL },
+	{ 0xf316271c7fc3908aULL, 0x8bef464e3945ef7aULL },
+	{ 0x97edd871cfda3a56ULL, 0x97758bf0e3cbb5acULL },
+	{ 0xbde94e8e43d0c8ecULL, 0x3d52eeed1cbea317ULL },
+	{ 0xed63a231d4c4fb27ULL, 0x4ca7aaa863ee4bddULL },
+	{ 0x945e455f24fb1cf8ULL, 0x8fe8caa93e74ef6aULL },
+	{ 0xb975d6b6ee39e436ULL, 0xb3e2fd538e122b44ULL },
+	{ 0xe7d34c64a9c85d44ULL, 0x60dbbca87196b616ULL },
+	{ 0x90e40fbeea1d3a4aULL, 0xbc8955e946fe31cdULL },
+	{ 0xb51d13aea4a488ddULL, 0x6babab6398bdbe41ULL },
+	{ 0xe264589a4dcdab14ULL, 0xc696963c7eed2dd1ULL },
+	{ 0x8d7eb76070a08aecULL, 0xfc1e1de5cf543ca2ULL },
+	{ 0xb0de65388cc8ada8ULL, 0x3b25a55f43294bcbULL },
+	{ 0xdd15fe86affad912ULL, 0x49ef0eb713f39ebeULL },
+	{ 0x8a2dbf142dfcc7abULL, 0x6e3569326c784337ULL },
+	{ 0xacb92ed9397bf996ULL, 0x49c2c37f07965404ULL },
+	{ 0xd7e77a8f87daf7fbULL, 0xdc33745ec97be906ULL },
+	{ 0x86f0ac99b4e8dafdULL, 0x69a028bb3ded71a3ULL },
+	{ 0xa8acd7c0222311bcULL, 0xc40832ea0d68ce0cULL },
+	{ 0xd2d80db02aabd62bULL, 0xf50a3fa490c30190ULL },
+	{ 0x83c7088e1aab65dbULL, 0x792667c6da79e0faULL },
+	{ 0xa4b8cab1a1563f52ULL, 0x577001b891185938ULL },
+	{ 0xcde6fd5e09abcf26ULL, 0xed4c0226b55e6f86ULL },
+	{ 0x80b05e5ac60b6178ULL, 0x544f8158315b05b4ULL },
+	{ 0xa0dc75f1778e39d6ULL, 0x696361ae3db1c721ULL },
+	{ 0xc913936dd571c84cULL, 0x03bc3a19cd1e38e9ULL },
+	{ 0xfb5878494ace3a5fULL, 0x04ab48a04065c723ULL },
+	{ 0x9d174b2dcec0e47bULL, 0x62eb0d64283f9c76ULL },
+	{ 0xc45d1df942711d9aULL, 0x3ba5d0bd324f8394ULL },
+	{ 0xf5746577930d6500ULL, 0xca8f44ec7ee36479ULL },
+	{ 0x9968bf6abbe85f20ULL, 0x7e998b13cf4e1ecbULL },
+	{ 0xbfc2ef456ae276e8ULL, 0x9e3fedd8c321a67eULL },
+	{ 0xefb3ab16c59b14a2ULL, 0xc5cfe94ef3ea101eULL },
+	{ 0x95d04aee3b80ece5ULL, 0xbba1f1d158724a12ULL },
+	{ 0xbb445da9ca61281fULL, 0x2a8a6e45ae8edc97ULL },
+	{ 0xea1575143cf97226ULL, 0xf52d09d71a3293bdULL },
+	{ 0x924d692ca61be758ULL, 0x593c2626705f9c56ULL },
+	{ 0xb6e0c377cfa2e12eULL, 0x6f8b2fb00c77836cULL },
+	{ 0xe498f455c38b997aULL, 0x0b6dfb9c0f956447ULL },
+	{ 0x8edf98b59a373fecULL, 0x4724bd4189bd5eacULL },
+	{ 0xb2977ee300c50fe7ULL, 0x58edec91ec2cb657ULL },
+	{ 0xdf3d5e9bc0f653e1ULL, 0x2f2967b66737e3edULL },
+	{ 0x8b865b215899f46cULL, 0xbd79e0d20082ee74ULL },
+	{ 0xae67f1e9aec07187ULL, 0xecd8590680a3aa11ULL },
+	{ 0xda01ee641a708de9ULL, 0xe80e6f4820cc9495ULL },
+	{ 0x884134fe908658b2ULL, 0x3109058d147fdcddULL },
+	{ 0xaa51823e34a7eedeULL, 0xbd4b46f0599fd415ULL },
+	{ 0xd4e5e2cdc1d1ea96ULL, 0x6c9e18ac7007c91aULL },
+	{ 0x850fadc09923329eULL, 0x03e2cf6bc604ddb0ULL },
+	{ 0xa6539930bf6bff45ULL, 0x84db8346b786151cULL },
+	{ 0xcfe87f7cef46ff16ULL, 0xe612641865679a63ULL },
+	{ 0x81f14fae158c5f6eULL, 0x4fcb7e8f3f60c07eULL },
+	{ 0xa26da3999aef7749ULL, 0xe3be5e330f38f09dULL },
+	{ 0xcb090c8001ab551cULL, 0x5cadf5bfd3072cc5ULL },
+	{ 0xfdcb4fa002162a63ULL, 0x73d9732fc7c8f7f6ULL },
+	{ 0x9e9f11c4014dda7eULL, 0x2867e7fddcdd9afaULL },
+	{ 0xc646d63501a1511dULL, 0xb281e1fd541501b8ULL },
+	{ 0xf7d88bc24209a565ULL, 0x1f225a7ca91a4226ULL },
+	{ 0x9ae757596946075fULL, 0x3375788de9b06958ULL },
+	{ 0xc1a12d2fc3978937ULL, 0x0052d6b1641c83aeULL },
+	{ 0xf209787bb47d6b84ULL, 0xc0678c5dbd23a49aULL },
+	{ 0x9745eb4d50ce6332ULL, 0xf840b7ba963646e0ULL },
+	{ 0xbd176620a501fbffULL, 0xb650e5a93bc3d898ULL },
+	{ 0xec5d3fa8ce427affULL, 0xa3e51f138ab4cebeULL },
+	{ 0x93ba47c980e98cdfULL, 0xc66f336c36b10137ULL },
+	{ 0xb8a8d9bbe123f017ULL, 0xb80b0047445d4184ULL },
+	{ 0xe6d3102ad96cec1dULL, 0xa60dc059157491e5ULL },
+	{ 0x9043ea1ac7e41392ULL, 0x87c89837ad68db2fULL },
+	{ 0xb454e4a179dd1877ULL, 0x29babe4598c311fbULL },
+	{ 0xe16a1dc9d8545e94ULL, 0xf4296dd6fef3d67aULL },
+	{ 0x8ce2529e2734bb1dULL, 0x1899e4a65f58660cULL },
+	{ 0xb01ae745b101e9e4ULL, 0x5ec05dcff72e7f8fULL },
+	{ 0xdc21a1171d42645dULL, 0x76707543f4fa1f73ULL },
+	{ 0x899504ae72497ebaULL, 0x6a06494a791c53a8ULL },
+	{ 0xabfa45da0edbde69ULL, 0x0487db9d17636892ULL },
+	{ 0xd6f8d7509292d603ULL, 0x45a9d2845d3c42b6ULL },
+	{ 0x865b86925b9bc5c2ULL, 0x0b8a2392ba45a9b2ULL },
+	{ 0xa7f26836f282b732ULL, 0x8e6cac7768d7141eULL },
+	{ 0xd1ef0244af2364ffULL, 0x3207d795430cd926ULL },
+	{ 0x8335616aed761f1fULL, 0x7f44e6bd49e807b8ULL },
+	{ 0xa402b9c5a8d3a6e7ULL, 0x5f16206c9c6209a6ULL },
+	{ 0xcd036837130890a1ULL, 0x36dba887c37a8c0fULL },
+	{ 0x802221226be55a64ULL, 0xc2494954da2c9789ULL },
+	{ 0xa02aa96b06deb0fdULL, 0xf2db9baa10b7bd6cULL },
+	{ 0xc83553c5c8965d3dULL, 0x6f92829494e5acc7ULL },
+	{ 0xfa42a8b73abbf48cULL, 0xcb772339ba1f17f9ULL },
+	{ 0x9c69a97284b578d7ULL, 0xff2a760414536efbULL },
+	{ 0xc38413cf25e2d70dULL, 0xfef5138519684abaULL },
+	{ 0xf46518c2ef5b8cd1ULL, 0x7eb258665fc25d69ULL },
+	{ 0x98bf2f79d5993802ULL, 0xef2f773ffbd97a61ULL },
+	{ 0xbeeefb584aff8603ULL, 0xaafb550ffacfd8faULL },
+	{ 0xeeaaba2e5dbf6784ULL, 0x95ba2a53f983cf38ULL },
+	{ 0x952ab45cfa97a0b2ULL, 0xdd945a747bf26183ULL },
+	{ 0xba756174393d88dfULL, 0x94f971119aeef9e4ULL },
+	{ 0xe912b9d1478ceb17ULL, 0x7a37cd5601aab85dULL },
+	{ 0x91abb422ccb812eeULL, 0xac62e055c10ab33aULL },
+	{ 0xb616a12b7fe617aaULL, 0x577b986b314d6009ULL },
+	{ 0xe39c49765fdf9d94ULL, 0xed5a7e85fda0b80bULL },
+	{ 0x8e41ade9fbebc27dULL, 0x14588f13be847307ULL },
+	{ 0xb1d219647ae6b31cULL, 0x596eb2d8ae258fc8ULL },
+	{ 0xde469fbd99a05fe3ULL, 0x6fca5f8ed9aef3bbULL },
+	{ 0x8aec23d680043beeULL, 0x25de7bb9480d5854ULL },
+	{ 0xada72ccc20054ae9ULL, 0xaf561aa79a10ae6aULL },
+	{ 0xd910f7ff28069da4ULL, 0x1b2ba1518094da04ULL },
+	{ 0x87aa9aff79042286ULL, 0x90fb44d2f05d0842ULL },
+	{ 0xa99541bf57452b28ULL, 0x353a1607ac744a53ULL },
+	{ 0xd3fa922f2d1675f2ULL, 0x42889b8997915ce8ULL },
+	{ 0x847c9b5d7c2e09b7ULL, 0x69956135febada11ULL },
+	{ 0xa59bc234db398c25ULL, 0x43fab9837e699095ULL },
+	{ 0xcf02b2c21207ef2eULL, 0x94f967e45e03f4bbULL },
+	{ 0x8161afb94b44f57dULL, 0x1d1be0eebac278f5ULL },
+	{ 0xa1ba1ba79e1632dcULL, 0x6462d92a69731732ULL },
+	{ 0xca28a291859bbf93ULL, 0x7d7b8f7503cfdcfeULL },
+	{ 0xfcb2cb35e702af78ULL, 0x5cda735244c3d43eULL },
+	{ 0x9defbf01b061adabULL, 0x3a0888136afa64a7ULL },
+	{ 0xc56baec21c7a1916ULL, 0x088aaa1845b8fdd0ULL },
+	{ 0xf6c69a72a3989f5bULL, 0x8aad549e57273d45ULL },
+	{ 0x9a3c2087a63f6399ULL, 0x36ac54e2f678864bULL },
+	{ 0xc0cb28a98fcf3c7fULL, 0x84576a1bb416a7ddULL },
+	{ 0xf0fdf2d3f3c30b9fULL, 0x656d44a2a11c51d5ULL },
+	{ 0x969eb7c47859e743ULL, 0x9f644ae5a4b1b325ULL },
+	{ 0xbc4665b596706114ULL, 0x873d5d9f0dde1feeULL },
+	{ 0xeb57ff22fc0c7959ULL, 0xa90cb506d155a7eaULL },
+	{ 0x9316ff75dd87cbd8ULL, 0x09a7f12442d588f2ULL },
+	{ 0xb7dcbf5354e9beceULL, 0x0c11ed6d538aeb2fULL },
+	{ 0xe5d3ef282a242e81ULL, 0x8f1668c8a86da5faULL },
+	{ 0x8fa475791a569d10ULL, 0xf96e017d694487bcULL },
+	{ 0xb38d92d760ec4455ULL, 0x37c981dcc395a9acULL },
+	{ 0xe070f78d3927556aULL, 0x85bbe253f47b1417ULL },
+	{ 0x8c469ab843b89562ULL, 0x93956d7478ccec8eULL },
+	{ 0xaf58416654a6babbULL, 0x387ac8d1970027b2ULL },
+	{ 0xdb2e51bfe9d0696aULL, 0x06997b05fcc0319eULL },
+	{ 0x88fcf317f22241e2ULL, 0x441fece3bdf81f03ULL },
+	{ 0xab3c2fddeeaad25aULL, 0xd527e81cad7626c3ULL },
+	{ 0xd60b3bd56a5586f1ULL, 0x8a71e223d8d3b074ULL },
+	{ 0x85c7056562757456ULL, 0xf6872d5667844e49ULL },
+	{ 0xa738c6bebb12d16cULL, 0xb428f8ac016561dbULL },
+	{ 0xd106f86e69d785c7ULL, 0xe13336d701beba52ULL },
+	{ 0x82a45b450226b39cULL, 0xecc0024661173473ULL },
+	{ 0xa34d721642b06084ULL, 0x27f002d7f95d0190ULL },
+	{ 0xcc20ce9bd35c78a5ULL, 0x31ec038df7b441f4ULL },
+	{ 0xff290242c83396ceULL, 0x7e67047175a15271ULL },
+	{ 0x9f79a169bd203e41ULL, 0x0f0062c6e984d386ULL },
+	{ 0xc75809c42c684dd1ULL, 0x52c07b78a3e60868ULL },
+	{ 0xf92e0c3537826145ULL, 0xa7709a56ccdf8a82ULL },
+	{ 0x9bbcc7a142b17ccbULL, 0x88a66076400bb691ULL },
+	{ 0xc2abf989935ddbfeULL, 0x6acff893d00ea435ULL },
+	{ 0xf356f7ebf83552feULL, 0x0583f6b8c4124d43ULL },
+	{ 0x98165af37b2153deULL, 0xc3727a337a8b704aULL },
+	{ 0xbe1bf1b059e9a8d6ULL, 0x744f18c0592e4c5cULL },
+	{ 0xeda2ee1c7064130cULL, 0x1162def06f79df73ULL },
+	{ 0x9485d4d1c63e8be7ULL, 0x8addcb5645ac2ba8ULL },
+	{ 0xb9a74a0637ce2ee1ULL, 0x6d953e2bd7173692ULL },
+	{ 0xe8111c87c5c1ba99ULL, 0xc8fa8db6ccdd0437ULL },
+	{ 0x910ab1d4db9914a0ULL, 0x1d9c9892400a22a2ULL },
+	{ 0xb54d5e4a127f59c8ULL, 0x2503beb6d00cab4bULL },
+	{ 0xe2a0b5dc971f303aULL, 0x2e44ae64840fd61dULL },
+	{ 0x8da471a9de737e24ULL, 0x5ceaecfed289e5d2ULL },
+	{ 0xb10d8e1456105dadULL, 0x7425a83e872c5f47ULL },
+	{ 0xdd50f1996b947518ULL, 0xd12f124e28f77719ULL },
+	{ 0x8a5296ffe33cc92fULL, 0x82bd6b70d99aaa6fULL },
+	{ 0xace73cbfdc0bfb7bULL, 0x636cc64d1001550bULL },
+	{ 0xd8210befd30efa5aULL, 0x3c47f7e05401aa4eULL },
+	{ 0x8714a775e3e95c78ULL, 0x65acfaec34810a71ULL },
+	{ 0xa8d9d1535ce3b396ULL, 0x7f1839a741a14d0dULL },
+	{ 0xd31045a8341ca07cULL, 0x1ede48111209a050ULL },
+	{ 0x83ea2b892091e44dULL, 0x934aed0aab460432ULL },
+	{ 0xa4e4b66b68b65d60ULL, 0xf81da84d5617853fULL },
+	{ 0xce1de40642e3f4b9ULL, 0x36251260ab9d668eULL },
+	{ 0x80d2ae83e9ce78f3ULL, 0xc1d72b7c6b426019ULL },
+	{ 0xa1075a24e4421730ULL, 0xb24cf65b8612f81fULL },
+	{ 0xc94930ae1d529cfcULL, 0xdee033f26797b627ULL },
+	{ 0xfb9b7cd9a4a7443cULL, 0x169840ef017da3b1ULL },
+	{ 0x9d412e0806e88aa5ULL, 0x8e1f289560ee864eULL },
+	{ 0xc491798a08a2ad4eULL, 0xf1a6f2bab92a27e2ULL },
+	{ 0xf5b5d7ec8acb58a2ULL, 0xae10af696774b1dbULL },
+	{ 0x9991a6f3d6bf1765ULL, 0xacca6da1e0a8ef29ULL },
+	{ 0xbff610b0cc6edd3fULL, 0x17fd090a58d32af3ULL },
+	{ 0xeff394dcff8a948eULL, 0xddfc4b4cef07f5b0ULL },
+	{ 0x95f83d0a1fb69cd9ULL, 0x4abdaf101564f98eULL },
+	{ 0xbb764c4ca7a4440fULL, 0x9d6d1ad41abe37f1ULL },
+	{ 0xea53df5fd18d5513ULL, 0x84c86189216dc5edULL },
+	{ 0x92746b9be2f8552cULL, 0x32fd3cf5b4e49bb4ULL },
+	{ 0xb7118682dbb66a77ULL, 0x3fbc8c33221dc2a1ULL },
+	{ 0xe4d5e82392a40515ULL, 0x0fabaf3feaa5334aULL },
+	{ 0x8f05b1163ba6832dULL, 0x29cb4d87f2a7400eULL },
+	{ 0xb2c71d5bca9023f8ULL, 0x743e20e9ef511012ULL },
+	{ 0xdf78e4b2bd342cf6ULL, 0x914da9246b255416ULL },
+	{ 0x8bab8eefb6409c1aULL, 0x1ad089b6c2f7548eULL },
+	{ 0xae9672aba3d0c320ULL, 0xa184ac2473b529b1ULL },
+	{ 0xda3c0f568cc4f3e8ULL, 0xc9e5d72d90a2741eULL },
+	{ 0x8865899617fb1871ULL, 0x7e2fa67c7a658892ULL },
+	{ 0xaa7eebfb9df9de8dULL, 0xddbb901b98feeab7ULL },
+	{ 0xd51ea6fa85785631ULL, 0x552a74227f3ea565ULL },
+	{ 0x8533285c936b35deULL, 0xd53a88958f87275fULL },
+	{ 0xa67ff273b8460356ULL, 0x8a892abaf368f137ULL },
+	{ 0xd01fef10a657842cULL, 0x2d2b7569b0432d85ULL },
+	{ 0x8213f56a67f6b29bULL, 0x9c3b29620e29fc73ULL },
+	{ 0xa298f2c501f45f42ULL, 0x8349f3ba91b47b8fULL },
+	{ 0xcb3f2f7642717713ULL, 0x241c70a936219a73ULL },
+	{ 0xfe0efb53d30dd4d7ULL, 0xed238cd383aa0110ULL },
+	{ 0x9ec95d1463e8a506ULL, 0xf4363804324a40aaULL },
+	{ 0xc67bb4597ce2ce48ULL, 0xb143c6053edcd0d5ULL },
+	{ 0xf81aa16fdc1b81daULL, 0xdd94b7868e94050aULL },
+	{ 0x9b10a4e5e9913128ULL, 0xca7cf2b4191c8326ULL },
+	{ 0xc1d4ce1f63f57d72ULL, 0xfd1c2f611f63a3f0ULL },
+	{ 0xf24a01a73cf2dccfULL, 0xbc633b39673c8cecULL },
+	{ 0x976e41088617ca01ULL, 0xd5be0503e085d813ULL },
+	{ 0xbd49d14aa79dbc82ULL, 0x4b2d8644d8a74e18ULL },
+	{ 0xec9c459d51852ba2ULL, 0xddf8e7d60ed1219eULL },
+	{ 0x93e1ab8252f33b45ULL, 0xcabb90e5c942b503ULL },
+	{ 0xb8da1662e7b00a17ULL, 0x3d6a751f3b936243ULL },
+	{ 0xe7109bfba19c0c9dULL, 0x0cc512670a783ad4ULL },
+	{ 0x906a617d450187e2ULL, 0x27fb2b80668b24c5ULL },
+	{ 0xb484f9dc9641e9daULL, 0xb1f9f660802dedf6ULL },
+	{ 0xe1a63853bbd26451ULL, 0x5e7873f8a0396973ULL },
+	{ 0x8d07e33455637eb2ULL, 0xdb0b487b6423e1e8ULL },
+	{ 0xb049dc016abc5e5fULL, 0x91ce1a9a3d2cda62ULL },
+	{ 0xdc5c5301c56b75f7ULL, 0x7641a140cc7810fbULL },
+	{ 0x89b9b3e11b6329baULL, 0xa9e904c87fcb0a9dULL },
+	{ 0xac2820d9623bf429ULL, 0x546345fa9fbdcd44ULL },
+	{ 0xd732290fbacaf133ULL, 0xa97c177947ad4095ULL },
+	{ 0x867f59a9d4bed6c0ULL, 0x49ed8eabcccc485dULL },
+	{ 0xa81f301449ee8c70ULL, 0x5c68f256bfff5a74ULL },
+	{ 0xd226fc195c6a2f8cULL, 0x73832eec6fff3111ULL },
+	{ 0x83585d8fd9c25db7ULL, 0xc831fd53c5ff7eabULL },
+	{ 0xa42e74f3d032f525ULL, 0xba3e7ca8b77f5e55ULL },
+	{ 0xcd3a1230c43fb26fULL, 0x28ce1bd2e55f35ebULL },
+	{ 0x80444b5e7aa7cf85ULL, 0x7980d163cf5b81b3ULL },
+	{ 0xa0555e361951c366ULL, 0xd7e105bcc332621fULL },
+	{ 0xc86ab5c39fa63440ULL, 0x8dd9472bf3fefaa7ULL },
+	{ 0xfa856334878fc150ULL, 0xb14f98f6f0feb951ULL },
+	{ 0x9c935e00d4b9d8d2ULL, 0x6ed1bf9a569f33d3ULL },
+	{ 0xc3b8358109e84f07ULL, 0x0a862f80ec4700c8ULL },
+	{ 0xf4a642e14c6262c8ULL, 0xcd27bb612758c0faULL },
+	{ 0x98e7e9cccfbd7dbdULL, 0x8038d51cb897789cULL },
+	{ 0xbf21e44003acdd2cULL, 0xe0470a63e6bd56c3ULL },
+	{ 0xeeea5d5004981478ULL, 0x1858ccfce06cac74ULL },
+	{ 0x95527a5202df0ccbULL, 0x0f37801e0c43ebc8ULL },
+	{ 0xbaa718e68396cffdULL, 0xd30560258f54e6baULL },
+	{ 0xe950df20247c83fdULL, 0x47c6b82ef32a2069ULL },
+	{ 0x91d28b7416cdd27eULL, 0x4cdc331d57fa5441ULL },
+	{ 0xb6472e511c81471dULL, 0xe0133fe4adf8e952ULL },
+	{ 0xe3d8f9e563a198e5ULL, 0x58180fddd97723a6ULL },
+	{ 0x8e679c2f5e44ff8fULL, 0x570f09eaa7ea7648ULL },
+};
+
+static const double exact_pow10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+	1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/* Returns the bits of the double nearest to w * 10^q, w being exact. */
+static unsigned long long int eisel_lemire(int q, unsigned long long int w)
+{
+	const unsigned long long int *pow5;
+	unsigned long long int hi, lo, mantissa;
+	int lz, upperbit, shift, power2;
+	if (!w || q < SMALLEST_POWER_OF_TEN)
+		return 0;
+	if (q > LARGEST_POWER_OF_TEN)
+		return (unsigned long long int)INFINITE_POWER << MANTISSA_BITS;
+	lz = __builtin_clzll(w);
+	w <<= lz;
+	pow5 = pow5_128[q - SMALLEST_POWER_OF_TEN];
+	mul128(w, pow5[0], &hi, &lo);
+	/* Refine the product only when the 55 bits we need may be off. */
+	if ((hi & 0x1ff) == 0x1ff) {
+		unsigned long long int hi2, lo2;
+		mul128(w, pow5[1], &hi2, &lo2);
+		lo += hi2;
+		if (hi2 > lo)
+			hi += 1;
+	}
+	upperbit = hi >> 63;
+	shift = upperbit + 64 - MANTISSA_BITS - 3;
+	mantissa = hi >> shift;
+	/* floor(q * log2(10)) + 63 */
+	power2 = (((152170 + 65536) * q) >> 16) + 63 + upperbit - lz +
+		EXPONENT_BIAS;
+	if (power2 <= 0) {
+		/* Subnormal, or the smallest normal after rounding. */
+		if (-power2 + 1 >= 64)
+			return 0;
+		mantissa >>= -power2 + 1;
+		mantissa += mantissa & 1;
+		mantissa >>= 1;
+		power2 = mantissa >= 1ULL << MANTISSA_BITS;
+		return (unsigned long long int)power2 << MANTISSA_BITS |
+			mantissa;
+	}
+	/* Exactly halfway between two doubles: round to even. This can only
+	 * happen for small powers of ten. */
+	if (lo <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 &&
+	    mantissa << shift == hi)
+		mantissa &= ~1ULL;
+	mantissa += mantissa & 1;
+	mantissa >>= 1;
+	if (mantissa >= 2ULL << MANTISSA_BITS) {
+		mantissa = 1ULL << MANTISSA_BITS;
+		power2 += 1;
+	}
+	mantissa &= ~(1ULL << MANTISSA_BITS);
+	if (power2 >= INFINITE_POWER)
+		return (unsigned long long int)INFINITE_POWER << MANTISSA_BITS;
+	return (unsigned long long int)power2 << MANTISSA_BITS | mantissa;
+}
+
+#define DECIMAL_DIGITS 800
+#define MAX_SHIFT 60
+
+/* Big decimal 0.d[0]d[1]...d[nd - 1] * 10^dp, where truncated tells whether
+ * non-zero digits were dropped past the capacity of the array. */
+struct decimal {
+	unsigned char d[DECIMAL_DIGITS];
+	int nd;
+	int dp;
+	int truncated;
+};
+
+static void decimal_trim(struct decimal *self)
+{
+	while (self->nd > 0 && !self->d[self->nd - 1])
+		self->nd -= 1;
+	if (!self->nd)
+		self->dp = 0;
+}
+
+static void decimal_left_shift(struct decimal *self, unsigned int k)
+{
+	/* Shifting by MAX_SHIFT bits adds at most 19 digits. */
+	unsigned char tmp[DECIMAL_DIGITS + 20];
+	unsigned int w = sizeof(tmp), len;
+	unsigned long long int n = 0;
+	int r;
+	for (r = self->nd - 1; r >= 0; r -= 1) {
+		n += (unsigned long long int)self->d[r] << k;
+		tmp[--w] = n % 10;
+		n /= 10;
+	}
+	for (; n; n /= 10)
+		tmp[--w] = n % 10;
+	len = sizeof(tmp) - w;
+	self->dp += len - self->nd;
+	if (len > DECIMAL_DIGITS) {
+		unsigned int i;
+		for (i = w + DECIMAL_DIGITS; i < sizeof(tmp); i += 1)
+			if (tmp[i])
+				self->truncated = 1;
+		len = DECIMAL_DIGITS;
+	}
+	__builtin_memcpy(self->d, tmp + w, len);
+	self->nd = len;
+	decimal_trim(self);
+}
+
+static void decimal_right_shift(struct decimal *self, unsigned int k)
+{
+	const unsigned long long int mask = (1ULL << k) - 1;
+	unsigned long long int n = 0;
+	int r = 0, w = 0;
+	for (; !(n >> k); r += 1) {
+		if (r >= self->nd) {
+			if (!n) {
+				self->nd = 0;
+				return;
+			}
+			for (; !(n >> k); r += 1)
+				n *= 10;
+			break;
+		}
+		n = n * 10 + self->d[r];
+	}
+	self->dp -= r - 1;
+	for (; r < self->nd; r += 1) {
+		self->d[w++] = n >> k;
+		n = (n & mask) * 10 + self->d[r];
+	}
+	for (; n; n = (n & mask) * 10)
+		if (w < DECIMAL_DIGITS)
+			self->d[w++] = n >> k;
+		else if (n >> k)
+			self->truncated = 1;
+	self->nd = w;
+	decimal_trim(self);
+}
+
+static void decimal_shift(struct decimal *self, int k)
+{
+	if (!self->nd)
+		return;
+	for (; k > MAX_SHIFT; k -= MAX_SHIFT)
+		decimal_left_shift(self, MAX_SHIFT);
+	for (; k < -MAX_SHIFT; k += MAX_SHIFT)
+		decimal_right_shift(self, MAX_SHIFT);
+	if (k > 0)
+		decimal_left_shift(self, k);
+	else if (k < 0)
+		decimal_right_shift(self, -k);
+}
+
+static int decimal_round_up(const struct decimal *self, int nd)
+{
+	if (nd < 0 || nd >= self->nd)
+		return 0;
+	/* Exactly halfway: round to even. */
+	if (self->d[nd] == 5 && nd + 1 == self->nd)
+		return self->truncated || (nd > 0 && self->d[nd - 1] & 1);
+	return self->d[nd] >= 5;
+}
+
+static unsigned long long int decimal_rounded_integer(
+	const struct decimal *self)
+{
+	unsigned long long int n = 0;
+	int i;
+	if (self->dp > 20)
+		return ~0ULL;
+	for (i = 0; i < self->dp && i < self->nd; i += 1)
+		n = n * 10 + self->d[i];
+	for (; i < self->dp; i += 1)
+		n *= 10;
+	return n + decimal_round_up(self, self->dp);
+}
+
+/* Returns the bits of the double nearest to the decimal, which is shifted
+ * by powers of two until it lies in [1/2, 1). */
+static unsigned long long int decimal_to_bits(struct decimal *self)
+{
+	static const int powtab[] = { 1, 3, 6, 9, 13, 16, 19, 23, 26 };
+	unsigned long long int mantissa;
+	int exp = 0, n;
+	decimal_trim(self);
+	if (!self->nd || self->dp < -330)
+		return 0;
+	if (self->dp > 310)
+		goto overflow;
+	while (self->dp > 0) {
+		n = self->dp < b6_card_of(powtab) ? powtab[self->dp] : 27;
+		decimal_shift(self, -n);
+		exp += n;
+	}
+	while (self->dp < 0 || (!self->dp && self->d[0] < 5)) {
+		n = -self->dp < b6_card_of(powtab) ? powtab[-self->dp] : 27;
+		decimal_shift(self, n);
+		exp -= n;
+	}
+	/* From [1/2, 1) to [1, 2). */
+	exp -= 1;
+	if (exp < 1 - EXPONENT_BIAS) {
+		n = 1 - EXPONENT_BIAS - exp;
+		decimal_shift(self, -n);
+		exp += n;
+	}
+	if (exp + EXPONENT_BIAS >= INFINITE_POWER)
+		goto overflow;
+	decimal_shift(self, MANTISSA_BITS + 1);
+	mantissa = decimal_rounded_integer(self);
+	if (mantissa == 2ULL << MANTISSA_BITS) {
+		mantissa >>= 1;
+		exp += 1;
+		if (exp + EXPONENT_BIAS >= INFINITE_POWER)
+			goto overflow;
+	}
+	if (!(mantissa & 1ULL << MANTISSA_BITS))
+		exp = -EXPONENT_BIAS;
+	return (unsigned long long int)(exp + EXPONENT_BIAS) << MANTISSA_BITS |
+		(mantissa & ((1ULL << MANTISSA_BITS) - 1));
+overflow:
+	return (unsigned long long int)INFINITE_POWER << MANTISSA_BITS;
+}
+
+#define MANTISSA_DIGITS 19
+
+/* Only sets the value of self, which does not need to belong to a document:
+ * flags replace the ones of its json instance. */
+static enum b6_json_error decode_number(struct b6_json_number *self, char c,
+					unsigned int flags,
+					struct b6_json_istream *is,
+					struct b6_json_parser_info *info)
 {
+	struct decimal decimal;
+	unsigned long long int mantissa = 0, bits;
+	int neg = 0, is_integer = 1, truncated = 0, nd = 0, dp = 0, e = 0, q;
 	double d;
-	int neg = 0;
+	decimal.truncated = 0;
 	if (c == minus) {
 		neg = 1;
 		if (!b6_json_istream_get(is, &c, info))
 			return B6_JSON_IO_ERROR;
 	}
-	if (c == 0) {
-		neg = 0;
-		d = 0;
+	/* Significant digits go both to the mantissa and the decimal, dp is
+	 * the position of the decimal point after the first one. */
+#define add_digit(digit) do { \
+	unsigned int _digit = (digit); \
+	if (nd < MANTISSA_DIGITS) \
+		mantissa = mantissa * 10 + _digit; \
+	else if (_digit) \
+		truncated = 1; \
+	if (nd < DECIMAL_DIGITS) \
+		decimal.d[nd] = _digit; \
+	else if (_digit) \
+		decimal.truncated = 1; \
+	nd += 1; \
+} while (0)
+	if (c == '0') {
+		if (!b6_json_istream_get(is, &c, info))
+			return B6_JSON_IO_ERROR;
 	} else if (is_digit(c)) {
-		d = c - '0';
-		for (;;) {
+		do {
+			add_digit(c - '0');
+			dp += 1;
 			if (!b6_json_istream_get(is, &c, info))
 				return B6_JSON_IO_ERROR;
-			if (!is_digit(c))
-				break;
-			d = d * 10 + c - '0';
-		}
+		} while (is_digit(c));
 	} else
 		return B6_JSON_PARSE_ERROR;
 	if (c == point) {
-		double f = 1;
+		is_integer = 0;
 		if (!b6_json_istream_get(is, &c, info))
 			return B6_JSON_IO_ERROR;
 		if (!is_digit(c))
 			return B6_JSON_PARSE_ERROR;
 		do {
-			f /= 10;
-			d += f * (c - '0');
+			if (nd || c != '0')
+				add_digit(c - '0');
+			else
+				dp -= 1;
 			if (!b6_json_istream_get(is, &c, info))
 				return B6_JSON_IO_ERROR;
 		} while (is_digit(c));
 	}
+#undef add_digit
 	if (c == power || c == (power & ~32)) {
-		double e;
+		int eneg = 0;
+		is_integer = 0;
 		if (!b6_json_istream_get(is, &c, info))
 			return B6_JSON_IO_ERROR;
-		if (c == minus) {
+		if (c == minus || c == plus) {
+			eneg = c == minus;
 			if (!b6_json_istream_get(is, &c, info))
 				return B6_JSON_IO_ERROR;
-			e = -1;
-		} else {
-			e = 1;
-			if (c == plus && !b6_json_istream_get(is, &c, info))
-				return B6_JSON_IO_ERROR;
 		}
 		if (!is_digit(c))
 			return B6_JSON_PARSE_ERROR;
-		e *= c - '0';
-		for (;;) {
+		do {
+			/* Anything larger overflows or underflows anyway. */
+			if (e < 1000000)
+				e = e * 10 + c - '0';
 			if (!b6_json_istream_get(is, &c, info))
 				return B6_JSON_IO_ERROR;
-			if (!is_digit(c))
-				break;
-			e = e * 10 + c - '0';
-		}
-		d *= e;
+		} while (is_digit(c));
+		if (eneg)
+			e = -e;
 	}
 	b6_json_istream_unget(is, c, info);
-	if (neg)
-		d = -d;
-	b6_json_set_number(self, d);
+	if (is_integer && (flags & B6_JSON_PRESERVE_INTEGERS) &&
+	    nd <= MANTISSA_DIGITS) {
+		if (!neg && mantissa <= ~0ULL >> 1) {
+			b6_json_set_integer(self, mantissa);
+			return B6_JSON_OK;
+		}
+		/* Keep -0 as a double. */
+		if (neg && mantissa && mantissa <= 1ULL << 63) {
+			b6_json_set_integer(self,
+					    -(long long int)(mantissa - 1) - 1);
+			return B6_JSON_OK;
+		}
+	}
+	q = dp + e - (nd < MANTISSA_DIGITS ? nd : MANTISSA_DIGITS);
+#if __FLT_EVAL_METHOD__ == 0
+	if (!truncated && mantissa <= 1ULL << 53 &&
+	    q >= -22 && q <= 22) {
+		d = mantissa;
+		d = q < 0 ? d / exact_pow10[-q] : d * exact_pow10[q];
+		goto done;
+	}
+#endif
+	bits = eisel_lemire(q, mantissa);
+	if (truncated && bits != eisel_lemire(q, mantissa + 1)) {
+		decimal.nd = nd < DECIMAL_DIGITS ? nd : DECIMAL_DIGITS;
+		decimal.dp = dp + e;
+		bits = decimal_to_bits(&decimal);
+	}
+	__builtin_memcpy(&d, &bits, sizeof(d));
+done:
+	b6_json_set_number(self, neg ? -d : d);
 	return B6_JSON_OK;
 }
 
+static enum b6_json_error parse_number(struct b6_json_number *self, char c,
+				       struct b6_json_istream *is,
+				       struct b6_json_parser_info *info)
+{
+	return decode_number(self, c, self->json->flags, is, info);
+}
+
 static enum b6_json_error parse_token(struct b6_json_istream *is,
 				      const char *token,
 				      struct b6_json_parser_info *info)
@@ -1047,6 +3317,59 @@ static enum b6_json_error parse_token(struct b6_json_istream *is,
 	return B6_JSON_OK;
 }
 
+static enum b6_json_error skip_value(struct b6_json_istream*, char,
+				     struct b6_json_parser_info*);
+
+static int is_lazy(const struct b6_json *self, const struct b6_json_istream *is,
+		   char c)
+{
+	if (!(self->flags & B6_JSON_LAZY) ||
+	    !b6_json_istream_is_addressable(is))
+		return 0;
+	if (c == opening_brace)
+		return !!self->impl->ops->lazy_object_impl;
+	return c == opening_bracket && self->impl->ops->lazy_array_impl;
+}
+
+/* Only matches the brackets of the value, which starts with c just before
+ * the window of the istream. */
+static enum b6_json_error parse_lazy(struct b6_json *self,
+				     struct b6_json_istream *is, char c,
+				     struct b6_json_value **value,
+				     struct b6_json_parser_info *info)
+{
+	const char *ptr = is->ptr - 1;
+	enum b6_json_error retval;
+	if ((retval = skip_value(is, c, info)))
+		return retval;
+	if (c == opening_brace) {
+		struct b6_json_object *v;
+		if (!(v = b6_pool_get(&self->pool)))
+			return B6_JSON_ALLOC_ERROR;
+		if (!(v->impl = self->impl->ops->lazy_object_impl(
+			      self->impl, self, ptr, is->ptr - ptr))) {
+			b6_pool_put(&self->pool, v);
+			return B6_JSON_ALLOC_ERROR;
+		}
+		b6_json_setup_value(&v->up, &b6_json_object_ops);
+		v->json = self;
+		*value = &v->up;
+	} else {
+		struct b6_json_array *v;
+		if (!(v = b6_pool_get(&self->pool)))
+			return B6_JSON_ALLOC_ERROR;
+		if (!(v->impl = self->impl->ops->lazy_array_impl(
+			      self->impl, self, ptr, is->ptr - ptr))) {
+			b6_pool_put(&self->pool, v);
+			return B6_JSON_ALLOC_ERROR;
+		}
+		b6_json_setup_value(&v->up, &b6_json_array_ops);
+		v->json = self;
+		*value = &v->up;
+	}
+	return B6_JSON_OK;
+}
+
 static enum b6_json_error parse_value_inner(struct b6_json *self,
 					    struct b6_json_istream *is,
 					    char c,
@@ -1054,6 +3377,8 @@ static enum b6_json_error parse_value_inner(struct b6_json *self,
 					    struct b6_json_parser_info *info)
 {
 	enum b6_json_error retval;
+	if (is_lazy(self, is, c))
+		return parse_lazy(self, is, c, value, info);
 	if (c == *null_token) {
 		struct b6_json_null *v = b6_json_new_null(self);
 		if (!v)
@@ -1140,34 +3465,1077 @@ enum b6_json_error b6_json_parse_object(struct b6_json_object *self,
 		return B6_JSON_PARSE_ERROR;
 	if (!(temp = b6_json_new_object(self->json)))
 		return B6_JSON_ALLOC_ERROR;
-	if ((retval = parse_object(temp, is, info)))
+	if ((retval = parse_object(temp, is, info))) {
+		b6_json_unref_value(&temp->up);
 		return retval;
+	}
 	b6_json_object_swap(self, temp);
 	b6_json_unref_value(&temp->up);
 	return B6_JSON_OK;
 }
 
-static enum b6_json_error enter_object(struct b6_json_serializer *up,
-				       struct b6_json_ostream *os,
-				       const struct b6_json_object *object)
+#define handle(handler, op, ...) \
+	((handler)->ops->op ? (handler)->ops->op(handler, ##__VA_ARGS__) : \
+	 B6_JSON_OK)
+
+struct array_sink {
+	struct string_sink up;
+	struct b6_array *array;
+	unsigned int nchars;
+};
+
+static enum b6_json_error array_sink_append(struct string_sink *up,
+					    const struct b6_utf8 *utf8)
 {
-	struct b6_json_default_serializer *self =
-		b6_cast_of(up, struct b6_json_default_serializer, up);
-	self->depth += 1;
-	if (b6_json_ostream_write(os, &opening_brace, 1) != 1)
-		return B6_JSON_IO_ERROR;
+	struct array_sink *self = b6_cast_of(up, struct array_sink, up);
+	void *ptr = b6_array_extend(self->array, utf8->nbytes);
+	if (!ptr)
+		return B6_JSON_ALLOC_ERROR;
+	__builtin_memcpy(ptr, utf8->ptr, utf8->nbytes);
+	self->nchars += utf8->nchars;
 	return B6_JSON_OK;
 }
 
-static enum b6_json_error leave_object(struct b6_json_serializer *up,
-				       struct b6_json_ostream *os,
-				       const struct b6_json_object *object)
+static enum b6_json_error parse_event_string(struct b6_json_event_parser *self,
+					     struct b6_json_istream *is,
+					     struct b6_utf8 *utf8,
+					     struct b6_json_parser_info *info)
 {
-	struct b6_json_default_serializer *self =
-		b6_cast_of(up, struct b6_json_default_serializer, up);
-	if (b6_json_ostream_write(os, &closing_brace, 1) != 1)
-		return B6_JSON_IO_ERROR;
-	if (!--self->depth && b6_json_ostream_flush(os))
+	struct array_sink sink = {
+		.up = { .append = array_sink_append, },
+		.array = &self->buf,
+		.nchars = 0,
+	};
+	enum b6_json_error retval;
+	long int len = scan_string_view(is->ptr, is->end, &utf8->nchars);
+	if (len >= 0) {
+		/* The bytes stay in the window until the next read. */
+		utf8->ptr = is->ptr;
+		utf8->nbytes = len;
+		is->ptr += len + 1;
+		if (info)
+			info->col += utf8->nchars + 1;
+		return B6_JSON_OK;
+	}
+	b6_array_clear(&self->buf);
+	if ((retval = decode_string(&sink.up, is, info)))
+		return retval;
+	utf8->ptr = (const char*)self->buf.buffer;
+	utf8->nbytes = self->buf.length;
+	utf8->nchars = sink.nchars;
+	return B6_JSON_OK;
+}
+
+static enum b6_json_error parse_event_value(struct b6_json_event_parser *self,
+					    struct b6_json_istream *is,
+					    char c,
+					    struct b6_json_handler *handler,
+					    struct b6_json_parser_info *info)
+{
+	enum b6_json_error retval;
+	struct b6_json_number number;
+	struct b6_utf8 utf8;
+	if (c == *null_token)
+		return (retval = parse_token(is, null_token + 1, info)) ?
+			retval : handle(handler, null);
+	if (c == *true_token)
+		return (retval = parse_token(is, true_token + 1, info)) ?
+			retval : handle(handler, boolean, 1);
+	if (c == *false_token)
+		return (retval = parse_token(is, false_token + 1, info)) ?
+			retval : handle(handler, boolean, 0);
+	if (c == quote)
+		return (retval = parse_event_string(self, is, &utf8, info)) ?
+			retval : handle(handler, string, &utf8);
+	if (c == opening_bracket) {
+		if ((retval = handle(handler, enter_array)) ||
+		    (retval = b6_json_istream_token(is, &c, info)))
+			return retval;
+		/* Nicely accept a comma before the closing bracket. */
+		while (c != closing_bracket) {
+			if ((retval = parse_event_value(self, is, c, handler,
+							info)) ||
+			    (retval = b6_json_istream_token(is, &c, info)))
+				return retval;
+			if (c == closing_bracket)
+				break;
+			if (c != comma)
+				return B6_JSON_PARSE_ERROR;
+			if ((retval = b6_json_istream_token(is, &c, info)))
+				return retval;
+		}
+		return handle(handler, leave_array);
+	}
+	if (c == opening_brace) {
+		if ((retval = handle(handler, enter_object)) ||
+		    (retval = b6_json_istream_token(is, &c, info)))
+			return retval;
+		/* Nicely accept a comma before the closing brace. */
+		while (c != closing_brace) {
+			if (c != quote)
+				return B6_JSON_PARSE_ERROR;
+			if ((retval = parse_event_string(self, is, &utf8,
+							 info)) ||
+			    (retval = handle(handler, key, &utf8)) ||
+			    (retval = b6_json_istream_token(is, &c, info)))
+				return retval;
+			if (c != colon)
+				return B6_JSON_PARSE_ERROR;
+			if ((retval = b6_json_istream_token(is, &c, info)) ||
+			    (retval = parse_event_value(self, is, c, handler,
+							info)) ||
+			    (retval = b6_json_istream_token(is, &c, info)))
+				return retval;
+			if (c == closing_brace)
+				break;
+			if (c != comma)
+				return B6_JSON_PARSE_ERROR;
+			if ((retval = b6_json_istream_token(is, &c, info)))
+				return retval;
+		}
+		return handle(handler, leave_object);
+	}
+	if ((retval = decode_number(&number, c, handler->ops->integer ?
+				    B6_JSON_PRESERVE_INTEGERS : 0, is, info)))
+		return retval;
+	if (b6_json_number_is_integer(&number))
+		return handle(handler, integer, number.integer);
+	return handle(handler, number, number.number);
+}
+
+enum b6_json_error b6_json_parse_events(struct b6_json_event_parser *self,
+					struct b6_json_istream *is,
+					struct b6_json_handler *handler,
+					struct b6_json_parser_info *info)
+{
+	enum b6_json_error retval;
+	char c;
+	if ((retval = b6_json_istream_token(is, &c, info)))
+		return retval;
+	return parse_event_value(self, is, c, handler, info);
+}
+
+/* What the push parser expects next. Tokens split between chunks are kept
+ * in the token array while the state is the one they started in. */
+enum push_state {
+	PUSH_VALUE,
+	PUSH_KEY,
+	PUSH_COLON,
+	PUSH_NEXT,
+};
+
+static int is_number_char(char c)
+{
+	return is_digit(c) || c == minus || c == plus || c == point ||
+		c == power || c == (power & ~32);
+}
+
+static int is_number_token(char c)
+{
+	return c != quote && c != *null_token && c != *true_token &&
+		c != *false_token;
+}
+
+/* Returns where a token starting with c, of which len bytes have already
+ * been seen, ends in [ptr, end), or NULL if it goes on past end. Numbers end
+ * before the byte that terminates them. */
+static const char *push_token_end(char c, unsigned long int len,
+				  const char *ptr, const char *end,
+				  int *escaped)
+{
+	if (c == quote) {
+		const struct scanner *scanner = get_best_scanner();
+		for (;;) {
+			if (!*escaped)
+				ptr = scanner->plain(ptr, end);
+			if (ptr == end)
+				return NULL;
+			if (*escaped)
+				*escaped = 0;
+			else if (*ptr == backslash)
+				*escaped = 1;
+			else if (*ptr == quote)
+				return ptr + 1;
+			ptr += 1;
+		}
+	}
+	if (!is_number_token(c)) {
+		len = (c == *false_token ? sizeof(false_token) :
+		       sizeof(null_token)) - 1 - len;
+		return end - ptr >= len ? ptr + len : NULL;
+	}
+	while (ptr != end && is_number_char(*ptr))
+		ptr += 1;
+	return ptr != end ? ptr : NULL;
+}
+
+static enum b6_json_error push_after_value(struct b6_json_push_parser *self)
+{
+	self->state = self->stack.length ? PUSH_NEXT : PUSH_VALUE;
+	return B6_JSON_OK;
+}
+
+static enum b6_json_error push_enter(struct b6_json_push_parser *self, char c)
+{
+	char *top = b6_array_extend(&self->stack, 1);
+	if (!top)
+		return B6_JSON_ALLOC_ERROR;
+	*top = c;
+	if (c == opening_brace) {
+		self->state = PUSH_KEY;
+		return handle(self->handler, enter_object);
+	}
+	self->state = PUSH_VALUE;
+	return handle(self->handler, enter_array);
+}
+
+static enum b6_json_error push_leave(struct b6_json_push_parser *self, char c)
+{
+	char opening = c == closing_brace ? opening_brace : opening_bracket;
+	if (!self->stack.length ||
+	    self->stack.buffer[self->stack.length - 1] != opening)
+		return B6_JSON_PARSE_ERROR;
+	self->stack.length -= 1;
+	push_after_value(self);
+	return c == closing_brace ? handle(self->handler, leave_object) :
+		handle(self->handler, leave_array);
+}
+
+/* Decodes a complete token starting with c, is pointing past c. */
+static enum b6_json_error push_decode(struct b6_json_push_parser *self,
+				      struct b6_json_istream *is, char c)
+{
+	enum b6_json_error retval;
+	struct b6_utf8 utf8;
+	if (self->state != PUSH_KEY) {
+		if ((retval = parse_event_value(&self->up, is, c,
+						self->handler, NULL)))
+			return retval;
+		return push_after_value(self);
+	}
+	if ((retval = parse_event_string(&self->up, is, &utf8, NULL)) ||
+	    (retval = handle(self->handler, key, &utf8)))
+		return retval;
+	self->state = PUSH_COLON;
+	return B6_JSON_OK;
+}
+
+static enum b6_json_error push_append(struct b6_json_push_parser *self,
+				      const char *ptr, unsigned long int len)
+{
+	void *dst = b6_array_extend(&self->token, len);
+	if (!dst)
+		return B6_JSON_ALLOC_ERROR;
+	__builtin_memcpy(dst, ptr, len);
+	return B6_JSON_OK;
+}
+
+/* The whole token has to be decoded, but the terminator of numbers: numbers
+ * stop before bytes that do not fit, which would be dropped otherwise. */
+static enum b6_json_error push_decode_token(struct b6_json_push_parser *self)
+{
+	struct b6_json_istream is;
+	enum b6_json_error retval;
+	char c = self->token.buffer[0];
+	b6_json_setup_memory_istream(&is, self->token.buffer,
+				     self->token.length);
+	is.ptr += 1;
+	retval = push_decode(self, &is, c);
+	if (!retval && is.ptr != is.end - is_number_token(c))
+		retval = B6_JSON_PARSE_ERROR;
+	b6_array_clear(&self->token);
+	return retval;
+}
+
+/* Goes on with the token started in a previous chunk. */
+static enum b6_json_error push_pending(struct b6_json_push_parser *self,
+				       struct b6_json_istream *is)
+{
+	char c = self->token.buffer[0];
+	const char *end = push_token_end(c, self->token.length, is->ptr,
+					 is->end, &self->escaped);
+	const char *ptr = is->ptr;
+	enum b6_json_error retval;
+	if (!end) {
+		is->ptr = is->end;
+		return push_append(self, ptr, is->end - ptr);
+	}
+	is->ptr = end;
+	/* Numbers are decoded along with their terminator, left in is. */
+	retval = push_append(self, ptr, end - ptr + is_number_token(c));
+	return retval ? retval : push_decode_token(self);
+}
+
+static enum b6_json_error push_token(struct b6_json_push_parser *self,
+				     struct b6_json_istream *is)
+{
+	const char *ptr = is->ptr;
+	const char *end;
+	self->escaped = 0;
+	end = push_token_end(*ptr, 1, ptr + 1, is->end, &self->escaped);
+	if (!end) {
+		is->ptr = is->end;
+		return push_append(self, ptr, is->end - ptr);
+	}
+	is->ptr = ptr + 1;
+	return push_decode(self, is, *ptr);
+}
+
+static enum b6_json_error push_parse(struct b6_json_push_parser *self,
+				     struct b6_json_istream *is)
+{
+	const struct scanner *scanner = get_best_scanner();
+	for (;;) {
+		enum b6_json_error retval = B6_JSON_OK;
+		char c;
+		is->ptr = scanner->blank(is->ptr, is->end);
+		if (is->ptr == is->end)
+			return B6_JSON_OK;
+		c = *is->ptr;
+		switch (self->state) {
+		case PUSH_VALUE:
+			if (c == opening_brace || c == opening_bracket) {
+				is->ptr += 1;
+				retval = push_enter(self, c);
+			} else if (c == closing_bracket) {
+				/* Nicely accept a comma before it. */
+				is->ptr += 1;
+				retval = push_leave(self, c);
+			} else if (c == closing_brace || c == comma ||
+				   c == colon)
+				retval = B6_JSON_PARSE_ERROR;
+			else
+				retval = push_token(self, is);
+			break;
+		case PUSH_KEY:
+			if (c == closing_brace) {
+				is->ptr += 1;
+				retval = push_leave(self, c);
+			} else if (c == quote)
+				retval = push_token(self, is);
+			else
+				retval = B6_JSON_PARSE_ERROR;
+			break;
+		case PUSH_COLON:
+			if (c != colon)
+				return B6_JSON_PARSE_ERROR;
+			is->ptr += 1;
+			self->state = PUSH_VALUE;
+			break;
+		case PUSH_NEXT:
+			is->ptr += 1;
+			if (c == closing_brace || c == closing_bracket)
+				retval = push_leave(self, c);
+			else if (c != comma)
+				retval = B6_JSON_PARSE_ERROR;
+			else if (self->stack.buffer[self->stack.length - 1] ==
+				 opening_brace)
+				self->state = PUSH_KEY;
+			else
+				self->state = PUSH_VALUE;
+			break;
+		}
+		if (retval)
+			return retval;
+	}
+}
+
+void b6_json_push_parser_initialize(struct b6_json_push_parser *self,
+				    struct b6_json_handler *handler,
+				    struct b6_allocator *allocator)
+{
+	b6_json_event_parser_initialize(&self->up, allocator);
+	b6_array_initialize(&self->stack, allocator, 1);
+	b6_array_initialize(&self->token, allocator, 1);
+	self->handler = handler;
+	self->error = B6_JSON_OK;
+	self->state = PUSH_VALUE;
+	self->escaped = 0;
+}
+
+void b6_json_push_parser_finalize(struct b6_json_push_parser *self)
+{
+	b6_array_finalize(&self->token);
+	b6_array_finalize(&self->stack);
+	b6_json_event_parser_finalize(&self->up);
+}
+
+enum b6_json_error b6_json_push_parser_feed(struct b6_json_push_parser *self,
+					    const void *buf,
+					    unsigned long int len)
+{
+	struct b6_json_istream is;
+	if (self->error)
+		return self->error;
+	b6_json_setup_memory_istream(&is, buf, len);
+	if (self->token.length && (self->error = push_pending(self, &is)))
+		return self->error;
+	return self->error = push_parse(self, &is);
+}
+
+enum b6_json_error b6_json_push_parser_finish(struct b6_json_push_parser *self)
+{
+	enum b6_json_error retval = self->error;
+	if (!retval && self->token.length) {
+		char c = self->token.buffer[0];
+		/* Only numbers can end with the input. */
+		if (!is_number_token(c))
+			retval = B6_JSON_IO_ERROR;
+		else if (!(retval = push_append(self, " ", 1)))
+			retval = push_decode_token(self);
+	}
+	if (!retval && (self->stack.length || self->state != PUSH_VALUE))
+		retval = B6_JSON_IO_ERROR;
+	b6_array_clear(&self->stack);
+	b6_array_clear(&self->token);
+	self->error = B6_JSON_OK;
+	self->state = PUSH_VALUE;
+	return retval;
+}
+
+/* Keys are decoded in place of buf, which is made as large as the text
+ * upfront so that they never move. */
+static enum b6_json_error reset_pointer(struct b6_json_pointer *self,
+					unsigned long int len, char **buf)
+{
+	b6_array_clear(&self->steps);
+	b6_array_clear(&self->buf);
+	*buf = NULL;
+	if (len && !(*buf = b6_array_extend(&self->buf, len)))
+		return B6_JSON_ALLOC_ERROR;
+	return B6_JSON_OK;
+}
+
+/* Only canonical numbers are array indices, as "01" is not. */
+static unsigned long int key_index(const struct b6_utf8 *key)
+{
+	unsigned long int index = 0, i;
+	if (!key->nbytes || (key->ptr[0] == '0' && key->nbytes > 1))
+		return ~0UL;
+	for (i = 0; i < key->nbytes; i += 1) {
+		if (!is_digit(key->ptr[i]) || index > (~0UL - 9) / 10)
+			return ~0UL;
+		index = index * 10 + key->ptr[i] - '0';
+	}
+	return index;
+}
+
+static enum b6_json_error add_step(struct b6_json_pointer *self,
+				   const char *ptr, const char *end)
+{
+	struct b6_json_pointer_step *step;
+	unsigned int nchars = 0;
+	const char *key = ptr;
+	while (ptr != end) {
+		unsigned int len = b6_utf8_dec_len(ptr);
+		unsigned int unicode;
+		if (len < 1 || len > end - ptr ||
+		    b6_utf8_dec(len, &unicode, ptr) != len)
+			return B6_JSON_PARSE_ERROR;
+		ptr += len;
+		nchars += 1;
+	}
+	if (!(step = b6_array_extend(&self->steps, 1)))
+		return B6_JSON_ALLOC_ERROR;
+	step->key.ptr = key;
+	step->key.nbytes = end - key;
+	step->key.nchars = nchars;
+	step->index = key_index(&step->key);
+	return B6_JSON_OK;
+}
+
+static enum b6_json_error compile_pointer(struct b6_json_pointer *self,
+					  const char *ptr, const char *end)
+{
+	enum b6_json_error retval;
+	char *buf;
+	if ((retval = reset_pointer(self, end - ptr, &buf)))
+		return retval;
+	while (ptr != end) {
+		char *key = buf;
+		if (*ptr++ != slash)
+			return B6_JSON_PARSE_ERROR;
+		for (; ptr != end && *ptr != slash; ptr += 1)
+			if (*ptr != '~')
+				*buf++ = *ptr;
+			else if (++ptr != end && (*ptr == '0' || *ptr == '1'))
+				*buf++ = *ptr == '0' ? '~' : slash;
+			else
+				return B6_JSON_PARSE_ERROR;
+		if ((retval = add_step(self, key, buf)))
+			return retval;
+	}
+	return B6_JSON_OK;
+}
+
+enum b6_json_error b6_json_compile_pointer(struct b6_json_pointer *self,
+					   const struct b6_utf8 *utf8)
+{
+	enum b6_json_error retval;
+	if ((retval = compile_pointer(self, utf8->ptr,
+				      utf8->ptr + utf8->nbytes)))
+		b6_array_clear(&self->steps);
+	return retval;
+}
+
+static enum b6_json_error compile_path(struct b6_json_pointer *self,
+				       const char *ptr, const char *end)
+{
+	enum b6_json_error retval;
+	int implicit = 0;
+	char *buf;
+	if ((retval = reset_pointer(self, end - ptr, &buf)))
+		return retval;
+	if (ptr != end && *ptr == '$')
+		ptr += 1;
+	else if (ptr != end && *ptr != point && *ptr != opening_bracket)
+		implicit = 1;
+	while (ptr != end) {
+		char *key = buf;
+		if (*ptr == opening_bracket) {
+			for (ptr += 1; ptr != end && is_digit(*ptr); ptr += 1)
+				*buf++ = *ptr;
+			if (ptr == end || *ptr++ != closing_bracket)
+				return B6_JSON_PARSE_ERROR;
+		} else if (*ptr == point || implicit) {
+			for (ptr += !implicit; ptr != end && *ptr != point &&
+			     *ptr != opening_bracket; ptr += 1)
+				*buf++ = *ptr;
+		} else
+			return B6_JSON_PARSE_ERROR;
+		if (buf == key)
+			return B6_JSON_PARSE_ERROR;
+		if ((retval = add_step(self, key, buf)))
+			return retval;
+		implicit = 0;
+	}
+	return B6_JSON_OK;
+}
+
+enum b6_json_error b6_json_compile_path(struct b6_json_pointer *self,
+					const struct b6_utf8 *utf8)
+{
+	enum b6_json_error retval;
+	if ((retval = compile_path(self, utf8->ptr,
+				   utf8->ptr + utf8->nbytes)))
+		b6_array_clear(&self->steps);
+	return retval;
+}
+
+struct b6_json_value *b6_json_select(const struct b6_json_pointer *self,
+				     struct b6_json_value *value)
+{
+	const struct b6_json_pointer_step *step = b6_json_pointer_step(self, 0);
+	unsigned long int n = b6_json_pointer_len(self);
+	for (; value && n; n -= 1, step += 1) {
+		struct b6_json_object *object;
+		struct b6_json_array *array;
+		if ((object = b6_json_value_as_or_null(value, object)))
+			value = b6_json_get_object(object, &step->key);
+		else if ((array = b6_json_value_as_or_null(value, array)))
+			value = step->index < b6_json_array_len(array) ?
+				b6_json_get_array(array, step->index) : NULL;
+		else
+			value = NULL;
+	}
+	return value;
+}
+
+/* Skips the rest of a string, whose escapes are not checked. */
+static enum b6_json_error skip_string(struct b6_json_istream *is,
+				      struct b6_json_parser_info *info)
+{
+	const struct scanner *scanner = get_best_scanner();
+	for (;;) {
+		const char *ptr = scanner->plain(is->ptr, is->end);
+		char c;
+		if (info)
+			info->col += ptr - is->ptr;
+		is->ptr = ptr;
+		if (ptr == is->end) {
+			if (b6_json_istream_refill(is, 1) < 1)
+				return B6_JSON_IO_ERROR;
+			continue;
+		}
+		if ((c = *ptr) != quote && c != backslash &&
+		    (unsigned char)c < 0x80)
+			return B6_JSON_PARSE_ERROR;
+		is->ptr += 1;
+		if (info && (c & 0xc0) != 0x80)
+			info->col += 1;
+		if (c == quote)
+			return B6_JSON_OK;
+		/* The escaped byte may be a quote. */
+		if (c == backslash && !b6_json_istream_get(is, &c, info))
+			return B6_JSON_IO_ERROR;
+	}
+}
+
+/* Skips the rest of a number, whose syntax is not checked. */
+static enum b6_json_error skip_number(struct b6_json_istream *is,
+				      struct b6_json_parser_info *info)
+{
+	for (;;) {
+		const char *ptr = is->ptr;
+		long int n;
+		while (ptr != is->end && is_number_char(*ptr))
+			ptr += 1;
+		if (info)
+			info->col += ptr - is->ptr;
+		is->ptr = ptr;
+		if (ptr != is->end)
+			return B6_JSON_OK;
+		if ((n = b6_json_istream_refill(is, 1)) < 0)
+			return B6_JSON_IO_ERROR;
+		if (!n)
+			return B6_JSON_OK;
+	}
+}
+
+static enum b6_json_error skip_value(struct b6_json_istream *is, char c,
+				     struct b6_json_parser_info *info)
+{
+	enum b6_json_error retval;
+	char close;
+	if (c == *null_token)
+		return parse_token(is, null_token + 1, info);
+	if (c == *true_token)
+		return parse_token(is, true_token + 1, info);
+	if (c == *false_token)
+		return parse_token(is, false_token + 1, info);
+	if (c == quote)
+		return skip_string(is, info);
+	if (c == opening_bracket)
+		close = closing_bracket;
+	else if (c == opening_brace)
+		close = closing_brace;
+	else
+		return is_number_char(c) ? skip_number(is, info) :
+			B6_JSON_PARSE_ERROR;
+	if ((retval = b6_json_istream_token(is, &c, info)))
+		return retval;
+	/* Nicely accept a comma before the closing bracket or brace. */
+	while (c != close) {
+		if (close == closing_brace) {
+			if (c != quote)
+				return B6_JSON_PARSE_ERROR;
+			if ((retval = skip_string(is, info)) ||
+			    (retval = b6_json_istream_token(is, &c, info)))
+				return retval;
+			if (c != colon)
+				return B6_JSON_PARSE_ERROR;
+			if ((retval = b6_json_istream_token(is, &c, info)))
+				return retval;
+		}
+		if ((retval = skip_value(is, c, info)) ||
+		    (retval = b6_json_istream_token(is, &c, info)))
+			return retval;
+		if (c == close)
+			break;
+		if (c != comma)
+			return B6_JSON_PARSE_ERROR;
+		if ((retval = b6_json_istream_token(is, &c, info)))
+			return retval;
+	}
+	return B6_JSON_OK;
+}
+
+/* Follows the n steps left of the pointer in the value starting with c. When
+ * a key appears several times, the first one is followed. */
+static enum b6_json_error parse_selected(
+	struct b6_json_event_parser *self, struct b6_json_istream *is, char c,
+	const struct b6_json_pointer_step *step, unsigned long int n,
+	struct b6_json_handler *handler, struct b6_json_parser_info *info)
+{
+	enum b6_json_error retval;
+	unsigned long int index = 0;
+	struct b6_utf8 key;
+	int found = 0;
+	if (!n)
+		return parse_event_value(self, is, c, handler, info);
+	if (c == opening_brace) {
+		if ((retval = b6_json_istream_token(is, &c, info)))
+			return retval;
+		while (c != closing_brace) {
+			int match;
+			if (c != quote)
+				return B6_JSON_PARSE_ERROR;
+			if ((retval = parse_event_string(self, is, &key,
+							 info)))
+				return retval;
+			match = !found && key.nbytes == step->key.nbytes &&
+				!__builtin_memcmp(key.ptr, step->key.ptr,
+						  key.nbytes);
+			if ((retval = b6_json_istream_token(is, &c, info)))
+				return retval;
+			if (c != colon)
+				return B6_JSON_PARSE_ERROR;
+			if ((retval = b6_json_istream_token(is, &c, info)))
+				return retval;
+			found |= match;
+			retval = match ?
+				parse_selected(self, is, c, step + 1, n - 1,
+					       handler, info) :
+				skip_value(is, c, info);
+			if (retval ||
+			    (retval = b6_json_istream_token(is, &c, info)))
+				return retval;
+			if (c == closing_brace)
+				break;
+			if (c != comma)
+				return B6_JSON_PARSE_ERROR;
+			if ((retval = b6_json_istream_token(is, &c, info)))
+				return retval;
+		}
+		return B6_JSON_OK;
+	}
+	if (c == opening_bracket) {
+		if ((retval = b6_json_istream_token(is, &c, info)))
+			return retval;
+		while (c != closing_bracket) {
+			retval = index++ == step->index ?
+				parse_selected(self, is, c, step + 1, n - 1,
+					       handler, info) :
+				skip_value(is, c, info);
+			if (retval ||
+			    (retval = b6_json_istream_token(is, &c, info)))
+				return retval;
+			if (c == closing_bracket)
+				break;
+			if (c != comma)
+				return B6_JSON_PARSE_ERROR;
+			if ((retval = b6_json_istream_token(is, &c, info)))
+				return retval;
+		}
+		return B6_JSON_OK;
+	}
+	return skip_value(is, c, info);
+}
+
+enum b6_json_error b6_json_parse_selected_events(
+	struct b6_json_event_parser *self, struct b6_json_istream *is,
+	const struct b6_json_pointer *pointer, struct b6_json_handler *handler,
+	struct b6_json_parser_info *info)
+{
+	enum b6_json_error retval;
+	char c;
+	if ((retval = b6_json_istream_token(is, &c, info)))
+		return retval;
+	return parse_selected(self, is, c, b6_json_pointer_step(pointer, 0),
+			      b6_json_pointer_len(pointer), handler, info);
+}
+
+/* Seeded FNV-1a, whose low bits are mixed with the high ones as slots are
+ * selected by a mask. */
+static unsigned int hash_field(unsigned int seed, const char *ptr,
+			       unsigned long int len)
+{
+	unsigned int hash = 2166136261U ^ seed;
+	while (len--) {
+		hash ^= (unsigned char)*ptr++;
+		hash *= 16777619U;
+	}
+	hash ^= hash >> 15;
+	hash *= 0x85ebca6bU;
+	return hash ^ hash >> 13;
+}
+
+/* Returns 0 if the names of all fields land in different slots with seed. */
+static int place_fields(struct b6_json_schema *self, unsigned int seed)
+{
+	struct b6_json_schema_slot *slots = b6_array_get(&self->slots, 0);
+	unsigned int i;
+	for (i = 0; i <= self->mask; i += 1)
+		slots[i].field = ~0U;
+	for (i = 0; i < self->nfields; i += 1) {
+		const char *name = self->fields[i].name;
+		unsigned long int len = __builtin_strlen(name);
+		struct b6_json_schema_slot *slot =
+			&slots[hash_field(seed, name, len) & self->mask];
+		if (slot->field != ~0U)
+			return -1;
+		slot->field = i;
+		slot->len = len;
+	}
+	self->seed = seed;
+	return 0;
+}
+
+enum b6_json_error b6_json_compile_schema(struct b6_json_schema *self,
+					  const struct b6_json_field *fields,
+					  unsigned int nfields)
+{
+	unsigned int size, seed, i, j;
+	for (i = 0; i < nfields; i += 1)
+		for (j = 0; j < i; j += 1)
+			if (!__builtin_strcmp(fields[i].name, fields[j].name))
+				return B6_JSON_ERROR;
+	self->fields = fields;
+	self->nfields = nfields;
+	/* Try a few seeds at each size, which quickly fits small tables. */
+	for (size = 1; size < 2 * nfields; size *= 2);
+	for (; size <= 1U << 20; size *= 2) {
+		b6_array_clear(&self->slots);
+		if (!b6_array_extend(&self->slots, size))
+			break;
+		self->mask = size - 1;
+		for (seed = 0; seed < 64; seed += 1)
+			if (!place_fields(self, seed))
+				return B6_JSON_OK;
+	}
+	b6_array_clear(&self->slots);
+	self->nfields = 0;
+	return size <= 1U << 20 ? B6_JSON_ALLOC_ERROR : B6_JSON_ERROR;
+}
+
+static const struct b6_json_field *find_field(
+	const struct b6_json_schema *self, const struct b6_utf8 *key)
+{
+	const struct b6_json_schema_slot *slot;
+	const struct b6_json_field *field;
+	if (!self->nfields)
+		return NULL;
+	slot = b6_array_get(&self->slots, hash_field(self->seed, key->ptr,
+						     key->nbytes) &
+			    self->mask);
+	if (slot->field == ~0U || slot->len != key->nbytes)
+		return NULL;
+	field = &self->fields[slot->field];
+	return __builtin_memcmp(field->name, key->ptr, key->nbytes) ?
+		NULL : field;
+}
+
+struct utf8_string_sink {
+	struct string_sink up;
+	struct b6_utf8_string *string;
+};
+
+static enum b6_json_error utf8_string_sink_append(struct string_sink *up,
+						  const struct b6_utf8 *utf8)
+{
+	struct utf8_string_sink *self =
+		b6_cast_of(up, struct utf8_string_sink, up);
+	return b6_extend_utf8_string(self->string, utf8) ?
+		B6_JSON_ALLOC_ERROR : B6_JSON_OK;
+}
+
+static enum b6_json_error parse_fields(struct b6_json_struct_parser*,
+				       struct b6_json_istream*, char,
+				       const struct b6_json_schema*, char*,
+				       struct b6_json_parser_info*);
+
+static enum b6_json_error parse_field(struct b6_json_struct_parser *self,
+				      struct b6_json_istream *is, char c,
+				      const struct b6_json_field *field,
+				      char *ptr,
+				      struct b6_json_parser_info *info)
+{
+	struct utf8_string_sink sink;
+	struct b6_json_number number;
+	enum b6_json_error retval;
+	switch (field->type) {
+	case B6_JSON_FIELD_BOOLEAN:
+		if (c == *true_token)
+			retval = parse_token(is, true_token + 1, info);
+		else if (c == *false_token)
+			retval = parse_token(is, false_token + 1, info);
+		else
+			return B6_JSON_PARSE_ERROR;
+		if (!retval)
+			*(int*)ptr = c == *true_token;
+		return retval;
+	case B6_JSON_FIELD_INTEGER:
+		if ((retval = decode_number(&number, c,
+					    B6_JSON_PRESERVE_INTEGERS, is,
+					    info)))
+			return retval;
+		if (!b6_json_number_is_integer(&number))
+			return B6_JSON_PARSE_ERROR;
+		*(long long int*)ptr = number.integer;
+		return B6_JSON_OK;
+	case B6_JSON_FIELD_NUMBER:
+		if ((retval = decode_number(&number, c, 0, is, info)))
+			return retval;
+		*(double*)ptr = number.number;
+		return B6_JSON_OK;
+	case B6_JSON_FIELD_STRING:
+		if (c != quote)
+			return B6_JSON_PARSE_ERROR;
+		sink.up.append = utf8_string_sink_append;
+		sink.string = (struct b6_utf8_string*)ptr;
+		sink.string->utf8.nbytes = sink.string->utf8.nchars = 0;
+		return decode_string(&sink.up, is, info);
+	case B6_JSON_FIELD_STRUCT:
+		return parse_fields(self, is, c, field->schema, ptr, info);
+	}
+	return B6_JSON_ERROR;
+}
+
+/* Marks the fields found in seen, which grows with the depth of objects. */
+static enum b6_json_error parse_fields(struct b6_json_struct_parser *self,
+				       struct b6_json_istream *is, char c,
+				       const struct b6_json_schema *schema,
+				       char *ptr,
+				       struct b6_json_parser_info *info)
+{
+	unsigned long int base = b6_array_length(&self->seen), i;
+	enum b6_json_error retval;
+	const unsigned char *seen;
+	unsigned char *mark;
+	if (c != opening_brace)
+		return B6_JSON_PARSE_ERROR;
+	if (!(mark = b6_array_extend(&self->seen, schema->nfields)) &&
+	    schema->nfields)
+		return B6_JSON_ALLOC_ERROR;
+	if (schema->nfields)
+		__builtin_memset(mark, 0, schema->nfields);
+	if ((retval = b6_json_istream_token(is, &c, info)))
+		goto out;
+	/* Nicely accept a comma before the closing brace. */
+	while (c != closing_brace) {
+		const struct b6_json_field *field;
+		struct b6_utf8 key;
+		retval = B6_JSON_PARSE_ERROR;
+		if (c != quote)
+			goto out;
+		if ((retval = parse_event_string(&self->up, is, &key, info)))
+			goto out;
+		field = find_field(schema, &key);
+		if ((retval = b6_json_istream_token(is, &c, info)))
+			goto out;
+		if (c != colon) {
+			retval = B6_JSON_PARSE_ERROR;
+			goto out;
+		}
+		if ((retval = b6_json_istream_token(is, &c, info)))
+			goto out;
+		if (!field)
+			retval = skip_value(is, c, info);
+		else if (c == *null_token)
+			retval = parse_token(is, null_token + 1, info);
+		else if (!(retval = parse_field(self, is, c, field,
+						ptr + field->offset, info))) {
+			mark = b6_array_get(&self->seen, base);
+			mark[field - schema->fields] = 1;
+		}
+		if (retval || (retval = b6_json_istream_token(is, &c, info)))
+			goto out;
+		if (c == closing_brace)
+			break;
+		if (c != comma) {
+			retval = B6_JSON_PARSE_ERROR;
+			goto out;
+		}
+		if ((retval = b6_json_istream_token(is, &c, info)))
+			goto out;
+	}
+	seen = b6_array_get(&self->seen, base);
+	for (i = 0; i < schema->nfields; i += 1)
+		if ((schema->fields[i].flags & B6_JSON_FIELD_REQUIRED) &&
+		    !seen[i])
+			retval = B6_JSON_PARSE_ERROR;
+out:
+	/* Unlike b6_array_reduce, keep the memory for the next objects. */
+	self->seen.length = base;
+	return retval;
+}
+
+enum b6_json_error b6_json_parse_struct(struct b6_json_struct_parser *self,
+					struct b6_json_istream *is,
+					const struct b6_json_schema *schema,
+					void *ptr, struct b6_json_parser_info *info)
+{
+	enum b6_json_error retval;
+	char c;
+	if ((retval = b6_json_istream_token(is, &c, info)))
+		return retval;
+	return parse_fields(self, is, c, schema, ptr, info);
+}
+
+static enum b6_json_error serialize_fields(const struct b6_json_schema *schema,
+					   const char *ptr,
+					   struct b6_json_ostream *os)
+{
+	enum b6_json_error retval;
+	unsigned int i;
+	if (b6_json_ostream_write(os, &opening_brace, 1) != 1)
+		return B6_JSON_IO_ERROR;
+	for (i = 0; i < schema->nfields; i += 1) {
+		const struct b6_json_field *field = &schema->fields[i];
+		const char *member = ptr + field->offset;
+		struct b6_utf8 name;
+		name.ptr = field->name;
+		name.nbytes = name.nchars = __builtin_strlen(field->name);
+		if (i && b6_json_ostream_write(os, &comma, 1) != 1)
+			return B6_JSON_IO_ERROR;
+		if ((retval = serialize_utf8(&name, os)))
+			return retval;
+		if (b6_json_ostream_write(os, &colon, 1) != 1)
+			return B6_JSON_IO_ERROR;
+		switch (field->type) {
+		case B6_JSON_FIELD_BOOLEAN:
+			retval = *(const int*)member ?
+				serialize_true(NULL, os, NULL) :
+				serialize_false(NULL, os, NULL);
+			break;
+		case B6_JSON_FIELD_INTEGER:
+			retval = serialize_integer(
+				*(const long long int*)member, os);
+			break;
+		case B6_JSON_FIELD_NUMBER:
+			retval = serialize_double(*(const double*)member, os);
+			break;
+		case B6_JSON_FIELD_STRING:
+			retval = serialize_utf8(
+				&((const struct b6_utf8_string*)member)->utf8,
+				os);
+			break;
+		case B6_JSON_FIELD_STRUCT:
+			retval = serialize_fields(field->schema, member, os);
+			break;
+		default:
+			retval = B6_JSON_ERROR;
+		}
+		if (retval)
+			return retval;
+	}
+	if (b6_json_ostream_write(os, &closing_brace, 1) != 1)
+		return B6_JSON_IO_ERROR;
+	return B6_JSON_OK;
+}
+
+enum b6_json_error b6_json_serialize_struct(const struct b6_json_schema *self,
+					    const void *ptr,
+					    struct b6_json_ostream *os)
+{
+	enum b6_json_error error;
+	os->depth += 1;
+	error = serialize_fields(self, ptr, os);
+	if (!--os->depth && !error && b6_json_ostream_flush(os))
+		error = B6_JSON_IO_ERROR;
+	return error;
+}
+
+static enum b6_json_error enter_object(struct b6_json_serializer *up,
+				       struct b6_json_ostream *os,
+				       const struct b6_json_object *object)
+{
+	struct b6_json_default_serializer *self =
+		b6_cast_of(up, struct b6_json_default_serializer, up);
+	self->depth += 1;
+	if (b6_json_ostream_write(os, &opening_brace, 1) != 1)
+		return B6_JSON_IO_ERROR;
+	return B6_JSON_OK;
+}
+
+static enum b6_json_error leave_object(struct b6_json_serializer *up,
+				       struct b6_json_ostream *os,
+				       const struct b6_json_object *object)
+{
+	struct b6_json_default_serializer *self =
+		b6_cast_of(up, struct b6_json_default_serializer, up);
+	self->depth -= 1;
+	if (b6_json_ostream_write(os, &closing_brace, 1) != 1)
 		return B6_JSON_IO_ERROR;
 	return B6_JSON_OK;
 }
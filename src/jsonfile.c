@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2015, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+#define _GNU_SOURCE
+
+#include "b6/json.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum b6_json_error b6_json_open_file_istream(struct b6_json_file_istream *self,
+					     const char *path)
+{
+	struct stat st;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return B6_JSON_IO_ERROR;
+	if (fstat(fd, &st)) {
+		close(fd);
+		return B6_JSON_IO_ERROR;
+	}
+	self->addr = NULL;
+	self->len = st.st_size;
+	/* mmap refuses empty mappings: parse the empty document instead. */
+	if (self->len) {
+		self->addr = mmap(NULL, self->len, PROT_READ, MAP_PRIVATE, fd,
+				  0);
+		if (self->addr == MAP_FAILED) {
+			close(fd);
+			return B6_JSON_IO_ERROR;
+		}
+		madvise(self->addr, self->len, MADV_SEQUENTIAL);
+	}
+	close(fd);
+	b6_json_setup_memory_istream(&self->up, self->addr, self->len);
+	return B6_JSON_OK;
+}
+
+void b6_json_close_file_istream(struct b6_json_file_istream *self)
+{
+	if (self->addr)
+		munmap(self->addr, self->len);
+}
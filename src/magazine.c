@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2015, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+#include "b6/magazine.h"
+
+static struct b6_magazine *new_magazine(struct b6_magazine_depot *depot)
+{
+	struct b6_magazine *magazine;
+	if (!b6_deque_empty(&depot->empty))
+		return b6_cast_of(b6_deque_del_first(&depot->empty),
+				  struct b6_magazine, sref);
+	magazine = b6_allocate(depot->allocator, sizeof(struct b6_magazine) +
+			       depot->capacity * sizeof(void*));
+	if (magazine)
+		magazine->count = 0;
+	return magazine;
+}
+
+static void store_magazine(struct b6_magazine_depot *depot,
+			   struct b6_magazine *magazine)
+{
+	if (magazine->count)
+		b6_deque_add_first(&depot->full, &magazine->sref);
+	else
+		b6_deque_add_first(&depot->empty, &magazine->sref);
+}
+
+static void swap_magazines(struct b6_magazine_cache *self)
+{
+	struct b6_magazine *magazine = self->loaded;
+	self->loaded = self->previous;
+	self->previous = magazine;
+}
+
+void *b6_magazine_reload(struct b6_magazine_cache *self)
+{
+	struct b6_magazine_depot *depot = self->depot;
+	if (self->previous->count) {
+		swap_magazines(self);
+		return self->loaded->rounds[--self->loaded->count];
+	}
+	b6_spinlock_acquire(&depot->lock);
+	if (!b6_deque_empty(&depot->full)) {
+		store_magazine(depot, self->previous);
+		self->previous = self->loaded;
+		self->loaded = b6_cast_of(b6_deque_del_first(&depot->full),
+					  struct b6_magazine, sref);
+	} else
+		/* Load the empty magazine straight from the pool. */
+		self->loaded->count = b6_pool_get_n(depot->pool,
+						    self->loaded->rounds,
+						    depot->capacity);
+	b6_spinlock_release(&depot->lock);
+	if (!self->loaded->count)
+		return NULL;
+	return self->loaded->rounds[--self->loaded->count];
+}
+
+void b6_magazine_unload(struct b6_magazine_cache *self, void *ptr)
+{
+	struct b6_magazine_depot *depot = self->depot;
+	struct b6_magazine *magazine;
+	if (self->previous->count < depot->capacity) {
+		swap_magazines(self);
+		self->loaded->rounds[self->loaded->count++] = ptr;
+		return;
+	}
+	b6_spinlock_acquire(&depot->lock);
+	if ((magazine = new_magazine(depot))) {
+		store_magazine(depot, self->previous);
+		self->previous = self->loaded;
+		self->loaded = magazine;
+		magazine->rounds[magazine->count++] = ptr;
+	} else
+		b6_pool_put(depot->pool, ptr);
+	b6_spinlock_release(&depot->lock);
+}
+
+static void *b6_magazine_allocate(struct b6_allocator *up,
+				  unsigned long int size)
+{
+	struct b6_magazine_cache *self =
+		b6_cast_of(up, struct b6_magazine_cache, parent);
+	return size > self->depot->pool->size ? NULL : b6_magazine_get(self);
+}
+
+static void *b6_magazine_reallocate(struct b6_allocator *up, void *ptr,
+				    unsigned long int size)
+{
+	struct b6_magazine_cache *self =
+		b6_cast_of(up, struct b6_magazine_cache, parent);
+	return size > self->depot->pool->size ? NULL : ptr;
+}
+
+static void b6_magazine_deallocate(struct b6_allocator *up, void *ptr)
+{
+	struct b6_magazine_cache *self =
+		b6_cast_of(up, struct b6_magazine_cache, parent);
+	b6_magazine_put(self, ptr);
+}
+
+int b6_magazine_cache_initialize(struct b6_magazine_cache *self,
+				 struct b6_magazine_depot *depot)
+{
+	static const struct b6_allocator_ops ops = {
+		.allocate = b6_magazine_allocate,
+		.reallocate = b6_magazine_reallocate,
+		.deallocate = b6_magazine_deallocate,
+	};
+	self->parent.ops = &ops;
+	self->depot = depot;
+	b6_spinlock_acquire(&depot->lock);
+	if ((self->loaded = new_magazine(depot)) &&
+	    !(self->previous = new_magazine(depot))) {
+		store_magazine(depot, self->loaded);
+		self->loaded = NULL;
+	}
+	b6_spinlock_release(&depot->lock);
+	return self->loaded ? 0 : -1;
+}
+
+void b6_magazine_cache_finalize(struct b6_magazine_cache *self)
+{
+	struct b6_magazine_depot *depot = self->depot;
+	b6_spinlock_acquire(&depot->lock);
+	store_magazine(depot, self->loaded);
+	store_magazine(depot, self->previous);
+	b6_spinlock_release(&depot->lock);
+}
+
+int b6_magazine_depot_initialize(struct b6_magazine_depot *self,
+				 struct b6_pool *pool,
+				 struct b6_allocator *allocator,
+				 unsigned int capacity)
+{
+	if (!pool || !allocator || !capacity)
+		return -1;
+	b6_spinlock_initialize(&self->lock);
+	self->pool = pool;
+	self->allocator = allocator;
+	self->capacity = capacity;
+	b6_deque_initialize(&self->full);
+	b6_deque_initialize(&self->empty);
+	return 0;
+}
+
+void b6_magazine_depot_finalize(struct b6_magazine_depot *self)
+{
+	while (!b6_deque_empty(&self->full)) {
+		struct b6_magazine *magazine =
+			b6_cast_of(b6_deque_del_first(&self->full),
+				   struct b6_magazine, sref);
+		b6_pool_put_n(self->pool, magazine->rounds, magazine->count);
+		b6_deallocate(self->allocator, magazine);
+	}
+	while (!b6_deque_empty(&self->empty))
+		b6_deallocate(self->allocator,
+			      b6_cast_of(b6_deque_del_first(&self->empty),
+					 struct b6_magazine, sref));
+}
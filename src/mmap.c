@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2015, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+#define _GNU_SOURCE
+
+#include "b6/mmap.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+struct mapping {
+	struct b6_tref tref;
+	char *addr;
+	unsigned long int size;
+	unsigned long int page_size;
+	unsigned long int alignment;
+};
+
+static unsigned long int round_up(unsigned long int size,
+				  unsigned long int page_size)
+{
+	return (size + page_size - 1) & ~(page_size - 1);
+}
+
+static void *map(unsigned long int size, int flags)
+{
+	void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+	return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+/* Descriptors are allocated in chunks of a single page. */
+static void *allocate_pages(struct b6_allocator *up, unsigned long int size)
+{
+	return map(size, 0);
+}
+
+static void deallocate_pages(struct b6_allocator *up, void *ptr)
+{
+	struct b6_mmap_allocator *self =
+		b6_cast_of(up, struct b6_mmap_allocator, pages);
+	munmap(ptr, self->page_size);
+}
+
+static struct mapping *find_mapping(struct b6_mmap_allocator *self, void *ptr,
+				    struct b6_tref **top, int *dir)
+{
+	struct b6_tref *ref;
+	b6_tree_search(&self->tree, ref, *top, *dir) {
+		struct mapping *mapping = b6_cast_of(ref, struct mapping, tref);
+		if ((char *)ptr < mapping->addr)
+			*dir = B6_PREV;
+		else if ((char *)ptr > mapping->addr)
+			*dir = B6_NEXT;
+		else
+			return mapping;
+	}
+	return NULL;
+}
+
+static int add_mapping(struct b6_mmap_allocator *self, void *addr,
+		       unsigned long int size, unsigned long int page_size,
+		       unsigned long int alignment)
+{
+	struct mapping *mapping;
+	struct b6_tref *top;
+	int dir;
+	if (!(mapping = b6_pool_get(&self->pool)))
+		return -1;
+	mapping->addr = addr;
+	mapping->size = size;
+	mapping->page_size = page_size;
+	mapping->alignment = alignment;
+	find_mapping(self, addr, &top, &dir);
+	b6_tree_add(&self->tree, top, dir, &mapping->tref);
+	return 0;
+}
+
+/* Map size bytes of regular pages aligned on alignment bytes. */
+static void *map_aligned(struct b6_mmap_allocator *self,
+			 unsigned long int size, unsigned long int alignment)
+{
+	unsigned long int head, len;
+	char *ptr;
+
+	if ((self->flags & B6_MMAP_HUGEPAGE) && size >= B6_MMAP_HUGE_PAGE_SIZE &&
+	    alignment < B6_MMAP_HUGE_PAGE_SIZE)
+		alignment = B6_MMAP_HUGE_PAGE_SIZE;
+
+	if (alignment <= self->page_size)
+		ptr = map(size, 0);
+	else {
+		/* Map more, then unmap what is out of alignment. */
+		len = size + alignment - self->page_size;
+		if (len < size || !(ptr = map(len, 0)))
+			return NULL;
+		head = -(unsigned long int)ptr & (alignment - 1);
+		if (head)
+			munmap(ptr, head);
+		if (len - head > size)
+			munmap(ptr + head + size, len - head - size);
+		ptr += head;
+	}
+
+	if (ptr && (self->flags & B6_MMAP_HUGEPAGE))
+		madvise(ptr, size, MADV_HUGEPAGE);
+
+	return ptr;
+}
+
+static void *b6_mmap_allocate_aligned(struct b6_allocator *up,
+				      unsigned long int size,
+				      unsigned long int alignment)
+{
+	struct b6_mmap_allocator *self =
+		b6_cast_of(up, struct b6_mmap_allocator, parent);
+	unsigned long int page_size = B6_MMAP_HUGE_PAGE_SIZE;
+	unsigned long int len = round_up(size, page_size);
+	void *ptr = NULL;
+
+	if (!size || len < size)
+		return NULL;
+
+	/* Huge pages are only worth it for allocations of one page or more. */
+	if ((self->flags & B6_MMAP_HUGETLB) && size >= page_size &&
+	    alignment <= page_size)
+		ptr = map(len, MAP_HUGETLB);
+
+	if (!ptr) {
+		page_size = self->page_size;
+		len = round_up(size, page_size);
+		if (!(ptr = map_aligned(self, len, alignment)))
+			return NULL;
+	}
+
+	if (add_mapping(self, ptr, len, page_size, alignment)) {
+		munmap(ptr, len);
+		return NULL;
+	}
+
+	return ptr;
+}
+
+static void *b6_mmap_allocate(struct b6_allocator *up, unsigned long int size)
+{
+	return b6_mmap_allocate_aligned(up, size, 1);
+}
+
+static void *b6_mmap_reallocate(struct b6_allocator *up, void *ptr,
+				unsigned long int size)
+{
+	struct b6_mmap_allocator *self =
+		b6_cast_of(up, struct b6_mmap_allocator, parent);
+	unsigned long int len;
+	struct mapping *mapping;
+	struct b6_tref *top;
+	int dir;
+	void *addr;
+	mapping = find_mapping(self, ptr, &top, &dir);
+	b6_assert(mapping);
+	/* Huge page mappings must be a multiple of the huge page size. */
+	len = round_up(size, mapping->page_size);
+	if (!size || len < size)
+		return NULL;
+	if (len == mapping->size)
+		return ptr;
+	if (mapping->alignment <= mapping->page_size)
+		addr = mremap(mapping->addr, mapping->size, len, MREMAP_MAYMOVE);
+	else if ((addr = mremap(mapping->addr, mapping->size, len, 0)) ==
+		 MAP_FAILED) {
+		/* Moving anywhere would lose the alignment: pages are moved
+		 * onto an aligned mapping instead, which they replace. */
+		void *dest = map_aligned(self, len, mapping->alignment);
+		if (!dest)
+			return NULL;
+		addr = mremap(mapping->addr, mapping->size, len,
+			      MREMAP_MAYMOVE | MREMAP_FIXED, dest);
+		if (addr == MAP_FAILED)
+			munmap(dest, len);
+	}
+	if (addr == MAP_FAILED)
+		return NULL;
+	mapping->size = len;
+	if (addr != ptr) {
+		b6_tree_del(&self->tree, top, dir);
+		mapping->addr = addr;
+		find_mapping(self, addr, &top, &dir);
+		b6_tree_add(&self->tree, top, dir, &mapping->tref);
+	}
+	return addr;
+}
+
+static void b6_mmap_deallocate(struct b6_allocator *up, void *ptr)
+{
+	struct b6_mmap_allocator *self =
+		b6_cast_of(up, struct b6_mmap_allocator, parent);
+	struct mapping *mapping;
+	struct b6_tref *top;
+	int dir;
+	mapping = find_mapping(self, ptr, &top, &dir);
+	b6_assert(mapping);
+	b6_tree_del(&self->tree, top, dir);
+	munmap(mapping->addr, mapping->size);
+	b6_pool_put(&self->pool, mapping);
+}
+
+int b6_mmap_allocator_initialize(struct b6_mmap_allocator *self, int flags)
+{
+	static const struct b6_allocator_ops ops = {
+		.allocate = b6_mmap_allocate,
+		.reallocate = b6_mmap_reallocate,
+		.deallocate = b6_mmap_deallocate,
+		.allocate_aligned = b6_mmap_allocate_aligned,
+	};
+	static const struct b6_allocator_ops pages_ops = {
+		.allocate = allocate_pages,
+		.deallocate = deallocate_pages,
+	};
+	long int page_size = sysconf(_SC_PAGESIZE);
+	if (page_size <= 0 || !b6_is_apot(page_size))
+		return -1;
+	self->parent.ops = &ops;
+	self->pages.ops = &pages_ops;
+	self->page_size = page_size;
+	self->flags = flags;
+	b6_tree_initialize(&self->tree, &b6_tree_avl_ops);
+	return b6_pool_initialize(&self->pool, &self->pages,
+				  sizeof(struct mapping), page_size);
+}
+
+void b6_mmap_allocator_finalize(struct b6_mmap_allocator *self)
+{
+	struct b6_tref *top;
+	int dir;
+	while (!b6_tree_empty(&self->tree)) {
+		struct mapping *mapping;
+		b6_tree_top(&self->tree, &top, &dir);
+		mapping = b6_cast_of(b6_tree_del(&self->tree, top, dir),
+				     struct mapping, tref);
+		munmap(mapping->addr, mapping->size);
+	}
+	b6_pool_finalize(&self->pool);
+}
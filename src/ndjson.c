@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2015, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+#include "b6/json.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MIN_CHUNK_SIZE (1UL << 16)
+#define MAX_CHUNK_SIZE (1UL << 24)
+
+/* Threads claim chunks by incrementing next. In order, the records of chunk
+ * i are delivered once turn reaches i, which guards the handler. */
+struct ndjson {
+	const char *buf;
+	unsigned long int len;
+	unsigned long int size;
+	unsigned long int nchunks;
+	unsigned long int next;
+	unsigned long int turn;
+	struct b6_json_record_handler *handler;
+	unsigned int flags;
+	enum b6_json_error error;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+};
+
+struct ndjson_record {
+	struct b6_json_object *object;
+	unsigned long int offset;
+};
+
+struct ndjson_worker {
+	struct ndjson *ndjson;
+	pthread_t thread;
+	struct b6_json_default_impl impl;
+	struct b6_json json;
+	struct b6_array records;
+};
+
+/* Chunk i starts after the first newline from byte i * size on, so that any
+ * thread finds the same bounds without scanning the previous chunks. */
+static unsigned long int chunk_start(const struct ndjson *self,
+				     unsigned long int i)
+{
+	unsigned long int offset = i * self->size;
+	const char *nl;
+	if (!i)
+		return 0;
+	if (offset >= self->len)
+		return self->len;
+	nl = memchr(self->buf + offset, '\n', self->len - offset);
+	return nl ? nl + 1 - self->buf : self->len;
+}
+
+static int is_blank(const char *ptr, const char *end)
+{
+	for (; ptr != end; ptr += 1)
+		if (*ptr != ' ' && *ptr != '\t' && *ptr != '\r')
+			return 0;
+	return 1;
+}
+
+static enum b6_json_error get_error(struct ndjson *self)
+{
+	return __atomic_load_n(&self->error, __ATOMIC_RELAXED);
+}
+
+/* Only the first error is kept. */
+static void set_error(struct ndjson *self, enum b6_json_error error)
+{
+	enum b6_json_error expected = B6_JSON_OK;
+	__atomic_compare_exchange_n(&self->error, &expected, error, 0,
+				    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+static enum b6_json_error parse_record(struct ndjson_worker *self,
+				       const char *ptr, const char *end,
+				       struct b6_json_object **object)
+{
+	struct b6_json_istream is;
+	enum b6_json_error error;
+	b6_json_setup_memory_istream(&is, ptr, end - ptr);
+	if (!(*object = b6_json_new_object(&self->json)))
+		return B6_JSON_ALLOC_ERROR;
+	if (!(error = b6_json_parse_object(*object, &is, NULL)) &&
+	    !is_blank(is.ptr, is.end))
+		error = B6_JSON_PARSE_ERROR;
+	if (error)
+		b6_json_unref_value(&(*object)->up);
+	return error;
+}
+
+static void deliver(struct ndjson *self, struct b6_json_object *object,
+		    unsigned long int offset)
+{
+	enum b6_json_error error;
+	if (!get_error(self) &&
+	    (error = self->handler->ops->record(self->handler, object,
+						offset)))
+		set_error(self, error);
+	b6_json_unref_value(&object->up);
+}
+
+static int is_turn(struct ndjson *self, unsigned long int i)
+{
+	return __atomic_load_n(&self->turn, __ATOMIC_ACQUIRE) == i;
+}
+
+static void flush_records(struct ndjson_worker *self)
+{
+	struct ndjson_record *records = b6_array_get(&self->records, 0);
+	unsigned long int n = b6_array_length(&self->records), j;
+	for (j = 0; j < n; j += 1)
+		deliver(self->ndjson, records[j].object, records[j].offset);
+	b6_array_clear(&self->records);
+}
+
+/* Waits for the turn of chunk i to deliver its remaining records, even after
+ * an error so that the threads waiting for the next chunks are released. */
+static void end_turn(struct ndjson_worker *self, unsigned long int i)
+{
+	struct ndjson *ndjson = self->ndjson;
+	pthread_mutex_lock(&ndjson->lock);
+	while (ndjson->turn != i)
+		pthread_cond_wait(&ndjson->cond, &ndjson->lock);
+	pthread_mutex_unlock(&ndjson->lock);
+	flush_records(self);
+	pthread_mutex_lock(&ndjson->lock);
+	__atomic_store_n(&ndjson->turn, i + 1, __ATOMIC_RELEASE);
+	pthread_cond_broadcast(&ndjson->cond);
+	pthread_mutex_unlock(&ndjson->lock);
+}
+
+/* In order, records are kept aside only until the turn of their chunk comes,
+ * which is right away for the oldest chunk. */
+static void parse_chunk(struct ndjson_worker *self, unsigned long int i)
+{
+	struct ndjson *ndjson = self->ndjson;
+	const char *ptr = ndjson->buf + chunk_start(ndjson, i);
+	const char *end = ndjson->buf + chunk_start(ndjson, i + 1);
+	int ordered = ndjson->flags & B6_JSON_NDJSON_ORDERED;
+	while (ptr != end && !get_error(ndjson)) {
+		const char *nl = memchr(ptr, '\n', end - ptr);
+		const char *eol = nl ? nl : end;
+		struct b6_json_object *object;
+		struct ndjson_record *record;
+		enum b6_json_error error;
+		if (is_blank(ptr, eol))
+			goto next;
+		if ((error = parse_record(self, ptr, eol, &object))) {
+			set_error(ndjson, error);
+			break;
+		}
+		if (!ordered)
+			deliver(ndjson, object, ptr - ndjson->buf);
+		else if (is_turn(ndjson, i)) {
+			flush_records(self);
+			deliver(ndjson, object, ptr - ndjson->buf);
+		} else if ((record = b6_array_extend(&self->records, 1))) {
+			record->object = object;
+			record->offset = ptr - ndjson->buf;
+		} else {
+			b6_json_unref_value(&object->up);
+			set_error(ndjson, B6_JSON_ALLOC_ERROR);
+			break;
+		}
+	next:
+		ptr = nl ? nl + 1 : end;
+	}
+	if (ordered)
+		end_turn(self, i);
+}
+
+static void *work(void *arg)
+{
+	struct ndjson_worker *self = arg;
+	struct ndjson *ndjson = self->ndjson;
+	unsigned long int i;
+	while (!get_error(ndjson) &&
+	       (i = __atomic_fetch_add(&ndjson->next, 1, __ATOMIC_RELAXED)) <
+	       ndjson->nchunks)
+		parse_chunk(self, i);
+	return NULL;
+}
+
+static int setup_worker(struct ndjson_worker *self, struct ndjson *ndjson,
+			struct b6_allocator *allocator)
+{
+	self->ndjson = ndjson;
+	if (b6_json_default_impl_initialize(&self->impl, allocator))
+		return -1;
+	if (ndjson->flags & B6_JSON_NDJSON_INTERN_KEYS)
+		b6_json_default_impl_intern_keys(&self->impl);
+	b6_json_initialize(&self->json, &self->impl.up, allocator);
+	self->json.flags = ndjson->flags &
+		~(B6_JSON_NDJSON_ORDERED | B6_JSON_NDJSON_INTERN_KEYS);
+	b6_array_initialize(&self->records, allocator,
+			    sizeof(struct ndjson_record));
+	return 0;
+}
+
+static void teardown_worker(struct ndjson_worker *self)
+{
+	b6_array_finalize(&self->records);
+	b6_json_finalize(&self->json);
+	b6_json_default_impl_finalize(&self->impl);
+}
+
+enum b6_json_error b6_json_parse_ndjson(const void *buf, unsigned long int len,
+					struct b6_json_record_handler *handler,
+					struct b6_allocator *allocator,
+					unsigned int nthreads,
+					unsigned int flags)
+{
+	struct ndjson ndjson;
+	struct ndjson_worker *workers;
+	unsigned int i, n;
+	if (!nthreads) {
+		long int ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = ncpus > 0 ? ncpus : 1;
+	}
+	/* Make enough chunks to balance the load. */
+	ndjson.size = len / nthreads / 16;
+	if (ndjson.size < MIN_CHUNK_SIZE)
+		ndjson.size = MIN_CHUNK_SIZE;
+	if (ndjson.size > MAX_CHUNK_SIZE)
+		ndjson.size = MAX_CHUNK_SIZE;
+	ndjson.nchunks = (len + ndjson.size - 1) / ndjson.size;
+	if (nthreads > ndjson.nchunks)
+		nthreads = ndjson.nchunks ? ndjson.nchunks : 1;
+	ndjson.buf = buf;
+	ndjson.len = len;
+	ndjson.next = ndjson.turn = 0;
+	ndjson.handler = handler;
+	ndjson.flags = flags;
+	ndjson.error = B6_JSON_OK;
+	if (!(workers = b6_allocate(allocator, nthreads * sizeof(*workers))))
+		return B6_JSON_ALLOC_ERROR;
+	for (i = 0; i < nthreads; i += 1)
+		if (setup_worker(&workers[i], &ndjson, allocator))
+			break;
+	if (i < nthreads) {
+		while (i--)
+			teardown_worker(&workers[i]);
+		b6_deallocate(allocator, workers);
+		return B6_JSON_ALLOC_ERROR;
+	}
+	pthread_mutex_init(&ndjson.lock, NULL);
+	pthread_cond_init(&ndjson.cond, NULL);
+	/* Chunks are shared among the threads that could be started. */
+	for (n = 1; n < nthreads; n += 1)
+		if (pthread_create(&workers[n].thread, NULL, work,
+				   &workers[n]))
+			break;
+	work(&workers[0]);
+	for (i = 1; i < n; i += 1)
+		pthread_join(workers[i].thread, NULL);
+	for (i = 0; i < nthreads; i += 1)
+		teardown_worker(&workers[i]);
+	pthread_cond_destroy(&ndjson.cond);
+	pthread_mutex_destroy(&ndjson.lock);
+	b6_deallocate(allocator, workers);
+	return ndjson.error;
+}
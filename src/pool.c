@@ -4,6 +4,29 @@
  */
 
 #include "b6/pool.h"
+#include "b6/guard.h"
+
+#ifdef B6_POOL_STATS
+#define count_objects(pool, n) do { \
+	struct b6_pool_counters *c = &(pool)->counters; \
+	c->objects += (n); \
+	if (c->peak_objects < c->objects) \
+		c->peak_objects = c->objects; \
+} while (0)
+#define count_chunks(pool, n) do { \
+	struct b6_pool_counters *c = &(pool)->counters; \
+	c->chunks += (n); \
+	if (c->peak_chunks < c->chunks) \
+		c->peak_chunks = c->chunks; \
+} while (0)
+#define count_event(pool, event, n) do { \
+	(pool)->counters.event += (n); \
+} while (0)
+#else
+#define count_objects(pool, n) do {} while (0)
+#define count_chunks(pool, n) do {} while (0)
+#define count_event(pool, event, n) do {} while (0)
+#endif
 
 static void initialize_chunk(struct b6_pool *pool, struct b6_chunk *chunk)
 {
@@ -14,8 +37,13 @@ static void initialize_chunk(struct b6_pool *pool, struct b6_chunk *chunk)
 	chunk->free = pool->chunk_size - chunk->index;
 	chunk->used = 0;
 	chunk->flag = 0;
+	chunk->pool = pool;
 
 	b6_list_add_first(&pool->list, &chunk->dref);
+	count_chunks(pool, 1);
+
+	if (pool->mask)
+		return;
 
 	b6_tree_search(&pool->tree, ref, top, dir)
 		dir = ref < &chunk->tref ? B6_NEXT : B6_PREV;
@@ -31,6 +59,10 @@ static void finalize_chunk(struct b6_pool *pool, struct b6_chunk *chunk)
 		pool->curr = NULL;
 
 	b6_list_del(&chunk->dref);
+	count_chunks(pool, -1);
+
+	if (pool->mask)
+		return;
 
 	b6_tree_search(&pool->tree, ref, top, dir) {
 		char *ptr = (char *)b6_cast_of(ref, struct b6_chunk, tref);
@@ -49,7 +81,10 @@ static struct b6_chunk *allocate_chunk(struct b6_pool *pool)
 	struct b6_chunk *chunk = pool->free;
 
 	if (chunk == NULL)
-		return b6_allocate(pool->allocator, pool->chunk_size);
+		return pool->mask ?
+			b6_allocate_aligned(pool->allocator, pool->chunk_size,
+					    pool->chunk_size) :
+			b6_allocate(pool->allocator, pool->chunk_size);
 
 	pool->free = NULL;
 
@@ -69,6 +104,9 @@ static struct b6_chunk *find_chunk(struct b6_pool *pool, void *ptr)
 	struct b6_tref *ref, *top;
 	int dir;
 
+	if (pool->mask)
+		return (struct b6_chunk *)((unsigned long int)ptr & pool->mask);
+
 	b6_tree_search(&pool->tree, ref, top, dir) {
 		struct b6_chunk *chunk = b6_cast_of(ref, struct b6_chunk, tref);
 		if ((char *)chunk > (char *)ptr)
@@ -82,14 +120,59 @@ static struct b6_chunk *find_chunk(struct b6_pool *pool, void *ptr)
 	return NULL;
 }
 
-void *b6_pool_get(struct b6_pool *pool)
+/* Free objects of guarded pools are marked after their link then poisoned. */
+#define FREE_MARK 0x46726565b6b6b6b6UL
+
+static void check_not_queued(struct b6_deque *queue, const void *ptr)
 {
-	struct b6_chunk *chunk;
-	void *ptr;
+	const struct b6_sref *sref;
+
+	for (sref = b6_deque_first(queue); sref != b6_deque_tail(queue);
+	     sref = b6_deque_walk(queue, sref, B6_NEXT))
+		b6_check(sref != ptr);
+}
+
+/* Objects being released along with ptr but not queued yet are in run. */
+static void poison_object(struct b6_pool *pool, struct b6_chunk *chunk,
+			  void *ptr, struct b6_deque *run)
+{
+	unsigned long int *mark = (unsigned long int *)ptr + 1;
+
+	b6_check(chunk && chunk->used);
+
+	if (pool->size < 2 * sizeof(*mark))
+		return;
+
+	/* Being marked is a hint the object is free already. */
+	if (*mark == FREE_MARK) {
+		check_not_queued(&pool->queue, ptr);
+		if (run)
+			check_not_queued(run, ptr);
+	}
+
+	*mark = FREE_MARK;
+	__builtin_memset(mark + 1, B6_GUARD_POISON,
+			 pool->size - 2 * sizeof(*mark));
+}
+
+static void check_poison(struct b6_pool *pool, void *ptr)
+{
+	unsigned long int *mark = (unsigned long int *)ptr + 1;
+
+	if (pool->size < 2 * sizeof(*mark))
+		return;
 
+	b6_check(*mark == FREE_MARK);
+	b6_check(b6_guard_poisoned(mark + 1, pool->size - 2 * sizeof(*mark)));
+	__builtin_memset(mark, B6_GUARD_POISON, sizeof(*mark));
+}
+
+static void *recycle_object(struct b6_pool *pool)
+{
 	/* First check whether something is available. */
 	while (!b6_deque_empty(&pool->queue)) {
 		/* Get the next free item and find the chunk it belongs to. */
+		struct b6_chunk *chunk;
 		struct b6_sref *sref;
 
 		sref = b6_deque_del_first(&pool->queue);
@@ -98,7 +181,10 @@ void *b6_pool_get(struct b6_pool *pool)
 		b6_assert(chunk);
 
 		if (!chunk->flag) {
+			if (b6_unlikely(pool->guarded))
+				check_poison(pool, sref);
 			chunk->used += 1;
+			count_event(pool, recycled, 1);
 			return sref;
 		}
 
@@ -109,30 +195,195 @@ void *b6_pool_get(struct b6_pool *pool)
 		if (chunk->free == pool->chunk_size - sizeof(*chunk)) {
 			finalize_chunk(pool, chunk);
 			release_chunk(pool, chunk);
+			if (pool->nempty)
+				pool->nempty -= 1;
 		}
 	}
 
-	/* Nothing found: Bummer! We have to allocate a new object. */
+	return NULL;
+}
+
+/* Return how many objects can be carved out of the current chunk. */
+static unsigned reserve_objects(struct b6_pool *pool)
+{
+	struct b6_chunk *chunk;
+
 	if (!pool->curr || pool->curr->index + pool->size > pool->chunk_size) {
 		/* A new chunk must be allocated. */
 		chunk = allocate_chunk(pool);
 
 		if (!chunk)
-			return NULL;
+			return 0;
+
+		count_event(pool, grown, 1);
 
 		initialize_chunk(pool, chunk);
 		pool->curr = chunk;
 	}
 
+	return (pool->chunk_size - pool->curr->index) / pool->size;
+}
+
+void *b6_pool_get(struct b6_pool *pool)
+{
+	void *ptr;
+
+	if ((ptr = recycle_object(pool))) {
+		count_objects(pool, 1);
+		return ptr;
+	}
+
+	/* Nothing found: Bummer! We have to allocate a new object. */
+	if (!reserve_objects(pool))
+		return NULL;
+
 	/* Allocate a ptr within the chunk. */
 	ptr = ((char *)pool->curr) + pool->curr->index;
 	pool->curr->used += 1;
 	pool->curr->free -= pool->size;
 	pool->curr->index += pool->size;
+	count_objects(pool, 1);
+	count_event(pool, carved, 1);
 
 	return ptr;
 }
 
+unsigned long int b6_pool_get_n(struct b6_pool *pool, void **ptrs,
+				unsigned long int n)
+{
+	unsigned long int i = 0;
+
+	while (i < n && (ptrs[i] = recycle_object(pool)))
+		i += 1;
+
+	while (i < n) {
+		unsigned long int count = reserve_objects(pool);
+		char *ptr;
+
+		if (!count)
+			break;
+		if (count > n - i)
+			count = n - i;
+		count_event(pool, carved, count);
+
+		/* Carve a run of objects within the chunk. */
+		ptr = ((char *)pool->curr) + pool->curr->index;
+		pool->curr->used += count;
+		pool->curr->free -= count * pool->size;
+		pool->curr->index += count * pool->size;
+		while (count--) {
+			ptrs[i++] = ptr;
+			ptr += pool->size;
+		}
+	}
+
+	count_objects(pool, i);
+
+	return i;
+}
+
+/* Chunks to release in b6_pool_trim. */
+#define TRIM_FLAG 2
+
+/* Returns how many bytes were released, and in work how many chunks and free
+ * objects were gone through. */
+static unsigned long int trim(struct b6_pool *pool,
+			      unsigned long int keep_bytes,
+			      unsigned long int *work)
+{
+	unsigned long int kept = 0, released = 0;
+	struct b6_dref *dref;
+	struct b6_sref *prev, *sref;
+
+	pool->nempty = 0;
+	*work = 0;
+
+	/* The cached free chunk is kept first. */
+	if (pool->free) {
+		if (pool->chunk_size <= keep_bytes)
+			kept += pool->chunk_size;
+		else {
+			b6_deallocate(pool->allocator, pool->free);
+			pool->free = NULL;
+			released += pool->chunk_size;
+		}
+	}
+
+	/* Chunks to keep are used again, the others are marked. Chunks which
+	 * objects were dropped from the queue already (see recycle_object)
+	 * cannot be used again without losing them: they are released. */
+	for (dref = b6_list_first(&pool->list);
+	     dref != b6_list_tail(&pool->list);
+	     dref = b6_list_walk(dref, B6_NEXT)) {
+		struct b6_chunk *chunk = b6_cast_of(dref, struct b6_chunk, dref);
+		*work += 1;
+		if (chunk->used)
+			continue;
+		if (kept + pool->chunk_size <= keep_bytes &&
+		    chunk->free + chunk->index == pool->chunk_size) {
+			kept += pool->chunk_size;
+			chunk->flag = 0;
+		} else
+			chunk->flag = TRIM_FLAG;
+	}
+
+	/* Filter out objects of marked chunks from the queue. */
+	prev = b6_deque_head(&pool->queue);
+	while ((sref = b6_deque_walk(&pool->queue, prev, B6_NEXT)) !=
+	       b6_deque_tail(&pool->queue)) {
+		*work += 1;
+		if (find_chunk(pool, sref)->flag == TRIM_FLAG)
+			b6_deque_del_after(&pool->queue, prev);
+		else
+			prev = sref;
+	}
+
+	/* Release marked chunks. */
+	dref = b6_list_first(&pool->list);
+	while (dref != b6_list_tail(&pool->list)) {
+		struct b6_chunk *chunk = b6_cast_of(dref, struct b6_chunk, dref);
+		dref = b6_list_walk(dref, B6_NEXT);
+		if (chunk->flag != TRIM_FLAG)
+			continue;
+		finalize_chunk(pool, chunk);
+		b6_deallocate(pool->allocator, chunk);
+		released += pool->chunk_size;
+	}
+
+	return released;
+}
+
+unsigned long int b6_pool_trim(struct b6_pool *pool,
+			       unsigned long int keep_bytes)
+{
+	unsigned long int work;
+
+	return trim(pool, keep_bytes, &work);
+}
+
+void b6_pool_set_threshold(struct b6_pool *pool, unsigned long int threshold)
+{
+	pool->threshold = threshold;
+	pool->trigger = 2 * threshold;
+	pool->nempty = 0;
+}
+
+/* Trimming waits for twice the threshold, so that chunks emptied and filled
+ * again around it do not trim each time, and for as many objects released
+ * in emptied chunks as the last trim went through, which pay for it. */
+static void count_empty_chunks(struct b6_pool *pool, unsigned long int n)
+{
+	unsigned long int work;
+
+	pool->nempty += n;
+	if (pool->nempty * pool->chunk_size <= pool->trigger)
+		return;
+	trim(pool, pool->threshold, &work);
+	pool->trigger = work * pool->size;
+	if (pool->trigger < 2 * pool->threshold)
+		pool->trigger = 2 * pool->threshold;
+}
+
 void b6_pool_put(struct b6_pool *pool, void *ptr)
 {
 	struct b6_chunk *chunk;
@@ -141,9 +392,70 @@ void b6_pool_put(struct b6_pool *pool, void *ptr)
 	chunk = find_chunk(pool, ptr);
 	sref = (struct b6_sref *)ptr;
 
+	if (b6_unlikely(pool->guarded))
+		poison_object(pool, chunk, ptr, NULL);
+
 	b6_deque_add_first(&pool->queue, sref);
 	chunk->used -= 1;
 	chunk->flag = (chunk->used == 0);
+	count_objects(pool, -1);
+
+	if (b6_unlikely(chunk->flag) && pool->threshold)
+		count_empty_chunks(pool, 1);
+}
+
+void b6_pool_put_n(struct b6_pool *pool, void **ptrs, unsigned long int n)
+{
+	struct b6_deque run;
+	unsigned long int i, nempty = 0;
+
+	/* Queue objects together, then put them ahead of the queue at once. */
+	b6_deque_initialize(&run);
+	for (i = 0; i < n; i += 1) {
+		struct b6_chunk *chunk = find_chunk(pool, ptrs[i]);
+		if (b6_unlikely(pool->guarded))
+			poison_object(pool, chunk, ptrs[i], &run);
+		chunk->used -= 1;
+		chunk->flag = (chunk->used == 0);
+		nempty += chunk->flag;
+		b6_deque_add_last(&run, (struct b6_sref *)ptrs[i]);
+	}
+	b6_deque_extend(&run, &pool->queue);
+	b6_deque_extend(&pool->queue, &run);
+	count_objects(pool, -n);
+
+	/* Trim once every object is queued. */
+	if (nempty && pool->threshold)
+		count_empty_chunks(pool, nempty);
+}
+
+void b6_pool_stats(const struct b6_pool *pool, struct b6_pool_stats *stats)
+{
+	const struct b6_dref *dref;
+	const struct b6_sref *sref;
+
+	stats->objects = 0;
+	stats->chunks = 0;
+	stats->flagged = 0;
+	for (dref = b6_list_first(&pool->list);
+	     dref != b6_list_tail(&pool->list);
+	     dref = b6_list_walk(dref, B6_NEXT)) {
+		const struct b6_chunk *chunk =
+			b6_cast_of(dref, struct b6_chunk, dref);
+		stats->objects += chunk->used;
+		stats->chunks += 1;
+		stats->flagged += !!chunk->flag;
+	}
+
+	stats->queued = 0;
+	for (sref = b6_deque_first(&pool->queue);
+	     sref != b6_deque_tail(&pool->queue);
+	     sref = b6_deque_walk(&pool->queue, sref, B6_NEXT))
+		stats->queued += 1;
+
+	stats->reserved = (stats->chunks + !!pool->free) * pool->chunk_size;
+	stats->used = stats->objects * pool->size;
+	stats->counters = pool->counters;
 }
 
 void b6_pool_finalize(struct b6_pool *pool)
@@ -179,45 +491,111 @@ static void b6_pool_deallocate(struct b6_allocator *self, void *ptr)
 	b6_pool_put(pool, ptr);
 }
 
-int b6_pool_initialize(struct b6_pool *pool, struct b6_allocator *allocator,
-		       unsigned size, unsigned chunk_size)
+static unsigned long int b6_pool_allocate_n(struct b6_allocator *self,
+					    unsigned long int size,
+					    void **ptrs, unsigned long int n)
 {
-	static const struct b6_allocator_ops ops = {
-		.allocate = b6_pool_allocate,
-		.reallocate = b6_pool_reallocate,
-		.deallocate = b6_pool_deallocate,
-	};
+	struct b6_pool *pool = b6_cast_of(self, struct b6_pool, parent);
+	return size > pool->size ? 0 : b6_pool_get_n(pool, ptrs, n);
+}
 
-	if (!allocator) return -1;
-	if (!size) return -1;
+static void b6_pool_deallocate_n(struct b6_allocator *self, void **ptrs,
+				 unsigned long int n)
+{
+	struct b6_pool *pool = b6_cast_of(self, struct b6_pool, parent);
+	b6_pool_put_n(pool, ptrs, n);
+}
+
+static const struct b6_allocator_ops b6_pool_ops = {
+	.allocate = b6_pool_allocate,
+	.reallocate = b6_pool_reallocate,
+	.deallocate = b6_pool_deallocate,
+	.allocate_n = b6_pool_allocate_n,
+	.deallocate_n = b6_pool_deallocate_n,
+};
 
+static unsigned align_size(unsigned size)
+{
 	/* align the size of a ptr to a multiple of queue_node */
 	b6_static_assert(sizeof(struct b6_sref) == sizeof(void*));
 	b6_static_assert(__b6_is_apot(sizeof(void*)));
 	size = (size + (sizeof(void*) - 1)) & ~(sizeof(void*) - 1);
 	b6_assert(!(size % sizeof(struct b6_sref)));
+	return size;
+}
+
+static void setup_pool(struct b6_pool *pool, struct b6_allocator *allocator,
+		       unsigned size, unsigned chunk_size,
+		       unsigned long int mask)
+{
+	pool->parent.ops = &b6_pool_ops;
+	pool->chunk_size = chunk_size;
+	pool->size = size;
+	pool->mask = mask;
+	pool->curr = NULL;
+	pool->free = NULL;
+	pool->allocator = allocator;
+	pool->guarded = b6_is_guard(allocator);
+	pool->threshold = 0;
+	pool->trigger = 0;
+	pool->nempty = 0;
+	__builtin_memset(&pool->counters, 0, sizeof(pool->counters));
+	b6_deque_initialize(&pool->queue);
+	b6_list_initialize(&pool->list);
+	b6_tree_initialize(&pool->tree, &b6_tree_avl_ops);
+}
+
+int b6_pool_initialize(struct b6_pool *pool, struct b6_allocator *allocator,
+		       unsigned size, unsigned chunk_size)
+{
+	if (!allocator) return -1;
+	if (!size) return -1;
+	if (size > ~0U - (sizeof(void*) - 1)) return -1;
+
+	size = align_size(size);
 
 	/* calculate and/or check chunk_size */
 	b6_static_assert(sizeof(struct b6_chunk) < 4096 - sizeof(void*));
 	if (!chunk_size) {
 		for (chunk_size = 4096; chunk_size - sizeof(struct b6_chunk) -
 		     sizeof(void*) < size; chunk_size *= 2)
-			if (!chunk_size)
+			if (chunk_size > ~0U / 2)
 				return -1;
 		chunk_size -= sizeof(void*);
 	} else if (chunk_size < sizeof(struct b6_chunk) ||
 		   chunk_size - sizeof(struct b6_chunk) < size)
 		return -1;
 
-	pool->parent.ops = &ops;
-	pool->chunk_size = chunk_size;
-	pool->size = size;
-	pool->curr = NULL;
-	pool->free = NULL;
-	pool->allocator = allocator;
-	b6_deque_initialize(&pool->queue);
-	b6_list_initialize(&pool->list);
-	b6_tree_initialize(&pool->tree, &b6_tree_avl_ops);
+	setup_pool(pool, allocator, size, chunk_size, 0);
+
+	return 0;
+}
+
+int b6_pool_initialize_aligned(struct b6_pool *pool,
+			       struct b6_allocator *allocator,
+			       unsigned size, unsigned chunk_size)
+{
+	if (!allocator) return -1;
+	if (!allocator->ops->allocate_aligned) return -1;
+	if (!size) return -1;
+	if (size > ~0U - (sizeof(void*) - 1)) return -1;
+
+	size = align_size(size);
+
+	/* no room is left for the underlying allocator as chunks are aligned */
+	if (!chunk_size) {
+		for (chunk_size = 4096;
+		     chunk_size - sizeof(struct b6_chunk) < size;
+		     chunk_size *= 2)
+			if (chunk_size > ~0U / 2)
+				return -1;
+	} else if (!b6_is_apot(chunk_size) ||
+		   chunk_size < sizeof(struct b6_chunk) ||
+		   chunk_size - sizeof(struct b6_chunk) < size)
+		return -1;
+
+	setup_pool(pool, allocator, size, chunk_size,
+		   ~((unsigned long int)chunk_size - 1));
 
 	return 0;
 }
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2015, Arnaud TROEL
+ * See LICENSE file for license details.
+ */
+
+#include "b6/slab.h"
+
+/* Large objects have a header that records them in the tree of the slab. */
+struct large_object {
+	struct b6_tref tref;
+	unsigned long int size;
+};
+
+#define LARGE_OBJECT_OFFSET \
+	((sizeof(struct large_object) + 15) & ~15UL)
+
+static unsigned long int class_size(unsigned int i)
+{
+	unsigned int bits = 4 + (i - 1) / 2;
+	if (!i)
+		return 16;
+	return (i - 1) & 1 ? 1UL << (bits + 1) : 3UL << (bits - 1);
+}
+
+static struct b6_chunk *find_chunk(const struct b6_slab *self, void *ptr)
+{
+	return (struct b6_chunk*)((unsigned long int)ptr & self->mask);
+}
+
+static struct large_object *find_large(struct b6_slab *self, void *ptr,
+				       struct b6_tref **top, int *dir)
+{
+	struct b6_tref *ref;
+	b6_tree_search(&self->tree, ref, *top, *dir) {
+		struct large_object *large =
+			b6_cast_of(ref, struct large_object, tref);
+		char *addr = (char*)large + LARGE_OBJECT_OFFSET;
+		if ((char*)ptr < addr)
+			*dir = B6_PREV;
+		else if ((char*)ptr > addr)
+			*dir = B6_NEXT;
+		else
+			return large;
+	}
+	return NULL;
+}
+
+static void *allocate_large(struct b6_slab *self, unsigned long int size)
+{
+	struct large_object *large;
+	struct b6_tref *top;
+	int dir;
+	void *ptr;
+	if (size > ~0UL - LARGE_OBJECT_OFFSET)
+		return NULL;
+	if (!(large = b6_allocate(self->allocator, LARGE_OBJECT_OFFSET + size)))
+		return NULL;
+	large->size = size;
+	ptr = (char*)large + LARGE_OBJECT_OFFSET;
+	find_large(self, ptr, &top, &dir);
+	b6_tree_add(&self->tree, top, dir, &large->tref);
+	return ptr;
+}
+
+static void deallocate_large(struct b6_slab *self, struct b6_tref *top,
+			     int dir)
+{
+	struct b6_tref *tref = b6_tree_del(&self->tree, top, dir);
+	b6_deallocate(self->allocator,
+		      b6_cast_of(tref, struct large_object, tref));
+}
+
+static void *b6_slab_allocate(struct b6_allocator *up, unsigned long int size)
+{
+	struct b6_slab *self = b6_cast_of(up, struct b6_slab, parent);
+	unsigned int i = b6_slab_class(size);
+	if (i < B6_SLAB_CLASSES)
+		return b6_pool_get(&self->pools[i]);
+	return allocate_large(self, size);
+}
+
+static void b6_slab_deallocate(struct b6_allocator *up, void *ptr)
+{
+	struct b6_slab *self = b6_cast_of(up, struct b6_slab, parent);
+	struct b6_tref *top;
+	int dir;
+	/* Large objects are not in chunks, masking their address is unsafe. */
+	if (find_large(self, ptr, &top, &dir))
+		deallocate_large(self, top, dir);
+	else
+		b6_pool_put(find_chunk(self, ptr)->pool, ptr);
+}
+
+static void *b6_slab_reallocate(struct b6_allocator *up, void *ptr,
+				unsigned long int size)
+{
+	struct b6_slab *self = b6_cast_of(up, struct b6_slab, parent);
+	struct large_object *large;
+	struct b6_tref *top;
+	unsigned int i = b6_slab_class(size);
+	unsigned long int len;
+	int dir;
+	void *dst;
+	if ((large = find_large(self, ptr, &top, &dir))) {
+		if (i == B6_SLAB_CLASSES && size <= large->size)
+			return ptr;
+		len = large->size;
+	} else {
+		struct b6_pool *pool = find_chunk(self, ptr)->pool;
+		if (pool == &self->pools[i])
+			return ptr;
+		len = pool->size;
+	}
+	if (!(dst = b6_slab_allocate(up, size)))
+		return NULL;
+	__builtin_memcpy(dst, ptr, len < size ? len : size);
+	b6_slab_deallocate(up, ptr);
+	return dst;
+}
+
+int b6_slab_initialize(struct b6_slab *self, struct b6_allocator *allocator,
+		       unsigned chunk_size)
+{
+	static const struct b6_allocator_ops ops = {
+		.allocate = b6_slab_allocate,
+		.reallocate = b6_slab_reallocate,
+		.deallocate = b6_slab_deallocate,
+	};
+	unsigned int i;
+	if (!chunk_size)
+		chunk_size = 65536;
+	for (i = 0; i < B6_SLAB_CLASSES; i += 1)
+		if (b6_pool_initialize_aligned(&self->pools[i], allocator,
+					       class_size(i), chunk_size))
+			return -1;
+	self->parent.ops = &ops;
+	self->allocator = allocator;
+	self->chunk_size = chunk_size;
+	self->mask = ~((unsigned long int)chunk_size - 1);
+	b6_tree_initialize(&self->tree, &b6_tree_avl_ops);
+	return 0;
+}
+
+void b6_slab_finalize(struct b6_slab *self)
+{
+	unsigned int i;
+	for (i = 0; i < B6_SLAB_CLASSES; i += 1)
+		b6_pool_finalize(&self->pools[i]);
+	while (!b6_tree_empty(&self->tree)) {
+		struct b6_tref *top;
+		int dir;
+		b6_tree_top(&self->tree, &top, &dir);
+		deallocate_large(self, top, dir);
+	}
+}
@@ -0,0 +1,149 @@
+#include "b6/arena.h"
+#include "b6/array.h"
+#include "b6/json.h"
+#include "stdalloc.h"
+#include "test.h"
+
+#include <string.h>
+
+static int bump()
+{
+	struct b6_arena arena;
+	char *a, *b;
+	int retval = 1;
+	b6_arena_initialize(&arena, &stdalloc, 256);
+	a = b6_allocate(&arena.parent, 10);
+	b = b6_allocate(&arena.parent, 10);
+	if (!a || !b || b - a != 16)
+		retval = 0;
+	/* larger than a block */
+	if (!(a = b6_allocate(&arena.parent, 1000)))
+		retval = 0;
+	memset(a, 0, 1000);
+	if ((unsigned long int)b6_allocate_aligned(&arena.parent, 8, 128) & 127)
+		retval = 0;
+	b6_arena_finalize(&arena);
+	return retval;
+}
+
+static int reallocate_last_in_place()
+{
+	struct b6_arena arena;
+	char *a, *b;
+	int retval = 1;
+	b6_arena_initialize(&arena, &stdalloc, 256);
+	a = b6_allocate(&arena.parent, 10);
+	strcpy(a, "hello");
+	if ((b = b6_reallocate(&arena.parent, a, 100)) != a)
+		retval = 0;
+	b = b6_allocate(&arena.parent, 10);
+	/* a is not the latest allocation anymore: it has to move */
+	if ((b = b6_reallocate(&arena.parent, a, 120)) == a || strcmp(b, "hello"))
+		retval = 0;
+	/* the latest allocation moves when it does not fit anymore */
+	if (!(a = b6_reallocate(&arena.parent, b, 1000)) || strcmp(a, "hello"))
+		retval = 0;
+	b6_arena_finalize(&arena);
+	return retval;
+}
+
+static int deallocate_last()
+{
+	struct b6_arena arena;
+	char *a, *b;
+	b6_arena_initialize(&arena, &stdalloc, 256);
+	a = b6_allocate(&arena.parent, 10);
+	b6_deallocate(&arena.parent, a);
+	b = b6_allocate(&arena.parent, 10);
+	b6_arena_finalize(&arena);
+	return a == b;
+}
+
+static int release_to_mark()
+{
+	struct b6_arena arena;
+	struct b6_arena_mark empty, mark;
+	char *a, *b;
+	int i, retval = 1;
+	b6_arena_initialize(&arena, &stdalloc, 256);
+	b6_arena_mark(&arena, &empty);
+	b6_allocate(&arena.parent, 10);
+	b6_arena_mark(&arena, &mark);
+	a = b6_allocate(&arena.parent, 10);
+	for (i = 0; i < 100; i += 1)
+		b6_allocate(&arena.parent, 100);
+	b6_arena_release_to_mark(&arena, &mark);
+	b = b6_allocate(&arena.parent, 10);
+	if (a != b)
+		retval = 0;
+	b6_arena_release_to_mark(&arena, &empty);
+	if (arena.block)
+		retval = 0;
+	b6_arena_finalize(&arena);
+	return retval;
+}
+
+static int array()
+{
+	struct b6_arena arena;
+	struct b6_array a, b;
+	unsigned long int i;
+	int retval = 1;
+	b6_arena_initialize(&arena, &stdalloc, 0);
+	b6_array_initialize(&a, &arena.parent, sizeof(i));
+	b6_array_initialize(&b, &arena.parent, sizeof(i));
+	for (i = 0; i < 10000; i += 1) {
+		*(unsigned long int*)b6_array_extend(&a, 1) = i;
+		*(unsigned long int*)b6_array_extend(&b, 1) = ~i;
+	}
+	for (i = 0; i < 10000; i += 1)
+		if (*(unsigned long int*)b6_array_get(&a, i) != i ||
+		    *(unsigned long int*)b6_array_get(&b, i) != ~i)
+			retval = 0;
+	b6_arena_finalize(&arena);
+	return retval;
+}
+
+static int drop_json_document()
+{
+	struct b6_arena arena;
+	struct b6_arena_mark mark;
+	struct b6_json_default_impl impl;
+	struct b6_json json;
+	struct b6_json_object *object;
+	int i, retval = 1;
+	b6_arena_initialize(&arena, &stdalloc, 0);
+	b6_arena_mark(&arena, &mark);
+	b6_json_default_impl_initialize(&impl, &arena.parent);
+	b6_json_initialize(&json, &impl.up, &arena.parent);
+	if (!(object = b6_json_new_object(&json)))
+		retval = 0;
+	for (i = 0; retval && i < 1000; i += 1) {
+		struct b6_json_number *number = b6_json_new_number(&json, i);
+		char key[16];
+		struct b6_utf8 utf8;
+		sprintf(key, "%d", i);
+		if (!number || b6_json_set_object(object,
+						  b6_utf8_from_ascii(&utf8, key),
+						  &number->up))
+			retval = 0;
+	}
+	b6_arena_release_to_mark(&arena, &mark);
+	if (arena.block)
+		retval = 0;
+	b6_arena_finalize(&arena);
+	return retval;
+}
+
+int main(int argc, const char *argv[])
+{
+	test_init();
+	test_exec(bump,);
+	test_exec(reallocate_last_in_place,);
+	test_exec(deallocate_last,);
+	test_exec(release_to_mark,);
+	test_exec(array,);
+	test_exec(drop_json_document,);
+	test_exit();
+	return 0;
+}
@@ -0,0 +1,125 @@
+#include "b6/concurrent.h"
+#include "b6/pool.h"
+#include "stdalloc.h"
+#include "test.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+static int allocate_deallocate()
+{
+	struct b6_concurrent_allocator shared;
+	struct b6_allocator *allocator;
+	void *ptr[100], *tmp;
+	int i, retval = 1;
+	b6_concurrent_allocator_initialize(&shared, &stdalloc, &stdalloc);
+	if (!(allocator = b6_concurrent_attach(&shared)))
+		return 0;
+	for (i = 0; i < b6_card_of(ptr); i += 1)
+		if (!(ptr[i] = b6_allocate(allocator, i * 10)) ||
+		    (unsigned long int)ptr[i] & 15)
+			retval = 0;
+		else
+			*(int *)ptr[i] = i;
+	/* same bin: in place */
+	if (b6_reallocate(allocator, ptr[1], 16) != ptr[1])
+		retval = 0;
+	if (!(tmp = b6_reallocate(allocator, ptr[1], 1000)) ||
+	    *(int *)tmp != 1)
+		retval = 0;
+	ptr[1] = tmp;
+	for (i = 0; i < b6_card_of(ptr); i += 1)
+		b6_deallocate(allocator, ptr[i]);
+	/* the latest block released is the first to be allocated again */
+	if (b6_allocate(allocator, 300) != ptr[30])
+		retval = 0;
+	b6_deallocate(allocator, ptr[30]);
+	b6_concurrent_detach(allocator);
+	b6_concurrent_allocator_finalize(&shared);
+	return retval;
+}
+
+/* Single producer single consumer ring of messages. */
+#define RING 256
+#define MESSAGES 100000
+
+struct ring {
+	struct b6_concurrent_allocator *shared;
+	long int *slots[RING];
+	unsigned long int head, tail;
+};
+
+static void *producer(void *arg)
+{
+	struct ring *ring = arg;
+	struct b6_allocator *allocator = b6_concurrent_attach(ring->shared);
+	long int i, *msg;
+	if (!allocator)
+		return NULL;
+	for (i = 0; i < MESSAGES; i += 1) {
+		if (!(msg = b6_allocate(allocator, sizeof(*msg))))
+			return NULL;
+		*msg = i;
+		while (ring->tail -
+		       __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == RING)
+			sched_yield();
+		ring->slots[ring->tail % RING] = msg;
+		__atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+	}
+	b6_concurrent_detach(allocator);
+	return (void *)1;
+}
+
+static void *consumer(void *arg)
+{
+	struct ring *ring = arg;
+	struct b6_allocator *allocator = b6_concurrent_attach(ring->shared);
+	long int i, *msg, retval = 1;
+	if (!allocator)
+		return NULL;
+	for (i = 0; i < MESSAGES; i += 1) {
+		while (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) ==
+		       ring->head)
+			sched_yield();
+		msg = ring->slots[ring->head % RING];
+		__atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+		if (*msg != i)
+			retval = 0;
+		b6_deallocate(allocator, msg);
+	}
+	b6_concurrent_detach(allocator);
+	return (void *)retval;
+}
+
+static int producer_consumer()
+{
+	struct b6_pool pool;
+	struct b6_concurrent_allocator shared;
+	struct ring ring = { .shared = &shared, .head = 0, .tail = 0, };
+	pthread_t threads[2];
+	void *retval;
+	int ok = 1;
+	if (b6_pool_initialize_aligned(&pool, &stdalloc,
+				       B6_CONCURRENT_SIZE(sizeof(long int)),
+				       0))
+		return 0;
+	b6_concurrent_allocator_initialize(&shared, &pool.parent, &stdalloc);
+	pthread_create(&threads[0], NULL, producer, &ring);
+	pthread_create(&threads[1], NULL, consumer, &ring);
+	pthread_join(threads[0], &retval);
+	ok &= !!retval;
+	pthread_join(threads[1], &retval);
+	ok &= !!retval;
+	b6_concurrent_allocator_finalize(&shared);
+	b6_pool_finalize(&pool);
+	return ok;
+}
+
+int main(int argc, const char *argv[])
+{
+	test_init();
+	test_exec(allocate_deallocate,);
+	test_exec(producer_consumer,);
+	test_exit();
+	return 0;
+}
@@ -0,0 +1,183 @@
+#include "b6/guard.h"
+#include "b6/pool.h"
+#include "b6/array.h"
+#include "stdalloc.h"
+#include "test.h"
+
+#include <string.h>
+
+/* Evaluate to true if statement fails a check. */
+#define fails(statement) ({						\
+	jmp_buf *_prev = test_handler, _env;				\
+	int _failed = 1;						\
+	test_handler = &_env;						\
+	if (!setjmp(_env)) {						\
+		statement;						\
+		_failed = 0;						\
+	}								\
+	test_handler = _prev;						\
+	_failed;							\
+})
+
+static int live_allocations()
+{
+	struct b6_guard guard;
+	struct b6_guard_block *block;
+	void *a, *b, *c;
+	int retval = 1;
+	b6_guard_initialize(&guard, &stdalloc, 1024);
+	a = b6_allocate(&guard.parent, 10);
+	b = b6_allocate(&guard.parent, 20);
+	c = b6_allocate_aligned(&guard.parent, 30, 256);
+	if (!a || !b || !c || (unsigned long int)c & 255)
+		retval = 0;
+	b6_deallocate(&guard.parent, b);
+	if (!(block = b6_guard_first(&guard)) ||
+	    b6_guard_block_ptr(block) != a || block->size != 10 ||
+	    !block->site)
+		retval = 0;
+	if (!(block = b6_guard_next(&guard, block)) ||
+	    b6_guard_block_ptr(block) != c || block->size != 30)
+		retval = 0;
+	if (b6_guard_next(&guard, block))
+		retval = 0;
+	if (b6_guard_finalize(&guard) != 2)
+		retval = 0;
+	return retval;
+}
+
+static int double_free()
+{
+	struct b6_guard guard;
+	void *a;
+	int retval = 1;
+	b6_guard_initialize(&guard, &stdalloc, 1024);
+	a = b6_allocate(&guard.parent, 10);
+	b6_deallocate(&guard.parent, a);
+	if (!fails(b6_deallocate(&guard.parent, a)))
+		retval = 0;
+	b6_guard_finalize(&guard);
+	return retval;
+}
+
+static int overflow()
+{
+	struct b6_guard guard;
+	char *a;
+	int retval = 1;
+	b6_guard_initialize(&guard, &stdalloc, 0);
+	a = b6_allocate(&guard.parent, 10);
+	a[10] = 0;
+	if (!fails(b6_deallocate(&guard.parent, a)))
+		retval = 0;
+	a[10] = 0xfd;
+	a[-1] = 0;
+	if (!fails(b6_reallocate(&guard.parent, a, 20)))
+		retval = 0;
+	a[-1] = 0xfd;
+	b6_deallocate(&guard.parent, a);
+	b6_guard_finalize(&guard);
+	return retval;
+}
+
+static int use_after_free()
+{
+	struct b6_guard guard;
+	char *a, *b;
+	int retval = 1;
+	b6_guard_initialize(&guard, &stdalloc, 64);
+	a = b6_allocate(&guard.parent, 32);
+	b = b6_allocate(&guard.parent, 48);
+	b6_deallocate(&guard.parent, a);
+	a[5] = 0;
+	/* a leaves the quarantine */
+	if (!fails(b6_deallocate(&guard.parent, b)))
+		retval = 0;
+	b6_guard_finalize(&guard);
+	return retval;
+}
+
+static int array()
+{
+	struct b6_guard guard;
+	struct b6_array array;
+	unsigned int i;
+	int retval = 1;
+	b6_guard_initialize(&guard, &stdalloc, 4096);
+	b6_array_initialize(&array, &guard.parent, sizeof(i));
+	for (i = 0; i < 1000; i += 1) {
+		unsigned int *ptr = b6_array_extend(&array, 1);
+		if (!ptr) {
+			retval = 0;
+			break;
+		}
+		*ptr = i;
+	}
+	for (i = 0; i < 1000 && retval; i += 1)
+		if (*(unsigned int *)b6_array_get(&array, i) != i)
+			retval = 0;
+	b6_array_finalize(&array);
+	if (b6_guard_finalize(&guard))
+		retval = 0;
+	return retval;
+}
+
+static int pool()
+{
+	struct b6_guard guard;
+	struct b6_pool pool;
+	unsigned long int *a, *b;
+	int retval = 1;
+	b6_guard_initialize(&guard, &stdalloc, 0);
+	if (b6_pool_initialize_aligned(&pool, &guard.parent, 32, 1024))
+		return 0;
+	a = b6_pool_get(&pool);
+	b = b6_pool_get(&pool);
+	b6_pool_put(&pool, a);
+	if (!fails(b6_pool_put(&pool, a)))
+		retval = 0;
+	a[2] = 0;
+	if (!fails(b6_pool_get(&pool)))
+		retval = 0;
+	b6_pool_put(&pool, b);
+	b6_pool_finalize(&pool);
+	if (b6_guard_finalize(&guard))
+		retval = 0;
+	return retval;
+}
+
+static int pool_put_n()
+{
+	struct b6_guard guard;
+	struct b6_pool pool;
+	void *ptrs[3], *live;
+	int retval = 1;
+	b6_guard_initialize(&guard, &stdalloc, 0);
+	if (b6_pool_initialize_aligned(&pool, &guard.parent, 32, 1024))
+		return 0;
+	/* Twice in the same batch, while the chunk is still in use. */
+	ptrs[0] = ptrs[2] = b6_pool_get(&pool);
+	ptrs[1] = b6_pool_get(&pool);
+	live = b6_pool_get(&pool);
+	if (!ptrs[0] || !ptrs[1] || !live ||
+	    !fails(b6_pool_put_n(&pool, ptrs, 3)))
+		retval = 0;
+	b6_pool_finalize(&pool);
+	if (b6_guard_finalize(&guard))
+		retval = 0;
+	return retval;
+}
+
+int main(int argc, const char *argv[])
+{
+	test_init();
+	test_exec(live_allocations,);
+	test_exec(double_free,);
+	test_exec(overflow,);
+	test_exec(use_after_free,);
+	test_exec(array,);
+	test_exec(pool,);
+	test_exec(pool_put_n,);
+	test_exit();
+	return 0;
+}
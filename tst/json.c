@@ -0,0 +1,1711 @@
+#include "b6/json.h"
+#include "stdalloc.h"
+#include "test.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct string_istream {
+	struct b6_json_istream up;
+	const char *ptr;
+	unsigned long int len;
+};
+
+static long int string_istream_read(struct b6_json_istream *up, void *buf,
+				    unsigned long int len)
+{
+	struct string_istream *self =
+		b6_cast_of(up, struct string_istream, up);
+	if (len > self->len)
+		len = self->len;
+	memcpy(buf, self->ptr, len);
+	self->ptr += len;
+	self->len -= len;
+	return len;
+}
+
+static void setup_string_istream(struct string_istream *self, const char *s)
+{
+	static const struct b6_json_istream_ops ops = {
+		.read = string_istream_read,
+	};
+	b6_json_setup_istream(&self->up, &ops);
+	self->ptr = s;
+	self->len = strlen(s);
+}
+
+struct string_ostream {
+	struct b6_json_ostream up;
+	char buf[4096];
+	unsigned long int len;
+};
+
+static long int string_ostream_write(struct b6_json_ostream *up,
+				     const void *buf, unsigned long int len)
+{
+	struct string_ostream *self =
+		b6_cast_of(up, struct string_ostream, up);
+	if (len > sizeof(self->buf) - 1 - self->len)
+		return -1;
+	memcpy(self->buf + self->len, buf, len);
+	self->len += len;
+	self->buf[self->len] = '\0';
+	return len;
+}
+
+static int string_ostream_flush(struct b6_json_ostream *up)
+{
+	return 0;
+}
+
+static void setup_string_ostream(struct string_ostream *self)
+{
+	static const struct b6_json_ostream_ops ops = {
+		.write = string_ostream_write,
+		.flush = string_ostream_flush,
+	};
+	b6_json_setup_ostream(&self->up, &ops);
+	self->len = 0;
+	self->buf[0] = '\0';
+}
+
+static struct b6_json_default_impl impl;
+static struct b6_json json;
+
+static void setup(void)
+{
+	b6_json_default_impl_initialize(&impl, &stdalloc);
+	b6_json_initialize(&json, &impl.up, &stdalloc);
+}
+
+static void teardown(void)
+{
+	b6_json_finalize(&json);
+	b6_json_default_impl_finalize(&impl);
+}
+
+static struct b6_json_object *parse(const char *s)
+{
+	struct string_istream is;
+	struct b6_json_object *object = b6_json_new_object(&json);
+	setup_string_istream(&is, s);
+	if (object && b6_json_parse_object(object, &is.up, NULL)) {
+		b6_json_unref_value(&object->up);
+		object = NULL;
+	}
+	return object;
+}
+
+static int serialize(struct b6_json_object *object, const char *expected)
+{
+	struct string_ostream os;
+	struct b6_json_default_serializer serializer;
+	setup_string_ostream(&os);
+	b6_json_setup_default_serializer(&serializer);
+	if (b6_json_serialize_object(object, &os.up, &serializer.up))
+		return 0;
+	if (strcmp(os.buf, expected)) {
+		fprintf(stderr, "expected %s, got %s\n", expected, os.buf);
+		return 0;
+	}
+	return 1;
+}
+
+static int parse_nested()
+{
+	struct b6_json_object *root, *object;
+	struct b6_json_array *array;
+	struct b6_json_string *string;
+	int retval = 1;
+	setup();
+	root = parse("{ \"a\": [1, 2, {\"b\": \"c\"}], \"d\": null }");
+	if (!root)
+		retval = 0;
+	else if (!(array = b6_json_get_object_as(root, B6_UTF8("a"), array)))
+		retval = 0;
+	else if (b6_json_array_len(array) != 3)
+		retval = 0;
+	else if (!(object = b6_json_get_array_as(array, 2, object)))
+		retval = 0;
+	else if (!(string = b6_json_get_object_as(object, B6_UTF8("b"),
+						  string)))
+		retval = 0;
+	else if (b6_json_get_string(string)->nbytes != 1)
+		retval = 0;
+	if (root)
+		b6_json_unref_value(&root->up);
+	teardown();
+	return retval;
+}
+
+static int parse_many_keys()
+{
+	struct b6_json_object *object;
+	char buf[8192], *ptr = buf;
+	int i, retval = 1;
+	setup();
+	ptr += sprintf(ptr, "{");
+	for (i = 0; i < 500; i += 1)
+		ptr += sprintf(ptr, "%s\"key%d\": %d", i ? "," : "", i, i);
+	sprintf(ptr, "}");
+	if (!(object = parse(buf)))
+		retval = 0;
+	else {
+		for (i = 0; i < 500; i += 1) {
+			struct b6_json_number *number;
+			char key[16];
+			struct b6_utf8 utf8;
+			sprintf(key, "key%d", i);
+			b6_utf8_from_ascii(&utf8, key);
+			number = b6_json_get_object_as(object, &utf8, number);
+			if (!number || b6_json_get_number(number) != i)
+				retval = 0;
+		}
+		b6_json_unref_value(&object->up);
+	}
+	teardown();
+	return retval;
+}
+
+/* Deletes every third key then checks lookups and insertion order. */
+static int object_order()
+{
+	struct b6_json_object *object;
+	struct b6_json_iterator iter;
+	int i, n = 0, retval = 1;
+	setup();
+	if (!(object = b6_json_new_object(&json)))
+		retval = 0;
+	for (i = 0; retval && i < 300; i += 1) {
+		struct b6_json_number *number = b6_json_new_number(&json, i);
+		char key[16];
+		struct b6_utf8 utf8;
+		sprintf(key, "%d", (i * 7919) % 300);
+		b6_utf8_from_ascii(&utf8, key);
+		if (!number || b6_json_set_object(object, &utf8, &number->up))
+			retval = 0;
+	}
+	for (i = 0; retval && i < 300; i += 3) {
+		char key[16];
+		struct b6_utf8 utf8;
+		sprintf(key, "%d", (i * 7919) % 300);
+		b6_utf8_from_ascii(&utf8, key);
+		b6_json_del_object_at(object, &utf8);
+	}
+	for (i = 0; retval && i < 300; i += 1) {
+		struct b6_json_number *number;
+		char key[16];
+		struct b6_utf8 utf8;
+		sprintf(key, "%d", (i * 7919) % 300);
+		b6_utf8_from_ascii(&utf8, key);
+		number = b6_json_get_object_as(object, &utf8, number);
+		if (i % 3 ? !number || b6_json_get_number(number) != i :
+		    !!number)
+			retval = 0;
+	}
+	if (retval)
+		for (b6_json_setup_iterator(&iter, object);
+		     b6_json_get_iterator(&iter);
+		     b6_json_advance_iterator(&iter)) {
+			const struct b6_json_pair *pair =
+				b6_json_get_iterator(&iter);
+			struct b6_json_number *number =
+				b6_json_value_as_or_null(pair->value, number);
+			if (!(++n % 3))
+				n += 1;
+			if (!number || b6_json_get_number(number) != n)
+				retval = 0;
+		}
+	if (n != 299)
+		retval = 0;
+	if (object)
+		b6_json_unref_value(&object->up);
+	teardown();
+	return retval;
+}
+
+static int intern_keys()
+{
+	struct b6_json_object *root, *x, *y;
+	struct b6_json_iterator iter;
+	const struct b6_json_string *a;
+	int retval = 1;
+	setup();
+	b6_json_default_impl_intern_keys(&impl);
+	root = parse("{\"x\": {\"a\": 1, \"b\": 2}, "
+		     "\"y\": {\"b\": 3, \"\\u0061\": 4}}");
+	if (!root ||
+	    !(x = b6_json_get_object_as(root, B6_UTF8("x"), object)) ||
+	    !(y = b6_json_get_object_as(root, B6_UTF8("y"), object)))
+		retval = 0;
+	else {
+		b6_json_setup_iterator(&iter, x);
+		a = b6_json_get_iterator(&iter)->key;
+		b6_json_setup_iterator_at(&iter, y, B6_UTF8("a"));
+		if (!b6_json_get_iterator(&iter) ||
+		    b6_json_get_iterator(&iter)->key != a ||
+		    a->up.refcount != 2 || impl.nkeys != 4)
+			retval = 0;
+		else if (b6_json_set_object(x, b6_json_get_string(a),
+					    &b6_json_new_null(&json)->up) ||
+			 a->up.refcount != 2)
+			retval = 0;
+		else if (b6_json_set_object(x, B6_UTF8("c"),
+					    &b6_json_new_null(&json)->up) ||
+			 impl.nkeys != 5)
+			retval = 0;
+	}
+	if (root)
+		b6_json_unref_value(&root->up);
+	if (impl.nkeys)
+		retval = 0;
+	teardown();
+	return retval;
+}
+
+static int serialize_simple()
+{
+	struct b6_json_object *object;
+	int retval;
+	setup();
+	object = parse("{\"a\":[true,false,null,\"x\\ny\"]}");
+	retval = object && serialize(object,
+				     "{\"a\":[true,false,null,\"x\\ny\"]}");
+	if (object)
+		b6_json_unref_value(&object->up);
+	teardown();
+	return retval;
+}
+
+static int serialize_buffered()
+{
+	static const char doc[] =
+		"{\"key\":\"a \\\"long\\\" string\\t\u00e9\\u0001\","
+		"\"n\":[1,23,456]}";
+	struct b6_json_object *object;
+	unsigned long int size;
+	int retval;
+	setup();
+	retval = !!(object = parse(doc));
+	for (size = 1; retval && size <= 16; size += 1) {
+		struct string_ostream os;
+		struct b6_json_default_serializer serializer;
+		char buf[16];
+		setup_string_ostream(&os);
+		b6_json_setup_buffered_ostream(&os.up, os.up.ops, buf, size);
+		b6_json_setup_default_serializer(&serializer);
+		if (b6_json_serialize_object(object, &os.up, &serializer.up) ||
+		    strcmp(os.buf, doc))
+			retval = 0;
+	}
+	if (object)
+		b6_json_unref_value(&object->up);
+	teardown();
+	return retval;
+}
+
+static int serialize_array()
+{
+	struct b6_json_array_ostream os;
+	struct b6_json_default_serializer serializer;
+	struct b6_json_array *array;
+	int i, retval = 1;
+	setup();
+	b6_json_array_ostream_initialize(&os, &stdalloc);
+	b6_json_setup_default_serializer(&serializer);
+	if (!(array = b6_json_new_array(&json)))
+		retval = 0;
+	for (i = 0; retval && i < 1000; i += 1) {
+		struct b6_json_number *number = b6_json_new_number(&json, i);
+		if (!number)
+			retval = 0;
+		else if (b6_json_add_array(array, i, &number->up)) {
+			b6_json_unref_value(&number->up);
+			retval = 0;
+		}
+	}
+	if (retval && b6_json_serialize_value(&array->up, &os.up,
+					      &serializer.up))
+		retval = 0;
+	if (retval) {
+		const char *ptr = b6_json_array_ostream_data(&os);
+		const char *end = ptr + b6_json_array_ostream_len(&os);
+		if (*ptr++ != '[' || end[-1] != ']')
+			retval = 0;
+		for (i = 0; retval && i < 1000; i += 1) {
+			char *next;
+			if (strtol(ptr, &next, 10) != i ||
+			    *next != (i < 999 ? ',' : ']'))
+				retval = 0;
+			ptr = next + 1;
+		}
+		if (ptr != end)
+			retval = 0;
+	}
+	if (array)
+		b6_json_unref_value(&array->up);
+	b6_json_array_ostream_finalize(&os);
+	teardown();
+	return retval;
+}
+
+/* Fails to grow blocks beyond limit bytes. */
+struct limited_allocator {
+	struct b6_allocator up;
+	unsigned long int limit;
+};
+
+static void *limited_allocate(struct b6_allocator *up, unsigned long int size)
+{
+	struct limited_allocator *self =
+		b6_cast_of(up, struct limited_allocator, up);
+	return size > self->limit ? NULL : malloc(size);
+}
+
+static void *limited_reallocate(struct b6_allocator *up, void *ptr,
+				unsigned long int size)
+{
+	struct limited_allocator *self =
+		b6_cast_of(up, struct limited_allocator, up);
+	return size > self->limit ? NULL : realloc(ptr, size);
+}
+
+static void limited_deallocate(struct b6_allocator *up, void *ptr)
+{
+	free(ptr);
+}
+
+static int serialize_array_out_of_memory()
+{
+	static const struct b6_allocator_ops ops = {
+		.allocate = limited_allocate,
+		.reallocate = limited_reallocate,
+		.deallocate = limited_deallocate,
+	};
+	struct limited_allocator allocator = {
+		.up = { .ops = &ops, },
+		.limit = 1024,
+	};
+	struct b6_json_array_ostream os;
+	unsigned long int len = 0, i;
+	char buf[100];
+	int retval = 1, failed = 0;
+	b6_json_array_ostream_initialize(&os, &allocator.up);
+	for (i = 0; i < 100; i += 1) {
+		memset(buf, 'a' + len / sizeof(buf) % 26, sizeof(buf));
+		if (b6_json_ostream_write(&os.up, buf, sizeof(buf)) < 0) {
+			failed = 1;
+			break;
+		}
+		len += sizeof(buf);
+	}
+	/* Bytes written before the failure are kept once, and only them. */
+	if (!failed || b6_json_ostream_flush(&os.up) ||
+	    b6_json_array_ostream_len(&os) != len ||
+	    b6_json_ostream_flush(&os.up) ||
+	    b6_json_array_ostream_len(&os) != len)
+		retval = 0;
+	allocator.limit = ~0UL;
+	for (i = 0; retval && i < 100; i += 1) {
+		memset(buf, 'a' + len / sizeof(buf) % 26, sizeof(buf));
+		if (b6_json_ostream_write(&os.up, buf, sizeof(buf)) < 0)
+			retval = 0;
+		len += sizeof(buf);
+	}
+	if (retval && (b6_json_ostream_flush(&os.up) ||
+		       b6_json_array_ostream_len(&os) != len))
+		retval = 0;
+	for (i = 0; retval && i < len; i += 1)
+		if (b6_json_array_ostream_data(&os)[i] !=
+		    'a' + i / sizeof(buf) % 26)
+			retval = 0;
+	b6_json_array_ostream_finalize(&os);
+	return retval;
+}
+
+/* Records the events of a parser in a compact textual form. */
+struct trace_handler {
+	struct b6_json_handler up;
+	char buf[256];
+	unsigned long int len;
+};
+
+static enum b6_json_error trace(struct b6_json_handler *up, const char *s,
+				unsigned long int len)
+{
+	struct trace_handler *self = b6_cast_of(up, struct trace_handler, up);
+	if (len > sizeof(self->buf) - 1 - self->len)
+		return B6_JSON_ERROR;
+	memcpy(self->buf + self->len, s, len);
+	self->len += len;
+	self->buf[self->len] = '\0';
+	return B6_JSON_OK;
+}
+
+static enum b6_json_error trace_enter_object(struct b6_json_handler *up)
+{
+	return trace(up, "{", 1);
+}
+
+static enum b6_json_error trace_leave_object(struct b6_json_handler *up)
+{
+	return trace(up, "}", 1);
+}
+
+static enum b6_json_error trace_key(struct b6_json_handler *up,
+				    const struct b6_utf8 *utf8)
+{
+	enum b6_json_error error = trace(up, utf8->ptr, utf8->nbytes);
+	return error ? error : trace(up, ":", 1);
+}
+
+static enum b6_json_error trace_enter_array(struct b6_json_handler *up)
+{
+	return trace(up, "[", 1);
+}
+
+static enum b6_json_error trace_leave_array(struct b6_json_handler *up)
+{
+	return trace(up, "]", 1);
+}
+
+static enum b6_json_error trace_string(struct b6_json_handler *up,
+				       const struct b6_utf8 *utf8)
+{
+	char buf[16];
+	int len = snprintf(buf, sizeof(buf), "s%u/", utf8->nchars);
+	enum b6_json_error error = trace(up, buf, len);
+	return error ? error : trace(up, utf8->ptr, utf8->nbytes);
+}
+
+static enum b6_json_error trace_number(struct b6_json_handler *up, double d)
+{
+	char buf[32];
+	return trace(up, buf, snprintf(buf, sizeof(buf), "d%g", d));
+}
+
+static enum b6_json_error trace_integer(struct b6_json_handler *up,
+					long long int i)
+{
+	char buf[32];
+	return trace(up, buf, snprintf(buf, sizeof(buf), "i%lld", i));
+}
+
+static enum b6_json_error trace_boolean(struct b6_json_handler *up, int b)
+{
+	return trace(up, b ? "T" : "F", 1);
+}
+
+static enum b6_json_error trace_null(struct b6_json_handler *up)
+{
+	return trace(up, "N", 1);
+}
+
+static const struct b6_json_handler_ops trace_handler_ops = {
+	.enter_object = trace_enter_object,
+	.leave_object = trace_leave_object,
+	.key = trace_key,
+	.enter_array = trace_enter_array,
+	.leave_array = trace_leave_array,
+	.string = trace_string,
+	.number = trace_number,
+	.integer = trace_integer,
+	.boolean = trace_boolean,
+	.null = trace_null,
+};
+
+static int parse_events()
+{
+	static const char doc[] =
+		"{ \"key\": \"a \\\"long\\\" string \\u00e9\", "
+		"\"n\": [1, -2.5, true, false, null, {}], \"caf\xc3\xa9\": 1e3 }";
+	static const char expected[] =
+		"{key:s17/a \"long\" string \xc3\xa9n:[i1d-2.5TFN{}]"
+		"caf\xc3\xa9:d1000}";
+	struct b6_json_event_parser parser;
+	unsigned long int size;
+	int retval = 1;
+	b6_json_event_parser_initialize(&parser, &stdalloc);
+	for (size = 0; retval && size <= 16; size += 1) {
+		struct string_istream is;
+		struct trace_handler handler = {
+			.up = { .ops = &trace_handler_ops, },
+		};
+		char buf[16];
+		setup_string_istream(&is, doc);
+		if (size)
+			b6_json_setup_buffered_istream(&is.up, is.up.ops, buf,
+						       size);
+		else
+			b6_json_setup_memory_istream(&is.up, doc,
+						     sizeof(doc) - 1);
+		if (b6_json_parse_events(&parser, &is.up, &handler.up, NULL))
+			retval = 0;
+		else if (strcmp(handler.buf, expected)) {
+			fprintf(stderr, "expected %s, got %s\n", expected,
+				handler.buf);
+			retval = 0;
+		}
+	}
+	b6_json_event_parser_finalize(&parser);
+	return retval;
+}
+
+static int parse_events_abort()
+{
+	static const struct b6_json_handler_ops ops = {
+		.key = trace_key,
+	};
+	struct b6_json_event_parser parser;
+	struct b6_json_istream is;
+	struct trace_handler handler = { .up = { .ops = &ops, }, };
+	static const char doc[] = "{\"a\": 1, \"b\": [2], \"c\": x}";
+	int retval;
+	b6_json_event_parser_initialize(&parser, &stdalloc);
+	b6_json_setup_memory_istream(&is, doc, sizeof(doc) - 1);
+	retval = b6_json_parse_events(&parser, &is, &handler.up, NULL) ==
+		B6_JSON_PARSE_ERROR && !strcmp(handler.buf, "a:b:c:");
+	b6_json_event_parser_finalize(&parser);
+	return retval;
+}
+
+static int check_select(struct b6_json_object *object, int path,
+			const char *text, struct b6_json_value *expected)
+{
+	struct b6_json_pointer pointer;
+	struct b6_utf8 utf8;
+	int retval;
+	b6_json_pointer_initialize(&pointer, &stdalloc);
+	b6_setup_utf8(&utf8, text, strlen(text));
+	if (path)
+		retval = !b6_json_compile_path(&pointer, &utf8);
+	else
+		retval = !b6_json_compile_pointer(&pointer, &utf8);
+	if (retval && b6_json_select(&pointer, &object->up) != expected) {
+		fprintf(stderr, "%s selects the wrong value\n", text);
+		retval = 0;
+	}
+	b6_json_pointer_finalize(&pointer);
+	return retval;
+}
+
+static int check_malformed(int path, const char *text)
+{
+	struct b6_json_pointer pointer;
+	struct b6_utf8 utf8;
+	enum b6_json_error error;
+	b6_json_pointer_initialize(&pointer, &stdalloc);
+	b6_setup_utf8(&utf8, text, strlen(text));
+	if (path)
+		error = b6_json_compile_path(&pointer, &utf8);
+	else
+		error = b6_json_compile_pointer(&pointer, &utf8);
+	b6_json_pointer_finalize(&pointer);
+	return error == B6_JSON_PARSE_ERROR;
+}
+
+static int select_pointer()
+{
+	struct b6_json_object *object, *a;
+	struct b6_json_array *list, *bc;
+	int retval = 1;
+	setup();
+	if (!(object = parse("{\"a\": {\"b/c\": [10, {\"~k\": \"x\"}]}, "
+			     "\"0\": true, \"l\": [1, 2]}")))
+		retval = 0;
+	else if (!(a = b6_json_get_object_as(object, B6_UTF8("a"), object)) ||
+		 !(bc = b6_json_get_object_as(a, B6_UTF8("b/c"), array)) ||
+		 !(list = b6_json_get_object_as(object, B6_UTF8("l"), array)))
+		retval = 0;
+	else {
+		struct b6_json_value *x = b6_json_get_object(
+			b6_json_get_array_as(bc, 1, object), B6_UTF8("~k"));
+		retval &= check_select(object, 0, "", &object->up);
+		retval &= check_select(object, 0, "/a/b~1c/1/~0k", x);
+		retval &= check_select(object, 0, "/a/b~1c/0",
+				       b6_json_get_array(bc, 0));
+		retval &= check_select(object, 0, "/a/b~1c/2", NULL);
+		retval &= check_select(object, 0, "/a/b~1c/-", NULL);
+		retval &= check_select(object, 0, "/l/01", NULL);
+		retval &= check_select(object, 0, "/0",
+				       b6_json_get_object(object,
+							  B6_UTF8("0")));
+		retval &= check_select(object, 1, "$", &object->up);
+		retval &= check_select(object, 1, "$.a", &a->up);
+		retval &= check_select(object, 1, "a.b/c[1].~k", x);
+		retval &= check_select(object, 1, "l[1]",
+				       b6_json_get_array(list, 1));
+		retval &= check_select(object, 1, "a[0]", NULL);
+		retval &= check_select(object, 1, "$.l.x", NULL);
+	}
+	retval &= check_malformed(0, "a");
+	retval &= check_malformed(0, "/~2");
+	retval &= check_malformed(0, "/a~");
+	retval &= check_malformed(0, "/\xff");
+	retval &= check_malformed(1, "a..b");
+	retval &= check_malformed(1, "a[x]");
+	retval &= check_malformed(1, "a[1");
+	retval &= check_malformed(1, "a[]");
+	if (object)
+		b6_json_unref_value(&object->up);
+	teardown();
+	return retval;
+}
+
+static int check_selected(const char *doc, const char *text,
+			  const char *expected, enum b6_json_error error)
+{
+	struct b6_json_event_parser parser;
+	struct b6_json_pointer pointer;
+	unsigned long int size;
+	struct b6_utf8 utf8;
+	int retval = 1;
+	b6_json_event_parser_initialize(&parser, &stdalloc);
+	b6_json_pointer_initialize(&pointer, &stdalloc);
+	b6_setup_utf8(&utf8, text, strlen(text));
+	if (b6_json_compile_pointer(&pointer, &utf8))
+		retval = 0;
+	for (size = 0; retval && size <= 16; size += 1) {
+		struct string_istream is;
+		struct trace_handler handler = {
+			.up = { .ops = &trace_handler_ops, },
+		};
+		char buf[16];
+		setup_string_istream(&is, doc);
+		if (size)
+			b6_json_setup_buffered_istream(&is.up, is.up.ops, buf,
+						       size);
+		else
+			b6_json_setup_memory_istream(&is.up, doc,
+						     strlen(doc));
+		if (b6_json_parse_selected_events(&parser, &is.up, &pointer,
+						  &handler.up, NULL) != error)
+			retval = 0;
+		else if (!error && strcmp(handler.buf, expected)) {
+			fprintf(stderr, "expected %s, got %s\n", expected,
+				handler.buf);
+			retval = 0;
+		} else if (!error && b6_json_istream_peek(&is.up, 1))
+			retval = 0;
+	}
+	b6_json_pointer_finalize(&pointer);
+	b6_json_event_parser_finalize(&parser);
+	return retval;
+}
+
+static int parse_selected_events()
+{
+	static const char doc[] =
+		"{\"skip\": {\"s\": \"a \\\"}]\\\" \\u00e9 caf\xc3\xa9\", "
+		"\"n\": [1e3, -2, [{}]], \"t\": true}, "
+		"\"a\": [0, {\"x\": 1}, {\"y\": [null, \"z\"]}], \"a\": 5}";
+	int retval = 1;
+	retval &= check_selected(doc, "/a/2/y", "[Ns1/z]", B6_JSON_OK);
+	retval &= check_selected(doc, "/a/1", "{x:i1}", B6_JSON_OK);
+	retval &= check_selected(doc, "/skip/n/0", "d1000", B6_JSON_OK);
+	retval &= check_selected(doc, "/missing", "", B6_JSON_OK);
+	retval &= check_selected(doc, "/a/7", "", B6_JSON_OK);
+	retval &= check_selected("{\"skip\": [1, x], \"a\": 1}", "/a", "",
+				 B6_JSON_PARSE_ERROR);
+	retval &= check_selected("{\"skip\": \"abc", "/a", "",
+				 B6_JSON_IO_ERROR);
+	return retval;
+}
+
+/* Feeds doc by chunks of every size and checks the events. */
+static int check_push(const char *doc, const char *expected,
+		      enum b6_json_error error)
+{
+	unsigned long int len = strlen(doc), size;
+	int retval = 1;
+	for (size = 1; retval && size <= len; size += 1) {
+		struct trace_handler handler = {
+			.up = { .ops = &trace_handler_ops, },
+		};
+		struct b6_json_push_parser parser;
+		enum b6_json_error e = B6_JSON_OK;
+		unsigned long int i;
+		b6_json_push_parser_initialize(&parser, &handler.up, &stdalloc);
+		for (i = 0; !e && i < len; i += size)
+			e = b6_json_push_parser_feed(&parser, doc + i,
+						     i + size < len ?
+						     size : len - i);
+		if (e == B6_JSON_OK)
+			e = b6_json_push_parser_finish(&parser);
+		if (e != error || strcmp(handler.buf, expected)) {
+			fprintf(stderr, "%lu-byte chunks: expected %s (%d), "
+				"got %s (%d)\n", size, expected, error,
+				handler.buf, e);
+			retval = 0;
+		}
+		b6_json_push_parser_finalize(&parser);
+	}
+	return retval;
+}
+
+static int push_parser()
+{
+	return check_push("{ \"key\": \"a \\\"long\\\" string \\u00e9\", "
+			  "\"n\": [1, -2.5, true, false, null, {}, [],], "
+			  "\"caf\xc3\xa9\": 1e3 }",
+			  "{key:s17/a \"long\" string \xc3\xa9n:[i1d-2.5TFN{}[]]"
+			  "caf\xc3\xa9:d1000}", B6_JSON_OK) &&
+		check_push("12 \"x\\\\\" [null]\n{}\n-0.5",
+			   "i12s2/x\\[N]{}d-0.5", B6_JSON_OK);
+}
+
+static int push_parser_errors()
+{
+	return check_push("{\"a\": [1, 2", "{a:[i1i2", B6_JSON_IO_ERROR) &&
+		check_push("[\"abc", "[", B6_JSON_IO_ERROR) &&
+		check_push("[tru", "[", B6_JSON_IO_ERROR) &&
+		check_push("[1, 2}", "[i1i2", B6_JSON_PARSE_ERROR) &&
+		check_push("{\"a\" 1}", "{a:", B6_JSON_PARSE_ERROR) &&
+		check_push("[nil]", "[", B6_JSON_PARSE_ERROR) &&
+		check_push("[01]", "[i0", B6_JSON_PARSE_ERROR) &&
+		check_push("[1-2]", "[i1", B6_JSON_PARSE_ERROR) &&
+		check_push("01", "i0", B6_JSON_PARSE_ERROR);
+}
+
+static int parse_buffered()
+{
+	static const char doc[] =
+		"{ \"key\": \"a \\\"long\\\" string \\u00e9\", "
+		"\"n\": [1, 23, 456] }";
+	unsigned long int size;
+	int retval = 1;
+	setup();
+	for (size = 1; retval && size <= 16; size += 1) {
+		struct string_istream is;
+		struct b6_json_object *object = b6_json_new_object(&json);
+		struct b6_json_string *string;
+		struct b6_json_array *array;
+		char buf[16];
+		setup_string_istream(&is, doc);
+		b6_json_setup_buffered_istream(&is.up, is.up.ops, buf, size);
+		if (!object || b6_json_parse_object(object, &is.up, NULL))
+			retval = 0;
+		else if (!(string = b6_json_get_object_as(object,
+							  B6_UTF8("key"),
+							  string)))
+			retval = 0;
+		else if (b6_json_get_string(string)->nchars != 17)
+			retval = 0;
+		else if (!(array = b6_json_get_object_as(object, B6_UTF8("n"),
+							 array)))
+			retval = 0;
+		else if (b6_json_array_len(array) != 3)
+			retval = 0;
+		if (object)
+			b6_json_unref_value(&object->up);
+	}
+	teardown();
+	return retval;
+}
+
+static int peek()
+{
+	struct string_istream is;
+	char buf[4];
+	const char *ptr;
+	setup_string_istream(&is, "abcdef");
+	b6_json_setup_buffered_istream(&is.up, is.up.ops, buf, sizeof(buf));
+	if (!(ptr = b6_json_istream_peek(&is.up, 3)) || memcmp(ptr, "abc", 3))
+		return 0;
+	b6_json_istream_advance(&is.up, 2);
+	if (!(ptr = b6_json_istream_peek(&is.up, 4)) || memcmp(ptr, "cdef", 4))
+		return 0;
+	b6_json_istream_advance(&is.up, 3);
+	if (!(ptr = b6_json_istream_peek(&is.up, 1)) || *ptr != 'f')
+		return 0;
+	return !b6_json_istream_peek(&is.up, 2);
+}
+
+static int parser_info()
+{
+	struct string_istream is;
+	struct b6_json_parser_info info;
+	struct b6_json_object *object;
+	int retval;
+	setup();
+	object = b6_json_new_object(&json);
+	setup_string_istream(&is, "{\n  \"abc\": 12,\n  \"d\": x }");
+	b6_json_reset_parser_info(&info);
+	retval = object &&
+		b6_json_parse_object(object, &is.up, &info) ==
+		B6_JSON_PARSE_ERROR && info.row == 3 && info.col == 8;
+	/* Long runs of blanks are skipped by the vector scanners. */
+	setup_string_istream(&is, "{\"a\": 1,\n\n\t                      "
+			     "                                         \n"
+			     "                                      \"b\" x}");
+	b6_json_reset_parser_info(&info);
+	retval = retval &&
+		b6_json_parse_object(object, &is.up, &info) ==
+		B6_JSON_PARSE_ERROR && info.row == 4 && info.col == 43;
+	if (object)
+		b6_json_unref_value(&object->up);
+	teardown();
+	return retval;
+}
+
+static int parse_memory()
+{
+	static const char doc[] =
+		"{\"plain\": \"caf\xc3\xa9\", \"escaped\": \"a\\tb\", "
+		"\"list\": [\"x\"]}";
+	struct b6_json_istream is;
+	struct b6_json_object *object;
+	struct b6_json_string *plain, *escaped;
+	const struct b6_utf8 *utf8;
+	int retval = 1;
+	setup();
+	object = b6_json_new_object(&json);
+	b6_json_setup_memory_istream(&is, doc, sizeof(doc) - 1);
+	if (!object || b6_json_parse_object(object, &is, NULL))
+		retval = 0;
+	else if (!(plain = b6_json_get_object_as(object, B6_UTF8("plain"),
+						 string)))
+		retval = 0;
+	else if (!(escaped = b6_json_get_object_as(object,
+						   B6_UTF8("escaped"),
+						   string)))
+		retval = 0;
+	else {
+		/* Strings without escapes point into the document. */
+		utf8 = b6_json_get_string(plain);
+		if (utf8->ptr != doc + 11 || utf8->nbytes != 5 ||
+		    utf8->nchars != 4)
+			retval = 0;
+		utf8 = b6_json_get_string(escaped);
+		if (utf8->ptr >= doc && utf8->ptr < doc + sizeof(doc))
+			retval = 0;
+		if (utf8->nbytes != 3 || memcmp(utf8->ptr, "a\tb", 3))
+			retval = 0;
+		/* Appending copies the view and leaves the document alone. */
+		if (plain->impl->ops->append(plain->impl, json.impl,
+					     B6_UTF8("!")))
+			retval = 0;
+		utf8 = b6_json_get_string(plain);
+		if (utf8->ptr == doc + 11 || utf8->nbytes != 6 ||
+		    memcmp(utf8->ptr, "caf\xc3\xa9!", 6) || doc[16] != '"')
+			retval = 0;
+	}
+	if (object)
+		b6_json_unref_value(&object->up);
+	teardown();
+	return retval;
+}
+
+static int parse_lazy()
+{
+	static const char doc[] =
+		"{\"a\": {\"b\": [1, {\"c\": \"d\"}], \"e\": \"f\"}, "
+		"\"bad\": {\"x\": 1, \"x\": 2}, \"num\": [1, 2.5e]}";
+	struct b6_json_istream is;
+	struct b6_json_object *object, *a, *c, *bad;
+	struct b6_json_array *b, *num;
+	struct b6_json_string *d;
+	struct string_ostream os;
+	struct b6_json_default_serializer serializer;
+	struct b6_json_array_ostream cbor;
+	int retval = 1;
+	setup();
+	json.flags = B6_JSON_LAZY;
+	/* Only memory istreams defer parsing, so errors show up here. */
+	if ((object = parse(doc))) {
+		b6_json_unref_value(&object->up);
+		retval = 0;
+	}
+	object = b6_json_new_object(&json);
+	b6_json_setup_memory_istream(&is, doc, sizeof(doc) - 1);
+	if (!object || b6_json_parse_object(object, &is, NULL))
+		retval = 0;
+	else if (!(a = b6_json_get_object_as(object, B6_UTF8("a"), object)) ||
+		 b6_json_load_value(&a->up) ||
+		 !(b = b6_json_get_object_as(a, B6_UTF8("b"), array)) ||
+		 b6_json_array_len(b) != 2 ||
+		 !(c = b6_json_get_array_as(b, 1, object)) ||
+		 !(d = b6_json_get_object_as(c, B6_UTF8("c"), string)))
+		retval = 0;
+	else {
+		/* Deferred values still reference the document. */
+		if (b6_json_get_string(d)->ptr != doc + 23)
+			retval = 0;
+		retval &= serialize(a, "{\"b\":[1,{\"c\":\"d\"}],\"e\":\"f\"}");
+		if (!(bad = b6_json_get_object_as(object, B6_UTF8("bad"),
+						  object)) ||
+		    b6_json_get_object(bad, B6_UTF8("x")) ||
+		    b6_json_load_value(&bad->up) != B6_JSON_ERROR)
+			retval = 0;
+		if (!(num = b6_json_get_object_as(object, B6_UTF8("num"),
+						  array)) ||
+		    b6_json_array_len(num) ||
+		    b6_json_load_value(&num->up) != B6_JSON_PARSE_ERROR ||
+		    b6_json_add_array(num, 0, &json.json_null.up) !=
+		    B6_JSON_PARSE_ERROR)
+			retval = 0;
+		/* Nor do they serialize as empty values. */
+		setup_string_ostream(&os);
+		b6_json_setup_default_serializer(&serializer);
+		if (b6_json_serialize_object(object, &os.up, &serializer.up) !=
+		    B6_JSON_ERROR)
+			retval = 0;
+		b6_json_array_ostream_initialize(&cbor, &stdalloc);
+		if (b6_json_serialize_cbor(&num->up, &cbor.up) !=
+		    B6_JSON_PARSE_ERROR ||
+		    b6_json_array_ostream_len(&cbor))
+			retval = 0;
+		b6_json_array_ostream_finalize(&cbor);
+	}
+	if (object)
+		b6_json_unref_value(&object->up);
+	teardown();
+	return retval;
+}
+
+static int parse_memory_truncated()
+{
+	static const char doc[] = "{\"key\": \"unterminated";
+	struct b6_json_istream is;
+	struct b6_json_object *object;
+	int retval;
+	setup();
+	object = b6_json_new_object(&json);
+	b6_json_setup_memory_istream(&is, doc, sizeof(doc) - 1);
+	retval = object && b6_json_parse_object(object, &is, NULL) ==
+		B6_JSON_IO_ERROR;
+	if (object)
+		b6_json_unref_value(&object->up);
+	teardown();
+	return retval;
+}
+
+static int parse_file()
+{
+	static const char doc[] = "{\"a\": [1, \"two\"], \"b\": {}}";
+	char path[] = "/tmp/b6-json-XXXXXX";
+	struct b6_json_file_istream is;
+	struct b6_json_object *object = NULL;
+	struct b6_json_array *array;
+	int fd, retval = 1;
+	if ((fd = mkstemp(path)) < 0)
+		return 0;
+	if (write(fd, doc, sizeof(doc) - 1) != sizeof(doc) - 1)
+		retval = 0;
+	close(fd);
+	setup();
+	if (!retval || b6_json_open_file_istream(&is, path))
+		retval = 0;
+	else {
+		object = b6_json_new_object(&json);
+		if (!object || b6_json_parse_object(object, &is.up, NULL))
+			retval = 0;
+		else if (!(array = b6_json_get_object_as(object, B6_UTF8("a"),
+							 array)))
+			retval = 0;
+		else if (b6_json_array_len(array) != 2)
+			retval = 0;
+		if (object)
+			b6_json_unref_value(&object->up);
+		b6_json_close_file_istream(&is);
+	}
+	teardown();
+	unlink(path);
+	return retval;
+}
+
+struct record_handler {
+	struct b6_json_record_handler up;
+	long long int next;
+	long long int sum;
+	unsigned long int offset;
+	int ordered;
+};
+
+static enum b6_json_error count_record(struct b6_json_record_handler *up,
+				       struct b6_json_object *object,
+				       unsigned long int offset)
+{
+	struct record_handler *self =
+		b6_cast_of(up, struct record_handler, up);
+	struct b6_json_number *number;
+	long long int id;
+	if (!(number = b6_json_get_object_as(object, B6_UTF8("id"), number)))
+		return B6_JSON_ERROR;
+	id = b6_json_get_number(number);
+	if (self->ordered) {
+		if (id != self->next || (id && offset <= self->offset))
+			return B6_JSON_ERROR;
+		self->next += 1;
+		self->offset = offset;
+	}
+	__atomic_add_fetch(&self->sum, id, __ATOMIC_RELAXED);
+	return B6_JSON_OK;
+}
+
+static const struct b6_json_record_handler_ops count_record_ops = {
+	.record = count_record,
+};
+
+static int parse_ndjson()
+{
+	static const long long int n = 20000;
+	struct record_handler handler = { .up = { &count_record_ops, }, };
+	char *doc, *ptr;
+	long long int i;
+	int retval = 1;
+	if (!(doc = malloc(n * 32)))
+		return 0;
+	for (ptr = doc, i = 0; i < n; i += 1) {
+		ptr += sprintf(ptr, "{\"id\": %lld}\n", i);
+		if (i % 1000 == 0)
+			ptr += sprintf(ptr, " \r\n");
+	}
+	/* Records come in order even though chunks are parsed in parallel. */
+	handler.ordered = 1;
+	if (b6_json_parse_ndjson(doc, ptr - doc, &handler.up, &stdalloc, 4,
+				 B6_JSON_NDJSON_ORDERED) ||
+	    handler.next != n || handler.sum != n * (n - 1) / 2)
+		retval = 0;
+	handler.ordered = 0;
+	handler.sum = 0;
+	if (b6_json_parse_ndjson(doc, ptr - doc, &handler.up, &stdalloc, 4,
+				 B6_JSON_NDJSON_INTERN_KEYS) ||
+	    handler.sum != n * (n - 1) / 2)
+		retval = 0;
+	/* The last line has no newline. */
+	ptr += sprintf(ptr, "{\"id\": }");
+	if (b6_json_parse_ndjson(doc, ptr - doc, &handler.up, &stdalloc, 4,
+				 0) != B6_JSON_PARSE_ERROR)
+		retval = 0;
+	free(doc);
+	return retval;
+}
+
+static int check_string(struct b6_json_istream *is, const char *expected,
+			unsigned int nbytes)
+{
+	struct b6_json_object *object = b6_json_new_object(&json);
+	struct b6_json_string *string;
+	const struct b6_utf8 *utf8;
+	int retval = 1;
+	if (!object || b6_json_parse_object(object, is, NULL))
+		retval = 0;
+	else if (!(string = b6_json_get_object_as(object, B6_UTF8("k"),
+						  string)))
+		retval = 0;
+	else if ((utf8 = b6_json_get_string(string))->nbytes != nbytes ||
+		 memcmp(utf8->ptr, expected, nbytes))
+		retval = 0;
+	if (object)
+		b6_json_unref_value(&object->up);
+	return retval;
+}
+
+/* Parses a string of len characters with a special one at pos, surrounded
+ * with len blanks, from memory and through a small buffer. */
+static int check_special(int len, int pos, const char *encoded,
+			 const char *decoded)
+{
+	char doc[512], expected[128], buf[32];
+	struct string_istream sis;
+	struct b6_json_istream is;
+	int n = sprintf(doc, "{%*s\"k\":%*s\"", len, "", len, "");
+	int m = pos;
+	memset(doc + n, 'x', pos);
+	memset(expected, 'x', pos);
+	n += pos;
+	n += sprintf(doc + n, "%s", encoded);
+	m += sprintf(expected + m, "%s", decoded);
+	memset(doc + n, 'x', len - pos);
+	memset(expected + m, 'x', len - pos);
+	n += len - pos;
+	m += len - pos;
+	sprintf(doc + n, "\"%*s}", len, "");
+	b6_json_setup_memory_istream(&is, doc, strlen(doc));
+	if (!check_string(&is, expected, m))
+		return 0;
+	setup_string_istream(&sis, doc);
+	b6_json_setup_buffered_istream(&sis.up, sis.up.ops, buf, sizeof(buf));
+	return check_string(&sis.up, expected, m);
+}
+
+/* Puts escapes, non-ascii characters and whitespace runs at every offset of
+ * the vectors the scanners work on. */
+static int scan_isa()
+{
+	static const struct {
+		const char *encoded;
+		const char *decoded;
+	} specials[] = {
+		{ "\\n", "\n" },
+		{ "\\\"", "\"" },
+		{ "\xc3\xa9", "\xc3\xa9" },
+		{ "\xe2\x82\xac", "\xe2\x82\xac" },
+		{ "\x7f", "\x7f" },
+	};
+	static const enum b6_json_isa isas[] = {
+		B6_JSON_ISA_SCALAR, B6_JSON_ISA_SSE2, B6_JSON_ISA_AVX2,
+	};
+	int i, len, pos, k, retval = 1;
+	setup();
+	for (i = 0; i < b6_card_of(isas); i += 1) {
+		if (b6_json_select_isa(isas[i]))
+			continue;
+		for (len = 0; len < 70; len += 1)
+			for (pos = 0; pos <= len; pos += 1)
+				for (k = 0; k < b6_card_of(specials); k += 1)
+					retval &= check_special(
+						len, pos, specials[k].encoded,
+						specials[k].decoded);
+	}
+	teardown();
+	return retval;
+}
+
+static int check_number(const char *text, double expected)
+{
+	struct b6_json_istream is;
+	struct b6_json_object *object = b6_json_new_object(&json);
+	struct b6_json_number *number;
+	char doc[1024];
+	double d;
+	int retval = 1;
+	snprintf(doc, sizeof(doc), "{\"n\":%s}", text);
+	b6_json_setup_memory_istream(&is, doc, strlen(doc));
+	if (!object || b6_json_parse_object(object, &is, NULL))
+		retval = 0;
+	else if (!(number = b6_json_get_object_as(object, B6_UTF8("n"),
+						  number)))
+		retval = 0;
+	else if (d = b6_json_get_number(number),
+		 memcmp(&d, &expected, sizeof(d))) {
+		fprintf(stderr, "%s: expected %.17g, got %.17g\n", text,
+			expected, d);
+		retval = 0;
+	}
+	if (object)
+		b6_json_unref_value(&object->up);
+	return retval;
+}
+
+static int parse_numbers()
+{
+	static const struct {
+		const char *text;
+		double expected;
+	} numbers[] = {
+		{ "0", 0. },
+		{ "-0", -0. },
+		{ "0.5", .5 },
+		{ "-12.25", -12.25 },
+		{ "1e2", 100. },
+		{ "2E-3", .002 },
+		{ "1e+22", 1e22 },
+		{ "1e23", 1e23 },
+		{ "0.1", .1 },
+		{ "0.3", .3 },
+		{ "3.141592653589793", 3.141592653589793 },
+		{ "9007199254740993", 9007199254740992. },
+		{ "123456789012345678901234567890", 1.2345678901234568e29 },
+		{ "1.7976931348623157e308", 1.7976931348623157e308 },
+		{ "1e400", __builtin_inf() },
+		{ "2.2250738585072011e-308", 2.2250738585072011e-308 },
+		{ "4.9e-324", 4.9e-324 },
+		{ "2.4703282292062327e-324", 0. },
+		{ "2.4703282292062328e-324", 4.9e-324 },
+		{ "1e-400", 0. },
+		{ "0.0000000000000000000000000000001e31", 1. },
+		/* Halfway between 1 and the next double, then just above. */
+		{ "1.00000000000000011102230246251565404236316680908203125",
+		  1. },
+		{ "1.000000000000000111022302462515654042363166809082031251",
+		  1.0000000000000002 },
+	};
+	static const char *const errors[] = {
+		"01", "-", "1.", ".5", "1e", "1e+", "+1", "-a",
+	};
+	int i, retval = 1;
+	setup();
+	for (i = 0; i < b6_card_of(numbers); i += 1)
+		retval &= check_number(numbers[i].text, numbers[i].expected);
+	for (i = 0; i < b6_card_of(errors); i += 1) {
+		struct b6_json_object *object = parse(errors[i]);
+		if (object) {
+			fprintf(stderr, "%s: parsed\n", errors[i]);
+			b6_json_unref_value(&object->up);
+			retval = 0;
+		}
+	}
+	teardown();
+	return retval;
+}
+
+static int preserve_integers()
+{
+	static const char doc[] = "{\"max\": 9223372036854775807, "
+		"\"min\": -9223372036854775808, "
+		"\"big\": 9223372036854775808, \"real\": 1.0}";
+	struct b6_json_istream is;
+	struct b6_json_object *object;
+	struct b6_json_number *max, *min, *big, *real;
+	int retval = 0;
+	setup();
+	json.flags |= B6_JSON_PRESERVE_INTEGERS;
+	object = b6_json_new_object(&json);
+	b6_json_setup_memory_istream(&is, doc, sizeof(doc) - 1);
+	if (!object || b6_json_parse_object(object, &is, NULL))
+		goto out;
+	max = b6_json_get_object_as(object, B6_UTF8("max"), number);
+	min = b6_json_get_object_as(object, B6_UTF8("min"), number);
+	big = b6_json_get_object_as(object, B6_UTF8("big"), number);
+	real = b6_json_get_object_as(object, B6_UTF8("real"), number);
+	if (!max || !min || !big || !real)
+		goto out;
+	if (!b6_json_number_is_integer(max) ||
+	    b6_json_get_integer(max) != 9223372036854775807LL)
+		goto out;
+	if (!b6_json_number_is_integer(min) ||
+	    b6_json_get_integer(min) != -9223372036854775807LL - 1)
+		goto out;
+	if (b6_json_number_is_integer(big) ||
+	    b6_json_get_number(big) != 9223372036854775808.)
+		goto out;
+	if (b6_json_number_is_integer(real) || b6_json_get_number(real) != 1)
+		goto out;
+	b6_json_del_object_at(object, B6_UTF8("big"));
+	b6_json_del_object_at(object, B6_UTF8("real"));
+	retval = serialize(object, "{\"max\":9223372036854775807,"
+			   "\"min\":-9223372036854775808}");
+out:
+	if (object)
+		b6_json_unref_value(&object->up);
+	teardown();
+	return retval;
+}
+
+static int check_integer(double d, long long int expected)
+{
+	struct b6_json_number number;
+	b6_json_set_number(&number, d);
+	if (b6_json_get_integer(&number) != expected) {
+		fprintf(stderr, "%g: expected %lld, got %lld\n", d, expected,
+			b6_json_get_integer(&number));
+		return 0;
+	}
+	return 1;
+}
+
+static int integer_conversion()
+{
+	static const char doc[] = "{\"huge\": 1e400}";
+	struct b6_json_object *object;
+	struct b6_json_number *huge;
+	int retval;
+	setup();
+	retval = check_integer(2.9, 2) && check_integer(-2.9, -2) &&
+		check_integer(-9223372036854775808.,
+			      -9223372036854775807LL - 1) &&
+		check_integer(9223372036854775808., 9223372036854775807LL) &&
+		check_integer(-1e19, -9223372036854775807LL - 1) &&
+		check_integer(__builtin_inf(), 9223372036854775807LL) &&
+		check_integer(-__builtin_inf(), -9223372036854775807LL - 1) &&
+		check_integer(__builtin_nan(""), 0);
+	if (!(object = parse(doc)) ||
+	    !(huge = b6_json_get_object_as(object, B6_UTF8("huge"), number)) ||
+	    b6_json_get_integer(huge) != 9223372036854775807LL)
+		retval = 0;
+	if (object)
+		b6_json_unref_value(&object->up);
+	teardown();
+	return retval;
+}
+
+static int check_format(double d, const char *expected)
+{
+	struct string_ostream os;
+	struct b6_json_default_serializer serializer;
+	struct b6_json_number *number = b6_json_new_number(&json, d);
+	struct b6_json_istream is;
+	struct b6_json_object *object;
+	char doc[64];
+	int retval = 1;
+	if (!number)
+		return 0;
+	setup_string_ostream(&os);
+	b6_json_setup_default_serializer(&serializer);
+	if (b6_json_serialize_value(&number->up, &os.up, &serializer.up))
+		retval = 0;
+	b6_json_unref_value(&number->up);
+	if (!retval)
+		return 0;
+	if (expected && strcmp(os.buf, expected)) {
+		fprintf(stderr, "expected %s, got %s\n", expected, os.buf);
+		return 0;
+	}
+	if (d != d || d - d != 0)
+		return 1;
+	snprintf(doc, sizeof(doc), "{\"n\":%s}", os.buf);
+	b6_json_setup_memory_istream(&is, doc, strlen(doc));
+	if (!(object = b6_json_new_object(&json)))
+		return 0;
+	if (b6_json_parse_object(object, &is, NULL) ||
+	    !(number = b6_json_get_object_as(object, B6_UTF8("n"), number)))
+		retval = 0;
+	else {
+		double back = b6_json_get_number(number);
+		if (memcmp(&back, &d, sizeof(d))) {
+			fprintf(stderr, "%s does not parse back\n", os.buf);
+			retval = 0;
+		}
+	}
+	b6_json_unref_value(&object->up);
+	return retval;
+}
+
+static int serialize_numbers()
+{
+	static const struct {
+		double d;
+		const char *expected;
+	} numbers[] = {
+		{ 0., "0" },
+		{ -0., "-0" },
+		{ 1., "1" },
+		{ -42., "-42" },
+		{ .1, "0.1" },
+		{ .3, "0.3" },
+		{ 1.5, "1.5" },
+		{ 100.25, "100.25" },
+		{ 1e-6, "0.000001" },
+		{ 1.234e-6, "0.000001234" },
+		{ 1e-7, "1e-7" },
+		{ 1e20, "100000000000000000000" },
+		{ 1e21, "1e21" },
+		{ 1.2345678901234568e+20, "123456789012345680000" },
+		{ 9007199254740993., "9007199254740992" },
+		{ 5e-324, "5e-324" },
+		{ 2.2250738585072014e-308, "2.2250738585072014e-308" },
+		{ 1.7976931348623157e308, "1.7976931348623157e308" },
+		{ __builtin_inf(), "null" },
+		{ __builtin_nan(""), "null" },
+	};
+	unsigned long long int seed = 0x9e3779b97f4a7c15ULL;
+	int i, retval = 1;
+	setup();
+	for (i = 0; i < b6_card_of(numbers); i += 1)
+		retval &= check_format(numbers[i].d, numbers[i].expected);
+	for (i = 0; i < 10000; i += 1) {
+		double d;
+		seed ^= seed << 13;
+		seed ^= seed >> 7;
+		seed ^= seed << 17;
+		__builtin_memcpy(&d, &seed, sizeof(d));
+		retval &= check_format(d, NULL);
+	}
+	teardown();
+	return retval;
+}
+
+static int check_cbor(const char *cbor, unsigned long int len,
+		      const char *expected)
+{
+	struct string_ostream os;
+	struct b6_json_default_serializer serializer;
+	struct b6_json_istream is;
+	struct b6_json_value *value;
+	int retval = 1;
+	b6_json_setup_memory_istream(&is, cbor, len);
+	if (b6_json_parse_cbor(&json, &is, &value))
+		return 0;
+	setup_string_ostream(&os);
+	b6_json_setup_default_serializer(&serializer);
+	if (b6_json_serialize_value(value, &os.up, &serializer.up))
+		retval = 0;
+	else if (strcmp(os.buf, expected)) {
+		fprintf(stderr, "expected %s, got %s\n", expected, os.buf);
+		retval = 0;
+	}
+	b6_json_unref_value(value);
+	return retval;
+}
+
+static enum b6_json_error parse_cbor_error(const char *cbor,
+					   unsigned long int len)
+{
+	struct b6_json_istream is;
+	struct b6_json_value *value;
+	enum b6_json_error error;
+	b6_json_setup_memory_istream(&is, cbor, len);
+	if (!(error = b6_json_parse_cbor(&json, &is, &value)))
+		b6_json_unref_value(value);
+	return error;
+}
+
+#define CBOR(s) s, sizeof(s) - 1
+
+static int parse_cbor()
+{
+	int retval = 1;
+	setup();
+	if (!check_cbor(CBOR("\xf9\x3e\x00"), "1.5") ||
+	    !check_cbor(CBOR("\xfa\x47\xc3\x50\x00"), "100000") ||
+	    !check_cbor(CBOR("\x38\x63"), "-100") ||
+	    !check_cbor(CBOR("\x64IETF"), "\"IETF\"") ||
+	    !check_cbor(CBOR("\x62\xc3\xbc"), "\"\xc3\xbc\"") ||
+	    !check_cbor(CBOR("\x83\xf4\xf5\xf6"), "[false,true,null]") ||
+	    !check_cbor(CBOR("\xc1\x1a\x51\x4b\x67\xb0"), "1363896240") ||
+	    !check_cbor(CBOR("\xa2\x61\x61\x01\x61\x62\x82\x02\x03"),
+			"{\"a\":1,\"b\":[2,3]}"))
+		retval = 0;
+	if (parse_cbor_error(CBOR("\x41\x61")) != B6_JSON_PARSE_ERROR ||
+	    parse_cbor_error(CBOR("\x9f\x01\xff")) != B6_JSON_PARSE_ERROR ||
+	    parse_cbor_error(CBOR("\xa1\x01\x01")) != B6_JSON_PARSE_ERROR ||
+	    parse_cbor_error(CBOR("\x62\xc3\x28")) != B6_JSON_PARSE_ERROR ||
+	    parse_cbor_error(CBOR("\xf8\x20")) != B6_JSON_PARSE_ERROR ||
+	    parse_cbor_error(CBOR("\x19\x01")) != B6_JSON_IO_ERROR ||
+	    parse_cbor_error(CBOR("\x82\x01")) != B6_JSON_IO_ERROR ||
+	    parse_cbor_error(CBOR("\x65IETF")) != B6_JSON_IO_ERROR ||
+	    !parse_cbor_error(CBOR("\xa2\x61\x61\x01\x61\x61\x02")))
+		retval = 0;
+	teardown();
+	return retval;
+}
+
+static int serialize_cbor()
+{
+	static const char doc[] = "{\"a\":1,\"b\":[2,3]}";
+	static const char rfc[] = "\xa2\x61\x61\x01\x61\x62\x82\x02\x03";
+	static const char text[] = "{\"s\":\"a string longer than a buffer "
+		"\xc3\xa9\",\"n\":[0,-1,23,24,-25,256,65536,4294967296,"
+		"-9223372036854775808,0.5,0.1,1e300],\"o\":{\"t\":true,"
+		"\"f\":false,\"z\":null,\"e\":{},\"a\":[]}}";
+	struct b6_json_array_ostream os;
+	struct b6_json_object *object;
+	unsigned long int size;
+	int retval = 1;
+	setup();
+	json.flags |= B6_JSON_PRESERVE_INTEGERS;
+	b6_json_array_ostream_initialize(&os, &stdalloc);
+	if (!(object = parse(doc)) ||
+	    b6_json_serialize_cbor(&object->up, &os.up) ||
+	    b6_json_array_ostream_len(&os) != sizeof(rfc) - 1 ||
+	    memcmp(b6_json_array_ostream_data(&os), rfc, sizeof(rfc) - 1))
+		retval = 0;
+	if (object)
+		b6_json_unref_value(&object->up);
+	b6_json_array_ostream_finalize(&os);
+	b6_json_array_ostream_initialize(&os, &stdalloc);
+	if (!(object = parse(text)) ||
+	    b6_json_serialize_cbor(&object->up, &os.up))
+		retval = 0;
+	if (object)
+		b6_json_unref_value(&object->up);
+	if (retval &&
+	    !check_cbor(b6_json_array_ostream_data(&os),
+			b6_json_array_ostream_len(&os), text))
+		retval = 0;
+	for (size = 1; retval && size <= 16; size += 1) {
+		struct string_istream is;
+		struct b6_json_value *value;
+		char buf[16];
+		setup_string_istream(&is, "");
+		is.ptr = b6_json_array_ostream_data(&os);
+		is.len = b6_json_array_ostream_len(&os);
+		b6_json_setup_buffered_istream(&is.up, is.up.ops, buf, size);
+		if (b6_json_parse_cbor(&json, &is.up, &value))
+			retval = 0;
+		else {
+			if (!b6_json_value_is_of(value, object) ||
+			    !serialize(b6_json_value_as(value, object), text))
+				retval = 0;
+			b6_json_unref_value(value);
+		}
+	}
+	b6_json_array_ostream_finalize(&os);
+	teardown();
+	return retval;
+}
+
+struct point {
+	double x;
+	double y;
+};
+
+struct item {
+	long long int id;
+	struct b6_utf8_string name;
+	int active;
+	double score;
+	struct point at;
+};
+
+static const struct b6_json_field point_fields[] = {
+	{ "x", b6_offset_of(struct point, x), B6_JSON_FIELD_NUMBER,
+	  B6_JSON_FIELD_REQUIRED },
+	{ "y", b6_offset_of(struct point, y), B6_JSON_FIELD_NUMBER,
+	  B6_JSON_FIELD_REQUIRED },
+};
+
+static struct b6_json_schema point_schema;
+
+static const struct b6_json_field item_fields[] = {
+	{ "id", b6_offset_of(struct item, id), B6_JSON_FIELD_INTEGER,
+	  B6_JSON_FIELD_REQUIRED },
+	{ "name", b6_offset_of(struct item, name), B6_JSON_FIELD_STRING },
+	{ "active", b6_offset_of(struct item, active),
+	  B6_JSON_FIELD_BOOLEAN },
+	{ "score", b6_offset_of(struct item, score), B6_JSON_FIELD_NUMBER },
+	{ "at", b6_offset_of(struct item, at), B6_JSON_FIELD_STRUCT, 0,
+	  &point_schema },
+};
+
+static enum b6_json_error parse_item(struct b6_json_struct_parser *parser,
+				     const struct b6_json_schema *schema,
+				     const char *doc, struct item *item,
+				     unsigned long int size)
+{
+	struct string_istream is;
+	char buf[16];
+	setup_string_istream(&is, doc);
+	if (size)
+		b6_json_setup_buffered_istream(&is.up, is.up.ops, buf, size);
+	b6_initialize_utf8_string(&item->name, &stdalloc);
+	item->active = -1;
+	item->score = -1;
+	return b6_json_parse_struct(parser, &is.up, schema, item, NULL);
+}
+
+static int parse_struct()
+{
+	static const char doc[] = "{\"at\": {\"y\": -2.5, \"x\": 1}, "
+		"\"skip\": {\"a\": [1, {\"b\": \"}\"}]}, \"id\": 42, "
+		"\"name\": \"caf\\u00e9 \\\"au\\\" lait\", \"score\": null, "
+		"\"active\": true}";
+	static const char *const malformed[] = {
+		"{\"name\": \"no id\", \"at\": {\"x\": 0, \"y\": 0}}",
+		"{\"id\": 1.5}",
+		"{\"id\": 9223372036854775808}",
+		"{\"id\": \"1\"}",
+		"{\"id\": 1, \"active\": 1}",
+		"{\"id\": 1, \"name\": 1}",
+		"{\"id\": 1, \"at\": [0, 0]}",
+		"{\"id\": 1, \"at\": {\"x\": 0}}",
+		"{\"id\": 1 \"name\": \"\"}",
+		"[]",
+	};
+	static const struct b6_json_field duplicates[] = {
+		{ "x", b6_offset_of(struct point, x), B6_JSON_FIELD_NUMBER },
+		{ "x", b6_offset_of(struct point, y), B6_JSON_FIELD_NUMBER },
+	};
+	struct b6_json_struct_parser parser;
+	struct b6_json_schema schema;
+	unsigned long int size, i;
+	int retval = 1;
+	b6_json_schema_initialize(&point_schema, &stdalloc);
+	b6_json_schema_initialize(&schema, &stdalloc);
+	b6_json_struct_parser_initialize(&parser, &stdalloc);
+	if (b6_json_compile_schema(&schema, duplicates,
+				   b6_card_of(duplicates)) != B6_JSON_ERROR ||
+	    b6_json_compile_schema(&point_schema, point_fields,
+				   b6_card_of(point_fields)) ||
+	    b6_json_compile_schema(&schema, item_fields,
+				   b6_card_of(item_fields)))
+		retval = 0;
+	for (size = 0; retval && size <= 16; size += 1) {
+		struct item item;
+		if (parse_item(&parser, &schema, doc, &item, size) ||
+		    item.id != 42 || item.active != 1 || item.score != -1 ||
+		    item.at.x != 1 || item.at.y != -2.5 ||
+		    item.name.utf8.nbytes != 15 || item.name.utf8.nchars != 14 ||
+		    memcmp(item.name.utf8.ptr, "caf\xc3\xa9 \"au\" lait", 15))
+			retval = 0;
+		b6_finalize_utf8_string(&item.name);
+	}
+	for (i = 0; retval && i < b6_card_of(malformed); i += 1) {
+		struct item item;
+		if (parse_item(&parser, &schema, malformed[i], &item, 0) !=
+		    B6_JSON_PARSE_ERROR) {
+			fprintf(stderr, "%s should not decode\n", malformed[i]);
+			retval = 0;
+		}
+		b6_finalize_utf8_string(&item.name);
+	}
+	if (b6_array_length(&parser.seen))
+		retval = 0;
+	b6_json_struct_parser_finalize(&parser);
+	b6_json_schema_finalize(&schema);
+	b6_json_schema_finalize(&point_schema);
+	return retval;
+}
+
+static int serialize_struct()
+{
+	static const char doc[] = "{\"id\":-7,\"name\":\"tab\\there\","
+		"\"active\":false,\"score\":0.1,\"at\":{\"x\":1e300,\"y\":-0}}";
+	struct b6_json_struct_parser parser;
+	struct b6_json_schema schema;
+	struct string_ostream os;
+	struct item item;
+	int retval = 1;
+	b6_json_schema_initialize(&point_schema, &stdalloc);
+	b6_json_schema_initialize(&schema, &stdalloc);
+	b6_json_struct_parser_initialize(&parser, &stdalloc);
+	setup_string_ostream(&os);
+	if (b6_json_compile_schema(&point_schema, point_fields,
+				   b6_card_of(point_fields)) ||
+	    b6_json_compile_schema(&schema, item_fields,
+				   b6_card_of(item_fields)) ||
+	    parse_item(&parser, &schema, doc, &item, 0) ||
+	    b6_json_serialize_struct(&schema, &item, &os.up))
+		retval = 0;
+	else if (strcmp(os.buf, doc)) {
+		fprintf(stderr, "expected %s, got %s\n", doc, os.buf);
+		retval = 0;
+	}
+	b6_finalize_utf8_string(&item.name);
+	b6_json_struct_parser_finalize(&parser);
+	b6_json_schema_finalize(&schema);
+	b6_json_schema_finalize(&point_schema);
+	return retval;
+}
+
+int main(int argc, const char *argv[])
+{
+	test_init();
+	test_exec(parse_nested,);
+	test_exec(parse_many_keys,);
+	test_exec(object_order,);
+	test_exec(intern_keys,);
+	test_exec(serialize_simple,);
+	test_exec(serialize_buffered,);
+	test_exec(serialize_array,);
+	test_exec(serialize_array_out_of_memory,);
+	test_exec(parse_buffered,);
+	test_exec(parse_events,);
+	test_exec(parse_events_abort,);
+	test_exec(select_pointer,);
+	test_exec(parse_selected_events,);
+	test_exec(push_parser,);
+	test_exec(push_parser_errors,);
+	test_exec(peek,);
+	test_exec(parser_info,);
+	test_exec(parse_memory,);
+	test_exec(parse_lazy,);
+	test_exec(parse_memory_truncated,);
+	test_exec(parse_file,);
+	test_exec(parse_ndjson,);
+	test_exec(scan_isa,);
+	test_exec(parse_numbers,);
+	test_exec(preserve_integers,);
+	test_exec(integer_conversion,);
+	test_exec(serialize_numbers,);
+	test_exec(parse_cbor,);
+	test_exec(serialize_cbor,);
+	test_exec(parse_struct,);
+	test_exec(serialize_struct,);
+	test_exit();
+	return 0;
+}
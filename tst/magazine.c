@@ -0,0 +1,87 @@
+#include "b6/magazine.h"
+#include "stdalloc.h"
+#include "test.h"
+
+#include <pthread.h>
+
+static int get_put()
+{
+	struct b6_pool pool;
+	struct b6_magazine_depot depot;
+	struct b6_magazine_cache cache;
+	void *ptr[100];
+	int i, retval = 1;
+	b6_pool_initialize(&pool, &stdalloc, 16, 0);
+	b6_magazine_depot_initialize(&depot, &pool, &stdalloc, 8);
+	if (b6_magazine_cache_initialize(&cache, &depot))
+		return 0;
+	for (i = 0; i < b6_card_of(ptr); i += 1)
+		if (!(ptr[i] = b6_allocate(&cache.parent, 16)))
+			retval = 0;
+	for (i = 0; i < b6_card_of(ptr); i += 1)
+		b6_deallocate(&cache.parent, ptr[i]);
+	/* the latest object released is the first to be allocated again */
+	if (b6_magazine_get(&cache) != ptr[b6_card_of(ptr) - 1])
+		retval = 0;
+	b6_magazine_put(&cache, ptr[b6_card_of(ptr) - 1]);
+	if (b6_allocate(&cache.parent, 17))
+		retval = 0;
+	b6_magazine_cache_finalize(&cache);
+	b6_magazine_depot_finalize(&depot);
+	b6_pool_finalize(&pool);
+	return retval;
+}
+
+static void *exchange_thread(void *arg)
+{
+	struct b6_magazine_depot *depot = arg;
+	struct b6_magazine_cache cache;
+	void *ptr[50];
+	long int i, j, retval = 1;
+	if (b6_magazine_cache_initialize(&cache, depot))
+		return NULL;
+	for (j = 0; j < 1000; j += 1) {
+		for (i = 0; i < b6_card_of(ptr); i += 1)
+			if ((ptr[i] = b6_magazine_get(&cache)))
+				*(long int*)ptr[i] = i;
+			else
+				retval = 0;
+		for (i = 0; i < b6_card_of(ptr); i += 1)
+			if (ptr[i] && *(long int*)ptr[i] != i)
+				retval = 0;
+		for (i = 0; i < b6_card_of(ptr); i += 1)
+			if (ptr[i])
+				b6_magazine_put(&cache, ptr[i]);
+	}
+	b6_magazine_cache_finalize(&cache);
+	return (void*)retval;
+}
+
+static int threads()
+{
+	struct b6_pool pool;
+	struct b6_magazine_depot depot;
+	pthread_t threads[4];
+	void *retval;
+	int i, ok = 1;
+	b6_pool_initialize(&pool, &stdalloc, sizeof(long int), 0);
+	b6_magazine_depot_initialize(&depot, &pool, &stdalloc, 16);
+	for (i = 0; i < b6_card_of(threads); i += 1)
+		pthread_create(&threads[i], NULL, exchange_thread, &depot);
+	for (i = 0; i < b6_card_of(threads); i += 1) {
+		pthread_join(threads[i], &retval);
+		ok &= !!retval;
+	}
+	b6_magazine_depot_finalize(&depot);
+	b6_pool_finalize(&pool);
+	return ok;
+}
+
+int main(int argc, const char *argv[])
+{
+	test_init();
+	test_exec(get_put,);
+	test_exec(threads,);
+	test_exit();
+	return 0;
+}
@@ -0,0 +1,135 @@
+#include "b6/mmap.h"
+#include "test.h"
+
+#include <string.h>
+#include <sys/mman.h>
+
+static int allocate_deallocate()
+{
+	struct b6_mmap_allocator mmap;
+	char *a, *b;
+	int retval = 1;
+	if (b6_mmap_allocator_initialize(&mmap, 0))
+		return 0;
+	a = b6_allocate(&mmap.parent, 10);
+	b = b6_allocate(&mmap.parent, 100000);
+	if (!a || !b)
+		retval = 0;
+	memset(a, 1, 10);
+	memset(b, 2, 100000);
+	b6_deallocate(&mmap.parent, a);
+	if (b[99999] != 2)
+		retval = 0;
+	/* b is unmapped by finalize */
+	b6_mmap_allocator_finalize(&mmap);
+	return retval;
+}
+
+static int reallocate()
+{
+	struct b6_mmap_allocator mmap;
+	char *a;
+	int retval = 1;
+	if (b6_mmap_allocator_initialize(&mmap, 0))
+		return 0;
+	a = b6_allocate(&mmap.parent, 10);
+	strcpy(a, "hello");
+	if (b6_reallocate(&mmap.parent, a, 20) != a)
+		retval = 0;
+	if (!(a = b6_reallocate(&mmap.parent, a, 1 << 20)) ||
+	    strcmp(a, "hello"))
+		retval = 0;
+	a[(1 << 20) - 1] = 0;
+	b6_deallocate(&mmap.parent, a);
+	b6_mmap_allocator_finalize(&mmap);
+	return retval;
+}
+
+static int aligned()
+{
+	struct b6_mmap_allocator mmap;
+	void *ptrs[8];
+	unsigned int i;
+	int retval = 1;
+	if (b6_mmap_allocator_initialize(&mmap,
+					 B6_MMAP_HUGETLB | B6_MMAP_HUGEPAGE))
+		return 0;
+	for (i = 0; i < b6_card_of(ptrs); i += 1) {
+		ptrs[i] = b6_allocate_aligned(&mmap.parent,
+					      B6_MMAP_HUGE_PAGE_SIZE,
+					      B6_MMAP_HUGE_PAGE_SIZE);
+		if (!ptrs[i] ||
+		    (unsigned long int)ptrs[i] & (B6_MMAP_HUGE_PAGE_SIZE - 1))
+			return 0;
+		memset(ptrs[i], i, B6_MMAP_HUGE_PAGE_SIZE);
+	}
+	for (i = 0; i < b6_card_of(ptrs); i += 1)
+		b6_deallocate(&mmap.parent, ptrs[i]);
+	b6_mmap_allocator_finalize(&mmap);
+	return retval;
+}
+
+static int reallocate_aligned()
+{
+	struct b6_mmap_allocator allocator;
+	unsigned long int alignment = 1 << 24, size = 1 << 16;
+	char *a, *b;
+	int retval = 1;
+	if (b6_mmap_allocator_initialize(&allocator, 0))
+		return 0;
+	if (!(a = b6_allocate_aligned(&allocator.parent, size, alignment)))
+		retval = 0;
+	/* Block the pages that follow so that the mapping cannot grow. */
+	else if ((b = mmap(a + size, 4096, PROT_READ,
+			   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+		retval = 0;
+	else {
+		strcpy(a, "hello");
+		if (!(a = b6_reallocate(&allocator.parent, a, 4 * size)) ||
+		    (unsigned long int)a & (alignment - 1) || strcmp(a, "hello"))
+			retval = 0;
+		else
+			a[4 * size - 1] = 0;
+		munmap(b, 4096);
+	}
+	b6_mmap_allocator_finalize(&allocator);
+	return retval;
+}
+
+static int pool_of_huge_chunks()
+{
+	struct b6_mmap_allocator mmap;
+	struct b6_pool pool;
+	unsigned long int i, n = 3 * B6_MMAP_HUGE_PAGE_SIZE / 64;
+	int retval = 1;
+	if (b6_mmap_allocator_initialize(&mmap, B6_MMAP_HUGEPAGE))
+		return 0;
+	if (b6_pool_initialize_aligned(&pool, &mmap.parent, 64,
+				       B6_MMAP_HUGE_PAGE_SIZE))
+		retval = 0;
+	else {
+		for (i = 0; i < n; i += 1) {
+			unsigned long int *ptr = b6_pool_get(&pool);
+			if (!ptr) {
+				retval = 0;
+				break;
+			}
+			*ptr = i;
+		}
+		b6_pool_finalize(&pool);
+	}
+	b6_mmap_allocator_finalize(&mmap);
+	return retval;
+}
+
+int main(int argc, const char *argv[])
+{
+	test_init();
+	test_exec(allocate_deallocate,);
+	test_exec(reallocate,);
+	test_exec(aligned,);
+	test_exec(reallocate_aligned,);
+	test_exec(pool_of_huge_chunks,);
+	test_exit();
+	return 0;
+}
@@ -0,0 +1,314 @@
+#include "b6/pool.h"
+#include "stdalloc.h"
+#include "test.h"
+
+static int get_put(struct b6_pool *pool)
+{
+	void *ptr[1000];
+	int i;
+	for (i = 0; i < b6_card_of(ptr); i += 1) {
+		if (!(ptr[i] = b6_pool_get(pool)))
+			return 0;
+		*(int*)ptr[i] = i;
+	}
+	for (i = 0; i < b6_card_of(ptr); i += 2)
+		b6_pool_put(pool, ptr[i]);
+	for (i = 1; i < b6_card_of(ptr); i += 2)
+		if (*(int*)ptr[i] != i)
+			return 0;
+	for (i = 0; i < b6_card_of(ptr); i += 2)
+		if (!(ptr[i] = b6_pool_get(pool)))
+			return 0;
+	for (i = 0; i < b6_card_of(ptr); i += 1)
+		b6_pool_put(pool, ptr[i]);
+	return 1;
+}
+
+static int tree_get_put()
+{
+	struct b6_pool pool;
+	int retval;
+	if (b6_pool_initialize(&pool, &stdalloc, 24, 0))
+		return 0;
+	retval = get_put(&pool);
+	b6_pool_finalize(&pool);
+	return retval;
+}
+
+static int aligned_get_put()
+{
+	struct b6_pool pool;
+	int retval;
+	if (b6_pool_initialize_aligned(&pool, &stdalloc, 24, 0))
+		return 0;
+	retval = get_put(&pool);
+	b6_pool_finalize(&pool);
+	return retval;
+}
+
+static int aligned_chunks()
+{
+	struct b6_pool pool;
+	unsigned long int mask;
+	void *ptr[100];
+	int i, retval = 1;
+	if (b6_pool_initialize_aligned(&pool, &stdalloc, 100, 1024))
+		return 0;
+	mask = ~(1024UL - 1);
+	for (i = 0; i < b6_card_of(ptr); i += 1) {
+		struct b6_chunk *chunk;
+		if (!(ptr[i] = b6_pool_get(&pool))) {
+			retval = 0;
+			break;
+		}
+		chunk = (struct b6_chunk*)((unsigned long int)ptr[i] & mask);
+		if ((void*)chunk == ptr[i] || !chunk->used)
+			retval = 0;
+	}
+	b6_pool_finalize(&pool);
+	return retval;
+}
+
+static int aligned_bad_chunk_size()
+{
+	struct b6_pool pool;
+	return b6_pool_initialize_aligned(&pool, &stdalloc, 8, 3000) &&
+		b6_pool_initialize_aligned(&pool, &stdalloc, 1000, 1024) &&
+		b6_pool_initialize_aligned(&pool, &b6_oom_allocator, 8, 0);
+}
+
+static int huge_objects()
+{
+	struct b6_pool pool;
+	int retval;
+	/* Chunks would be larger than 2^31 bytes. */
+	if (!b6_pool_initialize(&pool, &stdalloc, 1U << 31, 0) ||
+	    !b6_pool_initialize(&pool, &stdalloc, ~0U, 0) ||
+	    !b6_pool_initialize_aligned(&pool, &stdalloc, 1U << 31, 0) ||
+	    !b6_pool_initialize_aligned(&pool, &stdalloc, ~0U, 0))
+		return 0;
+	if (b6_pool_initialize_aligned(&pool, &stdalloc, (1U << 31) - 4096, 0))
+		return 0;
+	retval = pool.chunk_size == 1U << 31;
+	b6_pool_finalize(&pool);
+	return retval;
+}
+
+static int get_put_n()
+{
+	struct b6_pool pool;
+	void *ptr[300], *tmp;
+	unsigned long int i;
+	int retval = 1;
+	if (b6_pool_initialize_aligned(&pool, &stdalloc, 40, 4096))
+		return 0;
+	/* runs span several chunks */
+	if (b6_pool_get_n(&pool, ptr, b6_card_of(ptr)) != b6_card_of(ptr))
+		retval = 0;
+	for (i = 0; i < b6_card_of(ptr); i += 1)
+		*(unsigned long int*)ptr[i] = i;
+	for (i = 0; i < b6_card_of(ptr); i += 1)
+		if (*(unsigned long int*)ptr[i] != i)
+			retval = 0;
+	b6_pool_put_n(&pool, ptr + 100, 100);
+	/* released objects are recycled first, latest released first */
+	if (b6_pool_get(&pool) != ptr[100])
+		retval = 0;
+	if (b6_pool_get_n(&pool, &tmp, 1) != 1 || tmp != ptr[101])
+		retval = 0;
+	b6_deallocate_n(&pool.parent, ptr + 102, 98);
+	b6_pool_put_n(&pool, ptr, 100);
+	b6_pool_put_n(&pool, ptr + 200, 100);
+	b6_pool_put_n(&pool, ptr + 100, 2);
+	if (b6_allocate_n(&pool.parent, 40, ptr, b6_card_of(ptr)) !=
+	    b6_card_of(ptr))
+		retval = 0;
+	b6_deallocate_n(&pool.parent, ptr, b6_card_of(ptr));
+	b6_pool_finalize(&pool);
+	return retval;
+}
+
+static int stats()
+{
+	struct b6_pool pool;
+	struct b6_pool_stats stats;
+	void *ptr[200];
+	unsigned long int i;
+	int retval = 1;
+	if (b6_pool_initialize_aligned(&pool, &stdalloc, 32, 1024))
+		return 0;
+	for (i = 0; i < b6_card_of(ptr); i += 1)
+		ptr[i] = b6_pool_get(&pool);
+	for (i = 0; i < 50; i += 1)
+		b6_pool_put(&pool, ptr[i]);
+	b6_pool_stats(&pool, &stats);
+	if (stats.objects != 150 || stats.used != 150 * 32 ||
+	    stats.queued != 50 || !stats.chunks ||
+	    stats.reserved != stats.chunks * 1024 || stats.flagged != 1)
+		retval = 0;
+	/* counters are zero unless the library is built with B6_POOL_STATS */
+	if (stats.counters.carved && (stats.counters.objects != 150 ||
+				      stats.counters.peak_objects != 200 ||
+				      stats.counters.carved != 200 ||
+				      stats.counters.grown != stats.chunks))
+		retval = 0;
+	b6_pool_finalize(&pool);
+	return retval;
+}
+
+static int trim(int aligned)
+{
+	struct b6_pool pool;
+	struct b6_pool_stats stats;
+	void *ptr[1000];
+	unsigned long int i, chunks;
+	int retval = 1;
+	if (aligned ? b6_pool_initialize_aligned(&pool, &stdalloc, 32, 1024) :
+	    b6_pool_initialize(&pool, &stdalloc, 32, 1024))
+		return 0;
+	for (i = 0; i < b6_card_of(ptr); i += 1)
+		ptr[i] = b6_pool_get(&pool);
+	b6_pool_stats(&pool, &stats);
+	chunks = stats.chunks;
+	/* keep every other object */
+	for (i = 0; i < b6_card_of(ptr) / 2; i += 1)
+		b6_pool_put(&pool, ptr[i]);
+	if (b6_pool_trim(&pool, 2048) < (chunks / 2 - 3) * 1024)
+		retval = 0;
+	b6_pool_stats(&pool, &stats);
+	if (stats.chunks > chunks / 2 + 3 || stats.flagged ||
+	    stats.objects != b6_card_of(ptr) / 2)
+		retval = 0;
+	/* objects of kept chunks are reused */
+	for (i = 0; i < 10; i += 1)
+		if (!(ptr[i] = b6_pool_get(&pool)))
+			retval = 0;
+	b6_pool_stats(&pool, &stats);
+	if (stats.chunks > chunks / 2 + 3)
+		retval = 0;
+	for (i = 0; i < b6_card_of(ptr); i += 1)
+		if (i < 10 || i >= b6_card_of(ptr) / 2)
+			b6_pool_put(&pool, ptr[i]);
+	b6_pool_trim(&pool, 0);
+	b6_pool_stats(&pool, &stats);
+	if (stats.chunks || stats.reserved || stats.queued)
+		retval = 0;
+	/* the pool can be used again */
+	if (!(ptr[0] = b6_pool_get(&pool)))
+		retval = 0;
+	b6_pool_finalize(&pool);
+	return retval;
+}
+
+static int trim_tree()
+{
+	return trim(0);
+}
+
+static int trim_aligned()
+{
+	return trim(1);
+}
+
+static int threshold()
+{
+	struct b6_pool pool;
+	struct b6_pool_stats stats;
+	void *ptr[1000];
+	unsigned long int i;
+	int retval = 1;
+	if (b6_pool_initialize_aligned(&pool, &stdalloc, 32, 1024))
+		return 0;
+	b6_pool_set_threshold(&pool, 4096);
+	for (i = 0; i < b6_card_of(ptr); i += 1)
+		ptr[i] = b6_pool_get(&pool);
+	for (i = 0; i < b6_card_of(ptr) / 2; i += 1)
+		b6_pool_put(&pool, ptr[i]);
+	b6_pool_put_n(&pool, ptr + i, b6_card_of(ptr) - i);
+	b6_pool_stats(&pool, &stats);
+	if (stats.objects || pool.trigger < 2 * 4096 ||
+	    stats.reserved > 4096 + pool.trigger + 1024)
+		retval = 0;
+	b6_pool_finalize(&pool);
+	return retval;
+}
+
+static int threshold_hysteresis()
+{
+	struct b6_pool pool;
+	struct b6_pool_stats stats;
+	void *ptr[1000];
+	unsigned long int i;
+	int retval = 1;
+	if (b6_pool_initialize_aligned(&pool, &stdalloc, 32, 1024))
+		return 0;
+	b6_pool_set_threshold(&pool, 1024);
+	for (i = 0; i < b6_card_of(ptr); i += 1)
+		ptr[i] = b6_pool_get(&pool);
+	/* a long queue without empty chunks */
+	for (i = 1; i < b6_card_of(ptr); i += 2)
+		b6_pool_put(&pool, ptr[i]);
+	/* trims go through the queue: they wait for as many releases */
+	for (i = 0; i < b6_card_of(ptr); i += 2)
+		b6_pool_put(&pool, ptr[i]);
+	b6_pool_stats(&pool, &stats);
+	if (pool.trigger < b6_card_of(ptr) / 2 * 32 ||
+	    stats.reserved > 1024 + pool.trigger + 1024)
+		retval = 0;
+	b6_pool_finalize(&pool);
+	return retval;
+}
+
+/* A chunk which objects were partly dropped from the queue by b6_pool_get is
+ * released by b6_pool_trim instead of being used again without them. */
+static int trim_drained()
+{
+	struct b6_pool pool;
+	struct b6_pool_stats stats;
+	void *a[64], *b[2];
+	unsigned long int n, i;
+	int retval = 1;
+	if (b6_pool_initialize_aligned(&pool, &stdalloc, 32, 1024))
+		return 0;
+	for (n = 0; n < b6_card_of(a); n += 1) {
+		a[n] = b6_pool_get(&pool);
+		if (((unsigned long int)a[n] ^ (unsigned long int)a[0]) &
+		    ~1023UL)
+			break;
+	}
+	b[0] = a[n];
+	b[1] = b6_pool_get(&pool);
+	for (i = 0; i < n / 2; i += 1)
+		b6_pool_put(&pool, a[i]);
+	b6_pool_put(&pool, b[0]);
+	for (; i < n; i += 1)
+		b6_pool_put(&pool, a[i]);
+	/* drops the second half of a, then recycles b[0] */
+	if (b6_pool_get(&pool) != b[0])
+		retval = 0;
+	b6_pool_trim(&pool, 65536);
+	b6_pool_stats(&pool, &stats);
+	if (stats.chunks != 1 || stats.queued || stats.objects != 2)
+		retval = 0;
+	b6_pool_finalize(&pool);
+	return retval;
+}
+
+int main(int argc, const char *argv[])
+{
+	test_init();
+	test_exec(tree_get_put,);
+	test_exec(aligned_get_put,);
+	test_exec(aligned_chunks,);
+	test_exec(aligned_bad_chunk_size,);
+	test_exec(huge_objects,);
+	test_exec(get_put_n,);
+	test_exec(stats,);
+	test_exec(trim_tree,);
+	test_exec(trim_aligned,);
+	test_exec(threshold,);
+	test_exec(threshold_hysteresis,);
+	test_exec(trim_drained,);
+	test_exit();
+	return 0;
+}
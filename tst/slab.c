@@ -0,0 +1,164 @@
+#include "b6/slab.h"
+#include "stdalloc.h"
+#include "test.h"
+
+#include <string.h>
+
+static int classes()
+{
+	static const unsigned long int sizes[] = {
+		16, 24, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024,
+		1536, 2048, 3072, 4096,
+	};
+	unsigned int i;
+	if (b6_slab_class(0) || b6_slab_class(1) || b6_slab_class(16))
+		return 0;
+	for (i = 0; i < B6_SLAB_CLASSES; i += 1) {
+		if (b6_slab_class(sizes[i]) != i)
+			return 0;
+		if (i && b6_slab_class(sizes[i - 1] + 1) != i)
+			return 0;
+	}
+	return b6_slab_class(4097) == B6_SLAB_CLASSES;
+}
+
+static int allocate_deallocate()
+{
+	struct b6_slab slab;
+	void *ptrs[64];
+	unsigned int i;
+	int retval = 1;
+	if (b6_slab_initialize(&slab, &stdalloc, 0))
+		return 0;
+	for (i = 0; i < b6_card_of(ptrs); i += 1) {
+		unsigned long int size = 1 + i * i * 7;
+		if (!(ptrs[i] = b6_allocate(&slab.parent, size))) {
+			retval = 0;
+			break;
+		}
+		memset(ptrs[i], i, size);
+	}
+	while (i--) {
+		unsigned long int size = 1 + i * i * 7;
+		unsigned char *p = ptrs[i];
+		if (p[0] != i || p[size - 1] != i)
+			retval = 0;
+		b6_deallocate(&slab.parent, ptrs[i]);
+	}
+	b6_slab_finalize(&slab);
+	return retval;
+}
+
+static int reallocate()
+{
+	struct b6_slab slab;
+	char *a, *b;
+	int retval = 1;
+	if (b6_slab_initialize(&slab, &stdalloc, 0))
+		return 0;
+	a = b6_allocate(&slab.parent, 17);
+	strcpy(a, "hello");
+	/* same class */
+	if ((b = b6_reallocate(&slab.parent, a, 24)) != a)
+		retval = 0;
+	/* larger class */
+	if (!(b = b6_reallocate(&slab.parent, a, 100)) || b == a ||
+	    strcmp(b, "hello"))
+		retval = 0;
+	/* large object */
+	if (!(a = b6_reallocate(&slab.parent, b, 10000)) || strcmp(a, "hello"))
+		retval = 0;
+	if ((b = b6_reallocate(&slab.parent, a, 9000)) != a)
+		retval = 0;
+	/* back to a small object */
+	if (!(b = b6_reallocate(&slab.parent, a, 8)) || memcmp(b, "hello", 6))
+		retval = 0;
+	b6_deallocate(&slab.parent, b);
+	/* large objects left behind are released by finalize */
+	b6_allocate(&slab.parent, 100000);
+	b6_slab_finalize(&slab);
+	return retval;
+}
+
+struct counting_allocator {
+	struct b6_allocator up;
+	unsigned int aligned;
+};
+
+static void *counting_allocate(struct b6_allocator *up,
+			       unsigned long int size)
+{
+	return b6_allocate(&stdalloc, size);
+}
+
+static void *counting_allocate_aligned(struct b6_allocator *up,
+				       unsigned long int size,
+				       unsigned long int alignment)
+{
+	struct counting_allocator *self =
+		b6_cast_of(up, struct counting_allocator, up);
+	self->aligned += 1;
+	return b6_allocate_aligned(&stdalloc, size, alignment);
+}
+
+static void counting_deallocate(struct b6_allocator *up, void *ptr)
+{
+	b6_deallocate(&stdalloc, ptr);
+}
+
+static int large_objects()
+{
+	static const struct b6_allocator_ops ops = {
+		.allocate = counting_allocate,
+		.deallocate = counting_deallocate,
+		.allocate_aligned = counting_allocate_aligned,
+	};
+	struct counting_allocator allocator = { { &ops }, 0 };
+	struct b6_slab slab;
+	unsigned char *ptrs[32];
+	unsigned int i;
+	int retval = 1;
+	if (b6_slab_initialize(&slab, &allocator.up, 0))
+		return 0;
+	/* Large objects need no chunk alignment. */
+	for (i = 0; i < b6_card_of(ptrs); i += 2)
+		if ((ptrs[i] = b6_allocate(&slab.parent, 5000 + i)))
+			memset(ptrs[i], i, 5000 + i);
+		else
+			retval = 0;
+	if (allocator.aligned)
+		retval = 0;
+	for (i = 1; i < b6_card_of(ptrs); i += 2)
+		if ((ptrs[i] = b6_allocate(&slab.parent, i)))
+			memset(ptrs[i], i, i);
+		else
+			retval = 0;
+	for (i = 0; i < b6_card_of(ptrs); i += 3)
+		if (ptrs[i]) {
+			unsigned long int size = i & 1 ? i : 5000 + i;
+			if (ptrs[i][0] != i || ptrs[i][size - 1] != i)
+				retval = 0;
+			b6_deallocate(&slab.parent, ptrs[i]);
+		}
+	b6_slab_finalize(&slab);
+	return retval;
+}
+
+static int bad_chunk_size()
+{
+	struct b6_slab slab;
+	return b6_slab_initialize(&slab, &stdalloc, 4096) &&
+		b6_slab_initialize(&slab, &stdalloc, 12345);
+}
+
+int main(int argc, const char *argv[])
+{
+	test_init();
+	test_exec(classes,);
+	test_exec(allocate_deallocate,);
+	test_exec(reallocate,);
+	test_exec(large_objects,);
+	test_exec(bad_chunk_size,);
+	test_exit();
+	return 0;
+}
@@ -0,0 +1,39 @@
+#include "stdalloc.h"
+
+#include <stdlib.h>
+
+static void *stdalloc_allocate(struct b6_allocator *self,
+			       unsigned long int size)
+{
+	return malloc(size);
+}
+
+static void *stdalloc_reallocate(struct b6_allocator *self, void *ptr,
+				 unsigned long int size)
+{
+	return realloc(ptr, size);
+}
+
+static void stdalloc_deallocate(struct b6_allocator *self, void *ptr)
+{
+	free(ptr);
+}
+
+static void *stdalloc_allocate_aligned(struct b6_allocator *self,
+				       unsigned long int size,
+				       unsigned long int alignment)
+{
+	void *ptr;
+	if (alignment < sizeof(void*))
+		alignment = sizeof(void*);
+	return posix_memalign(&ptr, alignment, size) ? NULL : ptr;
+}
+
+static const struct b6_allocator_ops stdalloc_ops = {
+	.allocate = stdalloc_allocate,
+	.reallocate = stdalloc_reallocate,
+	.deallocate = stdalloc_deallocate,
+	.allocate_aligned = stdalloc_allocate_aligned,
+};
+
+struct b6_allocator stdalloc = { .ops = &stdalloc_ops, };
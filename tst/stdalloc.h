@@ -0,0 +1,8 @@
+#ifndef STDALLOC_H_
+#define STDALLOC_H_
+
+#include "b6/allocator.h"
+
+extern struct b6_allocator stdalloc;
+
+#endif /* STDALLOC_H_ */